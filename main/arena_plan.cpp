@@ -0,0 +1,193 @@
+// File: main/arena_plan.cpp
+
+#include "arena_plan.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_app_desc.h"
+#include "nvs.h"
+
+#include "tensorflow/lite/micro/micro_allocator.h"
+#include "tensorflow/lite/micro/recording_micro_allocator.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+
+static const char *TAG = "ARENA_PLAN";
+
+#define PLAN_NVS_NAMESPACE "arena_plan"
+
+static_assert((int)tflite::RecordedAllocationType::kNumAllocationTypes <= ARENA_PLAN_TYPES,
+              "arena_plan_t holds fewer allocation types than tflite-micro records");
+
+// RecordedAllocationType order
+static const char *const TYPE_NAMES[ARENA_PLAN_TYPES] = {
+    "eval tensor data",
+    "persistent tensors",
+    "tensor quant data",
+    "persistent buffers",
+    "variable buffers",
+    "node + registration",
+    "op data",
+    "compression data",
+};
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+// NVS key: 'p' + first 6 bytes of the model hash in hex
+static void plan_key(const uint8_t sha[32], char key[16])
+{
+    snprintf(key, 16, "p%02x%02x%02x%02x%02x%02x", sha[0], sha[1], sha[2], sha[3], sha[4], sha[5]);
+}
+
+static const uint8_t *app_sha256(void)
+{
+    return esp_app_get_description()->app_elf_sha256;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t arena_plan_measure(const tflite::Model *model, const tflite::MicroOpResolver &resolver,
+                             size_t probe_bytes, const uint8_t model_sha256[32], arena_plan_t *out)
+{
+    if (!model || !model_sha256 || !out) return ESP_ERR_INVALID_ARG;
+
+    uint8_t *probe = (uint8_t *)heap_caps_malloc(probe_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!probe) {
+        ESP_LOGE(TAG, "Probe arena alloc failed (%u KB)", (unsigned)(probe_bytes / 1024));
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->magic       = ARENA_PLAN_MAGIC;
+    out->version     = ARENA_PLAN_VERSION;
+    out->bytes       = sizeof(*out);
+    out->probe_bytes = (uint32_t)probe_bytes;
+    memcpy(out->model_sha256, model_sha256, sizeof(out->model_sha256));
+    memcpy(out->app_sha256, app_sha256(), sizeof(out->app_sha256));
+
+    const int64_t t0 = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+    {
+        tflite::RecordingMicroInterpreter interp(model, resolver, probe, probe_bytes);
+
+        if (interp.AllocateTensors() != kTfLiteOk) {
+            ESP_LOGE(TAG, "AllocateTensors failed in a %u KB probe arena", (unsigned)(probe_bytes / 1024));
+            err = ESP_ERR_INVALID_SIZE;
+        } else {
+            const tflite::RecordingMicroAllocator &alloc = interp.GetMicroAllocator();
+
+            // What the recording allocator's larger bookkeeping adds to the tail
+            const size_t plain_tail = tflite::MicroAllocator::GetDefaultTailUsage(false);
+            const size_t extra      = tflite::RecordingMicroAllocator::GetDefaultTailUsage() - plain_tail;
+
+            out->arena_bytes         = (uint32_t)(interp.arena_used_bytes() - extra);
+            out->persistent_bytes    = (uint32_t)(alloc.GetSimpleMemoryAllocator()->GetPersistentUsedBytes() - extra);
+            out->nonpersistent_bytes = (uint32_t)alloc.GetSimpleMemoryAllocator()->GetNonPersistentUsedBytes();
+            out->overhead_bytes      = (uint32_t)plain_tail;
+
+            for (int t = 0; t < (int)tflite::RecordedAllocationType::kNumAllocationTypes; t++) {
+                const tflite::RecordedAllocation r =
+                    alloc.GetRecordedAllocation((tflite::RecordedAllocationType)t);
+                out->type_used[t]  = (uint32_t)r.used_bytes;
+                out->type_count[t] = (uint32_t)r.count;
+            }
+        }
+    }
+    heap_caps_free(probe);
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Measured in %lu ms", (unsigned long)((esp_timer_get_time() - t0) / 1000));
+    }
+    return err;
+}
+
+esp_err_t arena_plan_load(const uint8_t model_sha256[32], arena_plan_t *out)
+{
+    if (!model_sha256 || !out) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t h;
+    if (nvs_open(PLAN_NVS_NAMESPACE, NVS_READONLY, &h) != ESP_OK) return ESP_ERR_NOT_FOUND;
+
+    char key[16];
+    plan_key(model_sha256, key);
+
+    size_t len = sizeof(*out);
+    esp_err_t err = nvs_get_blob(h, key, out, &len);
+    nvs_close(h);
+
+    if (err != ESP_OK) return ESP_ERR_NOT_FOUND;
+
+    if (len != sizeof(*out) || out->magic != ARENA_PLAN_MAGIC || out->version != ARENA_PLAN_VERSION ||
+        out->bytes != sizeof(*out) || memcmp(out->model_sha256, model_sha256, 32) != 0) {
+        ESP_LOGW(TAG, "Stored plan %s does not match the model", key);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (memcmp(out->app_sha256, app_sha256(), 32) != 0) {
+        ESP_LOGI(TAG, "Stored plan %s is from other firmware", key);
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+esp_err_t arena_plan_save(const arena_plan_t *plan)
+{
+    if (!plan) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PLAN_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    char key[16];
+    plan_key(plan->model_sha256, key);
+
+    err = nvs_set_blob(h, key, plan, sizeof(*plan));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t arena_plan_erase(const uint8_t model_sha256[32])
+{
+    if (!model_sha256) return ESP_ERR_INVALID_ARG;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(PLAN_NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+
+    char key[16];
+    plan_key(model_sha256, key);
+
+    err = nvs_erase_key(h, key);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+void arena_plan_log(const arena_plan_t *plan, const char *source)
+{
+    if (!plan) return;
+
+    ESP_LOGI(TAG, "Arena plan (%s): %lu B = %lu B non-persistent (activations + scratch) + %lu B persistent; "
+             "measured in a %lu KB probe",
+             source, (unsigned long)plan->arena_bytes, (unsigned long)plan->nonpersistent_bytes,
+             (unsigned long)plan->persistent_bytes, (unsigned long)(plan->probe_bytes / 1024));
+
+    uint32_t typed = 0;
+    for (int t = 0; t < ARENA_PLAN_TYPES; t++) {
+        if (plan->type_count[t] == 0) continue;
+        typed += plan->type_used[t];
+        ESP_LOGI(TAG, "  %-20s %8lu B in %lu allocations",
+                 TYPE_NAMES[t], (unsigned long)plan->type_used[t], (unsigned long)plan->type_count[t]);
+    }
+
+    const uint32_t known = typed + plan->overhead_bytes;
+    ESP_LOGI(TAG, "  %-20s %8lu B", "allocator objects", (unsigned long)plan->overhead_bytes);
+    ESP_LOGI(TAG, "  %-20s %8lu B", "other persistent",
+             (unsigned long)(plan->persistent_bytes > known ? plan->persistent_bytes - known : 0));
+}
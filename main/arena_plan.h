@@ -0,0 +1,69 @@
+// File: main/arena_plan.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+// -----------------------------------------------------------------------------
+// Tensor arena plan
+//
+// Instead of a fixed arena, the model is allocated once into a large probe
+// arena through tflite-micro's RecordingMicroInterpreter, which records what
+// AllocateTensors() takes: the persistent tail (eval tensors, quantization
+// data, node / registration array, op data, persistent buffers) and the
+// non-persistent head laid out by the memory planner (activations plus kernel
+// scratch buffers, which tflite-micro plans together and does not record
+// separately). The arena size a plain MicroInterpreter needs follows from the
+// total minus the recording allocator's extra bookkeeping.
+//
+// The plan is stored in NVS under the model's SHA-256 and is only reused
+// while the firmware ELF hash matches too, since kernel scratch sizes come
+// from the firmware, not the model.
+// -----------------------------------------------------------------------------
+#define ARENA_PLAN_MAGIC    0x4E4C5041u     // "APLN"
+#define ARENA_PLAN_VERSION  1
+#define ARENA_PLAN_TYPES    8               // recorded allocation types kept
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t bytes;                         // sizeof(arena_plan_t)
+    uint8_t  model_sha256[32];
+    uint8_t  app_sha256[32];                // firmware ELF
+    uint32_t arena_bytes;                   // a MicroInterpreter's arena_used_bytes()
+    uint32_t persistent_bytes;              // tail, recording allocator
+    uint32_t nonpersistent_bytes;           // head: planned activations + scratch
+    uint32_t overhead_bytes;                // allocator objects in the tail
+    uint32_t probe_bytes;                   // arena the plan was measured in
+    uint32_t type_used[ARENA_PLAN_TYPES];   // per RecordedAllocationType
+    uint32_t type_count[ARENA_PLAN_TYPES];
+} arena_plan_t;
+
+#ifdef __cplusplus
+namespace tflite {
+class MicroOpResolver;
+struct Model;
+}
+
+// Allocate model into a probe_bytes PSRAM arena with a recording interpreter
+// and fill out (model_sha256 included). Everything is freed again.
+esp_err_t arena_plan_measure(const tflite::Model *model, const tflite::MicroOpResolver &resolver,
+                             size_t probe_bytes, const uint8_t model_sha256[32], arena_plan_t *out);
+
+extern "C" {
+#endif
+
+// Stored plan for this model and firmware. ESP_ERR_NOT_FOUND: none / stale.
+esp_err_t arena_plan_load(const uint8_t model_sha256[32], arena_plan_t *out);
+esp_err_t arena_plan_save(const arena_plan_t *plan);
+esp_err_t arena_plan_erase(const uint8_t model_sha256[32]);
+
+// Breakdown per allocation type
+void arena_plan_log(const arena_plan_t *plan, const char *source);
+
+#ifdef __cplusplus
+}
+#endif
@@ -133,3 +133,20 @@ esp_err_t camera_init(void)
     ESP_LOGI(TAG, "Camera init complete");
     return ESP_OK;
 }
+
+// -----------------------------------------------------------------------------
+// Active frame size
+// -----------------------------------------------------------------------------
+
+esp_err_t camera_get_frame_size(int *width, int *height)
+{
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s || !width || !height) return ESP_FAIL;
+
+    framesize_t fs = s->status.framesize;
+    if (fs >= FRAMESIZE_INVALID) return ESP_FAIL;
+
+    *width  = resolution[fs].width;
+    *height = resolution[fs].height;
+    return ESP_OK;
+}
@@ -8,6 +8,9 @@ extern "C" {
 esp_err_t camera_init(void);
 esp_err_t camera_test_capture(void);
 
+// Active sensor output size (pixels), derived from the configured framesize
+esp_err_t camera_get_frame_size(int *width, int *height);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,323 @@
+// File: main/capture_store.cpp
+
+#include "capture_store.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <dirent.h>
+#include <sys/time.h>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_vfs_fat.h"
+
+#include "sd_writer.h"
+
+static const char *TAG = "CAP_STORE";
+
+#define CAP_PATH_MAX    96
+#define CAP_MOUNT_POINT "/sdcard"     // sdcard.cpp
+
+// On-card layout, mirrored by tools/capture_extract.py
+static_assert(sizeof(cap_seg_hdr_t) == 32, "segment header layout");
+static_assert(sizeof(cap_rec_hdr_t) == 36, "record header layout");
+static_assert(sizeof(cap_idx_hdr_t) == 24, "index header layout");
+static_assert(sizeof(cap_idx_entry_t) == 24, "index entry layout");
+
+// -----------------------------------------------------------------------------
+// State (s_lock)
+// -----------------------------------------------------------------------------
+static capture_store_cfg_t s_cfg;
+static char                s_dir[CAP_PATH_MAX];
+static bool                s_ready = false;
+static SemaphoreHandle_t   s_lock = nullptr;
+
+static bool                s_seg_open = false;     // file pre-allocated, header queued
+static uint32_t            s_seg = 0;              // open (or next) segment number
+static uint32_t            s_nonce = 0;
+static uint32_t            s_off = 0;              // next record offset
+static char                s_seg_path[CAP_PATH_MAX];
+
+static cap_idx_entry_t    *s_index = nullptr;      // PSRAM, max_records
+static int                 s_count = 0;
+static int                 s_count_synced = 0;     // entries in the last queued .idx
+
+static capture_store_stats_t s_st;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static void segment_path(char *out, size_t cap, uint32_t seg, const char *ext)
+{
+    snprintf(out, cap, "%s/seg_%06lu.%s", s_dir, (unsigned long)seg, ext);
+}
+
+// Highest existing segment number + 1; one directory scan at boot
+static uint32_t next_segment_number(void)
+{
+    uint32_t next = 1;
+
+    DIR *dir = opendir(s_dir);
+    if (!dir) return next;
+
+    struct dirent *e;
+    while ((e = readdir(dir)) != nullptr) {
+        unsigned long n = 0;
+        char ext[4] = {};
+        if (sscanf(e->d_name, "seg_%lu.%3s", &n, ext) == 2 &&
+            (strcasecmp(ext, "cap") == 0 || strcasecmp(ext, "idx") == 0)) {
+            next = std::max(next, (uint32_t)n + 1);
+        }
+    }
+    closedir(dir);
+    return next;
+}
+
+static int64_t wall_clock_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+// Queue <segment>.idx with the entries so far (replaces the previous one)
+static esp_err_t queue_index(void)
+{
+    if (!s_seg_open || s_count == s_count_synced) return ESP_OK;
+
+    cap_idx_hdr_t hdr = {};
+    hdr.magic       = CAP_IDX_MAGIC;
+    hdr.version     = CAP_VERSION;
+    hdr.entry_bytes = sizeof(cap_idx_entry_t);
+    hdr.segment     = s_seg;
+    hdr.nonce       = s_nonce;
+    hdr.count       = (uint32_t)s_count;
+    hdr.entries_crc = esp_rom_crc32_le(s_nonce, (const uint8_t *)s_index,
+                                       s_count * sizeof(cap_idx_entry_t));
+
+    char path[CAP_PATH_MAX];
+    segment_path(path, sizeof(path), s_seg, "idx");
+
+    esp_err_t err = sd_writer_submit(path, &hdr, sizeof(hdr),
+                                     s_index, s_count * sizeof(cap_idx_entry_t), 0);
+    if (err == ESP_OK) s_count_synced = s_count;
+    return err;
+}
+
+static void seal_segment(void)
+{
+    if (!s_seg_open) return;
+
+    if (queue_index() != ESP_OK) {
+        ESP_LOGW(TAG, "Index of segment %lu dropped; extract by scanning", (unsigned long)s_seg);
+    }
+    ESP_LOGI(TAG, "Sealed %s: %d records, %lu KB",
+             s_seg_path, s_count, (unsigned long)(s_off / 1024));
+
+    s_seg_open = false;
+    s_seg++;
+}
+
+// Pre-allocate the next segment contiguously and queue its header
+static esp_err_t open_segment(void)
+{
+    segment_path(s_seg_path, sizeof(s_seg_path), s_seg, "cap");
+
+    const int64_t t0 = esp_timer_get_time();
+    esp_err_t err = esp_vfs_fat_create_contiguous_file(CAP_MOUNT_POINT, s_seg_path, s_cfg.segment_bytes, true);
+    const uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+    s_st.prealloc_us_max = std::max(s_st.prealloc_us_max, dt);
+
+    if (err != ESP_OK) {
+        // Still usable, the file just grows cluster by cluster
+        ESP_LOGW(TAG, "Pre-allocating %s failed (%s)", s_seg_path, esp_err_to_name(err));
+    }
+
+    cap_seg_hdr_t hdr = {};
+    hdr.magic         = CAP_SEG_MAGIC;
+    hdr.version       = CAP_VERSION;
+    hdr.header_bytes  = sizeof(hdr);
+    hdr.segment       = s_seg;
+    hdr.nonce         = esp_random();
+    hdr.created_us    = wall_clock_us();
+    hdr.segment_bytes = s_cfg.segment_bytes;
+    hdr.header_crc    = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(cap_seg_hdr_t, header_crc));
+
+    err = sd_writer_submit_at(s_seg_path, 0, &hdr, sizeof(hdr), nullptr, 0, 0);
+    if (err != ESP_OK) {
+        // Skip the number: the file may exist without a header
+        s_seg++;
+        return err;
+    }
+
+    s_nonce        = hdr.nonce;
+    s_off          = sizeof(hdr);
+    s_count        = 0;
+    s_count_synced = 0;
+    s_seg_open     = true;
+
+    s_st.segment = s_seg;
+    s_st.segments_opened++;
+
+    ESP_LOGI(TAG, "Opened %s (%lu MB, pre-allocated in %lu ms)",
+             s_seg_path, (unsigned long)(s_cfg.segment_bytes >> 20), (unsigned long)(dt / 1000));
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t capture_store_init(const capture_store_cfg_t *cfg)
+{
+    if (!cfg || !cfg->dir || cfg->max_records <= 0 || cfg->index_every < 0 ||
+        cfg->segment_bytes < 1024 * 1024 || strlen(cfg->dir) + 16 >= CAP_PATH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!sd_writer_ready()) return ESP_ERR_INVALID_STATE;
+
+    if (s_ready) {
+        ESP_LOGW(TAG, "Capture store already initialized");
+        return ESP_OK;
+    }
+
+    s_cfg = *cfg;
+    strcpy(s_dir, cfg->dir);
+
+    s_index = (cap_idx_entry_t *)heap_caps_malloc(cfg->max_records * sizeof(cap_idx_entry_t),
+                                                  MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_lock  = xSemaphoreCreateMutex();
+
+    if (!s_index || !s_lock) {
+        ESP_LOGE(TAG, "Capture store alloc failed");
+        heap_caps_free(s_index);
+        if (s_lock) vSemaphoreDelete(s_lock);
+        s_index = nullptr;
+        s_lock  = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&s_st, 0, sizeof(s_st));
+    s_seg   = next_segment_number();
+    s_ready = true;
+
+    ESP_LOGI(TAG, "Capture store %s: next segment %lu, %lu MB segments, %d records each",
+             s_dir, (unsigned long)s_seg, (unsigned long)(cfg->segment_bytes >> 20), cfg->max_records);
+
+    return ESP_OK;
+}
+
+bool capture_store_ready(void)
+{
+    return s_ready;
+}
+
+esp_err_t capture_store_append(
+    cap_rec_type_t type,
+    uint32_t seq,
+    int64_t time_us,
+    uint16_t width,
+    uint16_t height,
+    const void *data,
+    size_t len,
+    uint32_t flags)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+    if (!data && len) return ESP_ERR_INVALID_ARG;
+
+    const size_t need = sizeof(cap_rec_hdr_t) + len;
+    if (need + sizeof(cap_seg_hdr_t) > s_cfg.segment_bytes) return ESP_ERR_INVALID_SIZE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (s_seg_open && (s_off + need > s_cfg.segment_bytes || s_count == s_cfg.max_records)) {
+        seal_segment();
+    }
+
+    esp_err_t err = ESP_OK;
+    if (!s_seg_open) err = open_segment();
+
+    if (err == ESP_OK) {
+        cap_rec_hdr_t hdr = {};
+        hdr.magic        = CAP_REC_MAGIC;
+        hdr.type         = (uint16_t)type;
+        hdr.header_bytes = sizeof(hdr);
+        hdr.seq          = seq;
+        hdr.len          = (uint32_t)len;
+        hdr.time_us      = time_us;
+        hdr.width        = width;
+        hdr.height       = height;
+        hdr.payload_crc  = esp_rom_crc32_le(s_nonce, (const uint8_t *)data, len);
+        hdr.header_crc   = esp_rom_crc32_le(s_nonce, (const uint8_t *)&hdr, offsetof(cap_rec_hdr_t, header_crc));
+
+        // Only a queued record advances the offset, so drops leave no holes
+        err = sd_writer_submit_at(s_seg_path, s_off, &hdr, sizeof(hdr), data, len,
+                                  flags & SD_WRITE_OPTIONAL);
+    }
+
+    if (err == ESP_OK) {
+        cap_idx_entry_t *e = &s_index[s_count++];
+        e->offset   = s_off;
+        e->seq      = seq;
+        e->len      = (uint32_t)len;
+        e->type     = (uint16_t)type;
+        e->reserved = 0;
+        e->time_us  = time_us;
+
+        s_off += need;
+
+        s_st.records++;
+        s_st.bytes += need;
+        s_st.segment_used = s_off;
+
+        if (s_cfg.index_every > 0 && s_count - s_count_synced >= s_cfg.index_every) {
+            queue_index();
+        }
+    } else {
+        s_st.dropped++;
+    }
+
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t capture_store_sync(void)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = queue_index();
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void capture_store_get_stats(capture_store_stats_t *out)
+{
+    if (s_lock) xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_st;
+    if (s_lock) xSemaphoreGive(s_lock);
+}
+
+void capture_store_log_stats(void)
+{
+    if (!s_ready) return;
+
+    capture_store_stats_t s;
+    capture_store_get_stats(&s);
+
+    ESP_LOGI(TAG, "segment=%lu used=%lu/%lu KB opened=%lu records=%lu dropped=%lu bytes=%llu KB prealloc max=%lu ms",
+             (unsigned long)s.segment,
+             (unsigned long)(s.segment_used / 1024), (unsigned long)(s_cfg.segment_bytes / 1024),
+             (unsigned long)s.segments_opened, (unsigned long)s.records, (unsigned long)s.dropped,
+             (unsigned long long)(s.bytes / 1024), (unsigned long)(s.prealloc_us_max / 1000));
+}
@@ -0,0 +1,139 @@
+// File: main/capture_store.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Segmented append-only capture store
+//
+// Instead of three files per frame in one ever-growing FAT directory, frames
+// are appended as records to large segment files, pre-allocated contiguously
+// when opened:
+//
+//   <dir>/seg_NNNNNN.cap   segment header, then records back to back
+//   <dir>/seg_NNNNNN.idx   index of the segment's records (rewritten every
+//                          index_every records and when the segment is sealed)
+//
+// Each record is a header (type, seq, wall-clock time, size, CRCs) followed
+// by the payload. All CRC-32s except the segment header's are seeded with a
+// random per-segment nonce, so stale records left in re-used clusters never
+// validate; a reader stops scanning at the first record that does not.
+// Writes go through the SD writer (sd_writer.h) as positional appends, so the
+// per-frame cost is one open of a small directory plus sequential transfers.
+//
+// tools/capture_extract.py lists / extracts segments on the host.
+//
+// Layout (little-endian, packed):
+//   segment header (32 B): magic 'CAPS', version, header_bytes, segment,
+//       nonce, created_us, segment_bytes, crc32(previous 28 B)
+//   record header (36 B): magic 'CAPR', type, header_bytes, seq, len,
+//       time_us, width, height, crc32(payload), crc32(previous 32 B)
+//   index (24 B + 24 B per record): magic 'CAPI', version, entry_bytes,
+//       segment, nonce, count, crc32(entries); entries: offset, seq, len,
+//       type, reserved, time_us
+// -----------------------------------------------------------------------------
+#define CAP_SEG_MAGIC   0x53504143u     // "CAPS"
+#define CAP_REC_MAGIC   0x52504143u     // "CAPR"
+#define CAP_IDX_MAGIC   0x49504143u     // "CAPI"
+#define CAP_VERSION     1
+
+typedef enum {
+    CAP_REC_JPEG = 1,               // camera JPEG
+    CAP_REC_RGB888_CROP,            // width × height RGB888, aspect crop
+    CAP_REC_RGB888_LETTERBOX,       // width × height RGB888, model input letterbox
+} cap_rec_type_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes;
+    uint32_t segment;
+    uint32_t nonce;
+    int64_t  created_us;
+    uint32_t segment_bytes;
+    uint32_t header_crc;
+} cap_seg_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t header_bytes;
+    uint32_t seq;
+    uint32_t len;
+    int64_t  time_us;               // wall clock, µs since the epoch
+    uint16_t width;
+    uint16_t height;
+    uint32_t payload_crc;
+    uint32_t header_crc;
+} cap_rec_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t entry_bytes;
+    uint32_t segment;
+    uint32_t nonce;
+    uint32_t count;
+    uint32_t entries_crc;
+} cap_idx_hdr_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t offset;                // record header offset in the segment
+    uint32_t seq;
+    uint32_t len;
+    uint16_t type;
+    uint16_t reserved;
+    int64_t  time_us;
+} cap_idx_entry_t;
+
+typedef struct {
+    const char *dir;                // e.g. "/sdcard/capture"
+    uint32_t    segment_bytes;      // pre-allocated size per segment
+    int         max_records;        // per segment (index capacity)
+    int         index_every;        // rewrite the index every N records (0: only on seal)
+} capture_store_cfg_t;
+
+typedef struct {
+    uint32_t segment;               // open segment number
+    uint32_t segment_used;          // bytes queued in it
+    uint32_t segments_opened;
+    uint32_t records;               // records queued
+    uint32_t dropped;               // refused by the SD writer
+    uint64_t bytes;
+    uint32_t prealloc_us_max;       // worst segment pre-allocation
+} capture_store_stats_t;
+
+// Needs sd_writer_init() first. Continues after the highest segment in dir.
+esp_err_t capture_store_init(const capture_store_cfg_t *cfg);
+bool      capture_store_ready(void);
+
+// Queue one record; data is copied. flags: SD_WRITE_OPTIONAL or 0.
+// ESP_ERR_NO_MEM: dropped by the SD writer (the segment stays contiguous).
+esp_err_t capture_store_append(
+    cap_rec_type_t type,
+    uint32_t seq,
+    int64_t time_us,
+    uint16_t width,
+    uint16_t height,
+    const void *data,
+    size_t len,
+    uint32_t flags
+);
+
+// Queue the open segment's index now
+esp_err_t capture_store_sync(void);
+
+void capture_store_get_stats(capture_store_stats_t *out);
+void capture_store_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
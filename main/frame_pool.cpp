@@ -0,0 +1,228 @@
+// File: main/frame_pool.cpp
+
+#include "frame_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/queue.h"
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "FPOOL";
+
+#define FRAME_POOL_MAX_SLOTS 8
+#define FRAME_POOL_ALIGN     16
+
+static frame_pool_cfg_t s_cfg;
+static frame_slot_t     s_slots[FRAME_POOL_MAX_SLOTS];
+static frame_scratch_t  s_scratch;
+static uint8_t         *s_arena = nullptr;
+static size_t           s_arena_size = 0;
+static QueueHandle_t    s_free = nullptr;
+
+static volatile uint32_t s_acquire_fail = 0;
+
+// Heap guard state
+static uint32_t s_guard_frames = 0;
+static bool     s_guard_armed  = false;
+static size_t   s_base_min_spiram   = 0;
+static size_t   s_base_min_internal = 0;
+
+static size_t align_up(size_t v)
+{
+    return (v + (FRAME_POOL_ALIGN - 1)) & ~(size_t)(FRAME_POOL_ALIGN - 1);
+}
+
+// -----------------------------------------------------------------------------
+// Init: size, allocate once, carve
+// -----------------------------------------------------------------------------
+esp_err_t frame_pool_init(const frame_pool_cfg_t *cfg)
+{
+    if (s_arena) {
+        ESP_LOGW(TAG, "Frame pool already initialized");
+        return ESP_OK;
+    }
+
+    if (!cfg || cfg->slot_count <= 0 || cfg->slot_count > FRAME_POOL_MAX_SLOTS ||
+        cfg->src_w <= 0 || cfg->src_h <= 0 || cfg->dst_w <= 0 || cfg->dst_h <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_cfg = *cfg;
+
+    const size_t src_px   = (size_t)cfg->src_w * cfg->src_h;
+    const size_t dst_px   = (size_t)cfg->dst_w * cfg->dst_h;
+
+    // QVGA JPEG at quality 10 stays well below 0.5 byte/pixel
+    const size_t jpeg_cap = align_up(src_px / 2);
+    const size_t rgb_dst  = align_up(dst_px * 3);
+    const size_t in_bytes = align_up(dst_px * cfg->dst_ch);
+    const size_t out_b    = align_up(cfg->output_bytes);
+
+    const size_t per_slot = jpeg_cap + 2 * rgb_dst + in_bytes + out_b;
+
+    const size_t aux_ch     = cfg->dst_ch > 3 ? cfg->dst_ch : 3;
+    const size_t scratchaux = cfg->full_frame_scratch ? align_up(dst_px * aux_ch) : 0;
+    const size_t scratch888 = cfg->full_frame_scratch ? align_up(src_px * 3) : 0;
+
+    s_arena_size = per_slot * cfg->slot_count + scratchaux + scratch888;
+
+    s_arena = (uint8_t *)heap_caps_aligned_alloc(
+        FRAME_POOL_ALIGN, s_arena_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s_arena) {
+        ESP_LOGE(TAG, "Frame arena alloc failed (%u bytes)", (unsigned)s_arena_size);
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_free = xQueueCreate(cfg->slot_count, sizeof(frame_slot_t *));
+    if (!s_free) {
+        heap_caps_free(s_arena);
+        s_arena = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint8_t *p = s_arena;
+
+    for (int i = 0; i < cfg->slot_count; i++) {
+        frame_slot_t *s = &s_slots[i];
+
+        s->index      = i;
+        s->refs       = 0;
+        s->jpeg       = p;                 p += jpeg_cap;
+        s->jpeg_cap   = jpeg_cap;
+        s->rgb_crop   = p;                 p += rgb_dst;
+        s->rgb_nocrop = p;                 p += rgb_dst;
+        s->input_i8   = (int8_t *)p;       p += in_bytes;
+        s->output_i8  = (int8_t *)p;       p += out_b;
+
+        xQueueSend(s_free, &s, 0);
+    }
+
+    s_scratch.aux         = p;   p += scratchaux;
+    s_scratch.aux_size    = scratchaux;
+    s_scratch.rgb         = p;   p += scratch888;
+    s_scratch.rgb_size    = scratch888;
+
+    ESP_LOGI(TAG, "Frame arena: %u bytes PSRAM, %d slots x %u bytes + %u bytes decode scratch (src %dx%d, dst %dx%dx%d)",
+             (unsigned)s_arena_size,
+             cfg->slot_count,
+             (unsigned)per_slot,
+             (unsigned)(scratchaux + scratch888),
+             cfg->src_w, cfg->src_h,
+             cfg->dst_w, cfg->dst_h, cfg->dst_ch);
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Acquire / release
+// -----------------------------------------------------------------------------
+frame_slot_t *frame_pool_acquire(TickType_t wait)
+{
+    frame_slot_t *s = nullptr;
+
+    if (!s_free || xQueueReceive(s_free, &s, wait) != pdTRUE) {
+        s_acquire_fail++;
+        return nullptr;
+    }
+
+    s->jpeg_len = 0;
+    __atomic_store_n(&s->refs, 1, __ATOMIC_RELEASE);
+    return s;
+}
+
+void frame_slot_ref(frame_slot_t *slot)
+{
+    if (!slot) return;
+    __atomic_add_fetch(&slot->refs, 1, __ATOMIC_ACQ_REL);
+}
+
+bool frame_slot_try_ref(frame_slot_t *slot)
+{
+    if (!slot) return false;
+
+    int32_t refs = __atomic_load_n(&slot->refs, __ATOMIC_ACQUIRE);
+    while (refs > 0) {
+        if (__atomic_compare_exchange_n(&slot->refs, &refs, refs + 1, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void frame_pool_release(frame_slot_t *slot)
+{
+    if (!slot || !s_free) return;
+
+    const int32_t left = __atomic_sub_fetch(&slot->refs, 1, __ATOMIC_ACQ_REL);
+    if (left > 0) return;
+
+    if (left < 0) {
+        ESP_LOGE(TAG, "Slot %d released more often than referenced", slot->index);
+        return;
+    }
+
+    xQueueSend(s_free, &slot, 0);
+}
+
+const frame_scratch_t *frame_pool_scratch(void)
+{
+    return (s_arena && s_cfg.full_frame_scratch) ? &s_scratch : nullptr;
+}
+
+uint32_t frame_pool_free_slots(void)
+{
+    return s_free ? (uint32_t)uxQueueMessagesWaiting(s_free) : 0;
+}
+
+uint32_t frame_pool_acquire_failures(void)
+{
+    return s_acquire_fail;
+}
+
+// -----------------------------------------------------------------------------
+// Heap-watermark guard
+// -----------------------------------------------------------------------------
+void frame_pool_heap_guard_check(uint32_t seq)
+{
+    if (s_cfg.heap_guard == FRAME_POOL_HEAP_GUARD_OFF) return;
+
+    const size_t min_spiram   = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+    const size_t min_internal = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+
+    if (!s_guard_armed) {
+        if (++s_guard_frames < s_cfg.heap_guard_warmup) return;
+
+        s_base_min_spiram   = min_spiram;
+        s_base_min_internal = min_internal;
+        s_guard_armed = true;
+
+        ESP_LOGI(TAG, "Heap guard armed after %lu frames: min free SPIRAM=%u internal=%u (slack=%u)",
+                 (unsigned long)s_guard_frames,
+                 (unsigned)min_spiram,
+                 (unsigned)min_internal,
+                 (unsigned)s_cfg.heap_guard_slack);
+        return;
+    }
+
+    const bool spiram_regressed   = min_spiram   + s_cfg.heap_guard_slack < s_base_min_spiram;
+    const bool internal_regressed = min_internal + s_cfg.heap_guard_slack < s_base_min_internal;
+
+    if (!spiram_regressed && !internal_regressed) return;
+
+    ESP_LOGE(TAG, "Heap guard: frame %lu lowered heap watermark (SPIRAM %u → %u, internal %u → %u)",
+             (unsigned long)seq,
+             (unsigned)s_base_min_spiram, (unsigned)min_spiram,
+             (unsigned)s_base_min_internal, (unsigned)min_internal);
+
+    if (s_cfg.heap_guard == FRAME_POOL_HEAP_GUARD_ASSERT) {
+        abort();
+    }
+
+    // Log mode: re-baseline so each regression is reported once
+    s_base_min_spiram   = min_spiram;
+    s_base_min_internal = min_internal;
+}
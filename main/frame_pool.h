@@ -0,0 +1,103 @@
+// File: main/frame_pool.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Frame arena
+//
+// All per-frame buffers are carved out of one PSRAM block at init, sized from
+// the camera resolution and the model input/output dims. Pipeline stages take
+// a slot, fill its buffers through the *_into() APIs and give it back; the
+// steady-state frame loop never calls malloc/free.
+//
+// Slots are reference counted so the pipeline and the HTTP preview clients
+// can share one JPEG copy: acquire returns a slot holding one reference,
+// frame_slot_ref() adds one, and the slot returns to the pool when the last
+// holder calls frame_pool_release().
+// -----------------------------------------------------------------------------
+typedef enum {
+    FRAME_POOL_HEAP_GUARD_OFF = 0,
+    FRAME_POOL_HEAP_GUARD_LOG,      // log watermark regressions
+    FRAME_POOL_HEAP_GUARD_ASSERT,   // abort on watermark regressions
+} frame_pool_heap_guard_t;
+
+typedef struct {
+    int    src_w;           // camera frame
+    int    src_h;
+    int    dst_w;           // model input
+    int    dst_h;
+    int    dst_ch;
+    size_t output_bytes;    // model output tensor
+    int    slot_count;
+    bool   full_frame_scratch;  // reserve src_w × src_h RGB888 decode scratch + one model-input buffer
+
+    frame_pool_heap_guard_t heap_guard;
+    uint32_t heap_guard_warmup;   // frames before the baseline is taken
+    size_t   heap_guard_slack;    // bytes tolerated for other tasks
+} frame_pool_cfg_t;
+
+typedef struct {
+    int      index;
+
+    volatile int32_t refs;  // holders; back to the pool at 0
+
+    uint8_t *jpeg;          // camera JPEG copy
+    size_t   jpeg_cap;
+    size_t   jpeg_len;      // valid bytes in jpeg
+
+    uint8_t *rgb_crop;      // dst_w × dst_h × 3, aspect crop
+    uint8_t *rgb_nocrop;    // dst_w × dst_h × 3, letterbox
+    int8_t  *input_i8;      // dst_w × dst_h × dst_ch
+    int8_t  *output_i8;     // output_bytes
+} frame_slot_t;
+
+// Full-frame decode scratch, owned by the (single) preprocess stage.
+// Only present when full_frame_scratch was requested.
+typedef struct {
+    uint8_t *aux;           // dst_w × dst_h × max(3, dst_ch), A/B reference output
+    size_t   aux_size;
+    uint8_t *rgb;           // src_w × src_h × 3, decoded frame
+    size_t   rgb_size;
+} frame_scratch_t;
+
+esp_err_t frame_pool_init(const frame_pool_cfg_t *cfg);
+
+// Returns NULL if no slot becomes free within wait. The slot holds one reference.
+frame_slot_t *frame_pool_acquire(TickType_t wait);
+
+// Add a reference (any task)
+void frame_slot_ref(frame_slot_t *slot);
+
+// Add a reference only if the slot still has one (lock-free). For readers
+// that found the slot through a shared pointer without holding a reference:
+// false means it went back to the pool; true does not prove it still holds
+// the same frame, so the caller re-checks the pointer afterwards.
+bool frame_slot_try_ref(frame_slot_t *slot);
+
+// Drop a reference; the last one returns the slot to the pool (any task)
+void frame_pool_release(frame_slot_t *slot);
+
+const frame_scratch_t *frame_pool_scratch(void);
+
+uint32_t frame_pool_free_slots(void);
+uint32_t frame_pool_acquire_failures(void);
+
+// -----------------------------------------------------------------------------
+// Heap-watermark guard: call once per completed frame. After warm-up the
+// PSRAM / internal free-size watermarks must not move down any more.
+// -----------------------------------------------------------------------------
+void frame_pool_heap_guard_check(uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
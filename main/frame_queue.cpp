@@ -0,0 +1,114 @@
+// File: main/frame_queue.cpp
+
+#include "frame_queue.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "FQUEUE";
+
+// -----------------------------------------------------------------------------
+// Init
+// -----------------------------------------------------------------------------
+esp_err_t frame_queue_init(
+    frame_queue_t *fq,
+    const char *name,
+    int capacity,
+    frame_queue_drop_cb_t on_drop)
+{
+    if (!fq || capacity <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(fq, 0, sizeof(*fq));
+
+    fq->q = xQueueCreate(capacity, sizeof(void *));
+    if (!fq->q) {
+        ESP_LOGE(TAG, "%s: queue alloc failed", name);
+        return ESP_ERR_NO_MEM;
+    }
+
+    fq->name     = name;
+    fq->on_drop  = on_drop;
+    fq->capacity = (uint32_t)capacity;
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Push (never blocks; drop-oldest when full)
+// -----------------------------------------------------------------------------
+bool frame_queue_push_drop_oldest(frame_queue_t *fq, void *item)
+{
+    bool dropped = false;
+
+    while (xQueueSend(fq->q, &item, 0) != pdTRUE) {
+        // Full: evict the oldest entry. If the consumer raced us and emptied
+        // a slot, the receive fails and the next send succeeds.
+        void *old = nullptr;
+        if (xQueueReceive(fq->q, &old, 0) == pdTRUE) {
+            fq->dropped++;
+            dropped = true;
+
+            ESP_LOGW(TAG, "%s: full, dropped oldest (total drops=%lu)",
+                     fq->name, (unsigned long)fq->dropped);
+
+            if (fq->on_drop && old) {
+                fq->on_drop(old);
+            }
+        }
+    }
+
+    fq->pushed++;
+
+    uint32_t depth = (uint32_t)uxQueueMessagesWaiting(fq->q);
+    if (depth > fq->depth_max) {
+        fq->depth_max = depth;
+    }
+
+    return dropped;
+}
+
+// -----------------------------------------------------------------------------
+// Pop
+// -----------------------------------------------------------------------------
+void *frame_queue_pop(frame_queue_t *fq, TickType_t wait)
+{
+    void *item = nullptr;
+
+    if (xQueueReceive(fq->q, &item, wait) != pdTRUE) {
+        return nullptr;
+    }
+
+    fq->popped++;
+    return item;
+}
+
+// -----------------------------------------------------------------------------
+// Stats
+// -----------------------------------------------------------------------------
+void frame_queue_get_stats(const frame_queue_t *fq, frame_queue_stats_t *out)
+{
+    out->pushed    = fq->pushed;
+    out->popped    = fq->popped;
+    out->dropped   = fq->dropped;
+    out->depth     = (uint32_t)uxQueueMessagesWaiting(fq->q);
+    out->depth_max = fq->depth_max;
+    out->capacity  = fq->capacity;
+}
+
+void frame_queue_log_stats(const frame_queue_t *fq)
+{
+    frame_queue_stats_t s;
+    frame_queue_get_stats(fq, &s);
+
+    ESP_LOGI(TAG, "%-10s depth=%lu/%lu max=%lu pushed=%lu popped=%lu dropped=%lu",
+             fq->name,
+             (unsigned long)s.depth,
+             (unsigned long)s.capacity,
+             (unsigned long)s.depth_max,
+             (unsigned long)s.pushed,
+             (unsigned long)s.popped,
+             (unsigned long)s.dropped);
+}
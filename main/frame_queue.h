@@ -0,0 +1,63 @@
+// File: main/frame_queue.h
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Bounded pointer queue between pipeline stages
+//
+// Producers never block: when the queue is full the OLDEST pending item is
+// evicted, handed to on_drop() and counted, then the new item is enqueued.
+// -----------------------------------------------------------------------------
+typedef void (*frame_queue_drop_cb_t)(void *item);
+
+typedef struct {
+    uint32_t pushed;     // items accepted
+    uint32_t popped;     // items handed to the consumer
+    uint32_t dropped;    // items evicted by drop-oldest
+    uint32_t depth;      // items currently waiting
+    uint32_t depth_max;  // high-water mark of depth
+    uint32_t capacity;
+} frame_queue_stats_t;
+
+typedef struct {
+    const char           *name;
+    QueueHandle_t         q;
+    frame_queue_drop_cb_t on_drop;
+
+    volatile uint32_t     pushed;
+    volatile uint32_t     popped;
+    volatile uint32_t     dropped;
+    volatile uint32_t     depth_max;
+    uint32_t              capacity;
+} frame_queue_t;
+
+esp_err_t frame_queue_init(
+    frame_queue_t *fq,
+    const char *name,
+    int capacity,
+    frame_queue_drop_cb_t on_drop
+);
+
+// Enqueue, evicting the oldest item if full. Returns true if an item was dropped.
+bool frame_queue_push_drop_oldest(frame_queue_t *fq, void *item);
+
+// Dequeue; returns NULL on timeout.
+void *frame_queue_pop(frame_queue_t *fq, TickType_t wait);
+
+void frame_queue_get_stats(const frame_queue_t *fq, frame_queue_stats_t *out);
+
+void frame_queue_log_stats(const frame_queue_t *fq);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,16 @@
 #include "httpd.h"
 
 #include <string.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 
 static const char *TAG = "HTTPD";
@@ -14,38 +18,207 @@ static const char *TAG = "HTTPD";
 static httpd_handle_t s_server = NULL;
 
 // -----------------------------------------------------------------------------
-// Last-frame storage (RAM only)
+// /stream config
 // -----------------------------------------------------------------------------
+#define STREAM_MAX_CLIENTS     HTTPD_STREAM_MAX_CLIENTS
+#define STREAM_MIN_INTERVAL_MS 200    // per-client pacing (max ~5 fps)
+#define STREAM_WAIT_MS         2000   // wake-up period without new frames
+#define STREAM_TASK_STACK      4096
+#define STREAM_TASK_PRIO       3      // below every pipeline stage
 
-static uint8_t *s_last_jpeg = NULL;
-static size_t   s_last_jpeg_len = 0;
-static SemaphoreHandle_t s_jpeg_mutex = NULL;
+#define STREAM_BOUNDARY        "frame"
 
 // -----------------------------------------------------------------------------
-// Public API: update last captured frame
+// Latest frame: shared frame_pool slot
+//
+// The preview keeps a reference to the newest captured slot. The producer
+// swaps the pointer with an atomic exchange and drops its reference to the
+// previous frame; it never takes a lock or waits on a client. /latest.jpg and
+// each stream worker take their own reference and send straight from the
+// slot, which goes back to the pool when the last of them releases it. The
+// pool is sized for that (HTTPD_PREVIEW_SLOTS).
 // -----------------------------------------------------------------------------
 
-void httpd_update_last_frame(const uint8_t *data, size_t len)
+static frame_slot_t *volatile s_latest = NULL;
+static volatile uint32_t      s_latest_seq = 0;  // bumped per published frame
+
+// Reference to the latest frame, NULL: none yet. The slot can be swapped out
+// and released between loading the pointer and taking the reference, so the
+// reference is only taken while the slot is live and kept only if it is
+// still the latest afterwards. *seq may lag the slot by one publish: at worst
+// a stream sends the same frame twice.
+static frame_slot_t *latest_acquire(uint32_t *seq)
 {
-    if (!data || len == 0 || !s_jpeg_mutex) {
-        return;
+    while (true) {
+        const uint32_t s = __atomic_load_n(&s_latest_seq, __ATOMIC_ACQUIRE);
+        frame_slot_t *slot = __atomic_load_n(&s_latest, __ATOMIC_ACQUIRE);
+
+        if (!slot) return NULL;
+
+        if (frame_slot_try_ref(slot)) {
+            if (__atomic_load_n(&s_latest, __ATOMIC_ACQUIRE) == slot) {
+                if (seq) *seq = s;
+                return slot;
+            }
+            frame_pool_release(slot);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Stream workers
+//
+// esp_http_server runs every handler on its single server task, so a stream
+// loop there would block all other requests. /stream hands the request off
+// (async handler API) to one of STREAM_MAX_CLIENTS worker tasks. Workers are
+// woken by a task notification per published frame and always send the
+// newest frame once it is their turn: a client that cannot keep up skips
+// frames instead of queueing them, and never holds back the producer.
+// -----------------------------------------------------------------------------
+
+typedef struct {
+    int          id;
+    TaskHandle_t task;
+    volatile bool active;
+
+    uint32_t     sent;          // this stream
+    uint32_t     skipped;
+} stream_worker_t;
+
+static stream_worker_t s_workers[STREAM_MAX_CLIENTS];
+static QueueHandle_t   s_stream_q = NULL;
+static volatile int    s_stream_busy = 0;   // streams accepted (queued or running)
+
+static void stream_notify_all(void)
+{
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (s_workers[i].task && s_workers[i].active) {
+            xTaskNotifyGive(s_workers[i].task);
+        }
+    }
+}
+
+static esp_err_t stream_send_frame(httpd_req_t *req, const uint8_t *jpeg, size_t len)
+{
+    char hdr[96];
+    int n = snprintf(hdr, sizeof(hdr),
+                     "--" STREAM_BOUNDARY "\r\n"
+                     "Content-Type: image/jpeg\r\n"
+                     "Content-Length: %u\r\n\r\n",
+                     (unsigned)len);
+
+    esp_err_t err = httpd_resp_send_chunk(req, hdr, n);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, (const char *)jpeg, len);
+    }
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(req, "\r\n", 2);
+    }
+
+    return err;
+}
+
+static void stream_run(stream_worker_t *w, httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "multipart/x-mixed-replace;boundary=" STREAM_BOUNDARY);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    uint32_t last_seq  = 0;
+    bool     have_sent = false;
+    int64_t  last_us   = 0;
+    bool     pending   = true;      // send the current frame right away
+
+    while (true) {
+
+        if (!pending) {
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(STREAM_WAIT_MS));
+        }
+        pending = false;
+
+        // Pacing: not before STREAM_MIN_INTERVAL_MS after the last part
+        const int64_t since_ms = (esp_timer_get_time() - last_us) / 1000;
+        if (have_sent && since_ms < STREAM_MIN_INTERVAL_MS) {
+            vTaskDelay(pdMS_TO_TICKS(STREAM_MIN_INTERVAL_MS - since_ms));
+        }
+
+        // Idle wake-ups (STREAM_WAIT_MS) leave the slot alone
+        if (have_sent && __atomic_load_n(&s_latest_seq, __ATOMIC_ACQUIRE) == last_seq) {
+            continue;                       // nothing new yet
+        }
+
+        uint32_t seq = 0;
+        frame_slot_t *slot = latest_acquire(&seq);
+        if (!slot) continue;
+
+        if (have_sent && seq == last_seq) {
+            frame_pool_release(slot);
+            continue;                       // published in between, seq not yet bumped
+        }
+
+        if (have_sent && seq - last_seq > 1) {
+            w->skipped += seq - last_seq - 1;
+        }
+
+        esp_err_t err = stream_send_frame(req, slot->jpeg, slot->jpeg_len);
+        frame_pool_release(slot);
+
+        if (err != ESP_OK) {
+            break;                          // client gone or send timeout
+        }
+
+        w->sent++;
+        last_seq  = seq;
+        have_sent = true;
+        last_us   = esp_timer_get_time();
     }
+}
 
-    if (xSemaphoreTake(s_jpeg_mutex, pdMS_TO_TICKS(50)) == pdTRUE) {
+static void stream_worker_task(void *pv)
+{
+    stream_worker_t *w = (stream_worker_t *)pv;
 
-        free(s_last_jpeg);
-        s_last_jpeg = (uint8_t *)malloc(len);
+    while (true) {
 
-        if (s_last_jpeg) {
-            memcpy(s_last_jpeg, data, len);
-            s_last_jpeg_len = len;
-        } else {
-            s_last_jpeg_len = 0;
-            ESP_LOGE(TAG, "JPEG buffer alloc failed (%u bytes)", (unsigned)len);
+        httpd_req_t *req = NULL;
+        if (xQueueReceive(s_stream_q, &req, portMAX_DELAY) != pdTRUE || !req) {
+            continue;
         }
 
-        xSemaphoreGive(s_jpeg_mutex);
+        w->sent    = 0;
+        w->skipped = 0;
+        w->active  = true;
+        ESP_LOGI(TAG, "Stream %d opened", w->id);
+
+        stream_run(w, req);
+
+        w->active = false;
+        httpd_req_async_handler_complete(req);
+        __atomic_sub_fetch(&s_stream_busy, 1, __ATOMIC_ACQ_REL);
+
+        ESP_LOGI(TAG, "Stream %d closed: sent=%lu skipped=%lu",
+                 w->id, (unsigned long)w->sent, (unsigned long)w->skipped);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Public API: publish last captured frame
+// -----------------------------------------------------------------------------
+
+void httpd_publish_frame(frame_slot_t *slot)
+{
+    if (!slot || slot->jpeg_len == 0) {
+        return;
     }
+
+    frame_slot_ref(slot);
+
+    frame_slot_t *old = __atomic_exchange_n(&s_latest, slot, __ATOMIC_ACQ_REL);
+    __atomic_add_fetch(&s_latest_seq, 1, __ATOMIC_RELEASE);
+
+    // Clients sending the old frame hold their own references
+    frame_pool_release(old);
+
+    stream_notify_all();
 }
 
 // -----------------------------------------------------------------------------
@@ -54,34 +227,196 @@ void httpd_update_last_frame(const uint8_t *data, size_t len)
 
 static esp_err_t latest_handler(httpd_req_t *req)
 {
-    if (!s_jpeg_mutex) {
+    frame_slot_t *slot = latest_acquire(NULL);
+
+    if (!slot) {
         httpd_resp_send_err(req,
-            HTTPD_500_INTERNAL_SERVER_ERROR,
-            "Not initialized");
+            HTTPD_404_NOT_FOUND,
+            "No frame yet");
         return ESP_FAIL;
     }
 
-    if (xSemaphoreTake(s_jpeg_mutex, pdMS_TO_TICKS(50)) != pdTRUE) {
+    httpd_resp_set_type(req, "image/jpeg");
+    esp_err_t err = httpd_resp_send(req, (const char *)slot->jpeg, slot->jpeg_len);
+
+    frame_pool_release(slot);
+    return err;
+}
+
+// -----------------------------------------------------------------------------
+// HTTP handler: /stream (MJPEG)
+// -----------------------------------------------------------------------------
+
+static esp_err_t stream_handler(httpd_req_t *req)
+{
+    if (!s_stream_q) {
         httpd_resp_send_err(req,
             HTTPD_500_INTERNAL_SERVER_ERROR,
-            "Busy");
+            "Not initialized");
         return ESP_FAIL;
     }
 
-    if (!s_last_jpeg || s_last_jpeg_len == 0) {
-        xSemaphoreGive(s_jpeg_mutex);
+    // Cap concurrent streams; extra clients fall back to /latest.jpg
+    if (__atomic_add_fetch(&s_stream_busy, 1, __ATOMIC_ACQ_REL) > STREAM_MAX_CLIENTS) {
+        __atomic_sub_fetch(&s_stream_busy, 1, __ATOMIC_ACQ_REL);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Too many streams");
+        return ESP_OK;
+    }
+
+    httpd_req_t *async_req = NULL;
+    if (httpd_req_async_handler_begin(req, &async_req) != ESP_OK) {
+        __atomic_sub_fetch(&s_stream_busy, 1, __ATOMIC_ACQ_REL);
         httpd_resp_send_err(req,
-            HTTPD_404_NOT_FOUND,
-            "No frame yet");
+            HTTPD_500_INTERNAL_SERVER_ERROR,
+            "Stream setup failed");
         return ESP_FAIL;
     }
 
-    httpd_resp_set_type(req, "image/jpeg");
-    httpd_resp_send(req,
-        (const char *)s_last_jpeg,
-        s_last_jpeg_len);
+    // Queue holds STREAM_MAX_CLIENTS entries, so this never fails
+    xQueueSend(s_stream_q, &async_req, 0);
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// HTTP handler: /record (manual recording trigger)
+// -----------------------------------------------------------------------------
+
+static volatile httpd_record_fn_t s_record_fn = NULL;
+
+void httpd_set_record_handler(httpd_record_fn_t fn)
+{
+    s_record_fn = fn;
+}
+
+static esp_err_t record_handler(httpd_req_t *req)
+{
+    uint32_t frames = 0;
+
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "frames", value, sizeof(value)) == ESP_OK) {
+        frames = (uint32_t)strtoul(value, NULL, 10);
+    }
+
+    httpd_record_fn_t fn = s_record_fn;
+    if (!fn || !fn(frames)) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Recording unavailable\n");
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, "Recording\n");
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// HTTP handler: /profile (per-op inference profile)
+// -----------------------------------------------------------------------------
+
+#define PROFILE_REPLY_MAX (48 * 1024)
+
+static volatile httpd_profile_fn_t s_profile_fn = NULL;
+
+void httpd_set_profile_handler(httpd_profile_fn_t fn)
+{
+    s_profile_fn = fn;
+}
+
+static esp_err_t profile_handler(httpd_req_t *req)
+{
+    httpd_profile_req_t pr = {
+        .enable = -1,
+        .reset  = false,
+        .dump   = false,
+        .csv    = false,
+        .top    = 20,
+    };
+
+    char query[96];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        if (httpd_query_key_value(query, "on", value, sizeof(value)) == ESP_OK) {
+            pr.enable = atoi(value) ? 1 : 0;
+        }
+        if (httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK) {
+            pr.reset = atoi(value) != 0;
+        }
+        if (httpd_query_key_value(query, "dump", value, sizeof(value)) == ESP_OK) {
+            pr.dump = atoi(value) != 0;
+        }
+        if (httpd_query_key_value(query, "csv", value, sizeof(value)) == ESP_OK) {
+            pr.csv = atoi(value) != 0;
+        }
+        if (httpd_query_key_value(query, "top", value, sizeof(value)) == ESP_OK) {
+            pr.top = atoi(value);
+        }
+    }
+
+    httpd_profile_fn_t fn = s_profile_fn;
+    char *buf = fn ? (char *)heap_caps_malloc(PROFILE_REPLY_MAX, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT) : NULL;
+    const size_t len = buf ? fn(&pr, buf, PROFILE_REPLY_MAX) : 0;
+
+    if (len == 0) {
+        heap_caps_free(buf);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Profiling unavailable\n");
+        return ESP_OK;
+    }
 
-    xSemaphoreGive(s_jpeg_mutex);
+    httpd_resp_set_type(req, pr.csv ? "text/csv" : "text/plain");
+    httpd_resp_send(req, buf, len);
+    heap_caps_free(buf);
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// HTTP handler: /filter (model-input resize filter)
+// -----------------------------------------------------------------------------
+
+static const char *const FILTER_NAMES[] = { "nearest", "bilinear", "area" };
+
+static volatile httpd_filter_fn_t s_filter_fn = NULL;
+
+void httpd_set_filter_handler(httpd_filter_fn_t fn)
+{
+    s_filter_fn = fn;
+}
+
+static esp_err_t filter_handler(httpd_req_t *req)
+{
+    httpd_filter_fn_t fn = s_filter_fn;
+    if (!fn) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_sendstr(req, "Filter selection unavailable\n");
+        return ESP_OK;
+    }
+
+    char query[32];
+    char value[12];
+    int  mode = -1;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "mode", value, sizeof(value)) == ESP_OK) {
+        for (int i = 0; i <= RESAMPLE_AREA; i++) {
+            if (!strcmp(value, FILTER_NAMES[i])) mode = i;
+        }
+        if (mode < 0) {
+            httpd_resp_set_status(req, "400 Bad Request");
+            httpd_resp_sendstr(req, "mode: nearest, bilinear or area\n");
+            return ESP_OK;
+        }
+    }
+
+    const resample_filter_t want = (resample_filter_t)mode;
+    const resample_filter_t cur  = fn(mode >= 0 ? &want : NULL);
+
+    char reply[48];
+    snprintf(reply, sizeof(reply), "Input filter: %s%s\n", FILTER_NAMES[cur],
+             mode >= 0 && cur != want ? " (change failed)" : "");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_sendstr(req, reply);
     return ESP_OK;
 }
 
@@ -103,12 +438,16 @@ static esp_err_t index_handler(httpd_req_t *req)
         "</style>"
         "</head><body>"
         "<h1>Live Capture</h1>"
-        "<img id='cam' src='/latest.jpg'>"
+        "<img id='cam' src='/stream'>"
         "<script>"
+        // Stream slots exhausted or stream dropped: poll instead
+        "const cam=document.getElementById('cam');"
+        "cam.onerror=()=>{"
+        "cam.onerror=null;"
         "setInterval(()=>{"
-        "document.getElementById('cam').src="
-        "'/latest.jpg?nocache='+Date.now();"
+        "cam.src='/latest.jpg?nocache='+Date.now();"
         "},1000);"
+        "};"
         "</script>"
         "</body></html>"
     );
@@ -127,8 +466,19 @@ void http_server_start(void)
         return;
     }
 
-    if (!s_jpeg_mutex) {
-        s_jpeg_mutex = xSemaphoreCreateMutex();
+    if (!s_stream_q) {
+        s_stream_q = xQueueCreate(STREAM_MAX_CLIENTS, sizeof(httpd_req_t *));
+
+        for (int i = 0; s_stream_q && i < STREAM_MAX_CLIENTS; i++) {
+            char name[16];
+            snprintf(name, sizeof(name), "HTTP_STRM%d", i);
+
+            s_workers[i].id = i;
+            if (xTaskCreate(stream_worker_task, name, STREAM_TASK_STACK,
+                            &s_workers[i], STREAM_TASK_PRIO, &s_workers[i].task) != pdPASS) {
+                ESP_LOGE(TAG, "Stream worker %d create failed", i);
+            }
+        }
     }
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
@@ -155,8 +505,40 @@ void http_server_start(void)
         .user_ctx = NULL
     };
 
+    httpd_uri_t stream_uri = {
+        .uri      = "/stream",
+        .method   = HTTP_GET,
+        .handler  = stream_handler,
+        .user_ctx = NULL
+    };
+
     httpd_register_uri_handler(s_server, &index_uri);
     httpd_register_uri_handler(s_server, &latest_uri);
+    httpd_uri_t record_uri = {
+        .uri      = "/record",
+        .method   = HTTP_GET,
+        .handler  = record_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t profile_uri = {
+        .uri      = "/profile",
+        .method   = HTTP_GET,
+        .handler  = profile_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_uri_t filter_uri = {
+        .uri      = "/filter",
+        .method   = HTTP_GET,
+        .handler  = filter_handler,
+        .user_ctx = NULL
+    };
+
+    httpd_register_uri_handler(s_server, &stream_uri);
+    httpd_register_uri_handler(s_server, &record_uri);
+    httpd_register_uri_handler(s_server, &profile_uri);
+    httpd_register_uri_handler(s_server, &filter_uri);
 
-    ESP_LOGI(TAG, "HTTP server started");
+    ESP_LOGI(TAG, "HTTP server started (/stream: max %d clients)", STREAM_MAX_CLIENTS);
 }
@@ -3,6 +3,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "frame_pool.h"
+#include "resample.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -10,8 +13,44 @@ extern "C" {
 // Start HTTP server (call once after WiFi is up)
 void http_server_start(void);
 
-// Update the last captured JPEG frame (called by camera task)
-void httpd_update_last_frame(const uint8_t *data, size_t len);
+// Concurrent /stream connections
+#define HTTPD_STREAM_MAX_CLIENTS 2
+
+// frame_pool slots the preview can hold on top of the pipeline's: the latest
+// frame, plus one being sent by each stream and by /latest.jpg (clients send
+// straight from the slot)
+#define HTTPD_PREVIEW_SLOTS (1 + HTTPD_STREAM_MAX_CLIENTS + 1)
+
+// Publish a captured frame as the preview "latest" (called by capture task).
+// Takes its own slot reference, swaps the pointer atomically and releases the
+// previous latest; never waits on clients.
+void httpd_publish_frame(frame_slot_t *slot);
+
+// GET /record[?frames=N] calls fn (manual recording trigger, N = 0: default
+// post-roll). fn returns false if recording is unavailable. Set before or
+// after http_server_start.
+typedef bool (*httpd_record_fn_t)(uint32_t frames);
+void httpd_set_record_handler(httpd_record_fn_t fn);
+
+// GET /profile[?on=0|1][&reset=1][&dump=1][&csv=1][&top=N] calls fn with
+// the parsed query; fn applies it and writes the reply (plain text, or CSV
+// with csv=1) into out, returning its length (0: profiling unavailable).
+typedef struct {
+    int  enable;                    // -1: unchanged
+    bool reset;
+    bool dump;                      // CSV to SD
+    bool csv;
+    int  top;                       // ops listed in the text report, -1: all
+} httpd_profile_req_t;
+
+typedef size_t (*httpd_profile_fn_t)(const httpd_profile_req_t *req, char *out, size_t cap);
+void httpd_set_profile_handler(httpd_profile_fn_t fn);
+
+// GET /filter[?mode=nearest|bilinear|area] calls fn with the requested
+// model-input filter (NULL: query only); fn applies it from the next frame
+// and returns the filter in use.
+typedef resample_filter_t (*httpd_filter_fn_t)(const resample_filter_t *set);
+void httpd_set_filter_handler(httpd_filter_fn_t fn);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,684 @@
+// File: main/jpeg_dec.cpp
+
+#include "jpeg_dec.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "JPEGDEC";
+
+// -----------------------------------------------------------------------------
+// Context
+// -----------------------------------------------------------------------------
+esp_err_t jpeg_dec_ctx_init(jpeg_dec_ctx_t *ctx, uint32_t caps)
+{
+    if (!ctx) return ESP_ERR_INVALID_ARG;
+
+    memset(ctx, 0, sizeof(*ctx));
+
+    if (caps == 0) {
+        caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    }
+
+    ctx->work = (uint8_t *)heap_caps_malloc(TJPGD_WORK_BUF_SIZE, caps);
+    if (!ctx->work) {
+        ESP_LOGE(TAG, "Work buffer alloc failed (%u bytes)", (unsigned)TJPGD_WORK_BUF_SIZE);
+        return ESP_ERR_NO_MEM;
+    }
+    ctx->work_size = TJPGD_WORK_BUF_SIZE;
+
+    return ESP_OK;
+}
+
+void jpeg_dec_ctx_deinit(jpeg_dec_ctx_t *ctx)
+{
+    if (!ctx) return;
+
+    heap_caps_free(ctx->work);
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+// -----------------------------------------------------------------------------
+// TJpgDec callbacks: jd.device is the context
+// -----------------------------------------------------------------------------
+
+// Copy [src, src + n) of the original data, applying the band patches
+static void band_copy(jpeg_dec_ctx_t *ctx, uint8_t *buf, size_t src, size_t n)
+{
+    if (buf) {
+        memcpy(buf, ctx->jpeg + src, n);
+
+        for (int i = 0; i < 2; i++) {
+            const size_t at = ctx->sof_h_at + i;
+            if (ctx->sof_h_at != SIZE_MAX && at >= src && at - src < n) {
+                buf[at - src] = (uint8_t)(i ? ctx->sof_h : ctx->sof_h >> 8);
+            }
+        }
+    }
+
+    // RSTn byte of each band marker → RST0, RST1, ... from the band start
+    while (ctx->rst_next < ctx->rst_n && ctx->rst[ctx->rst_next] + 1 < src + n) {
+        const size_t at = ctx->rst[ctx->rst_next] + 1;
+        if (buf && at >= src) {
+            buf[at - src] = (uint8_t)(0xD0 | (ctx->rst_next & 7));
+        }
+        ctx->rst_next++;
+    }
+}
+
+static tjpgd_len_t dec_in_cb(JDEC *jd, uint8_t *buf, tjpgd_len_t nbyte)
+{
+    jpeg_dec_ctx_t *ctx = (jpeg_dec_ctx_t *)jd->device;
+
+    static const uint8_t eoi[2] = { 0xFF, 0xD9 };
+
+    const size_t ent_len = ctx->ent_end - ctx->ent_start;
+    const size_t total   = ctx->hdr_len + ent_len + (ctx->add_eoi ? 2 : 0);
+
+    size_t done = 0;
+    while (done < nbyte && ctx->pos < total) {
+        uint8_t *dst = buf ? buf + done : nullptr;
+        size_t   n   = nbyte - done;
+
+        if (ctx->pos < ctx->hdr_len) {
+            n = std::min(n, ctx->hdr_len - ctx->pos);
+            band_copy(ctx, dst, ctx->pos, n);
+        } else if (ctx->pos < ctx->hdr_len + ent_len) {
+            const size_t off = ctx->pos - ctx->hdr_len;
+            n = std::min(n, ent_len - off);
+            band_copy(ctx, dst, ctx->ent_start + off, n);
+        } else {
+            const size_t off = ctx->pos - ctx->hdr_len - ent_len;
+            n = std::min(n, (size_t)2 - off);
+            if (dst) memcpy(dst, eoi + off, n);
+        }
+
+        ctx->pos += n;
+        done     += n;
+    }
+
+    return (tjpgd_len_t)done;
+}
+
+static tjpgd_out_t dec_out_cb(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    jpeg_dec_ctx_t *ctx = (jpeg_dec_ctx_t *)jd->device;
+
+    if (ctx->y_off) {
+        JRECT r = *rect;
+        r.top    += ctx->y_off;
+        r.bottom += ctx->y_off;
+        return ctx->out(ctx->user, (const uint8_t *)bitmap, &r) ? 1 : 0;
+    }
+
+    return ctx->out(ctx->user, (const uint8_t *)bitmap, rect) ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------
+// Decode
+// -----------------------------------------------------------------------------
+static esp_err_t dec_prepare(jpeg_dec_ctx_t *ctx)
+{
+    JRESULT res = tjpgd_prepare(&ctx->jd, dec_in_cb, ctx->work, ctx->work_size, ctx);
+    if (res != JDR_OK) {
+        ESP_LOGE(TAG, "jd_prepare failed (%d)", (int)res);
+        return ESP_FAIL;
+    }
+
+    ctx->width  = (int)ctx->jd.width;
+    ctx->height = (int)ctx->jd.height;
+    ctx->mcu_w  = ctx->jd.msx * 8;
+    ctx->mcu_h  = ctx->jd.msy * 8;
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_dec_open(jpeg_dec_ctx_t *ctx, const uint8_t *jpeg, size_t jpeg_len)
+{
+    if (!ctx || !ctx->work || !jpeg || jpeg_len == 0) return ESP_ERR_INVALID_ARG;
+
+    ctx->jpeg      = jpeg;
+    ctx->len       = jpeg_len;
+    ctx->pos       = 0;
+    ctx->hdr_len   = jpeg_len;      // whole file, untouched
+    ctx->ent_start = 0;
+    ctx->ent_end   = 0;
+    ctx->add_eoi   = false;
+    ctx->sof_h_at  = SIZE_MAX;
+    ctx->rst       = nullptr;
+    ctx->rst_n     = 0;
+    ctx->rst_next  = 0;
+    ctx->y_off     = 0;
+
+    return dec_prepare(ctx);
+}
+
+esp_err_t jpeg_dec_run(jpeg_dec_ctx_t *ctx, int scale, jpeg_dec_out_cb_t out_cb, void *user)
+{
+    if (!ctx || !ctx->jpeg || !out_cb || scale < 0 || scale > 3) return ESP_ERR_INVALID_ARG;
+
+    ctx->out  = out_cb;
+    ctx->user = user;
+
+    JRESULT res = tjpgd_decomp(&ctx->jd, dec_out_cb, (uint8_t)scale);
+
+    ctx->jpeg = nullptr;    // one run per open
+
+    if (res != JDR_OK) {
+        ESP_LOGE(TAG, "jd_decomp failed (%d)", (int)res);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Restart-marker index
+// -----------------------------------------------------------------------------
+static inline uint16_t be16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+esp_err_t jpeg_dec_index(const uint8_t *jpeg, size_t jpeg_len, jpeg_rst_index_t *idx)
+{
+    if (!jpeg || jpeg_len < 4 || !idx) return ESP_ERR_INVALID_ARG;
+    if (jpeg[0] != 0xFF || jpeg[1] != 0xD8) return ESP_FAIL;
+
+    memset(idx, 0, offsetof(jpeg_rst_index_t, rst));
+
+    // Header segments up to SOS
+    size_t pos = 2;
+    while (!idx->hdr_len) {
+        if (pos + 4 > jpeg_len || jpeg[pos] != 0xFF) return ESP_FAIL;
+
+        const uint8_t  m   = jpeg[pos + 1];
+        if (m == 0xFF) { pos++; continue; }     // fill byte
+
+        const uint16_t seg = be16(jpeg + pos + 2);
+        if (pos + 2 + seg > jpeg_len) return ESP_FAIL;
+
+        const uint8_t *p = jpeg + pos + 4;
+
+        switch (m) {
+        case 0xC0:                              // SOF0 (baseline)
+            idx->sof_h_at = pos + 5;
+            idx->height   = be16(p + 1);
+            idx->width    = be16(p + 3);
+            idx->mcu_w    = (p[7] >> 4) * 8;    // first component sampling
+            idx->mcu_h    = (p[7] & 15) * 8;
+            break;
+        case 0xC1: case 0xC2: case 0xC3:
+        case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB:
+        case 0xCD: case 0xCE: case 0xCF:
+            return ESP_ERR_NOT_SUPPORTED;
+        case 0xDD:                              // DRI
+            idx->nrst = be16(p);
+            break;
+        case 0xDA:                              // SOS
+            idx->hdr_len = pos + 2 + seg;
+            break;
+        default:
+            break;
+        }
+
+        pos += 2 + seg;
+    }
+
+    if (!idx->sof_h_at || idx->mcu_w == 0 || idx->mcu_h == 0) return ESP_FAIL;
+
+    idx->mcus_per_row = (idx->width  + idx->mcu_w - 1) / idx->mcu_w;
+    idx->mcu_rows     = (idx->height + idx->mcu_h - 1) / idx->mcu_h;
+    idx->ent_end      = jpeg_len;
+
+    // Entropy data: only markers (FF xx, xx != 00) matter
+    const uint8_t *p   = jpeg + idx->hdr_len;
+    const uint8_t *end = jpeg + jpeg_len - 1;
+
+    while (p < end) {
+        p = (const uint8_t *)memchr(p, 0xFF, end - p);
+        if (!p) break;
+
+        const uint8_t m = p[1];
+        if (m >= 0xD0 && m <= 0xD7) {
+            if (idx->count < JPEG_DEC_MAX_RST) {
+                idx->rst[idx->count] = (uint32_t)(p - jpeg);
+            }
+            idx->count++;
+        } else if (m == 0xD9) {
+            idx->ent_end = p - jpeg;
+            break;
+        }
+        p += (m == 0xFF) ? 1 : 2;
+    }
+
+    if (idx->nrst) {
+        const int mcus = idx->mcus_per_row * idx->mcu_rows;
+        const int expect = (mcus + idx->nrst - 1) / idx->nrst - 1;
+        idx->complete = idx->count == expect && idx->count <= JPEG_DEC_MAX_RST;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t jpeg_dec_open_band(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    const jpeg_rst_index_t *idx,
+    int row0,
+    int row1)
+{
+    if (!ctx || !ctx->work || !jpeg || !idx) return ESP_ERR_INVALID_ARG;
+    if (!idx->nrst || !idx->complete) return ESP_ERR_NOT_SUPPORTED;
+    if (row0 < 0 || row1 <= row0 || row1 > idx->mcu_rows) return ESP_ERR_INVALID_ARG;
+
+    const int m0 = row0 * idx->mcus_per_row;
+    const int m1 = row1 * idx->mcus_per_row;
+    const bool last = row1 == idx->mcu_rows;
+
+    if (m0 % idx->nrst || (!last && m1 % idx->nrst)) {
+        return ESP_ERR_INVALID_ARG;     // not on a restart boundary
+    }
+
+    const int k0 = m0 / idx->nrst;      // first restart interval of the band
+    const int k1 = last ? idx->count + 1 : m1 / idx->nrst;
+
+    const int y0 = row0 * idx->mcu_h;
+    const int y1 = std::min(row1 * idx->mcu_h, idx->height);
+
+    ctx->jpeg      = jpeg;
+    ctx->len       = jpeg_len;
+    ctx->pos       = 0;
+    ctx->hdr_len   = idx->hdr_len;
+    ctx->ent_start = k0 ? idx->rst[k0 - 1] + 2 : idx->hdr_len;
+    ctx->ent_end   = last ? idx->ent_end : idx->rst[k1 - 1];
+    ctx->add_eoi   = true;
+    ctx->sof_h_at  = idx->sof_h_at;
+    ctx->sof_h     = (uint16_t)(y1 - y0);
+    ctx->rst       = idx->rst + k0;     // markers inside the band
+    ctx->rst_n     = k1 - 1 - k0;
+    ctx->rst_next  = 0;
+    ctx->y_off     = y0;
+
+    return dec_prepare(ctx);
+}
+
+// -----------------------------------------------------------------------------
+// Two-core decode
+// -----------------------------------------------------------------------------
+typedef struct {
+    const uint8_t          *jpeg;
+    size_t                  len;
+    const jpeg_rst_index_t *idx;
+    int                     row0;
+    int                     row1;
+    jpeg_dec_out_cb_t       out;
+    void                   *user;
+    esp_err_t               err;
+} band_job_t;
+
+static jpeg_dec_ctx_t    s_par_ctx;         // worker's context
+static TaskHandle_t      s_par_task = nullptr;
+static SemaphoreHandle_t s_par_done = nullptr;
+static SemaphoreHandle_t s_par_lock = nullptr;     // one split frame at a time
+static band_job_t        s_par_job;
+static jpeg_rst_index_t  s_par_idx;         // ~1 KB, one frame at a time
+
+static void parallel_worker_task(void *pv)
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        band_job_t *job = &s_par_job;
+
+        job->err = jpeg_dec_open_band(&s_par_ctx, job->jpeg, job->len, job->idx,
+                                      job->row0, job->row1);
+        if (job->err == ESP_OK) {
+            job->err = jpeg_dec_run(&s_par_ctx, 0, job->out, job->user);
+        }
+
+        xSemaphoreGive(s_par_done);
+    }
+}
+
+esp_err_t jpeg_dec_parallel_init(int worker_core)
+{
+    if (s_par_task) return ESP_OK;
+
+    esp_err_t err = jpeg_dec_ctx_init(&s_par_ctx, 0);
+    if (err != ESP_OK) return err;
+
+    s_par_done = xSemaphoreCreateBinary();
+    s_par_lock = xSemaphoreCreateMutex();
+    if (!s_par_done || !s_par_lock ||
+        xTaskCreatePinnedToCore(parallel_worker_task, "JDEC_PAR", 4096, nullptr,
+                                5, &s_par_task, worker_core) != pdPASS) {
+        ESP_LOGE(TAG, "Parallel decode worker not started");
+        if (s_par_done) vSemaphoreDelete(s_par_done);
+        if (s_par_lock) vSemaphoreDelete(s_par_lock);
+        s_par_done = nullptr;
+        s_par_lock = nullptr;
+        s_par_task = nullptr;
+        jpeg_dec_ctx_deinit(&s_par_ctx);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Parallel decode worker on core %d", worker_core);
+    return ESP_OK;
+}
+
+bool jpeg_dec_parallel_ready(void)
+{
+    return s_par_task != nullptr;
+}
+
+// Restart boundary (in MCU rows) nearest to the middle, 0 if none
+static int pick_split(const jpeg_rst_index_t *idx)
+{
+    if (!idx->nrst || !idx->complete) return 0;
+
+    const int mid = idx->mcu_rows / 2;
+    int best = 0;
+
+    for (int r = 1; r < idx->mcu_rows; r++) {
+        if ((r * idx->mcus_per_row) % idx->nrst) continue;
+        if (!best || abs(r - mid) < abs(best - mid)) best = r;
+    }
+
+    return best;
+}
+
+esp_err_t jpeg_dec_run_parallel(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    jpeg_dec_out_cb_t out_cb,
+    void *user,
+    int *split)
+{
+    if (split) *split = 0;
+    if (!ctx || !jpeg || !out_cb) return ESP_ERR_INVALID_ARG;
+
+    if (!s_par_task) {
+        esp_err_t err = jpeg_dec_open(ctx, jpeg, jpeg_len);
+        return err == ESP_OK ? jpeg_dec_run(ctx, 0, out_cb, user) : err;
+    }
+
+    xSemaphoreTake(s_par_lock, portMAX_DELAY);
+
+    int row = 0;
+    if (jpeg_dec_index(jpeg, jpeg_len, &s_par_idx) == ESP_OK) {
+        row = pick_split(&s_par_idx);
+    }
+
+    if (!row) {
+        // No restart markers: plain single-core decode
+        xSemaphoreGive(s_par_lock);
+
+        esp_err_t err = jpeg_dec_open(ctx, jpeg, jpeg_len);
+        return err == ESP_OK ? jpeg_dec_run(ctx, 0, out_cb, user) : err;
+    }
+
+    s_par_job.jpeg = jpeg;
+    s_par_job.len  = jpeg_len;
+    s_par_job.idx  = &s_par_idx;
+    s_par_job.row0 = row;
+    s_par_job.row1 = s_par_idx.mcu_rows;
+    s_par_job.out  = out_cb;
+    s_par_job.user = user;
+    s_par_job.err  = ESP_FAIL;
+
+    xTaskNotifyGive(s_par_task);
+
+    esp_err_t err = jpeg_dec_open_band(ctx, jpeg, jpeg_len, &s_par_idx, 0, row);
+    if (err == ESP_OK) {
+        err = jpeg_dec_run(ctx, 0, out_cb, user);
+    }
+
+    xSemaphoreTake(s_par_done, portMAX_DELAY);
+
+    const esp_err_t worker_err = s_par_job.err;
+    xSemaphoreGive(s_par_lock);
+
+    if (split) *split = row;
+    return err != ESP_OK ? err : worker_err;
+}
+
+// -----------------------------------------------------------------------------
+// Parallel benchmark
+// -----------------------------------------------------------------------------
+typedef struct {
+    uint8_t *rgb;
+    int      width;
+} frame_dst_t;
+
+static bool frame_out_cb(void *user, const uint8_t *rgb, const JRECT *rect)
+{
+    frame_dst_t *d = (frame_dst_t *)user;
+
+    const size_t row_bytes = (size_t)(rect->right - rect->left + 1) * 3;
+
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        memcpy(d->rgb + ((size_t)y * d->width + rect->left) * 3, rgb, row_bytes);
+        rgb += row_bytes;
+    }
+
+    return true;
+}
+
+esp_err_t jpeg_dec_parallel_bench(const uint8_t *jpeg, size_t jpeg_len, int iterations)
+{
+    if (!jpeg || jpeg_len == 0 || iterations <= 0) return ESP_ERR_INVALID_ARG;
+    if (!s_par_task) return ESP_ERR_INVALID_STATE;
+
+    jpeg_rst_index_t *idx = (jpeg_rst_index_t *)malloc(sizeof(jpeg_rst_index_t));
+    if (!idx) return ESP_ERR_NO_MEM;
+
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err = jpeg_dec_index(jpeg, jpeg_len, idx);
+    const int64_t t_index = esp_timer_get_time() - t0;
+
+    if (err != ESP_OK) {
+        free(idx);
+        return err;
+    }
+
+    const size_t bytes = (size_t)idx->width * idx->height * 3;
+    uint8_t *a = (uint8_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *b = (uint8_t *)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+    jpeg_dec_ctx_t ctx;
+    err = jpeg_dec_ctx_init(&ctx, 0);
+
+    if (!a || !b || err != ESP_OK) {
+        heap_caps_free(a); heap_caps_free(b); free(idx);
+        jpeg_dec_ctx_deinit(&ctx);
+        return ESP_ERR_NO_MEM;
+    }
+
+    frame_dst_t da = { a, idx->width };
+    frame_dst_t db = { b, idx->width };
+
+    int64_t t_single = 0;
+    int64_t t_par    = 0;
+    int     split    = 0;
+
+    for (int it = 0; it < iterations && err == ESP_OK; it++) {
+        t0 = esp_timer_get_time();
+        err = jpeg_dec_open(&ctx, jpeg, jpeg_len);
+        if (err == ESP_OK) err = jpeg_dec_run(&ctx, 0, frame_out_cb, &da);
+        const int64_t t1 = esp_timer_get_time();
+        if (err == ESP_OK) err = jpeg_dec_run_parallel(&ctx, jpeg, jpeg_len, frame_out_cb, &db, &split);
+        const int64_t t2 = esp_timer_get_time();
+
+        t_single += t1 - t0;
+        t_par    += t2 - t1;
+    }
+
+    if (err == ESP_OK) {
+        const bool same = memcmp(a, b, bytes) == 0;
+
+        ESP_LOGI(TAG, "Parallel bench %dx%d, DRI %u MCUs, %d RST, split at MCU row %d/%d: "
+                      "single %lld us, two-core %lld us (x%.2f, index %lld us), output %s",
+                 idx->width, idx->height, (unsigned)idx->nrst, idx->count,
+                 split, idx->mcu_rows,
+                 (long long)(t_single / iterations), (long long)(t_par / iterations),
+                 t_par > 0 ? (double)t_single / (double)t_par : 0.0,
+                 (long long)t_index,
+                 same ? "identical" : "DIFFERENT");
+
+        if (!same) err = ESP_FAIL;
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+    heap_caps_free(a);
+    heap_caps_free(b);
+    free(idx);
+
+    return err;
+}
+
+// -----------------------------------------------------------------------------
+// Stress test
+// -----------------------------------------------------------------------------
+typedef struct {
+    const uint8_t    *jpeg;
+    size_t            len;
+    int               iterations;
+    uint32_t          expect;
+
+    int               core;
+    int               ok;
+    int               bad;
+    int64_t           us;
+    SemaphoreHandle_t done;
+} stress_job_t;
+
+// FNV-1a over blocks in decode order (order is deterministic per image)
+static bool hash_out_cb(void *user, const uint8_t *rgb, const JRECT *rect)
+{
+    uint32_t *h = (uint32_t *)user;
+    const size_t n = (size_t)(rect->right - rect->left + 1) * (rect->bottom - rect->top + 1) * 3;
+
+    uint32_t x = *h;
+    for (size_t i = 0; i < n; i++) {
+        x = (x ^ rgb[i]) * 16777619u;
+    }
+    *h = x;
+
+    return true;
+}
+
+static esp_err_t decode_hash(jpeg_dec_ctx_t *ctx, const uint8_t *jpeg, size_t len, uint32_t *hash)
+{
+    *hash = 2166136261u;
+
+    esp_err_t err = jpeg_dec_open(ctx, jpeg, len);
+    if (err == ESP_OK) {
+        err = jpeg_dec_run(ctx, 0, hash_out_cb, hash);
+    }
+    return err;
+}
+
+static void stress_task(void *pv)
+{
+    stress_job_t *job = (stress_job_t *)pv;
+
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) == ESP_OK) {
+
+        const int64_t t0 = esp_timer_get_time();
+
+        for (int i = 0; i < job->iterations; i++) {
+            uint32_t h = 0;
+            if (decode_hash(&ctx, job->jpeg, job->len, &h) == ESP_OK && h == job->expect) {
+                job->ok++;
+            } else {
+                job->bad++;
+            }
+        }
+
+        job->us = esp_timer_get_time() - t0;
+        jpeg_dec_ctx_deinit(&ctx);
+    } else {
+        job->bad = job->iterations;
+    }
+
+    xSemaphoreGive(job->done);
+    vTaskDelete(nullptr);
+}
+
+esp_err_t jpeg_dec_stress(const uint8_t *jpeg, size_t jpeg_len, int iterations)
+{
+    if (!jpeg || jpeg_len == 0 || iterations <= 0) return ESP_ERR_INVALID_ARG;
+
+    // Single-task reference
+    jpeg_dec_ctx_t ctx;
+    esp_err_t err = jpeg_dec_ctx_init(&ctx, 0);
+    if (err != ESP_OK) return err;
+
+    uint32_t expect = 0;
+    const int64_t t0 = esp_timer_get_time();
+    err = decode_hash(&ctx, jpeg, jpeg_len, &expect);
+    const int64_t t_single = esp_timer_get_time() - t0;
+    const int w = ctx.width;
+    const int h = ctx.height;
+    jpeg_dec_ctx_deinit(&ctx);
+
+    if (err != ESP_OK) return err;
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    if (!done) return ESP_ERR_NO_MEM;
+
+    stress_job_t jobs[2] = {};
+    int started = 0;
+
+    for (int c = 0; c < 2; c++) {
+        jobs[c].jpeg       = jpeg;
+        jobs[c].len        = jpeg_len;
+        jobs[c].iterations = iterations;
+        jobs[c].expect     = expect;
+        jobs[c].core       = c;
+        jobs[c].done       = done;
+
+        if (xTaskCreatePinnedToCore(stress_task, c ? "JDEC_ST1" : "JDEC_ST0", 4096,
+                                    &jobs[c], 4, nullptr, c) == pdPASS) {
+            started++;
+        } else {
+            ESP_LOGE(TAG, "Stress task on core %d not started", c);
+        }
+    }
+
+    for (int i = 0; i < started; i++) {
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(done);
+
+    int bad = 0;
+    for (int c = 0; c < 2; c++) {
+        ESP_LOGI(TAG, "Stress core %d: %d ok, %d mismatched, %lld us/decode",
+                 c, jobs[c].ok, jobs[c].bad,
+                 jobs[c].ok + jobs[c].bad ? (long long)(jobs[c].us / (jobs[c].ok + jobs[c].bad)) : 0LL);
+        bad += jobs[c].bad;
+    }
+
+    ESP_LOGI(TAG, "Stress %dx%d, %d decodes per core: %s (single decode %lld us, hash %08lx)",
+             w, h, iterations,
+             (started == 2 && bad == 0) ? "PASS" : "FAIL",
+             (long long)t_single, (unsigned long)expect);
+
+    return (started == 2 && bad == 0) ? ESP_OK : ESP_FAIL;
+}
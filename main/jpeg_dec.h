@@ -0,0 +1,155 @@
+// File: main/jpeg_dec.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "tjpgd_port.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Reentrant TJpgDec decoder context
+//
+// esp32-camera's jpg2rgb565 / jpg2rgb888 / jpg2bmp share one file-static
+// TJpgDec work buffer, so two tasks decoding at the same time corrupt each
+// other. Every decoder in main/ instead owns a context: the work buffer
+// (TJPGD_WORK_BUF_SIZE, sized for the backend chosen in tjpgd_port.h), the
+// JDEC state and the input cursor. Contexts
+// are independent, so one per task / core can decode concurrently.
+//
+// A context is used by one task at a time.
+// -----------------------------------------------------------------------------
+
+// Called per decoded MCU block (RGB888, rect inclusive, frame coordinates).
+// Return false to abort.
+typedef bool (*jpeg_dec_out_cb_t)(void *user, const uint8_t *rgb, const JRECT *rect);
+
+#define JPEG_DEC_MAX_RST 256    // restart markers indexed per frame
+
+// Restart-marker index of one baseline frame
+typedef struct {
+    int      width;
+    int      height;
+    int      mcu_w;
+    int      mcu_h;
+    int      mcus_per_row;
+    int      mcu_rows;
+
+    uint16_t nrst;              // restart interval in MCUs, 0: none
+    bool     complete;          // every expected marker found and indexed
+
+    size_t   hdr_len;           // bytes before the first entropy-coded byte
+    size_t   sof_h_at;          // offset of the SOF height field
+    size_t   ent_end;           // EOI marker (or end of data)
+
+    int      count;
+    uint32_t rst[JPEG_DEC_MAX_RST];     // offset of each RSTn marker
+} jpeg_rst_index_t;
+
+typedef struct {
+    uint8_t *work;              // TJpgDec scratch, caller-placed
+    size_t   work_size;
+
+    JDEC     jd;
+
+    // Current image (valid after jpeg_dec_open*)
+    const uint8_t *jpeg;
+    size_t         len;
+    int            width;
+    int            height;
+    int            mcu_w;       // MCU size in pixels (8 or 16)
+    int            mcu_h;
+
+    // Input stream as TJpgDec sees it: header [0, hdr_len) + entropy
+    // [ent_start, ent_end) + optional EOI. A whole image is just the header
+    // part; a band gets a patched SOF height and renumbered RST markers.
+    size_t          pos;
+    size_t          hdr_len;
+    size_t          ent_start;
+    size_t          ent_end;
+    bool            add_eoi;
+    size_t          sof_h_at;
+    uint16_t        sof_h;
+    const uint32_t *rst;        // band markers to renumber
+    int             rst_n;
+    int             rst_next;
+    int             y_off;      // band top, added to output rects
+
+    jpeg_dec_out_cb_t out;
+    void             *user;
+} jpeg_dec_ctx_t;
+
+// caps: heap for the work buffer, 0 = internal RAM
+esp_err_t jpeg_dec_ctx_init(jpeg_dec_ctx_t *ctx, uint32_t caps);
+void      jpeg_dec_ctx_deinit(jpeg_dec_ctx_t *ctx);
+
+// Parse headers; fills width / height / mcu_w / mcu_h
+esp_err_t jpeg_dec_open(jpeg_dec_ctx_t *ctx, const uint8_t *jpeg, size_t jpeg_len);
+
+// Decode the opened image at 1 / (1 << scale), feeding out_cb block by block
+esp_err_t jpeg_dec_run(jpeg_dec_ctx_t *ctx, int scale, jpeg_dec_out_cb_t out_cb, void *user);
+
+// -----------------------------------------------------------------------------
+// Restart-interval slicing
+//
+// A restart marker resets the DC predictors and the bit reader, so the MCU
+// rows after any marker can be decoded on their own: the band is presented to
+// TJpgDec as a small image (original headers with the SOF height cut to the
+// band, the band's entropy data, EOI) whose RST markers are renumbered from
+// RST0, and its output rects are shifted back into frame coordinates. Bands
+// must start on a restart boundary.
+// -----------------------------------------------------------------------------
+
+// Parse headers and index all RSTn markers (ESP_ERR_NOT_SUPPORTED: not baseline)
+esp_err_t jpeg_dec_index(const uint8_t *jpeg, size_t jpeg_len, jpeg_rst_index_t *idx);
+
+// Open MCU rows [row0, row1) of an indexed frame
+esp_err_t jpeg_dec_open_band(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    const jpeg_rst_index_t *idx,
+    int row0,
+    int row1
+);
+
+// -----------------------------------------------------------------------------
+// Two-core decode
+//
+// A worker pinned to the other core owns a second context. A frame with
+// restart markers is split at the restart boundary nearest to half its MCU
+// rows; the caller decodes the top band, the worker the bottom one. out_cb
+// then runs on both cores at once, for disjoint rows. Frames without usable
+// markers are decoded on the calling core only. Split frames from several
+// callers are serialized on the one worker.
+// -----------------------------------------------------------------------------
+esp_err_t jpeg_dec_parallel_init(int worker_core);
+bool      jpeg_dec_parallel_ready(void);
+
+// *split: MCU row the frame was split at, 0 if decoded single-core (may be NULL)
+esp_err_t jpeg_dec_run_parallel(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    jpeg_dec_out_cb_t out_cb,
+    void *user,
+    int *split
+);
+
+// Single-core vs two-core timing and output hash comparison on one frame
+esp_err_t jpeg_dec_parallel_bench(const uint8_t *jpeg, size_t jpeg_len, int iterations);
+
+// -----------------------------------------------------------------------------
+// Stress test: decode the same JPEG on both cores at once, one context per
+// task, and compare every result with a single-task reference checksum.
+// -----------------------------------------------------------------------------
+esp_err_t jpeg_dec_stress(const uint8_t *jpeg, size_t jpeg_len, int iterations);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,6 @@
 // -----------------------------------------------------------------------------
 // main/main.cpp
-// RFC – Single deterministic camera → SD → preview → inference pipeline
+// RFC – Staged dual-core camera → preview → inference → SD pipeline
 // Deep inference logging + decoding debug (additive only)
 // -----------------------------------------------------------------------------
 
@@ -8,13 +8,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <math.h>
 #include <algorithm>
 #include <string>
-#include <vector>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "esp_log.h"
 #include "esp_err.h"
@@ -29,6 +30,20 @@
 #include "wifi.h"
 #include "httpd.h"
 #include "ppm.h"
+#include "frame_queue.h"
+#include "frame_pool.h"
+#include "preproc.h"
+#include "quant_lut.h"
+#include "yolo_decode.h"
+#include "motion_gate.h"
+#include "jpeg_dec.h"
+#include "tjpgd_kern.h"
+#include "sd_writer.h"
+#include "capture_store.h"
+#include "recorder.h"
+#include "model_store.h"
+#include "op_profiler.h"
+#include "arena_plan.h"
 
 #include "tensorflow/lite/schema/schema_generated.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
@@ -45,10 +60,99 @@
 #define MODEL_DIR   "/sdcard/models/"
 #define MAX_MODEL_PATH 256
 
-#define REG_MAX   16
-#define REG_CH    (4 * REG_MAX)
+#define MODEL_FROM_FLASH   1        // install the model into a flash partition once, map it at boot
+#define MODEL_PARTITION    "model"  // partitions.csv label
+#define MODEL_FLASH_VERIFY 1        // re-hash the mapped image at boot (SHA-256)
+
+#define OP_PROFILER        1        // per-op profiler in the interpreter (0: not built in)
+#define OP_PROFILER_ON     0        // profile from the first Invoke() (else GET /profile?on=1)
+#define OP_PROFILER_DIR    "/sdcard/profile"
+
+#define ARENA_AUTO_SIZE    1        // tensor arena sized from a measured plan (NVS, per model + firmware)
+#define ARENA_FIXED_KB     2048     // ARENA_AUTO_SIZE 0, or measuring failed
+#define ARENA_PROBE_MAX_KB 4096     // arena the plan is measured in (less if PSRAM is short)
+#define ARENA_MARGIN_KB    16       // on top of the plan
+
 #define MAX_BOXES 20
 #define CONF_THRESH 0.30f
+#define NMS_TOPK        64      // best candidates decoded per frame
+#define NMS_IOU_THRESH  0.45f
+#define NMS_CLASS_AWARE 1
+
+// Output layout descriptor (see yolo_decode.h). Default: Ultralytics TFLite
+// export, [1 x (4 + nc) x anchors], pre-decoded normalized xywh, sigmoid
+// applied, anchors from strides 8/16/32 (192 px → 756).
+#define YOLO_LAYOUT          YOLO_LAYOUT_CHANNEL_MAJOR
+#define YOLO_BOX_FORMAT      YOLO_BOX_XYWH
+#define YOLO_NUM_CLASSES     0     // 0: derive from tensor dims
+#define YOLO_REG_MAX         16    // DFL bins (YOLO_BOX_DFL only)
+#define YOLO_XYWH_NORMALIZED 1
+#define YOLO_CLS_ACTIVATED   1
+static const int YOLO_STRIDES[] = { 8, 16, 32 };
+
+// -----------------------------------------------------------------------------
+// PIPELINE CONFIG (stages, queues, cores)
+// -----------------------------------------------------------------------------
+#define CAPTURE_PERIOD_MS    300   // capture/preview cadence
+#define Q_DEPTH_DECODE       2     // capture → preprocess
+#define Q_DEPTH_INFER        1     // preprocess → inference (freshest frame wins)
+#define Q_DEPTH_POST         2     // inference → post/persist
+#define CORE_IO              0     // capture, preprocess, post/persist
+#define CORE_INFER           1     // Invoke()
+#define PIPELINE_STATS_EVERY 10    // log stage/queue stats every N persisted frames
+#define FRAME_POOL_SLOTS     4     // frames in flight; capture skips when exhausted (+ HTTPD_PREVIEW_SLOTS)
+#define PREPROC_FUSED        1     // 1: fused JPEG→tensor pass, 0: reference ppm.cpp path
+// 1: full-frame decodes split over both cores at RST markers. The band worker
+// is pinned to CORE_INFER at Invoke()'s priority (5): while an inference is
+// running the two time-slice, so a split frame delays Invoke() by about its
+// bottom-band decode and gains little itself. Pays off only while core 1 is
+// otherwise idle.
+#define JPEG_PARALLEL_DECODE 0
+#define INPUT_RESIZE_FILTER  RESAMPLE_AREA  // model input letterbox at boot: RESAMPLE_NEAREST / _AREA / _BILINEAR (GET /filter changes it)
+
+// Motion gate: skip preprocess + Invoke() while the scene is static
+#define MOTION_GATE          1
+#define GATE_PIXEL_THRESH    12    // luma delta per 1/8 thumbnail pixel
+#define GATE_AREA_PERMILLE   8     // changed thumbnail pixels to pass (‰)
+#define GATE_BG_SHIFT        3     // background adapts 1/8 per static frame
+#define GATE_BG_SHIFT_MOTION 6     // ... and 1/64 per frame with motion
+#define GATE_FORCE_EVERY     30    // inference at least every N frames (0: off)
+#define GATE_WARMUP_FRAMES   3
+
+// Frame persistence: background SD writer, post stage only copies into PSRAM
+#define SD_ASYNC_WRITER      1     // 0: write synchronously from STG_POST
+#define SD_WRITER_RING_KB    1024  // PSRAM ring of pending files (~3 frames)
+#define SD_WRITER_JOBS       24
+#define SD_WRITER_BLOCK_MS   0     // >0: post stage waits this long for space before dropping
+#define SD_WRITER_SHED_PCT   50    // ring fill that sheds the audit .ppm files first
+#define CAPTURE_CONTAINER    1     // 1: records in seg_*.cap segments (needs the SD writer), 0: three files per frame
+#define CAPTURE_SEGMENT_MB   64    // pre-allocated segment size
+#define CAPTURE_MAX_RECORDS  4096  // per segment
+#define CAPTURE_INDEX_EVERY  30    // rewrite the segment index every N records
+#define CAPTURE_DIR_MAX_FILES 300  // per-file layout: files per /YYYYMMDD/HH shard directory
+#define CAPTURE_SHARD_AHEAD_S 120  // pre-create the next hour's shard this early
+
+// Event recording: the last frames wait in a PSRAM ring, SD writes only around events
+#define RECORD_ON_EVENT      1     // 0: persist every inferred frame
+#define REC_PREROLL_FRAMES   6     // frames written before the triggering frame
+#define REC_POSTROLL_FRAMES  10    // ... and after it (the last trigger's)
+#define REC_TRIGGER_LAT_MS   12000 // capture → detection: preprocess + infer queue + Invoke() + decode
+#define REC_RING_FRAMES      (REC_PREROLL_FRAMES + (REC_TRIGGER_LAT_MS + CAPTURE_PERIOD_MS - 1) / CAPTURE_PERIOD_MS + 2)
+#define REC_RGB_FRAMES       4     // letterboxed model inputs of inferred frames kept (0: JPEG only)
+#define REC_TRIGGERS         (REC_TRIGGER_DETECTION | REC_TRIGGER_MANUAL)   // | REC_TRIGGER_MOTION
+
+// Per-class detection triggers: { class, min score }; REC_CLASS_ANY covers
+// classes without their own rule, min score > 1 disables a class
+static const recorder_class_rule_t REC_CLASS_RULES[] = {
+    { REC_CLASS_ANY, 0.50f },
+};
+
+// Input quantizer folding (evaluated once into the LUT, free per frame)
+#define INPUT_CONTRAST       0     // 1: same stretch as improve_rgb888_contrast()
+#define INPUT_GAMMA          1.0f  // 1.0: off
+#define INPUT_NORMALIZE      0     // 1: (x/255 - mean) / std before quantization
+static const float INPUT_MEAN[3] = { 0.0f, 0.0f, 0.0f };
+static const float INPUT_STD[3]  = { 1.0f, 1.0f, 1.0f };
 
 // -----------------------------------------------------------------------------
 // DEBUG CONFIG (runtime logging knobs)
@@ -61,6 +165,18 @@
 #define DBG_LOG_DETECTIONS     1   // dump decoded boxes
 #define DBG_TOPK_CLASSES       5   // top-k class probes at best cell
 #define DBG_DUMP_LIMIT_BOXES   10  // max printed boxes per frame
+#define DBG_HEAP_GUARD         FRAME_POOL_HEAP_GUARD_LOG // OFF / LOG / ASSERT
+#define DBG_HEAP_GUARD_WARMUP  3   // frames before heap watermark baseline
+#define DBG_HEAP_GUARD_SLACK   4096 // bytes tolerated for other tasks
+#define DBG_PREPROC_AB         0   // run reference preprocessing too and diff the tensors
+#define DBG_QUANT_BENCH        0   // at start: roundf loop vs LUT quantizer timing
+#define DBG_TJPGD_KERN_BENCH   0   // at start: N reference vs fast IDCT / YCbCr kernel runs (0: off)
+#define DBG_DECODE_STRESS      0   // first frame: N concurrent decodes per core (0: off)
+#define DBG_DECODE_PARALLEL_BENCH 0 // first frame: N single vs two-core decodes (0: off)
+#define DBG_THUMB_BENCH        0   // first frame: N full vs 1/8 thumbnail decodes (0: off)
+#define DBG_RESIZE_BENCH       0   // first frame: N nearest vs area letterbox resizes + stability (0: off)
+#define DBG_SD_CREATE_BENCH    0   // at start: create latency of N files, flat vs sharded directories (0: off)
+#define DBG_MODEL_LOAD_BENCH   0   // at start: also time the SD → PSRAM model read when the model is mapped
 
 static const char *TAG = "PIPELINE";
 
@@ -71,19 +187,11 @@ static std::string g_ts_compact;
 static std::string g_ts_iso;
 static uint32_t g_frame_seq = 0;
 
-// -----------------------------------------------------------------------------
-// YOLO STRUCT
-// -----------------------------------------------------------------------------
-typedef struct {
-    float x, y, w, h;
-    float score;
-    int   cls;
-} yolo_box_t;
-
 // TensorFlow globals
 static tflite::MicroInterpreter *g_interpreter = nullptr;
 static TfLiteTensor *g_input_tensor  = nullptr;
 static TfLiteTensor *g_output_tensor = nullptr;
+static model_image_t g_model_image = {};
 
 // -----------------------------------------------------------------------------
 // UTILS
@@ -93,18 +201,6 @@ static inline float dequant_i8(int8_t v, const TfLiteTensor *t)
     return (v - t->params.zero_point) * t->params.scale;
 }
 
-static inline float sigmoid(float x)
-{
-    return 1.0f / (1.0f + expf(-x));
-}
-
-static inline int8_t quantize_u8_to_int8(uint8_t v, float scale, int zero_point)
-{
-    int q = (int)roundf(v / scale) + zero_point;
-    q = std::max(-128, std::min(127, q));
-    return (int8_t)q;
-}
-
 static const char *tf_type_str(TfLiteType t)
 {
     switch (t) {
@@ -198,30 +294,6 @@ static void log_i8_stats(const char *label, const int8_t *buf, int n, float scal
              label, n, (int)mn, (int)mx, mean_i8, mean_deq);
 }
 
-static void log_output_dequant_stats(const TfLiteTensor *out)
-{
-    if (!out || out->type != kTfLiteInt8) {
-        ESP_LOGW(TAG, "Output stats skipped (out NULL or not int8)");
-        return;
-    }
-
-    const int8_t *d = out->data.int8;
-    const int n = out->bytes; // int8 => bytes == element count
-
-    float mn = 1e30f, mx = -1e30f;
-    double sum = 0.0;
-
-    for (int i = 0; i < n; i++) {
-        float v = dequant_i8(d[i], out);
-        if (v < mn) mn = v;
-        if (v > mx) mx = v;
-        sum += v;
-    }
-
-    double mean = sum / (double)n;
-    ESP_LOGI(TAG, "Output dequant stats: n=%d min=%.6f max=%.6f mean=%.6f", n, mn, mx, mean);
-}
-
 static void log_output_samples(const TfLiteTensor *out, int count)
 {
     if (!out || out->type != kTfLiteInt8) return;
@@ -229,220 +301,168 @@ static void log_output_samples(const TfLiteTensor *out, int count)
     const int n = out->bytes;
 
     int c = std::min(count, n);
-    std::string s;
-    s.reserve(128);
+    char s[512];
+    int len = 0;
+    s[0] = 0;
 
-    for (int i = 0; i < c; i++) {
-        char buf[64];
+    // Fixed line buffer: per-frame logging must not touch the heap
+    for (int i = 0; i < c && len < (int)sizeof(s); i++) {
         float deq = dequant_i8(d[i], out);
-        snprintf(buf, sizeof(buf), " [%d]=%d(%.4f)", i, (int)d[i], deq);
-        s += buf;
+        len += snprintf(s + len, sizeof(s) - len, " [%d]=%d(%.4f)", i, (int)d[i], deq);
     }
 
-    ESP_LOGI(TAG, "Output samples:%s", s.c_str());
+    ESP_LOGI(TAG, "Output samples:%s", s);
 }
 
 // -----------------------------------------------------------------------------
-// YOLO DIAGNOSTIC: global max class score (across all cells/classes)
+// Model config / load
 // -----------------------------------------------------------------------------
-static float log_max_class_score(const TfLiteTensor *out)
+static bool read_model_from_config(char *out_full_path, size_t out_len)
 {
-    float maxs = 0.0f;
-    const int8_t *d = out->data.int8;
-
-    const int N   = out->dims->data[1];
-    const int C   = out->dims->data[2];
-    const int CLS = C - REG_CH;
-
-    for (int i = 0; i < N; i++) {
-        for (int c = 0; c < CLS; c++) {
-            float p = sigmoid(
-                dequant_i8(d[i * C + REG_CH + c], out)
-            );
-            if (p > maxs)
-                maxs = p;
-        }
+    FILE *f = fopen(CONFIG_PATH, "r");
+    if (!f) {
+        ESP_LOGE(TAG, "Config file not found: %s", CONFIG_PATH);
+        return false;
     }
 
-    ESP_LOGI(TAG, "YOLO max class score = %.6f (CONF_THRESH=%.2f)", maxs, (double)CONF_THRESH);
-    return maxs;
-}
-
-typedef struct {
-    float score;
-    int cell;
-    int cls;
-} best_score_t;
-
-static best_score_t find_best_cell_class(const TfLiteTensor *out)
-{
-    best_score_t best{0.0f, -1, -1};
+    char line[256];
+    char model[128] = {0};
 
-    if (!out || out->type != kTfLiteInt8 || !out->dims || out->dims->size < 3) {
-        return best;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "#define", 7) == 0 && strstr(line, "MODEL")) {
+            char *q1 = strchr(line, '"');
+            char *q2 = q1 ? strchr(q1 + 1, '"') : nullptr;
+            if (q1 && q2 && q2 > q1 + 1) {
+                size_t len = q2 - q1 - 1;
+                strncpy(model, q1 + 1, len);
+                model[len] = 0;
+                break;
+            }
+        }
     }
 
-    const int8_t *data = out->data.int8;
-    const int N = out->dims->data[1];
-    const int C = out->dims->data[2];
-    const int CLS_CH = C - REG_CH;
+    fclose(f);
 
-    for (int i = 0; i < N; i++) {
-        int base = i * C;
-        for (int c = 0; c < CLS_CH; c++) {
-            float p = sigmoid(dequant_i8(data[base + REG_CH + c], out));
-            if (p > best.score) {
-                best.score = p;
-                best.cell = i;
-                best.cls = c;
-            }
-        }
+    if (!model[0]) {
+        ESP_LOGE(TAG, "MODEL not found in config");
+        return false;
     }
 
-    return best;
+    snprintf(out_full_path, out_len, "%s%s", MODEL_DIR, model);
+    ESP_LOGI(TAG, "Model: %s", out_full_path);
+    return true;
 }
 
-static void log_topk_classes_at_cell(const TfLiteTensor *out, int cell, int k)
+// Flash-mapped image when the partition holds (or can take) the model,
+// otherwise the SD file read into PSRAM
+static bool load_model_image(const char *model_path, model_image_t *img)
 {
-    if (!out || out->type != kTfLiteInt8 || !out->dims || out->dims->size < 3) return;
-    if (cell < 0) return;
-
-    const int8_t *data = out->data.int8;
-    const int C = out->dims->data[2];
-    const int CLS_CH = C - REG_CH;
-
-    std::vector<std::pair<float,int>> v;
-    v.reserve(CLS_CH);
-
-    int base = cell * C;
-    for (int c = 0; c < CLS_CH; c++) {
-        float p = sigmoid(dequant_i8(data[base + REG_CH + c], out));
-        v.push_back({p, c});
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+#if MODEL_FROM_FLASH
+    if (model_store_init(MODEL_PARTITION) == ESP_OK) {
+        err = model_store_install(model_path);
+        if (err == ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "Model not on SD: %s, using the installed copy", model_path);
+        } else if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Model install failed (%s)", esp_err_to_name(err));
+        }
+        if (err == ESP_OK || err == ESP_ERR_NOT_FOUND) {
+            err = model_store_map(MODEL_FLASH_VERIFY, img);
+        }
     }
+#endif
 
-    std::partial_sort(v.begin(), v.begin() + std::min(k, (int)v.size()), v.end(),
-                      [](auto &a, auto &b){ return a.first > b.first; });
+    if (err != ESP_OK) {
+        err = model_store_read_sd(model_path, img);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Model load failed: %s (%s)", model_path, esp_err_to_name(err));
+            return false;
+        }
+    }
 
-    std::string s;
-    for (int i = 0; i < k && i < (int)v.size(); i++) {
-        char buf[64];
-        snprintf(buf, sizeof(buf), " #%d cls=%d p=%.6f", i+1, v[i].second, (double)v[i].first);
-        s += buf;
+    ESP_LOGI(TAG, "Model: %lu KB %s in %lu ms",
+             (unsigned long)(img->size / 1024),
+             img->src == MODEL_SRC_FLASH ? "mapped from flash" : "read into PSRAM",
+             (unsigned long)(img->load_us / 1000));
+
+#if DBG_MODEL_LOAD_BENCH
+    if (img->src == MODEL_SRC_FLASH) {
+        model_image_t ref = {};
+        if (model_store_read_sd(model_path, &ref) == ESP_OK) {
+            ESP_LOGI(TAG, "[MODEL_LOAD_BENCH] flash map%s %lu us, SD → PSRAM %lu us, identical=%d",
+                     MODEL_FLASH_VERIFY ? " + verify" : "",
+                     (unsigned long)img->load_us, (unsigned long)ref.load_us,
+                     ref.size == img->size && memcmp(ref.data, img->data, ref.size) == 0);
+            model_store_release(&ref);
+        }
     }
+#endif
 
-    ESP_LOGI(TAG, "Top-%d classes at best cell %d:%s", k, cell, s.c_str());
+    return true;
 }
 
-// -----------------------------------------------------------------------------
-// YOLOv8 DFL DECODE
-// -----------------------------------------------------------------------------
-static int decode_yolov8(const TfLiteTensor *out, yolo_box_t *boxes)
+// Arena size for model: the stored plan, else one measured now (and
+// stored), else the fixed size. *stored: the size came from NVS.
+static size_t plan_arena_bytes(const tflite::Model *model, const tflite::MicroOpResolver &resolver,
+                               bool remeasure, bool *stored)
 {
-    const int8_t *data = out->data.int8;
-    int N = out->dims->data[1];
-    int C = out->dims->data[2];
-    int CLS_CH = C - REG_CH;
-
-    int grid = (int)roundf(sqrtf((float)N));
-    float stride = (float)INPUT_W / grid;
+    *stored = false;
 
-    // Deep sanity logs (one-liners, per-frame safe)
-    ESP_LOGI(TAG, "YOLO decode: N=%d C=%d CLS_CH=%d REG_CH=%d grid=%d stride=%.3f",
-             N, C, CLS_CH, REG_CH, grid, (double)stride);
+#if ARENA_AUTO_SIZE
+    arena_plan_t plan;
 
-    if (grid * grid != N) {
-        ESP_LOGW(TAG, "YOLO decode: N=%d is not a perfect square (grid=%d)", N, grid);
+    if (!remeasure && arena_plan_load(g_model_image.sha256, &plan) == ESP_OK) {
+        arena_plan_log(&plan, "stored");
+        *stored = true;
+        return plan.arena_bytes + ARENA_MARGIN_KB * 1024;
     }
 
-    int found = 0;
-
-    for (int i = 0; i < N && found < MAX_BOXES; i++) {
-        int base = i * C;
-        float dfl[4] = {0};
-
-        for (int s = 0; s < 4; s++) {
-            float sum = 0;
-            float probs[REG_MAX];
+    const size_t probe = std::min<size_t>(ARENA_PROBE_MAX_KB * 1024,
+        heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
 
-            for (int k = 0; k < REG_MAX; k++) {
-                probs[k] = expf(dequant_i8(
-                    data[base + s * REG_MAX + k], out));
-                sum += probs[k];
-            }
-            for (int k = 0; k < REG_MAX; k++)
-                dfl[s] += k * (probs[k] / sum);
+    if (arena_plan_measure(model, resolver, probe, g_model_image.sha256, &plan) == ESP_OK) {
+        arena_plan_log(&plan, "measured");
+        const esp_err_t err = arena_plan_save(&plan);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Arena plan not stored (%s)", esp_err_to_name(err));
         }
-
-        int best_cls = -1;
-        float best_score = 0;
-
-        for (int c = 0; c < CLS_CH; c++) {
-            float p = sigmoid(dequant_i8(
-                data[base + REG_CH + c], out));
-            if (p > best_score) {
-                best_score = p;
-                best_cls = c;
-            }
-        }
-
-        if (best_score < CONF_THRESH) continue;
-
-        int gx = i % grid;
-        int gy = i / grid;
-
-        float cx = (gx + 0.5f) * stride;
-        float cy = (gy + 0.5f) * stride;
-
-        boxes[found++] = {
-            cx - dfl[0] * stride,
-            cy - dfl[1] * stride,
-            (dfl[0] + dfl[2]) * stride,
-            (dfl[1] + dfl[3]) * stride,
-            best_score,
-            best_cls
-        };
+        return plan.arena_bytes + ARENA_MARGIN_KB * 1024;
     }
 
-    return found;
+    ESP_LOGW(TAG, "Arena plan unavailable, using %d KB", ARENA_FIXED_KB);
+#endif
+
+    return ARENA_FIXED_KB * 1024;
 }
 
-// -----------------------------------------------------------------------------
-// Model config / load
-// -----------------------------------------------------------------------------
-static bool read_model_from_config(char *out_full_path, size_t out_len)
+// Interpreter over a fresh PSRAM arena, nullptr (nothing kept) if the model
+// does not fit
+static tflite::MicroInterpreter *create_interpreter(
+    const tflite::Model *model,
+    const tflite::MicroOpResolver &resolver,
+    size_t arena_bytes,
+    tflite::MicroProfilerInterface *profiler)
 {
-    FILE *f = fopen(CONFIG_PATH, "r");
-    if (!f) {
-        ESP_LOGE(TAG, "Config file not found: %s", CONFIG_PATH);
-        return false;
-    }
-
-    char line[256];
-    char model[128] = {0};
-
-    while (fgets(line, sizeof(line), f)) {
-        if (strncmp(line, "#define", 7) == 0 && strstr(line, "MODEL")) {
-            char *q1 = strchr(line, '"');
-            char *q2 = q1 ? strchr(q1 + 1, '"') : nullptr;
-            if (q1 && q2 && q2 > q1 + 1) {
-                size_t len = q2 - q1 - 1;
-                strncpy(model, q1 + 1, len);
-                model[len] = 0;
-                break;
-            }
-        }
+    uint8_t *arena = (uint8_t *)heap_caps_malloc(arena_bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!arena) {
+        ESP_LOGE(TAG, "Tensor arena alloc failed (%u KB)", (unsigned)(arena_bytes / 1024));
+        return nullptr;
     }
 
-    fclose(f);
+    tflite::MicroInterpreter *interp = new tflite::MicroInterpreter(
+        model, resolver, arena, arena_bytes, nullptr, profiler);
 
-    if (!model[0]) {
-        ESP_LOGE(TAG, "MODEL not found in config");
-        return false;
+    if (interp->AllocateTensors() != kTfLiteOk) {
+        ESP_LOGE(TAG, "AllocateTensors failed (%u KB arena)", (unsigned)(arena_bytes / 1024));
+        delete interp;
+        heap_caps_free(arena);
+        return nullptr;
     }
 
-    snprintf(out_full_path, out_len, "%s%s", MODEL_DIR, model);
-    ESP_LOGI(TAG, "Model: %s", out_full_path);
-    return true;
+    ESP_LOGI(TAG, "Tensor arena: %u KB, %u B used",
+             (unsigned)(arena_bytes / 1024), (unsigned)interp->arena_used_bytes());
+    return interp;
 }
 
 static bool init_model()
@@ -454,24 +474,11 @@ static bool init_model()
         return false;
     }
 
-    struct stat st;
-    if (stat(model_path, &st) != 0) {
-        ESP_LOGE(TAG, "Model not found: %s", model_path);
+    if (!load_model_image(model_path, &g_model_image)) {
         return false;
     }
 
-    uint8_t *model_buf = (uint8_t *)
-        heap_caps_malloc(st.st_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!model_buf) {
-        ESP_LOGE(TAG, "Model buffer alloc failed");
-        return false;
-    }
-
-    FILE *f = fopen(model_path, "rb");
-    fread(model_buf, 1, st.st_size, f);
-    fclose(f);
-
-    const tflite::Model *model = tflite::GetModel(model_buf);
+    const tflite::Model *model = tflite::GetModel(g_model_image.data);
 
     static tflite::MicroMutableOpResolver<64> resolver;
     resolver.AddConv2D();
@@ -500,25 +507,33 @@ static bool init_model()
     resolver.AddResizeBilinear();
     resolver.AddFullyConnected();
 
-    uint8_t *arena = (uint8_t *)
-        heap_caps_malloc(2 * 1024 * 1024,
-                          MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!arena) {
-        ESP_LOGE(TAG, "Tensor arena alloc failed");
-        return false;
+    tflite::MicroProfilerInterface *profiler = nullptr;
+#if OP_PROFILER
+    if (op_profiler_init(model) == ESP_OK) {
+        op_profiler_enable(OP_PROFILER_ON);
+        profiler = op_profiler_interface();
+    } else {
+        ESP_LOGW(TAG, "Op profiler unavailable");
     }
+#endif
+
+    bool stored = false;
+    tflite::MicroInterpreter *interp = create_interpreter(
+        model, resolver, plan_arena_bytes(model, resolver, false, &stored), profiler);
 
-    static tflite::MicroInterpreter static_interpreter(
-        model, resolver, arena, 2 * 1024 * 1024);
+    if (!interp && stored) {
+        ESP_LOGW(TAG, "Stored arena plan does not fit, measuring again");
+        interp = create_interpreter(
+            model, resolver, plan_arena_bytes(model, resolver, true, &stored), profiler);
+    }
 
-    if (static_interpreter.AllocateTensors() != kTfLiteOk) {
-        ESP_LOGE(TAG, "AllocateTensors failed");
+    if (!interp) {
         return false;
     }
 
-    g_interpreter   = &static_interpreter;
-    g_input_tensor  = static_interpreter.input(0);
-    g_output_tensor = static_interpreter.output(0);
+    g_interpreter   = interp;
+    g_input_tensor  = interp->input(0);
+    g_output_tensor = interp->output(0);
 
     ESP_LOGI(TAG, "Model initialized successfully");
 
@@ -535,308 +550,981 @@ static bool init_model()
 }
 
 // -----------------------------------------------------------------------------
-// No-crop resize helper (RGB888, NN)
+// PIPELINE FRAME JOB
+// One job travels capture → decode → infer → post. Its buffers live in a
+// frame_pool slot (job i always uses slot i), so no stage allocates. The job
+// owns one slot reference; the HTTP preview may hold another.
 // -----------------------------------------------------------------------------
-static uint8_t *resize_rgb888_no_crop(
-    const uint8_t *src,
-    int src_w,
-    int src_h,
-    int dst_w,
-    int dst_h)
-{
-    // Geometry-preserving, no-crop resize using letterboxing
-    // Output is always dst_w × dst_h (e.g. 192×192)
-    // Aspect ratio preserved, padding added where needed
+typedef struct {
+    frame_slot_t *slot;
 
-    if (!src || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0)
-        return nullptr;
+    uint32_t seq;
+    int64_t  t_capture_us;
+    bool     has_crop;      // slot->rgb_crop filled
+    size_t   output_len;    // valid bytes in slot->output_i8 (0 = none)
 
-    uint8_t *dst = (uint8_t *)malloc(dst_w * dst_h * 3);
-    if (!dst)
-        return nullptr;
+    TfLiteStatus invoke_status;
+    int64_t      invoke_us;
+} frame_job_t;
 
-    // Fill with black (padding)
-    memset(dst, 0, dst_w * dst_h * 3);
+static frame_job_t s_jobs[FRAME_POOL_SLOTS + HTTPD_PREVIEW_SLOTS];
 
-    // Uniform scale
-    float scale = std::min(
-        (float)dst_w / (float)src_w,
-        (float)dst_h / (float)src_h
-    );
+// Input quantizer tables, built once the input tensor params are known
+static quant_lut_t s_in_lut;
 
-    int scaled_w = (int)(src_w * scale);
-    int scaled_h = (int)(src_h * scale);
+// Model-input letterbox filter of the reference path (the fused path keeps
+// its own, see preproc_set_filter())
+static volatile resample_filter_t s_input_filter = INPUT_RESIZE_FILTER;
 
-    int pad_x = (dst_w - scaled_w) / 2;
-    int pad_y = (dst_h - scaled_h) / 2;
+static frame_queue_t s_q_decode;   // capture → decode+preprocess
+static frame_queue_t s_q_infer;    // decode+preprocess → inference
+static frame_queue_t s_q_post;     // inference → post-process+persist
 
-    for (int y = 0; y < scaled_h; y++) {
-        int sy = (int)(y / scale);
-        if (sy >= src_h) sy = src_h - 1;
+static volatile uint32_t s_capture_fail = 0;
+static volatile uint32_t s_decode_fail  = 0;
+static volatile uint32_t s_invoke_fail  = 0;
+static volatile uint32_t s_persisted    = 0;
 
-        uint8_t *row_dst = dst + ((y + pad_y) * dst_w + pad_x) * 3;
+static frame_job_t *frame_job_acquire(void)
+{
+    frame_slot_t *slot = frame_pool_acquire(0);
+    if (!slot) return nullptr;
+
+    frame_job_t *job = &s_jobs[slot->index];
+    memset(job, 0, sizeof(*job));
+    job->slot = slot;
+    job->invoke_status = kTfLiteError;
+    return job;
+}
 
-        for (int x = 0; x < scaled_w; x++) {
-            int sx = (int)(x / scale);
-            if (sx >= src_w) sx = src_w - 1;
+static void frame_job_release(void *item)
+{
+    frame_job_t *job = (frame_job_t *)item;
+    if (!job) return;
 
-            const uint8_t *p = &src[(sy * src_w + sx) * 3];
-            uint8_t *q = row_dst + x * 3;
+    frame_pool_release(job->slot);
+}
 
-            q[0] = p[0];
-            q[1] = p[1];
-            q[2] = p[2];
-        }
-    }
+static void pipeline_log_stats(void)
+{
+    ESP_LOGI(TAG, "Stage stats: capture_fail=%lu pool_empty=%lu decode_fail=%lu invoke_fail=%lu persisted=%lu free_slots=%lu",
+             (unsigned long)s_capture_fail,
+             (unsigned long)frame_pool_acquire_failures(),
+             (unsigned long)s_decode_fail,
+             (unsigned long)s_invoke_fail,
+             (unsigned long)s_persisted,
+             (unsigned long)frame_pool_free_slots());
+
+#if MOTION_GATE
+    motion_gate_log_stats();
+#endif
 
-    return dst;
+    frame_queue_log_stats(&s_q_decode);
+    frame_queue_log_stats(&s_q_infer);
+    frame_queue_log_stats(&s_q_post);
+
+#if SD_ASYNC_WRITER
+    sd_writer_log_stats();
+#endif
+#if CAPTURE_CONTAINER
+    capture_store_log_stats();
+#endif
+    sdcard_capture_log_stats();
+#if RECORD_ON_EVENT
+    recorder_log_stats();
+#endif
+#if OP_PROFILER
+    if (op_profiler_enabled()) op_profiler_log_summary();
+#endif
 }
 
+#if RECORD_ON_EVENT
 // -----------------------------------------------------------------------------
-// PIPELINE TASK
+// Event recording: every frame goes through the pre-roll ring (JPEG; the
+// model input is attached once inferred); the recorder task persists the
+// frames around a trigger
 // -----------------------------------------------------------------------------
-void pipeline_task(void *pv)
+static void record_frame(const frame_job_t *job)
 {
-    ESP_LOGI(TAG, "Pipeline task started");
-    mkdir("/sdcard/capture", 0775);
+    recorder_frame_t f = {};
+    f.seq          = job->seq;
+    f.t_capture_us = job->t_capture_us;
+    f.jpeg         = job->slot->jpeg;
+    f.jpeg_len     = job->slot->jpeg_len;
 
-    while (!g_interpreter || !g_input_tensor || !g_output_tensor) {
-        ESP_LOGW(TAG, "Waiting for model initialization...");
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
-
-    // One-time sanity
-#if DBG_LOG_TENSORS
-    ESP_LOGI(TAG, "Pipeline ready: input type=%s output type=%s",
-             tf_type_str(g_input_tensor->type), tf_type_str(g_output_tensor->type));
+    recorder_push(&f);
+}
 #endif
 
+// -----------------------------------------------------------------------------
+// STAGE 1: capture + preview
+// -----------------------------------------------------------------------------
+static void capture_task(void *pv)
+{
+    ESP_LOGI(TAG, "Capture stage started on core %d", xPortGetCoreID());
+
     while (true) {
 
-        // -------------------------------------------------
-        // Capture
-        // -------------------------------------------------
         camera_fb_t *fb = esp_camera_fb_get();
         if (!fb) {
+            s_capture_fail++;
             vTaskDelay(pdMS_TO_TICKS(50));
             continue;
         }
 
         if (fb->format != PIXFORMAT_JPEG) {
             esp_camera_fb_return(fb);
+            s_capture_fail++;
             continue;
         }
 
         // -------------------------------------------------
-        // Preview JPEG (HTTP)
-        // -------------------------------------------------
-        httpd_update_last_frame(fb->buf, fb->len);
-
-        // -------------------------------------------------
-        // JPEG → RGB888
+        // Detach from the camera buffer so the driver keeps
+        // streaming while later stages work on this frame.
+        // No free slot = every stage is busy; skip this frame.
         // -------------------------------------------------
-        uint8_t *rgb = nullptr;
-        int w = 0, h = 0;
-
-        if (jpeg_to_rgb888(fb->buf, fb->len, &rgb, &w, &h) != ESP_OK) {
+        frame_job_t *job = frame_job_acquire();
+        if (!job) {
             esp_camera_fb_return(fb);
+            vTaskDelay(pdMS_TO_TICKS(CAPTURE_PERIOD_MS));
             continue;
         }
 
-        // -------------------------------------------------
-        // A) Aspect-crop resize (MODEL INPUT)
-        // -------------------------------------------------
-        uint8_t *resize_crop = nullptr;
-        resize_rgb888_aspect_crop(rgb, w, h, INPUT_W, &resize_crop);
-
-        if (!resize_crop) {
-            free(rgb);
+        if (fb->len > job->slot->jpeg_cap) {
+            ESP_LOGE(TAG, "JPEG too large for frame slot (%u > %u)",
+                     (unsigned)fb->len, (unsigned)job->slot->jpeg_cap);
+            frame_job_release(job);
             esp_camera_fb_return(fb);
+            s_capture_fail++;
+            vTaskDelay(pdMS_TO_TICKS(CAPTURE_PERIOD_MS));
             continue;
         }
 
+        memcpy(job->slot->jpeg, fb->buf, fb->len);
+        job->slot->jpeg_len = fb->len;
+        job->seq            = g_frame_seq++;
+        job->t_capture_us   = esp_timer_get_time();
+
+        esp_camera_fb_return(fb);
+
         // -------------------------------------------------
-        // B) No-crop resize (DATASET / AUDIT)
+        // Preview JPEG (HTTP): shares the slot, no copy
         // -------------------------------------------------
-        uint8_t *resize_nocrop =
-            resize_rgb888_no_crop(rgb, w, h, INPUT_W, INPUT_H);
+        httpd_publish_frame(job->slot);
 
-        free(rgb);
+        frame_queue_push_drop_oldest(&s_q_decode, job);
 
-        if (!resize_nocrop) {
-            free(resize_crop);
-            esp_camera_fb_return(fb);
-            continue;
+        vTaskDelay(pdMS_TO_TICKS(CAPTURE_PERIOD_MS));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// STAGE 2: decode + preprocess + quantize
+// -----------------------------------------------------------------------------
+// Reference path: full-frame decode, separate resizes, per-value quantize.
+// Kept for A/B against the fused path and as fallback (PREPROC_FUSED 0).
+static esp_err_t preprocess_reference(
+    frame_job_t *job,
+    const frame_scratch_t *scratch,
+    uint8_t *dst_nocrop,
+    int8_t *dst_i8)
+{
+    frame_slot_t *slot = job->slot;
+
+    // -------------------------------------------------
+    // JPEG → RGB888
+    // -------------------------------------------------
+    uint8_t *rgb = scratch->rgb;
+    int w = 0, h = 0;
+
+    esp_err_t err = jpeg_to_rgb888_into(slot->jpeg, slot->jpeg_len,
+                                        rgb, scratch->rgb_size,
+                                        &w, &h);
+    if (err != ESP_OK) return err;
+
+    // -------------------------------------------------
+    // A) Aspect-crop resize (AUDIT)
+    // -------------------------------------------------
+    resize_rgb888_aspect_crop_into(rgb, w, h, INPUT_W, slot->rgb_crop);
+    job->has_crop = true;
+
+    // -------------------------------------------------
+    // B) No-crop resize (MODEL INPUT)
+    // -------------------------------------------------
+    err = resize_rgb888_letterbox_filter_into(rgb, w, h, INPUT_W, INPUT_H,
+                                              s_input_filter, dst_nocrop);
+    if (err != ESP_OK) return err;
+
+    // -------------------------------------------------
+    // Quantize (MODEL INPUT – NON-CROPPED, LETTERBOXED)
+    // -------------------------------------------------
+    quant_lut_apply_rgb(&s_in_lut, dst_nocrop, dst_i8, INPUT_W * INPUT_H);
+
+    return ESP_OK;
+}
+
+static void preprocess_task(void *pv)
+{
+    ESP_LOGI(TAG, "Preprocess stage started on core %d (%s)",
+             xPortGetCoreID(), PREPROC_FUSED ? "fused" : "reference");
+
+    const int in_count = INPUT_W * INPUT_H * INPUT_CH;
+
+#if !PREPROC_FUSED || DBG_PREPROC_AB
+    // Full-frame decode buffers (reference / A-B only), reused every frame
+    const frame_scratch_t *scratch = frame_pool_scratch();
+#endif
+
+    while (true) {
+
+        frame_job_t *job = (frame_job_t *)frame_queue_pop(&s_q_decode, portMAX_DELAY);
+        if (!job) continue;
+
+        frame_slot_t *slot = job->slot;
+        esp_err_t err;
+
+#if DBG_DECODE_STRESS
+        // Decoder contexts: both cores decoding the same frame at once
+        static bool stressed = false;
+        if (!stressed) {
+            stressed = true;
+            jpeg_dec_stress(slot->jpeg, slot->jpeg_len, DBG_DECODE_STRESS);
         }
+#endif
+
+#if DBG_DECODE_PARALLEL_BENCH
+        static bool benched = false;
+        if (!benched) {
+            benched = true;
+            jpeg_dec_parallel_bench(slot->jpeg, slot->jpeg_len, DBG_DECODE_PARALLEL_BENCH);
+        }
+#endif
 
+#if DBG_THUMB_BENCH
+        static bool thumb_benched = false;
+        if (!thumb_benched) {
+            thumb_benched = true;
+            jpeg_thumb_benchmark(slot->jpeg, slot->jpeg_len, DBG_THUMB_BENCH);
+        }
+#endif
+
+#if DBG_RESIZE_BENCH
+        static bool resize_benched = false;
+        if (!resize_benched) {
+            resize_benched = true;
+            resize_filter_benchmark(slot->jpeg, slot->jpeg_len, INPUT_W, INPUT_H, DBG_RESIZE_BENCH);
+        }
+#endif
+
+#if MOTION_GATE
         // -------------------------------------------------
-        // Filenames
+        // Scene-change gate: static frames end here
         // -------------------------------------------------
-        char jpg_path[128];
-        char ppm_crop_path[128];
-        char ppm_nocrop_path[128];
+        motion_gate_result_t gate;
+        motion_gate_check(slot->jpeg, slot->jpeg_len, &gate);
 
-        snprintf(jpg_path, sizeof(jpg_path),
-                 "/sdcard/capture/frame_%06lu.jpg",
-                 (unsigned long)g_frame_seq);
+        ESP_LOGI(TAG, "Frame %06lu: gate %s (changed=%u‰, %ld us)",
+                 (unsigned long)job->seq,
+                 motion_gate_reason_str(gate.reason),
+                 (unsigned)gate.changed_permille, (long)gate.us);
 
-        snprintf(ppm_crop_path, sizeof(ppm_crop_path),
-                 "/sdcard/capture/frame_%06lu_cropped.ppm",
-                 (unsigned long)g_frame_seq);
+#if RECORD_ON_EVENT
+        if (!gate.run) record_frame(job);
+#endif
 
-        snprintf(ppm_nocrop_path, sizeof(ppm_nocrop_path),
-                 "/sdcard/capture/frame_%06lu_rgb192.ppm",
-                 (unsigned long)g_frame_seq);
+        if (!gate.run) {
+            frame_job_release(job);
 
-        // -------------------------------------------------
-        // Save original JPEG
-        // -------------------------------------------------
-        sdcard_write_file(jpg_path, fb->buf, fb->len);
+            motion_gate_stats_t gs;
+            motion_gate_get_stats(&gs);
+            if ((gs.gated % PIPELINE_STATS_EVERY) == 0) {
+                pipeline_log_stats();
+            }
+            continue;
+        }
+#endif
 
         // -------------------------------------------------
-        // Save preprocessed images
+        // JPEG → letterboxed, quantized model input.
+        // Staged in the slot: the tensor itself belongs to
+        // the inference stage while Invoke() runs.
         // -------------------------------------------------
-        ppm_write_rgb888(ppm_crop_path,
-                         resize_crop,
-                         INPUT_W,
-                         INPUT_H);
+#if PREPROC_FUSED
+        int64_t t0 = esp_timer_get_time();
+        err = preproc_jpeg_to_input(slot->jpeg, slot->jpeg_len,
+                                    slot->input_i8, slot->rgb_nocrop, slot->rgb_crop);
+        int64_t t1 = esp_timer_get_time();
+        job->has_crop = (err == ESP_OK);
+
+        ESP_LOGI(TAG, "Frame %06lu: fused preprocess %lld us",
+                 (unsigned long)job->seq, (long long)(t1 - t0));
+
+#if DBG_PREPROC_AB
+        // Reference output goes into the aux scratch; quantized in place.
+        if (err == ESP_OK &&
+            preprocess_reference(job, scratch, scratch->aux,
+                                 (int8_t *)scratch->aux) == ESP_OK) {
+            preproc_compare_i8("A/B fused vs reference",
+                               slot->input_i8, (const int8_t *)scratch->aux, in_count);
+        }
+#endif
+#else
+        err = preprocess_reference(job, scratch, slot->rgb_nocrop, slot->input_i8);
+#endif
 
-        ppm_write_rgb888(ppm_nocrop_path,
-                         resize_nocrop,
-                         INPUT_W,
-                         INPUT_H);
+        if (err != ESP_OK) {
+            s_decode_fail++;
+            frame_job_release(job);
+            continue;
+        }
 
         // -------------------------------------------------
-        // Input stats (pre-quant)
+        // Input stats
         // -------------------------------------------------
 #if DBG_LOG_INPUT_STATS
-        log_rgb_stats_u8("MODEL_INPUT_RGB (cropped)", resize_crop, INPUT_W, INPUT_H);
-        log_rgb_stats_u8("AUDIT_RGB (nocrop)", resize_nocrop, INPUT_W, INPUT_H);
+        if (job->has_crop) {
+            log_rgb_stats_u8("MODEL_INPUT_RGB (cropped)", slot->rgb_crop, INPUT_W, INPUT_H);
+        }
+        log_rgb_stats_u8("AUDIT_RGB (nocrop)", slot->rgb_nocrop, INPUT_W, INPUT_H);
+        log_i8_stats("MODEL_INPUT_INT8", slot->input_i8, in_count,
+                     g_input_tensor->params.scale,
+                     g_input_tensor->params.zero_point);
 #endif
 
-    // -------------------------------------------------
-    // Quantize (MODEL INPUT – NON-CROPPED, GEOMETRY-DISTORTED)
-    // -------------------------------------------------
-    const int in_count = INPUT_W * INPUT_H * 3;
+#if RECORD_ON_EVENT
+        record_frame(job);
+#if MOTION_GATE
+        if (gate.reason == MOTION_GATE_MOTION) recorder_trigger(REC_TRIGGER_MOTION, 0);
+#endif
+#endif
 
-    for (int i = 0; i < in_count; i++) {
-        g_input_tensor->data.int8[i] =
-            quantize_u8_to_int8(
-                resize_nocrop[i],
-                g_input_tensor->params.scale,
-                g_input_tensor->params.zero_point
-            );
+        frame_queue_push_drop_oldest(&s_q_infer, job);
     }
+}
 
-#if DBG_LOG_INPUT_STATS
-log_i8_stats("MODEL_INPUT_INT8",
-            g_input_tensor->data.int8,
-            in_count,
-            g_input_tensor->params.scale,
-            g_input_tensor->params.zero_point);
-#endif
+// -----------------------------------------------------------------------------
+// STAGE 3: inference (sole owner of the interpreter)
+// -----------------------------------------------------------------------------
+static void inference_task(void *pv)
+{
+    ESP_LOGI(TAG, "Inference stage started on core %d", xPortGetCoreID());
 
-        free(resize_crop);
-        free(resize_nocrop);
+    const size_t in_count = INPUT_W * INPUT_H * INPUT_CH;
+
+    while (true) {
+
+        frame_job_t *job = (frame_job_t *)frame_queue_pop(&s_q_infer, portMAX_DELAY);
+        if (!job) continue;
+
+        memcpy(g_input_tensor->data.int8, job->slot->input_i8, in_count);
 
-        // -------------------------------------------------
-        // Inference
-        // -------------------------------------------------
         int64_t t0 = esp_timer_get_time();
-        TfLiteStatus st = g_interpreter->Invoke();
+#if OP_PROFILER
+        op_profiler_invoke_begin();
+#endif
+        job->invoke_status = g_interpreter->Invoke();
+#if OP_PROFILER
+        op_profiler_invoke_end();
+#endif
         int64_t t1 = esp_timer_get_time();
+        job->invoke_us = t1 - t0;
 
-        ESP_LOGI(TAG, "Frame %06lu: Invoke()=%s time=%lld us",
-                 (unsigned long)g_frame_seq,
-                 (st == kTfLiteOk ? "kTfLiteOk" : "kTfLiteError"),
-                 (long long)(t1 - t0));
+        ESP_LOGI(TAG, "Frame %06lu: Invoke()=%s time=%lld us (capture→done %lld us)",
+                 (unsigned long)job->seq,
+                 (job->invoke_status == kTfLiteOk ? "kTfLiteOk" : "kTfLiteError"),
+                 (long long)job->invoke_us,
+                 (long long)(t1 - job->t_capture_us));
 
-        if (st != kTfLiteOk) {
-            ESP_LOGE(TAG, "Invoke failed on frame %lu", (unsigned long)g_frame_seq);
-            esp_camera_fb_return(fb);
-            g_frame_seq++;
-            vTaskDelay(pdMS_TO_TICKS(300));
-            continue;
+        if (job->invoke_status != kTfLiteOk) {
+            ESP_LOGE(TAG, "Invoke failed on frame %lu", (unsigned long)job->seq);
+            s_invoke_fail++;
+        } else {
+            // Output tensor is overwritten by the next Invoke(); post-processing
+            // runs concurrently, so it works on the slot's private copy.
+            job->output_len = g_output_tensor->bytes;
+            memcpy(job->slot->output_i8, g_output_tensor->data.int8, job->output_len);
         }
 
-        // -------------------------------------------------
-        // Output logging
-        // -------------------------------------------------
+        frame_queue_push_drop_oldest(&s_q_post, job);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// STAGE 4: post-process + persist
+// -----------------------------------------------------------------------------
+static void postprocess_frame(frame_job_t *job)
+{
+    // Shallow tensor view over the job's private output copy
+    TfLiteTensor out_view = *g_output_tensor;
+    out_view.data.int8 = job->slot->output_i8;
+    const TfLiteTensor *out = &out_view;
+
+    // -------------------------------------------------
+    // Output logging
+    // -------------------------------------------------
 #if DBG_LOG_TENSORS
-        // per-frame light sanity (dims can change only if model changed)
-        if (g_output_tensor && g_output_tensor->dims && g_output_tensor->dims->size >= 3) {
-            ESP_LOGI(TAG, "OUTPUT dims: [%d x %d x %d] type=%s",
-                     g_output_tensor->dims->data[0],
-                     g_output_tensor->dims->data[1],
-                     g_output_tensor->dims->data[2],
-                     tf_type_str(g_output_tensor->type));
-        }
+    // per-frame light sanity (dims can change only if model changed)
+    if (out->dims && out->dims->size >= 3) {
+        ESP_LOGI(TAG, "OUTPUT dims: [%d x %d x %d] type=%s",
+                 out->dims->data[0],
+                 out->dims->data[1],
+                 out->dims->data[2],
+                 tf_type_str(out->type));
+    }
 #endif
 
+    // -------------------------------------------------
+    // YOLO: one int8 scan → stats + survivors decoded
+    // -------------------------------------------------
+    yolo_scan_stats_t st = {};
+    yolo_box_t boxes[MAX_BOXES];
+
+    int n = yolo_decode(out->data.int8, boxes, MAX_BOXES, &st);
+
 #if DBG_LOG_OUTPUT_STATS
-        log_output_dequant_stats(g_output_tensor);
+    if (st.count > 0) {
+        ESP_LOGI(TAG, "Output dequant stats: n=%d min=%.6f max=%.6f mean=%.6f",
+                 st.count,
+                 (double)dequant_i8(st.q_min, out),
+                 (double)dequant_i8(st.q_max, out),
+                 ((double)st.q_sum / st.count - out->params.zero_point) * out->params.scale);
+    }
 #endif
 
 #if DBG_LOG_OUTPUT_SAMPLES
-        log_output_samples(g_output_tensor, 16);
+    log_output_samples(out, 16);
 #endif
 
-        // -------------------------------------------------
-        // YOLO: deep scan and decode
-        // -------------------------------------------------
 #if DBG_LOG_YOLO_SCAN
-        float maxp = log_max_class_score(g_output_tensor);
-        best_score_t best = find_best_cell_class(g_output_tensor);
-        ESP_LOGI(TAG, "Best cell/class: cell=%d cls=%d p=%.6f (global max=%.6f)",
-                 best.cell, best.cls, (double)best.score, (double)maxp);
-
-        // Log top-k at that cell to see distribution (helpful for wrong label maps)
-        if (best.cell >= 0) {
-            log_topk_classes_at_cell(g_output_tensor, best.cell, DBG_TOPK_CLASSES);
+    ESP_LOGI(TAG, "YOLO max class score = %.6f (CONF_THRESH=%.2f, q>=%d)",
+             (double)st.best_score, (double)CONF_THRESH, yolo_decode_q_thresh());
+    ESP_LOGI(TAG, "Best cell/class: cell=%d cls=%d p=%.6f (raw=%d)",
+             st.best_cell, st.best_cls, (double)st.best_score, (int)st.best_q);
+
+    // Log top-k at that cell to see distribution (helpful for wrong label maps)
+    if (st.best_cell >= 0) {
+        int   top_cls[DBG_TOPK_CLASSES];
+        float top_p[DBG_TOPK_CLASSES];
+        int k = yolo_decode_topk_at_cell(out->data.int8, st.best_cell,
+                                         DBG_TOPK_CLASSES, top_cls, top_p);
+
+        char s[256];
+        int len = 0;
+        s[0] = 0;
+        for (int i = 0; i < k && len < (int)sizeof(s); i++) {
+            len += snprintf(s + len, sizeof(s) - len, " #%d cls=%d p=%.6f",
+                            i + 1, top_cls[i], (double)top_p[i]);
         }
+        ESP_LOGI(TAG, "Top-%d classes at best cell %d:%s", k, st.best_cell, s);
+    }
 #endif
 
-        yolo_box_t boxes[MAX_BOXES];
-        int n = decode_yolov8(g_output_tensor, boxes);
+    ESP_LOGI(TAG, "Frame %06lu: Detections=%d (CONF_THRESH=%.2f) candidates=%d top-k=%d suppressed=%d scan=%ld us nms=%ld us",
+             (unsigned long)job->seq, n, (double)CONF_THRESH,
+             st.candidates, st.nms_in, st.suppressed,
+             (long)st.scan_us, (long)st.nms_us);
 
-        ESP_LOGI(TAG, "Frame %06lu: Detections=%d (CONF_THRESH=%.2f)",
-                 (unsigned long)g_frame_seq, n, (double)CONF_THRESH);
+#if RECORD_ON_EVENT
+    for (int i = 0; i < n; i++) {
+        recorder_on_detection(job->seq, boxes[i].cls, boxes[i].score);
+    }
+#endif
 
 #if DBG_LOG_DETECTIONS
-        if (n > 0) {
-            int lim = std::min(n, DBG_DUMP_LIMIT_BOXES);
-            for (int i = 0; i < lim; i++) {
-                ESP_LOGI(TAG,
-                         "Box[%d]: cls=%d score=%.6f  x=%.1f y=%.1f w=%.1f h=%.1f",
-                         i,
-                         boxes[i].cls,
-                         (double)boxes[i].score,
-                         (double)boxes[i].x,
-                         (double)boxes[i].y,
-                         (double)boxes[i].w,
-                         (double)boxes[i].h);
-            }
-            if (n > lim) {
-                ESP_LOGI(TAG, "Box dump truncated: printed %d / %d", lim, n);
-            }
-        } else {
-            // Critical: show why there are no boxes (threshold vs dead model)
-            // If best.score is near 0.0 always -> likely model mismatch / bad quant / wrong op set
-            best_score_t best = find_best_cell_class(g_output_tensor);
-            ESP_LOGW(TAG,
-                     "No detections. Best p=%.6f at cell=%d cls=%d (threshold=%.2f).",
-                     (double)best.score, best.cell, best.cls, (double)CONF_THRESH);
+    if (n > 0) {
+        int lim = std::min(n, DBG_DUMP_LIMIT_BOXES);
+        for (int i = 0; i < lim; i++) {
+            ESP_LOGI(TAG,
+                     "Box[%d]: cls=%d score=%.6f  x=%.1f y=%.1f w=%.1f h=%.1f",
+                     i,
+                     boxes[i].cls,
+                     (double)boxes[i].score,
+                     (double)boxes[i].x,
+                     (double)boxes[i].y,
+                     (double)boxes[i].w,
+                     (double)boxes[i].h);
         }
+        if (n > lim) {
+            ESP_LOGI(TAG, "Box dump truncated: printed %d / %d", lim, n);
+        }
+    } else {
+        // Critical: show why there are no boxes (threshold vs dead model)
+        // If best.score is near 0.0 always -> likely model mismatch / bad quant / wrong op set
+        ESP_LOGW(TAG,
+                 "No detections. Best p=%.6f at cell=%d cls=%d (threshold=%.2f).",
+                 (double)st.best_score, st.best_cell, st.best_cls, (double)CONF_THRESH);
+    }
 #endif
+}
 
-        // -------------------------------------------------
-        // Cleanup
-        // -------------------------------------------------
-        esp_camera_fb_return(fb);
-        g_frame_seq++;
+#if CAPTURE_CONTAINER
+// Wall-clock time of a monotonic esp_timer stamp
+static int64_t wall_time_us(int64_t mono_us)
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - (esp_timer_get_time() - mono_us);
+}
+#endif
+
+// JPEG plus the optional audit images (rgb_crop / rgb_nocrop may be NULL).
+// Returns the JPEG's status; the images are best effort.
+static esp_err_t persist_artifacts(
+    uint32_t seq,
+    int64_t t_capture_us,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    const uint8_t *rgb_crop,
+    const uint8_t *rgb_nocrop)
+{
+#if CAPTURE_CONTAINER
+    // -------------------------------------------------
+    // Append to the open segment: sequential writes,
+    // no per-frame directory entries
+    // -------------------------------------------------
+    if (capture_store_ready()) {
+        const int64_t t_us = wall_time_us(t_capture_us);
+
+        esp_err_t err = capture_store_append(CAP_REC_JPEG, seq, t_us, 0, 0, jpeg, jpeg_len, 0);
+
+        if (rgb_crop) {
+            capture_store_append(CAP_REC_RGB888_CROP, seq, t_us, INPUT_W, INPUT_H,
+                                 rgb_crop, INPUT_W * INPUT_H * 3, SD_WRITE_OPTIONAL);
+        }
+        if (rgb_nocrop) {
+            capture_store_append(CAP_REC_RGB888_LETTERBOX, seq, t_us, INPUT_W, INPUT_H,
+                                 rgb_nocrop, INPUT_W * INPUT_H * 3, SD_WRITE_OPTIONAL);
+        }
+        return err;
+    }
+#endif
+
+    // -------------------------------------------------
+    // Filenames
+    // -------------------------------------------------
+    // Hour shard of the capture namespace, one entry per file
+    char dir[96];
+    if (sdcard_capture_dir(dir, sizeof(dir), 1 + (rgb_crop ? 1 : 0) + (rgb_nocrop ? 1 : 0)) < 0) {
+        strcpy(dir, "/sdcard/capture");
+    }
+
+    char jpg_path[128];
+    char ppm_crop_path[128];
+    char ppm_nocrop_path[128];
+
+    snprintf(jpg_path, sizeof(jpg_path),
+             "%s/frame_%06lu.jpg",
+             dir, (unsigned long)seq);
+
+    snprintf(ppm_crop_path, sizeof(ppm_crop_path),
+             "%s/frame_%06lu_cropped.ppm",
+             dir, (unsigned long)seq);
+
+    snprintf(ppm_nocrop_path, sizeof(ppm_nocrop_path),
+             "%s/frame_%06lu_rgb192.ppm",
+             dir, (unsigned long)seq);
+
+#if SD_ASYNC_WRITER
+    // -------------------------------------------------
+    // Queue for the SD writer: the JPEG is the record,
+    // the .ppm files are audit output and go first when
+    // the card falls behind
+    // -------------------------------------------------
+    if (sd_writer_ready()) {
+        esp_err_t err = sd_writer_submit(jpg_path, nullptr, 0, jpeg, jpeg_len, 0);
+
+        if (rgb_crop) {
+            ppm_submit_rgb888(ppm_crop_path, rgb_crop,
+                              INPUT_W, INPUT_H, SD_WRITE_OPTIONAL);
+        }
+        if (rgb_nocrop) {
+            ppm_submit_rgb888(ppm_nocrop_path, rgb_nocrop,
+                              INPUT_W, INPUT_H, SD_WRITE_OPTIONAL);
+        }
+        return err;
+    }
+#endif
+
+    // -------------------------------------------------
+    // Save original JPEG
+    // -------------------------------------------------
+    esp_err_t err = sdcard_write_file(jpg_path, jpeg, jpeg_len);
+
+    // -------------------------------------------------
+    // Save preprocessed images
+    // -------------------------------------------------
+    if (rgb_crop) {
+        ppm_write_rgb888(ppm_crop_path,
+                         rgb_crop,
+                         INPUT_W,
+                         INPUT_H);
+    }
+
+    if (rgb_nocrop) {
+        ppm_write_rgb888(ppm_nocrop_path,
+                         rgb_nocrop,
+                         INPUT_W,
+                         INPUT_H);
+    }
+    return err;
+}
+
+static void persist_frame(const frame_job_t *job)
+{
+    persist_artifacts(job->seq, job->t_capture_us,
+                      job->slot->jpeg, job->slot->jpeg_len,
+                      job->has_crop ? job->slot->rgb_crop : nullptr,
+                      job->slot->rgb_nocrop);
+}
+
+#if RECORD_ON_EVENT
+static esp_err_t record_sink(const recorder_frame_t *f)
+{
+#if SD_ASYNC_WRITER
+    // Background task: wait for the SD writer rather than being shed
+    if (sd_writer_ready()) {
+        sd_writer_wait_room(f->jpeg_len + (f->rgb ? INPUT_W * INPUT_H * 3 : 0),
+                            pdMS_TO_TICKS(5000));
+    }
+#endif
+    const esp_err_t err = persist_artifacts(f->seq, f->t_capture_us, f->jpeg, f->jpeg_len, nullptr, f->rgb);
+
+    // This task creates the capture files now: the shard is prepared here too
+    sdcard_capture_prepare(CAPTURE_SHARD_AHEAD_S);
+    return err;
+}
+
+static bool http_record(uint32_t frames)
+{
+    if (!recorder_ready() || !(REC_TRIGGERS & REC_TRIGGER_MANUAL)) return false;
+
+    recorder_trigger(REC_TRIGGER_MANUAL, frames);
+    return true;
+}
+#endif
+
+#if OP_PROFILER
+static size_t http_profile(const httpd_profile_req_t *req, char *out, size_t cap)
+{
+    if (!op_profiler_ready()) return 0;
+
+    if (req->enable >= 0) op_profiler_enable(req->enable != 0);
+    if (req->reset) op_profiler_reset();
+
+    size_t len = 0;
+    if (req->dump) {
+        char path[64];
+        snprintf(path, sizeof(path), OP_PROFILER_DIR "/ops_%06lu.csv", (unsigned long)g_frame_seq);
+        sdcard_mkdir(OP_PROFILER_DIR);
+
+        const esp_err_t err = op_profiler_dump_csv(path);
+        if (!req->csv) {
+            len = snprintf(out, cap, "%s %s\n\n", err == ESP_OK ? "Wrote" : "Failed to write", path);
+        }
+    }
+
+    return len + (req->csv ? op_profiler_csv(out + len, cap - len)
+                           : op_profiler_report(out + len, cap - len, req->top));
+}
+#endif
+
+// GET /filter: model-input filter for the following frames, both paths
+static resample_filter_t http_filter(const resample_filter_t *set)
+{
+    if (set) {
+        if (preproc_set_filter(*set) != ESP_OK) return s_input_filter;
+        s_input_filter = *set;
+        ESP_LOGI(TAG, "Input filter -> %d", (int)*set);
+    }
+    return s_input_filter;
+}
+
+static void postprocess_task(void *pv)
+{
+    ESP_LOGI(TAG, "Post-process stage started on core %d", xPortGetCoreID());
+
+    while (true) {
+
+        frame_job_t *job = (frame_job_t *)frame_queue_pop(&s_q_post, portMAX_DELAY);
+        if (!job) continue;
+
+#if RECORD_ON_EVENT
+        // The model input goes with the frame, before a detection can mark it
+        if (job->invoke_status == kTfLiteOk) recorder_attach_rgb(job->seq, job->slot->rgb_nocrop);
+#endif
+
+        if (job->invoke_status == kTfLiteOk && job->output_len > 0) {
+            postprocess_frame(job);
+        }
+
+#if RECORD_ON_EVENT
+        // Frames reach the card through the recorder
+        if (!recorder_ready()) persist_frame(job);
+#else
+        persist_frame(job);
+#endif
+        s_persisted++;
+
+        // Next hour's shard is created here, not on the next frame's write path
+        // (by the file-creating task: the recorder's sink while it records)
+#if RECORD_ON_EVENT
+        if (!recorder_ready()) sdcard_capture_prepare(CAPTURE_SHARD_AHEAD_S);
+#else
+        sdcard_capture_prepare(CAPTURE_SHARD_AHEAD_S);
+#endif
+
+        if ((s_persisted % PIPELINE_STATS_EVERY) == 0) {
+            pipeline_log_stats();
+        }
+
+        uint32_t seq = job->seq;
+        frame_job_release(job);
+
+        frame_pool_heap_guard_check(seq);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// PIPELINE START
+// -----------------------------------------------------------------------------
+static bool pipeline_start(void)
+{
+    ESP_LOGI(TAG, "Pipeline starting (staged, dual-core)");
+    sdcard_capture_ns_init("/sdcard/capture", CAPTURE_DIR_MAX_FILES);
+
+#if DBG_SD_CREATE_BENCH
+    sdcard_create_benchmark("/sdcard/bench_create", DBG_SD_CREATE_BENCH, 250);
+#endif
+
+    if (!g_interpreter || !g_input_tensor || !g_output_tensor) {
+        ESP_LOGE(TAG, "Pipeline start without initialized model");
+        return false;
+    }
+
+    // One-time sanity
+#if DBG_LOG_TENSORS
+    ESP_LOGI(TAG, "Pipeline ready: input type=%s output type=%s",
+             tf_type_str(g_input_tensor->type), tf_type_str(g_output_tensor->type));
+#endif
+
+    // -------------------------------------------------
+    // Frame arena: sized once from camera + model dims
+    // -------------------------------------------------
+    frame_pool_cfg_t pool_cfg = {};
+    if (camera_get_frame_size(&pool_cfg.src_w, &pool_cfg.src_h) != ESP_OK) {
+        ESP_LOGE(TAG, "Camera frame size unknown");
+        return false;
+    }
+    pool_cfg.dst_w             = INPUT_W;
+    pool_cfg.dst_h             = INPUT_H;
+    pool_cfg.dst_ch            = INPUT_CH;
+    pool_cfg.output_bytes      = g_output_tensor->bytes;
+    pool_cfg.slot_count        = FRAME_POOL_SLOTS + HTTPD_PREVIEW_SLOTS;   // latest + slots clients send from
+    pool_cfg.full_frame_scratch = !PREPROC_FUSED || DBG_PREPROC_AB;
+    pool_cfg.heap_guard        = DBG_HEAP_GUARD;
+    pool_cfg.heap_guard_warmup = DBG_HEAP_GUARD_WARMUP;
+    pool_cfg.heap_guard_slack  = DBG_HEAP_GUARD_SLACK;
+
+    if (frame_pool_init(&pool_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Frame pool init failed");
+        return false;
+    }
+
+    // -------------------------------------------------
+    // Input quantizer: tensor params (+ folding) → LUT
+    // -------------------------------------------------
+    quant_lut_cfg_t q_cfg;
+    quant_lut_default_cfg(&q_cfg,
+                          g_input_tensor->params.scale,
+                          g_input_tensor->params.zero_point);
+    q_cfg.contrast  = INPUT_CONTRAST;
+    q_cfg.gamma     = INPUT_GAMMA;
+    q_cfg.normalize = INPUT_NORMALIZE;
+    for (int c = 0; c < 3; c++) {
+        q_cfg.mean[c] = INPUT_MEAN[c];
+        q_cfg.std[c]  = INPUT_STD[c];
+    }
+
+    if (quant_lut_build(&s_in_lut, &q_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Input LUT build failed");
+        return false;
+    }
+
+#if DBG_QUANT_BENCH
+    quant_lut_benchmark(&s_in_lut, &q_cfg, INPUT_W * INPUT_H, 10);
+#endif
+
+#if DBG_TJPGD_KERN_BENCH
+    tjpgd_kern_benchmark(DBG_TJPGD_KERN_BENCH);
+#endif
+
+    // -------------------------------------------------
+    // Output decoder: int8 threshold + tables built once
+    // -------------------------------------------------
+    if (!g_output_tensor->dims || g_output_tensor->dims->size < 3) {
+        ESP_LOGE(TAG, "Unexpected output tensor rank");
+        return false;
+    }
+
+    yolo_decode_cfg_t yd_cfg = {};
+    yd_cfg.desc.layout          = YOLO_LAYOUT;
+    yd_cfg.desc.box_format      = YOLO_BOX_FORMAT;
+    yd_cfg.desc.num_classes     = YOLO_NUM_CLASSES;
+    yd_cfg.desc.reg_max         = YOLO_REG_MAX;
+    yd_cfg.desc.xywh_normalized = YOLO_XYWH_NORMALIZED;
+    yd_cfg.desc.cls_activated   = YOLO_CLS_ACTIVATED;
+    yd_cfg.desc.num_strides     = sizeof(YOLO_STRIDES) / sizeof(YOLO_STRIDES[0]);
+    for (int i = 0; i < yd_cfg.desc.num_strides; i++) {
+        yd_cfg.desc.strides[i] = YOLO_STRIDES[i];
+    }
+
+    yd_cfg.dim1           = g_output_tensor->dims->data[1];
+    yd_cfg.dim2           = g_output_tensor->dims->data[2];
+    yd_cfg.input_w        = INPUT_W;
+    yd_cfg.input_h        = INPUT_H;
+    yd_cfg.conf_thresh    = CONF_THRESH;
+    yd_cfg.nms_topk        = NMS_TOPK;
+    yd_cfg.nms_iou_thresh  = NMS_IOU_THRESH;
+    yd_cfg.nms_class_aware = NMS_CLASS_AWARE;
+    yd_cfg.out_scale      = g_output_tensor->params.scale;
+    yd_cfg.out_zero_point = g_output_tensor->params.zero_point;
+
+    if (yolo_decode_init(&yd_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "YOLO decoder init failed");
+        return false;
+    }
 
-        vTaskDelay(pdMS_TO_TICKS(300));
+#if MOTION_GATE
+    // -------------------------------------------------
+    // Motion gate: thumbnail + background
+    // -------------------------------------------------
+    motion_gate_cfg_t gate_cfg = {};
+    gate_cfg.src_w           = pool_cfg.src_w;
+    gate_cfg.src_h           = pool_cfg.src_h;
+    gate_cfg.pixel_thresh    = GATE_PIXEL_THRESH;
+    gate_cfg.area_permille   = GATE_AREA_PERMILLE;
+    gate_cfg.bg_shift        = GATE_BG_SHIFT;
+    gate_cfg.bg_shift_motion = GATE_BG_SHIFT_MOTION;
+    gate_cfg.force_every     = GATE_FORCE_EVERY;
+    gate_cfg.warmup_frames   = GATE_WARMUP_FRAMES;
+
+    if (motion_gate_init(&gate_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Motion gate init failed");
+        return false;
     }
+#endif
+
+#if JPEG_PARALLEL_DECODE || DBG_DECODE_PARALLEL_BENCH
+    // -------------------------------------------------
+    // Second decode worker next to Invoke()
+    // -------------------------------------------------
+    if (jpeg_dec_parallel_init(CORE_INFER) != ESP_OK) {
+        ESP_LOGW(TAG, "Two-core decode unavailable, single-core only");
+    }
+#endif
+
+    // -------------------------------------------------
+    // Fused preprocessor: letterbox / crop maps built once
+    // -------------------------------------------------
+    preproc_cfg_t pp_cfg = {};
+    pp_cfg.src_w         = pool_cfg.src_w;
+    pp_cfg.src_h         = pool_cfg.src_h;
+    pp_cfg.dst_w         = INPUT_W;
+    pp_cfg.dst_h         = INPUT_H;
+    pp_cfg.crop_size     = INPUT_W;     // audit crop, as the reference path
+    pp_cfg.filter        = INPUT_RESIZE_FILTER;
+    pp_cfg.lut           = &s_in_lut;
+    pp_cfg.rgb565_compat = false;   // reference path decodes straight to RGB888
+
+    if (preproc_init(&pp_cfg) != ESP_OK) {
+        ESP_LOGE(TAG, "Preprocessor init failed");
+        return false;
+    }
+
+    if (frame_queue_init(&s_q_decode, "decode", Q_DEPTH_DECODE, frame_job_release) != ESP_OK ||
+        frame_queue_init(&s_q_infer,  "infer",  Q_DEPTH_INFER,  frame_job_release) != ESP_OK ||
+        frame_queue_init(&s_q_post,   "post",   Q_DEPTH_POST,   frame_job_release) != ESP_OK) {
+        ESP_LOGE(TAG, "Pipeline queue init failed");
+        return false;
+    }
+
+    // Inference gets core 1 to itself; everything else shares core 0
+    // with Wi-Fi / lwIP and overlaps the ~10 s Invoke().
+#if SD_ASYNC_WRITER
+    // -------------------------------------------------
+    // SD writer: below STG_POST so card stalls never
+    // hold up the stages; on failure persist_frame
+    // writes synchronously
+    // -------------------------------------------------
+    sd_writer_cfg_t sdw_cfg = {};
+    sdw_cfg.ring_bytes        = SD_WRITER_RING_KB * 1024;
+    sdw_cfg.max_jobs          = SD_WRITER_JOBS;
+    sdw_cfg.chunk_bytes       = SD_WRITER_CHUNK_DEFAULT;
+    sdw_cfg.policy            = SD_WRITER_BLOCK_MS > 0 ? SD_WRITER_BLOCK : SD_WRITER_DROP;
+    sdw_cfg.block_ms          = SD_WRITER_BLOCK_MS;
+    sdw_cfg.optional_fill_pct = SD_WRITER_SHED_PCT;
+    sdw_cfg.core              = CORE_IO;
+    sdw_cfg.priority          = 2;
+
+    if (sd_writer_init(&sdw_cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "SD writer unavailable, persisting synchronously");
+    }
+#endif
+
+#if CAPTURE_CONTAINER
+    // -------------------------------------------------
+    // Capture segments; without them persist_frame
+    // falls back to three files per frame
+    // -------------------------------------------------
+    capture_store_cfg_t cap_cfg = {};
+    cap_cfg.dir           = "/sdcard/capture";
+    cap_cfg.segment_bytes = CAPTURE_SEGMENT_MB * 1024 * 1024;
+    cap_cfg.max_records   = CAPTURE_MAX_RECORDS;
+    cap_cfg.index_every   = CAPTURE_INDEX_EVERY;
+
+    if (capture_store_init(&cap_cfg) != ESP_OK) {
+        ESP_LOGW(TAG, "Capture store unavailable, one file per artifact");
+    }
+#endif
+
+#if RECORD_ON_EVENT
+    // -------------------------------------------------
+    // Pre-roll ring; without it every inferred frame
+    // is persisted as before
+    // -------------------------------------------------
+    recorder_cfg_t rec_cfg = {};
+    rec_cfg.ring_frames     = REC_RING_FRAMES;
+    rec_cfg.preroll_frames  = REC_PREROLL_FRAMES;
+    rec_cfg.postroll_frames = REC_POSTROLL_FRAMES;
+    rec_cfg.jpeg_cap        = (size_t)pool_cfg.src_w * pool_cfg.src_h / 2;   // = frame_pool slot
+    rec_cfg.rgb_frames      = REC_RGB_FRAMES;
+    rec_cfg.rgb_w           = INPUT_W;
+    rec_cfg.rgb_h           = INPUT_H;
+    rec_cfg.triggers        = REC_TRIGGERS;
+    rec_cfg.class_rules     = REC_CLASS_RULES;
+    rec_cfg.num_class_rules = sizeof(REC_CLASS_RULES) / sizeof(REC_CLASS_RULES[0]);
+    rec_cfg.sink            = record_sink;
+    rec_cfg.core            = CORE_IO;
+    rec_cfg.priority        = 2;
+
+    if (recorder_init(&rec_cfg) == ESP_OK) {
+        httpd_set_record_handler(http_record);
+    } else {
+        ESP_LOGW(TAG, "Recorder unavailable, persisting every frame");
+    }
+#endif
+
+#if OP_PROFILER
+    httpd_set_profile_handler(http_profile);
+#endif
+    httpd_set_filter_handler(http_filter);
+
+    xTaskCreatePinnedToCore(inference_task,   "STG_INFER", 12288, nullptr, 5, nullptr, CORE_INFER);
+    xTaskCreatePinnedToCore(postprocess_task, "STG_POST",  8192,  nullptr, 4, nullptr, CORE_IO);
+    xTaskCreatePinnedToCore(preprocess_task,  "STG_PREP",  8192,  nullptr, 5, nullptr, CORE_IO);
+    xTaskCreatePinnedToCore(capture_task,     "STG_CAP",   4096,  nullptr, 6, nullptr, CORE_IO);
+
+    return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -953,14 +1641,10 @@ extern "C" void app_main(void)
     }
 
     // -----------------------------------------------------------------
-    // 7. Start deterministic pipeline
+    // 7. Start staged pipeline
     // -----------------------------------------------------------------
-    xTaskCreate(
-        pipeline_task,
-        "PIPELINE",
-        12288,
-        nullptr,
-        6,
-        nullptr
-    );
+    if (!pipeline_start()) {
+        ESP_LOGE(TAG, "Pipeline start failed");
+        return;
+    }
 }
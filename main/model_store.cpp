@@ -0,0 +1,288 @@
+// File: main/model_store.cpp
+
+#include "model_store.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "mbedtls/sha256.h"
+
+static const char *TAG = "MODEL_STORE";
+
+#define MODEL_STORE_CHUNK (16 * 1024)   // SD read / flash write / read-back unit
+
+static_assert(sizeof(model_store_hdr_t) == 124, "model store header layout");
+static_assert(sizeof(model_store_hdr_t) <= MODEL_STORE_DATA_OFFSET, "header overlaps the image");
+
+// -----------------------------------------------------------------------------
+// State
+// -----------------------------------------------------------------------------
+static const esp_partition_t *s_part = nullptr;
+static model_store_hdr_t      s_hdr;
+static bool                   s_installed = false;     // s_hdr valid
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static const char *file_name(const char *path)
+{
+    const char *slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+static uint32_t header_crc(const model_store_hdr_t *h)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(model_store_hdr_t, header_crc));
+}
+
+static bool header_valid(const model_store_hdr_t *h)
+{
+    return h->magic == MODEL_STORE_MAGIC &&
+           h->version == MODEL_STORE_VERSION &&
+           h->header_bytes == sizeof(model_store_hdr_t) &&
+           h->header_crc == header_crc(h) &&
+           h->size > 0 &&
+           h->data_offset >= sizeof(model_store_hdr_t) &&
+           (uint64_t)h->data_offset + h->size <= s_part->size;
+}
+
+static void read_header(void)
+{
+    s_installed = esp_partition_read(s_part, 0, &s_hdr, sizeof(s_hdr)) == ESP_OK &&
+                  header_valid(&s_hdr);
+}
+
+// SHA-256 of size bytes at offset, read back through buf
+static esp_err_t hash_partition(uint32_t offset, uint32_t size, uint8_t *buf, uint8_t out[32])
+{
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    esp_err_t err = ESP_OK;
+    for (uint32_t done = 0; done < size && err == ESP_OK; ) {
+        const uint32_t n = std::min<uint32_t>(MODEL_STORE_CHUNK, size - done);
+        err = esp_partition_read(s_part, offset + done, buf, n);
+        if (err == ESP_OK) mbedtls_sha256_update(&sha, buf, n);
+        done += n;
+    }
+
+    mbedtls_sha256_finish(&sha, out);
+    mbedtls_sha256_free(&sha);
+    return err;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t model_store_init(const char *label)
+{
+    if (!label) return ESP_ERR_INVALID_ARG;
+
+    s_part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (!s_part) {
+        ESP_LOGW(TAG, "No \"%s\" data partition", label);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    read_header();
+
+    if (s_installed) {
+        ESP_LOGI(TAG, "Partition %s @0x%lx (%lu KB): %s, %lu KB installed",
+                 label, (unsigned long)s_part->address, (unsigned long)(s_part->size / 1024),
+                 s_hdr.name, (unsigned long)(s_hdr.size / 1024));
+    } else {
+        ESP_LOGI(TAG, "Partition %s @0x%lx (%lu KB): empty",
+                 label, (unsigned long)s_part->address, (unsigned long)(s_part->size / 1024));
+    }
+    return ESP_OK;
+}
+
+bool model_store_ready(void)
+{
+    return s_part != nullptr;
+}
+
+esp_err_t model_store_install(const char *sd_path)
+{
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+    if (!sd_path) return ESP_ERR_INVALID_ARG;
+
+    struct stat st;
+    if (stat(sd_path, &st) != 0) return ESP_ERR_NOT_FOUND;
+
+    const char *name = file_name(sd_path);
+    const uint32_t size = (uint32_t)st.st_size;
+
+    if (s_installed && s_hdr.size == size && s_hdr.mtime == (int64_t)st.st_mtime &&
+        strncmp(s_hdr.name, name, MODEL_STORE_NAME_MAX) == 0) {
+        return ESP_OK;
+    }
+
+    if (size == 0 || strlen(name) >= MODEL_STORE_NAME_MAX ||
+        (uint64_t)MODEL_STORE_DATA_OFFSET + size > s_part->size) {
+        ESP_LOGW(TAG, "%s (%lu KB) does not fit the %lu KB partition",
+                 name, (unsigned long)(size / 1024), (unsigned long)(s_part->size / 1024));
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(MODEL_STORE_CHUNK, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    FILE *f = fopen(sd_path, "rb");
+    if (!buf || !f) {
+        heap_caps_free(buf);
+        if (f) fclose(f);
+        return buf ? ESP_ERR_NOT_FOUND : ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Installing %s (%lu KB)", name, (unsigned long)(size / 1024));
+
+    // Header sector goes with the first erase: from here on nothing is installed
+    s_installed = false;
+
+    const int64_t t0 = esp_timer_get_time();
+    const uint32_t erase_len = (MODEL_STORE_DATA_OFFSET + size + s_part->erase_size - 1) &
+                               ~(s_part->erase_size - 1);
+    esp_err_t err = esp_partition_erase_range(s_part, 0, erase_len);
+    const int64_t t1 = esp_timer_get_time();
+
+    uint8_t sha_sd[32];
+    mbedtls_sha256_context sha;
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    for (uint32_t done = 0; done < size && err == ESP_OK; ) {
+        const uint32_t n = std::min<uint32_t>(MODEL_STORE_CHUNK, size - done);
+        if (fread(buf, 1, n, f) != n) {
+            err = ESP_FAIL;
+            break;
+        }
+        mbedtls_sha256_update(&sha, buf, n);
+        err = esp_partition_write(s_part, MODEL_STORE_DATA_OFFSET + done, buf, n);
+        done += n;
+    }
+    fclose(f);
+
+    mbedtls_sha256_finish(&sha, sha_sd);
+    mbedtls_sha256_free(&sha);
+    const int64_t t2 = esp_timer_get_time();
+
+    uint8_t sha_flash[32];
+    if (err == ESP_OK) err = hash_partition(MODEL_STORE_DATA_OFFSET, size, buf, sha_flash);
+    if (err == ESP_OK && memcmp(sha_sd, sha_flash, sizeof(sha_sd)) != 0) err = ESP_ERR_INVALID_CRC;
+    const int64_t t3 = esp_timer_get_time();
+
+    heap_caps_free(buf);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Installing %s failed (%s)", name, esp_err_to_name(err));
+        return err;
+    }
+
+    model_store_hdr_t hdr = {};
+    hdr.magic        = MODEL_STORE_MAGIC;
+    hdr.version      = MODEL_STORE_VERSION;
+    hdr.header_bytes = sizeof(hdr);
+    hdr.data_offset  = MODEL_STORE_DATA_OFFSET;
+    hdr.size         = size;
+    hdr.mtime        = (int64_t)st.st_mtime;
+    memcpy(hdr.sha256, sha_sd, sizeof(hdr.sha256));
+    memcpy(hdr.name, name, strlen(name));
+    hdr.header_crc   = header_crc(&hdr);
+
+    err = esp_partition_write(s_part, 0, &hdr, sizeof(hdr));
+    if (err != ESP_OK) return err;
+
+    read_header();
+    if (!s_installed) return ESP_ERR_INVALID_CRC;
+
+    ESP_LOGI(TAG, "Installed %s: erase %lu ms, SD read + write %lu ms, verify %lu ms",
+             name, (unsigned long)((t1 - t0) / 1000), (unsigned long)((t2 - t1) / 1000),
+             (unsigned long)((t3 - t2) / 1000));
+    return ESP_OK;
+}
+
+esp_err_t model_store_map(bool verify, model_image_t *out)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+    if (!s_installed) return ESP_ERR_NOT_FOUND;
+
+    const int64_t t0 = esp_timer_get_time();
+
+    const void *ptr = nullptr;
+    esp_partition_mmap_handle_t handle;
+    esp_err_t err = esp_partition_mmap(s_part, s_hdr.data_offset, s_hdr.size,
+                                       ESP_PARTITION_MMAP_DATA, &ptr, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Mapping %s failed (%s)", s_hdr.name, esp_err_to_name(err));
+        return err;
+    }
+
+    if (verify) {
+        uint8_t sha[32];
+        mbedtls_sha256((const uint8_t *)ptr, s_hdr.size, sha, 0);
+        if (memcmp(sha, s_hdr.sha256, sizeof(sha)) != 0) {
+            ESP_LOGE(TAG, "%s: SHA-256 mismatch in flash", s_hdr.name);
+            esp_partition_munmap(handle);
+            return ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    out->data    = (const uint8_t *)ptr;
+    out->size    = s_hdr.size;
+    out->src     = MODEL_SRC_FLASH;
+    out->load_us = (uint32_t)(esp_timer_get_time() - t0);
+    out->handle  = handle;
+    memcpy(out->sha256, s_hdr.sha256, sizeof(out->sha256));
+    return ESP_OK;
+}
+
+esp_err_t model_store_read_sd(const char *sd_path, model_image_t *out)
+{
+    if (!sd_path || !out) return ESP_ERR_INVALID_ARG;
+
+    const int64_t t0 = esp_timer_get_time();
+
+    struct stat st;
+    if (stat(sd_path, &st) != 0) return ESP_ERR_NOT_FOUND;
+
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(st.st_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    FILE *f = fopen(sd_path, "rb");
+    const size_t n = f ? fread(buf, 1, st.st_size, f) : 0;
+    if (f) fclose(f);
+
+    if (n != (size_t)st.st_size) {
+        heap_caps_free(buf);
+        return ESP_FAIL;
+    }
+
+    out->data    = buf;
+    out->size    = n;
+    out->src     = MODEL_SRC_PSRAM;
+    out->load_us = (uint32_t)(esp_timer_get_time() - t0);
+    out->handle  = 0;
+
+    // Not part of the load time: the flash path has it in the header
+    mbedtls_sha256(buf, n, out->sha256, 0);
+    return ESP_OK;
+}
+
+void model_store_release(model_image_t *img)
+{
+    if (!img) return;
+
+    if (img->src == MODEL_SRC_FLASH) esp_partition_munmap(img->handle);
+    if (img->src == MODEL_SRC_PSRAM) heap_caps_free((void *)img->data);
+
+    memset(img, 0, sizeof(*img));
+}
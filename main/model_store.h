@@ -0,0 +1,85 @@
+// File: main/model_store.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Model store
+//
+// The .tflite model is installed once from the SD card into a dedicated data
+// partition and memory-mapped from there at boot, so tflite::GetModel() reads
+// the flatbuffer straight out of the flash cache: no SD read, no PSRAM copy.
+//
+// Partition layout:
+//   0x0000  header (124 B): magic 'MDLS', version, header_bytes,
+//           data_offset, size, SD file mtime, SHA-256 of the image, file
+//           name, crc32(previous bytes)
+//   0x1000  model image
+//
+// An install erases the header first and writes it last, after the image
+// has been read back and its SHA-256 matches the one computed while reading
+// the SD file; a power loss in between leaves no valid header and the next
+// boot installs again. The installed image is considered current while the
+// SD file's name, size and mtime match the header.
+// -----------------------------------------------------------------------------
+#define MODEL_STORE_MAGIC       0x534C444Du     // "MDLS"
+#define MODEL_STORE_VERSION     1
+#define MODEL_STORE_DATA_OFFSET 0x1000
+#define MODEL_STORE_NAME_MAX    64
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_bytes;
+    uint32_t data_offset;
+    uint32_t size;
+    int64_t  mtime;                     // st_mtime of the installed SD file
+    uint8_t  sha256[32];
+    char     name[MODEL_STORE_NAME_MAX];
+    uint32_t header_crc;
+} model_store_hdr_t;
+
+typedef enum {
+    MODEL_SRC_NONE = 0,
+    MODEL_SRC_FLASH,                    // mapped from the model partition
+    MODEL_SRC_PSRAM,                    // read from SD into PSRAM
+} model_src_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t         size;
+    model_src_t    src;
+    uint32_t       load_us;             // map (+ verify) or stat + alloc + read
+    uint32_t       handle;              // esp_partition_mmap handle (FLASH)
+    uint8_t        sha256[32];          // of the image
+} model_image_t;
+
+// Find the data partition labelled label. ESP_ERR_NOT_FOUND: no such partition.
+esp_err_t model_store_init(const char *label);
+bool      model_store_ready(void);
+
+// Install sd_path unless the partition already holds it (cheap: one stat).
+// ESP_ERR_INVALID_SIZE: does not fit; ESP_ERR_INVALID_CRC: read-back mismatch.
+esp_err_t model_store_install(const char *sd_path);
+
+// Map the installed image; verify: re-hash it against the header first.
+// ESP_ERR_NOT_FOUND: nothing installed.
+esp_err_t model_store_map(bool verify, model_image_t *out);
+
+// Fallback / reference path: read sd_path into a PSRAM buffer
+esp_err_t model_store_read_sd(const char *sd_path, model_image_t *out);
+
+// Unmap / free an image from either path
+void model_store_release(model_image_t *img);
+
+#ifdef __cplusplus
+}
+#endif
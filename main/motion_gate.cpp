@@ -0,0 +1,190 @@
+// File: main/motion_gate.cpp
+
+#include "motion_gate.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "ppm.h"
+
+static const char *TAG = "MGATE";
+
+// -----------------------------------------------------------------------------
+// State
+// -----------------------------------------------------------------------------
+static motion_gate_cfg_t s_cfg;
+static bool s_ready = false;
+
+static int       s_tw = 0;              // thumbnail size
+static int       s_th = 0;
+static uint8_t  *s_thumb = nullptr;     // current luma
+static uint16_t *s_bg    = nullptr;     // background luma, Q8
+static jpeg_dec_ctx_t s_dec;            // own decoder context
+
+static uint32_t  s_since_run = 0;       // frames since the last inference
+static motion_gate_stats_t s_stats;
+
+esp_err_t motion_gate_init(const motion_gate_cfg_t *cfg)
+{
+    if (!cfg || cfg->src_w <= 0 || cfg->src_h <= 0 || cfg->bg_shift > 8 || cfg->bg_shift_motion > 8) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_ready) {
+        ESP_LOGW(TAG, "Motion gate already initialized");
+        return ESP_OK;
+    }
+
+    s_cfg = *cfg;
+    s_tw  = JPEG_THUMB_DIM(cfg->src_w);
+    s_th  = JPEG_THUMB_DIM(cfg->src_h);
+
+    const size_t px = (size_t)s_tw * s_th;
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+
+    s_thumb = (uint8_t *)heap_caps_malloc(px, caps);
+    s_bg    = (uint16_t *)heap_caps_malloc(px * sizeof(uint16_t), caps);
+
+    if (!s_thumb || !s_bg || jpeg_dec_ctx_init(&s_dec, caps) != ESP_OK) {
+        free(s_thumb); free(s_bg);
+        jpeg_dec_ctx_deinit(&s_dec);
+        s_thumb = nullptr;
+        s_bg    = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(s_bg, 0, px * sizeof(uint16_t));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_since_run = 0;
+    s_ready = true;
+
+    ESP_LOGI(TAG, "Motion gate: thumb %dx%d, pixel>%u, area>=%u‰, bg 1/%d (1/%d in motion), force every %lu, warm-up %lu",
+             s_tw, s_th,
+             (unsigned)cfg->pixel_thresh, (unsigned)cfg->area_permille,
+             1 << cfg->bg_shift, 1 << cfg->bg_shift_motion,
+             (unsigned long)cfg->force_every, (unsigned long)cfg->warmup_frames);
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// 1/8 luma thumbnail
+// -----------------------------------------------------------------------------
+static esp_err_t decode_thumb(const uint8_t *jpeg, size_t len)
+{
+    int w = 0, h = 0;
+    esp_err_t err = jpeg_thumb_luma(&s_dec, jpeg, len, s_thumb, (size_t)s_tw * s_th, &w, &h);
+    if (err != ESP_OK) return err;
+
+    return (w == s_tw && h == s_th) ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+// -----------------------------------------------------------------------------
+// Decision
+// -----------------------------------------------------------------------------
+void motion_gate_check(const uint8_t *jpeg, size_t jpeg_len, motion_gate_result_t *res)
+{
+    memset(res, 0, sizeof(*res));
+    res->run    = true;
+    res->reason = MOTION_GATE_ERROR;
+
+    if (!s_ready) return;
+
+    const int64_t t0 = esp_timer_get_time();
+    s_stats.frames++;
+
+    if (decode_thumb(jpeg, jpeg_len) != ESP_OK) {
+        s_stats.errors++;
+        s_stats.inferred++;
+        s_since_run = 0;
+        res->us = (int32_t)(esp_timer_get_time() - t0);
+        return;
+    }
+
+    const int  px      = s_tw * s_th;
+    const bool warming = s_stats.frames <= s_cfg.warmup_frames;
+
+    // First frame seeds the background
+    if (s_stats.frames == 1) {
+        for (int i = 0; i < px; i++) {
+            s_bg[i] = (uint16_t)(s_thumb[i] << 8);
+        }
+    }
+
+    int changed = 0;
+    for (int i = 0; i < px; i++) {
+        int d = (int)s_thumb[i] - (s_bg[i] >> 8);
+        if (d < 0) d = -d;
+        if (d > s_cfg.pixel_thresh) changed++;
+    }
+
+    res->changed_permille = (uint16_t)((changed * 1000) / px);
+    const bool motion = res->changed_permille >= s_cfg.area_permille;
+
+    // Background adaptation: slower while something moves, so a bee
+    // lingering at the entrance is not absorbed within a few frames
+    const int shift = motion ? s_cfg.bg_shift_motion : s_cfg.bg_shift;
+    for (int i = 0; i < px; i++) {
+        const int32_t cur = (int32_t)s_thumb[i] << 8;
+        s_bg[i] = (uint16_t)(s_bg[i] + ((cur - (int32_t)s_bg[i]) >> shift));
+    }
+
+    s_since_run++;
+
+    if (warming) {
+        res->reason = MOTION_GATE_WARMUP;
+    } else if (motion) {
+        res->reason = MOTION_GATE_MOTION;
+        s_stats.motion++;
+    } else if (s_cfg.force_every && s_since_run >= s_cfg.force_every) {
+        res->reason = MOTION_GATE_FORCED;
+        s_stats.forced++;
+    } else {
+        res->reason = MOTION_GATE_STATIC;
+        res->run    = false;
+    }
+
+    if (res->run) {
+        s_stats.inferred++;
+        s_since_run = 0;
+    } else {
+        s_stats.gated++;
+    }
+
+    res->us = (int32_t)(esp_timer_get_time() - t0);
+}
+
+// -----------------------------------------------------------------------------
+// Stats
+// -----------------------------------------------------------------------------
+void motion_gate_get_stats(motion_gate_stats_t *out)
+{
+    *out = s_stats;
+}
+
+void motion_gate_log_stats(void)
+{
+    ESP_LOGI(TAG, "Gate: frames=%lu inferred=%lu gated=%lu (motion=%lu forced=%lu errors=%lu)",
+             (unsigned long)s_stats.frames,
+             (unsigned long)s_stats.inferred,
+             (unsigned long)s_stats.gated,
+             (unsigned long)s_stats.motion,
+             (unsigned long)s_stats.forced,
+             (unsigned long)s_stats.errors);
+}
+
+const char *motion_gate_reason_str(motion_gate_reason_t r)
+{
+    switch (r) {
+    case MOTION_GATE_STATIC: return "static";
+    case MOTION_GATE_MOTION: return "motion";
+    case MOTION_GATE_FORCED: return "forced";
+    case MOTION_GATE_WARMUP: return "warm-up";
+    case MOTION_GATE_ERROR:  return "error";
+    default:                 return "?";
+    }
+}
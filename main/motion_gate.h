@@ -0,0 +1,72 @@
+// File: main/motion_gate.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Motion / scene-change gate
+//
+// Runs before preprocessing and decides whether a frame is worth an Invoke().
+// The JPEG is decoded at 1/8 scale (one value per 8x8 block, i.e. the DC
+// coefficients: 40x30 for QVGA) into a luma thumbnail, which is compared with
+// a slowly adapting background. A frame passes when enough thumbnail pixels
+// differ by more than the pixel threshold, or when a periodic / warm-up
+// inference is due.
+// -----------------------------------------------------------------------------
+typedef struct {
+    int      src_w;                 // expected JPEG size
+    int      src_h;
+
+    uint8_t  pixel_thresh;          // |luma - background| counted as changed
+    uint16_t area_permille;         // changed pixels needed to pass, ‰ of thumbnail
+    uint8_t  bg_shift;              // background EMA: bg += (cur - bg) >> shift
+    uint8_t  bg_shift_motion;       // slower adaptation while motion is seen
+    uint32_t force_every;           // run at least every N frames (0: never forced)
+    uint32_t warmup_frames;         // always run while the background settles
+} motion_gate_cfg_t;
+
+typedef enum {
+    MOTION_GATE_STATIC = 0,         // skipped
+    MOTION_GATE_MOTION,             // change above threshold
+    MOTION_GATE_FORCED,             // periodic inference
+    MOTION_GATE_WARMUP,
+    MOTION_GATE_ERROR,              // thumbnail failed: fail open
+} motion_gate_reason_t;
+
+typedef struct {
+    bool                 run;
+    motion_gate_reason_t reason;
+    uint16_t             changed_permille;
+    int32_t              us;        // thumbnail + compare time
+} motion_gate_result_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t gated;                 // skipped
+    uint32_t inferred;              // passed (any reason)
+    uint32_t motion;
+    uint32_t forced;
+    uint32_t errors;
+} motion_gate_stats_t;
+
+esp_err_t motion_gate_init(const motion_gate_cfg_t *cfg);
+
+// Decide for one frame; also adapts the background
+void motion_gate_check(const uint8_t *jpeg, size_t jpeg_len, motion_gate_result_t *res);
+
+void motion_gate_get_stats(motion_gate_stats_t *out);
+void motion_gate_log_stats(void);
+
+const char *motion_gate_reason_str(motion_gate_reason_t r);
+
+#ifdef __cplusplus
+}
+#endif
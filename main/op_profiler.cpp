@@ -0,0 +1,524 @@
+// File: main/op_profiler.cpp
+
+#include "op_profiler.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <algorithm>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_heap_caps.h"
+
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "tensorflow/lite/micro/micro_profiler_interface.h"
+
+#include "sdcard.h"
+
+static const char *TAG = "OP_PROF";
+
+// esp_nn kernel timers (esp-tflite-micro kernels/esp_nn/*.cc): µs spent in
+// each kernel type since boot, summed on every Invoke()
+extern long long conv_total_time;
+extern long long dc_total_time;
+extern long long fc_total_time;
+extern long long add_total_time;
+extern long long mul_total_time;
+extern long long pooling_total_time;
+extern long long softmax_total_time;
+
+#define OP_PROF_MAX_TYPES 32
+
+#define EV_OFF    UINT32_MAX        // not profiling
+#define EV_NESTED (UINT32_MAX - 1)  // inside another op's event, or past the op table
+
+typedef struct {
+    const char *type;               // builtin op name (schema string) / custom code
+    uint64_t    macs;
+    uint32_t    in_bytes;           // activation inputs
+    uint32_t    w_bytes;            // constant inputs
+    uint32_t    out_bytes;
+
+    // s_mux
+    uint32_t    runs;
+    uint32_t    last_cycles;
+    uint32_t    max_cycles;
+    uint64_t    total_cycles;
+} op_entry_t;
+
+typedef struct {
+    const char *type;
+    int         ops;
+    uint64_t    macs;
+    uint64_t    cycles;             // per invoke (sum of op averages)
+} type_entry_t;
+
+typedef struct {
+    int         op;
+    uint64_t    cycles;
+} op_rank_t;
+
+// -----------------------------------------------------------------------------
+// State
+// -----------------------------------------------------------------------------
+static op_entry_t  *s_ops = nullptr;        // PSRAM, one per main-subgraph operator
+static int          s_num_ops = 0;
+static uint64_t     s_total_macs = 0;
+static volatile bool s_enabled = false;
+
+// Inference task only
+static bool         s_active = false;       // profiling the current Invoke()
+static uint32_t     s_next = 0;             // next op index
+static uint32_t     s_depth = 0;
+static uint32_t     s_t_begin = 0;          // CCOUNT at the open op's begin
+static int64_t      s_t_invoke = 0;
+
+// s_mux
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t     s_invokes = 0;
+static uint64_t     s_invoke_us = 0;
+static uint32_t     s_last_invoke_us = 0;
+static uint32_t     s_mismatched = 0;       // event tag != expected op
+static uint32_t     s_partial = 0;          // Invoke()s whose event count != op count
+
+// -----------------------------------------------------------------------------
+// Profiler
+// -----------------------------------------------------------------------------
+class OpProfiler : public tflite::MicroProfilerInterface {
+public:
+    uint32_t BeginEvent(const char *tag) override
+    {
+        if (!s_active) return EV_OFF;
+        if (s_depth++ > 0) return EV_NESTED;
+
+        const uint32_t i = s_next++;
+        if (i >= (uint32_t)s_num_ops) return EV_NESTED;
+        if (tag != s_ops[i].type && strcmp(tag, s_ops[i].type) != 0) s_mismatched++;
+
+        s_t_begin = esp_cpu_get_cycle_count();
+        return i;
+    }
+
+    void EndEvent(uint32_t handle) override
+    {
+        if (handle == EV_OFF) return;
+
+        const uint32_t dt = esp_cpu_get_cycle_count() - s_t_begin;
+        s_depth--;
+        if (handle == EV_NESTED) return;
+
+        op_entry_t *e = &s_ops[handle];
+        portENTER_CRITICAL(&s_mux);
+        e->runs++;
+        e->last_cycles   = dt;
+        e->max_cycles    = std::max(e->max_cycles, dt);
+        e->total_cycles += dt;
+        portEXIT_CRITICAL(&s_mux);
+    }
+};
+
+static OpProfiler s_profiler;
+
+// -----------------------------------------------------------------------------
+// Model walk
+// -----------------------------------------------------------------------------
+static uint32_t type_bytes(tflite::TensorType t)
+{
+    switch (t) {
+    case tflite::TensorType_INT16:
+    case tflite::TensorType_UINT16:
+    case tflite::TensorType_FLOAT16: return 2;
+    case tflite::TensorType_INT32:
+    case tflite::TensorType_UINT32:
+    case tflite::TensorType_FLOAT32: return 4;
+    case tflite::TensorType_INT64:
+    case tflite::TensorType_UINT64:
+    case tflite::TensorType_FLOAT64: return 8;
+    default:                         return 1;
+    }
+}
+
+static uint64_t elems(const tflite::Tensor *t)
+{
+    uint64_t n = 1;
+    if (t && t->shape()) {
+        for (int32_t d : *t->shape()) n *= (uint64_t)std::max<int32_t>(d, 1);
+    }
+    return n;
+}
+
+// Dimension i of tensor t, 1 if absent
+static uint64_t dim(const tflite::Tensor *t, int i)
+{
+    return (t && t->shape() && i < (int)t->shape()->size()) ? (uint64_t)std::max<int32_t>(t->shape()->Get(i), 1) : 1;
+}
+
+static uint64_t op_macs(tflite::BuiltinOperator code,
+                        const tflite::Tensor *in, const tflite::Tensor *filter, const tflite::Tensor *out)
+{
+    switch (code) {
+    case tflite::BuiltinOperator_CONV_2D:
+        // filter [oc, kh, kw, ic]
+        return elems(out) * dim(filter, 1) * dim(filter, 2) * dim(filter, 3);
+    case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+        // filter [1, kh, kw, oc]
+        return elems(out) * dim(filter, 1) * dim(filter, 2);
+    case tflite::BuiltinOperator_TRANSPOSE_CONV:
+        // each input value is scattered over kh × kw × oc outputs
+        return elems(in) * dim(filter, 0) * dim(filter, 1) * dim(filter, 2);
+    case tflite::BuiltinOperator_FULLY_CONNECTED:
+        // filter [units, depth]
+        return elems(out) * dim(filter, 1);
+    case tflite::BuiltinOperator_MUL:
+    case tflite::BuiltinOperator_ADD:
+    case tflite::BuiltinOperator_SUB:
+        return elems(out);
+    default:
+        return 0;
+    }
+}
+
+static void describe_op(const tflite::Model *model, const tflite::SubGraph *sg,
+                        const tflite::Operator *op, op_entry_t *e)
+{
+    const auto *tensors = sg->tensors();
+    const auto *buffers = model->buffers();
+    const auto *opcode  = model->operator_codes()->Get(op->opcode_index());
+
+    // Same rule as tflite::GetBuiltinCode() (deprecated_builtin_code for old models)
+    const tflite::BuiltinOperator code = std::max(
+        opcode->builtin_code(), (tflite::BuiltinOperator)opcode->deprecated_builtin_code());
+
+    e->type = (code == tflite::BuiltinOperator_CUSTOM && opcode->custom_code())
+              ? opcode->custom_code()->c_str()
+              : tflite::EnumNameBuiltinOperator(code);
+
+    const tflite::Tensor *first_in = nullptr;
+    const tflite::Tensor *filter   = nullptr;
+    const tflite::Tensor *out      = nullptr;
+
+    if (op->inputs()) {
+        for (uint32_t k = 0; k < op->inputs()->size(); k++) {
+            const int idx = op->inputs()->Get(k);
+            if (idx < 0 || !tensors || idx >= (int)tensors->size()) continue;
+
+            const tflite::Tensor *t = tensors->Get(idx);
+            const uint32_t bytes = (uint32_t)(elems(t) * type_bytes(t->type()));
+            const auto *buf = (buffers && t->buffer() < buffers->size()) ? buffers->Get(t->buffer()) : nullptr;
+
+            if (buf && buf->data() && buf->data()->size() > 0) {
+                e->w_bytes += bytes;
+            } else {
+                e->in_bytes += bytes;
+                if (!first_in) first_in = t;
+            }
+        }
+        // Weights: input 1 (TRANSPOSE_CONV: 0 output_shape, 1 weights, 2 input)
+        const int w = op->inputs()->size() > 1 ? op->inputs()->Get(1) : -1;
+        if (tensors && w >= 0 && w < (int)tensors->size()) filter = tensors->Get(w);
+    }
+
+    if (op->outputs()) {
+        for (uint32_t k = 0; k < op->outputs()->size(); k++) {
+            const int idx = op->outputs()->Get(k);
+            if (idx < 0 || !tensors || idx >= (int)tensors->size()) continue;
+
+            const tflite::Tensor *t = tensors->Get(idx);
+            e->out_bytes += (uint32_t)(elems(t) * type_bytes(t->type()));
+            if (!out) out = t;
+        }
+    }
+
+    e->macs = op_macs(code, first_in, filter, out);
+}
+
+// -----------------------------------------------------------------------------
+// Formatting
+// -----------------------------------------------------------------------------
+static size_t appendf(char *out, size_t cap, size_t len, const char *fmt, ...)
+{
+    if (len + 1 >= cap) return len;
+
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(out + len, cap - len, fmt, ap);
+    va_end(ap);
+
+    return n < 0 ? len : std::min(len + (size_t)n, cap - 1);
+}
+
+static op_entry_t snapshot_op(int i)
+{
+    portENTER_CRITICAL(&s_mux);
+    const op_entry_t e = s_ops[i];
+    portEXIT_CRITICAL(&s_mux);
+    return e;
+}
+
+static uint64_t avg_cycles(const op_entry_t *e)
+{
+    return e->runs ? e->total_cycles / e->runs : 0;
+}
+
+static int collect_types(type_entry_t *types, uint64_t *op_cycles)
+{
+    int n = 0;
+    *op_cycles = 0;
+
+    for (int i = 0; i < s_num_ops; i++) {
+        const op_entry_t e = snapshot_op(i);
+
+        int t = 0;
+        while (t < n && strcmp(types[t].type, e.type) != 0) t++;
+        if (t == n) {
+            if (n == OP_PROF_MAX_TYPES) t = n - 1;      // lump the rest into the last
+            else types[n++] = {e.type, 0, 0, 0};
+        }
+        types[t].ops++;
+        types[t].macs   += e.macs;
+        types[t].cycles += avg_cycles(&e);
+        *op_cycles      += avg_cycles(&e);
+    }
+
+    std::sort(types, types + n, [](const type_entry_t &a, const type_entry_t &b) {
+        return a.cycles > b.cycles;
+    });
+    return n;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t op_profiler_init(const tflite::Model *model)
+{
+    if (!model || !model->subgraphs() || model->subgraphs()->size() == 0 || !model->operator_codes()) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_ops) {
+        ESP_LOGW(TAG, "Op profiler already initialized");
+        return ESP_OK;
+    }
+
+    const tflite::SubGraph *sg = model->subgraphs()->Get(0);
+    const int n = sg->operators() ? (int)sg->operators()->size() : 0;
+    if (n == 0) return ESP_ERR_INVALID_ARG;
+
+    s_ops = (op_entry_t *)heap_caps_calloc(n, sizeof(op_entry_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!s_ops) return ESP_ERR_NO_MEM;
+
+    for (int i = 0; i < n; i++) {
+        describe_op(model, sg, sg->operators()->Get(i), &s_ops[i]);
+        s_total_macs += s_ops[i].macs;
+    }
+    s_num_ops = n;
+
+    ESP_LOGI(TAG, "Op profiler: %d ops, %.1f MMAC per invoke (%s)",
+             n, (double)s_total_macs / 1e6, s_enabled ? "enabled" : "disabled");
+    return ESP_OK;
+}
+
+tflite::MicroProfilerInterface *op_profiler_interface(void)
+{
+    return &s_profiler;
+}
+
+bool op_profiler_ready(void)
+{
+    return s_ops != nullptr;
+}
+
+void op_profiler_enable(bool on)
+{
+    s_enabled = on;
+}
+
+bool op_profiler_enabled(void)
+{
+    return s_enabled;
+}
+
+void op_profiler_reset(void)
+{
+    portENTER_CRITICAL(&s_mux);
+    for (int i = 0; i < s_num_ops; i++) {
+        s_ops[i].runs         = 0;
+        s_ops[i].last_cycles  = 0;
+        s_ops[i].max_cycles   = 0;
+        s_ops[i].total_cycles = 0;
+    }
+    s_invokes        = 0;
+    s_invoke_us      = 0;
+    s_last_invoke_us = 0;
+    s_mismatched     = 0;
+    s_partial        = 0;
+    portEXIT_CRITICAL(&s_mux);
+
+    conv_total_time = dc_total_time = fc_total_time = 0;
+    add_total_time = mul_total_time = pooling_total_time = softmax_total_time = 0;
+}
+
+void op_profiler_invoke_begin(void)
+{
+    s_active = s_enabled && s_ops;
+    if (!s_active) return;
+
+    s_next     = 0;
+    s_depth    = 0;
+    s_t_invoke = esp_timer_get_time();
+}
+
+void op_profiler_invoke_end(void)
+{
+    if (!s_active) return;
+    s_active = false;
+
+    const uint32_t dt = (uint32_t)(esp_timer_get_time() - s_t_invoke);
+
+    portENTER_CRITICAL(&s_mux);
+    s_invokes++;
+    s_invoke_us     += dt;
+    s_last_invoke_us = dt;
+    if (s_next != (uint32_t)s_num_ops) s_partial++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+size_t op_profiler_report(char *out, size_t cap, int top_ops)
+{
+    if (!out || cap == 0) return 0;
+    out[0] = 0;
+    if (!s_ops) return appendf(out, cap, 0, "Op profiler not initialized\n");
+
+    portENTER_CRITICAL(&s_mux);
+    const uint32_t invokes    = s_invokes;
+    const uint64_t invoke_us  = s_invoke_us;
+    const uint32_t last_us    = s_last_invoke_us;
+    const uint32_t mismatched = s_mismatched;
+    const uint32_t partial    = s_partial;
+    portEXIT_CRITICAL(&s_mux);
+
+    const uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+
+    type_entry_t types[OP_PROF_MAX_TYPES];
+    uint64_t op_cycles = 0;
+    const int num_types = collect_types(types, &op_cycles);
+
+    const double avg_ms = invokes ? (double)invoke_us / invokes / 1000.0 : 0.0;
+    const double op_ms  = (double)op_cycles / mhz / 1000.0;
+
+    size_t len = 0;
+    len = appendf(out, cap, len,
+                  "Op profile (%s): %lu invokes, last %.1f ms, avg %.1f ms, ops %.1f ms; "
+                  "%d ops, %.1f MMAC, CPU %lu MHz; tag mismatches %lu, partial invokes %lu\n\n",
+                  s_enabled ? "on" : "off", (unsigned long)invokes, last_us / 1000.0, avg_ms, op_ms,
+                  s_num_ops, (double)s_total_macs / 1e6, (unsigned long)mhz,
+                  (unsigned long)mismatched, (unsigned long)partial);
+
+    len = appendf(out, cap, len, "%-24s %4s %10s %6s %9s %8s\n",
+                  "type", "ops", "ms/invoke", "%", "MMAC", "MAC/cyc");
+    for (int t = 0; t < num_types; t++) {
+        len = appendf(out, cap, len, "%-24s %4d %10.1f %6.1f %9.1f %8.2f\n",
+                      types[t].type, types[t].ops, (double)types[t].cycles / mhz / 1000.0,
+                      op_cycles ? 100.0 * types[t].cycles / op_cycles : 0.0,
+                      (double)types[t].macs / 1e6,
+                      types[t].cycles ? (double)types[t].macs / types[t].cycles : 0.0);
+    }
+
+    // Most expensive ops first
+    const int shown = (top_ops < 0) ? s_num_ops : std::min(top_ops, s_num_ops);
+    if (shown > 0) {
+        // Sort on a snapshot: the inference task keeps updating the counters
+        op_rank_t *order = (op_rank_t *)heap_caps_malloc(s_num_ops * sizeof(op_rank_t), MALLOC_CAP_8BIT);
+        if (order) {
+            for (int i = 0; i < s_num_ops; i++) {
+                const op_entry_t e = snapshot_op(i);
+                order[i] = {i, avg_cycles(&e)};
+            }
+            std::sort(order, order + s_num_ops, [](const op_rank_t &a, const op_rank_t &b) {
+                return a.cycles > b.cycles;
+            });
+
+            len = appendf(out, cap, len, "\n%4s %-24s %9s %6s %9s %8s %8s %8s %8s\n",
+                          "op", "type", "avg ms", "%", "MMAC", "MAC/cyc", "in KB", "w KB", "out KB");
+            for (int k = 0; k < shown; k++) {
+                const op_entry_t *e = &s_ops[order[k].op];
+                const uint64_t c = order[k].cycles;
+                len = appendf(out, cap, len, "%4d %-24s %9.2f %6.2f %9.2f %8.2f %8.1f %8.1f %8.1f\n",
+                              order[k].op, e->type, (double)c / mhz / 1000.0,
+                              op_cycles ? 100.0 * c / op_cycles : 0.0, (double)e->macs / 1e6,
+                              c ? (double)e->macs / c : 0.0,
+                              e->in_bytes / 1024.0, e->w_bytes / 1024.0, e->out_bytes / 1024.0);
+            }
+            heap_caps_free(order);
+        }
+    }
+
+    len = appendf(out, cap, len,
+                  "\nesp_nn kernel timers since reset (ms): conv=%lld dwconv=%lld fc=%lld add=%lld mul=%lld pool=%lld softmax=%lld\n",
+                  conv_total_time / 1000, dc_total_time / 1000, fc_total_time / 1000,
+                  add_total_time / 1000, mul_total_time / 1000, pooling_total_time / 1000,
+                  softmax_total_time / 1000);
+    return len;
+}
+
+size_t op_profiler_csv(char *out, size_t cap)
+{
+    if (!out || cap == 0) return 0;
+    out[0] = 0;
+
+    const uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+
+    size_t len = appendf(out, cap, 0,
+                         "op,type,runs,last_cycles,avg_cycles,max_cycles,avg_us,macs,input_bytes,weight_bytes,output_bytes\n");
+    for (int i = 0; i < s_num_ops; i++) {
+        const op_entry_t e = snapshot_op(i);
+        const uint64_t c = avg_cycles(&e);
+        len = appendf(out, cap, len, "%d,%s,%lu,%lu,%llu,%lu,%llu,%llu,%lu,%lu,%lu\n",
+                      i, e.type, (unsigned long)e.runs, (unsigned long)e.last_cycles,
+                      (unsigned long long)c, (unsigned long)e.max_cycles,
+                      (unsigned long long)(c / mhz), (unsigned long long)e.macs,
+                      (unsigned long)e.in_bytes, (unsigned long)e.w_bytes, (unsigned long)e.out_bytes);
+    }
+    return len;
+}
+
+esp_err_t op_profiler_dump_csv(const char *path)
+{
+    if (!path) return ESP_ERR_INVALID_ARG;
+    if (!s_ops) return ESP_ERR_INVALID_STATE;
+
+    const size_t cap = 128 + (size_t)s_num_ops * 128;
+    char *buf = (char *)heap_caps_malloc(cap, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!buf) return ESP_ERR_NO_MEM;
+
+    const size_t len = op_profiler_csv(buf, cap);
+    esp_err_t err = sdcard_write_file(path, (const uint8_t *)buf, len);
+
+    heap_caps_free(buf);
+    return err;
+}
+
+void op_profiler_log_summary(void)
+{
+    if (!s_ops || s_invokes == 0) return;
+
+    const uint32_t mhz = esp_rom_get_cpu_ticks_per_us();
+
+    type_entry_t types[OP_PROF_MAX_TYPES];
+    uint64_t op_cycles = 0;
+    const int num_types = collect_types(types, &op_cycles);
+
+    ESP_LOGI(TAG, "%lu invokes, ops %.1f ms per invoke",
+             (unsigned long)s_invokes, (double)op_cycles / mhz / 1000.0);
+    for (int t = 0; t < num_types && t < 8; t++) {
+        ESP_LOGI(TAG, "  %-24s %3d ops %9.1f ms %5.1f%% %8.1f MMAC",
+                 types[t].type, types[t].ops, (double)types[t].cycles / mhz / 1000.0,
+                 op_cycles ? 100.0 * types[t].cycles / op_cycles : 0.0,
+                 (double)types[t].macs / 1e6);
+    }
+}
@@ -0,0 +1,71 @@
+// File: main/op_profiler.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+// -----------------------------------------------------------------------------
+// Per-operator inference profiler
+//
+// A tflite::MicroProfilerInterface handed to the MicroInterpreter. The
+// interpreter opens one event per operator it invokes; events are matched to
+// the operators of the model's main subgraph in execution order, so each op
+// gets CPU cycles (last / total / max over the profiled Invoke()s) next to
+// what it costs on paper, taken from the flatbuffer when the profiler is
+// created: MACs (CONV_2D, DEPTHWISE_CONV_2D, TRANSPOSE_CONV, FULLY_CONNECTED;
+// one per output element for element-wise MUL / ADD / SUB) and the bytes of
+// its activation inputs, constant inputs (weights, bias) and outputs.
+// Per-op-type totals are summed from the ops.
+//
+// Cycles are the inference core's CCOUNT between the op's begin and end
+// events, so they include any preemption by higher-priority tasks on that
+// core. Nested events (kernels that profile themselves) count towards the
+// enclosing op.
+//
+// Disabled, each op still makes two virtual calls that return at once;
+// built without it (interpreter profiler nullptr) nothing runs at all.
+// -----------------------------------------------------------------------------
+#ifdef __cplusplus
+namespace tflite {
+class MicroProfilerInterface;
+struct Model;
+}
+
+// Build the op table for model (main subgraph); call before creating the
+// interpreter and pass op_profiler_interface() to its constructor.
+esp_err_t op_profiler_init(const tflite::Model *model);
+tflite::MicroProfilerInterface *op_profiler_interface(void);
+
+extern "C" {
+#endif
+
+bool op_profiler_ready(void);
+
+// Takes effect at the next op_profiler_invoke_begin()
+void op_profiler_enable(bool on);
+bool op_profiler_enabled(void);
+
+// Clear the cycle counters (and the esp_nn kernel timers)
+void op_profiler_reset(void);
+
+// Bracket Invoke() (inference task only)
+void op_profiler_invoke_begin(void);
+void op_profiler_invoke_end(void);
+
+// Plain-text report (per type, then the top_ops most expensive ops; <0: all)
+// or one CSV row per op. Returns the length written (truncated to cap - 1).
+size_t op_profiler_report(char *out, size_t cap, int top_ops);
+size_t op_profiler_csv(char *out, size_t cap);
+
+// Write the CSV to path (sync, SD)
+esp_err_t op_profiler_dump_csv(const char *path);
+
+// Per-type summary to the log
+void op_profiler_log_summary(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,32 +6,18 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
 #include "esp_log.h"
-#include "img_converters.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "jpeg_decoder.h"
+#include "resample.h"
+#include "sd_writer.h"
 
 static const char *TAG = "PPM";
 
-// -----------------------------------------------------------------------------
-// RGB565 → RGB888 conversion
-// -----------------------------------------------------------------------------
-static void rgb565_to_rgb888(
-    const uint8_t *src,
-    uint8_t *dst,
-    int pixel_count)
-{
-    for (int i = 0; i < pixel_count; i++) {
-        uint16_t p = ((uint16_t *)src)[i];
-
-        uint8_t r = (p >> 11) & 0x1F;
-        uint8_t g = (p >> 5)  & 0x3F;
-        uint8_t b =  p        & 0x1F;
-
-        dst[i * 3 + 0] = (r << 3) | (r >> 2);
-        dst[i * 3 + 1] = (g << 2) | (g >> 4);
-        dst[i * 3 + 2] = (b << 3) | (b >> 2);
-    }
-}
-
 // -----------------------------------------------------------------------------
 // Write RGB888 buffer as binary PPM (P6)
 // -----------------------------------------------------------------------------
@@ -55,60 +41,405 @@ esp_err_t ppm_write_rgb888(
     return ESP_OK;
 }
 
+esp_err_t ppm_submit_rgb888(
+    const char *path,
+    const uint8_t *rgb,
+    int width,
+    int height,
+    uint32_t flags)
+{
+    char hdr[32];
+    const int hdr_len = snprintf(hdr, sizeof(hdr), "P6\n%d %d\n255\n", width, height);
+
+    return sd_writer_submit(path, hdr, hdr_len, rgb, (size_t)width * height * 3, flags);
+}
+
 // -----------------------------------------------------------------------------
-// JPEG → RGB888 (via RGB565, guaranteed API)
+// JPEG decode: header-derived size, caller-owned output
 // -----------------------------------------------------------------------------
-esp_err_t jpeg_to_rgb888(
+
+// Shared context for callers without their own (serialized)
+static jpeg_dec_ctx_t    s_dec;
+static SemaphoreHandle_t s_dec_lock = NULL;
+static portMUX_TYPE      s_lock_init_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Mutex created on first use; two first callers race through the mux
+static SemaphoreHandle_t lazy_mutex(SemaphoreHandle_t *lock)
+{
+    if (!*lock) {
+        SemaphoreHandle_t m = xSemaphoreCreateMutex();
+        if (!m) return NULL;
+
+        portENTER_CRITICAL(&s_lock_init_mux);
+        if (!*lock) {
+            *lock = m;
+            m = NULL;
+        }
+        portEXIT_CRITICAL(&s_lock_init_mux);
+
+        if (m) vSemaphoreDelete(m);     // lost the race
+    }
+    return *lock;
+}
+
+static jpeg_dec_ctx_t *shared_ctx_lock(void)
+{
+    if (!lazy_mutex(&s_dec_lock)) return NULL;
+
+    xSemaphoreTake(s_dec_lock, portMAX_DELAY);
+
+    if (!s_dec.work && jpeg_dec_ctx_init(&s_dec, 0) != ESP_OK) {
+        xSemaphoreGive(s_dec_lock);
+        return NULL;
+    }
+    return &s_dec;
+}
+
+esp_err_t jpeg_get_size(
     const uint8_t *jpeg,
     size_t jpeg_len,
-    uint8_t **out_rgb,
     int *out_w,
     int *out_h)
 {
-    // You KNOW the file is 320×240 (per your setup)
-    const int width  = 320;
-    const int height = 240;
-    const int pixels = width * height;
+    if (!jpeg || jpeg_len == 0 || !out_w || !out_h) return ESP_ERR_INVALID_ARG;
+
+    esp_jpeg_image_cfg_t cfg = {};
+    cfg.indata      = (uint8_t *)jpeg;
+    cfg.indata_size = jpeg_len;
+    cfg.out_format  = JPEG_IMAGE_FORMAT_RGB888;
+    cfg.out_scale   = JPEG_IMAGE_SCALE_0;
+
+    esp_jpeg_image_output_t info = {};
+    esp_err_t err = esp_jpeg_get_image_info(&cfg, &info);
+    if (err != ESP_OK || info.width == 0 || info.height == 0) {
+        ESP_LOGE(TAG, "JPEG header parse failed");
+        return ESP_FAIL;
+    }
 
-    uint8_t *rgb565 = (uint8_t *)malloc(pixels * 2);
-    if (!rgb565) {
-        ESP_LOGE(TAG, "RGB565 alloc failed");
-        return ESP_ERR_NO_MEM;
+    *out_w = info.width;
+    *out_h = info.height;
+    return ESP_OK;
+}
+
+size_t jpeg_layout_bytes(jpeg_layout_t layout, int width, int height)
+{
+    const size_t px = (size_t)width * height;
+    return layout == JPEG_LAYOUT_LUMA ? px : px * 3;
+}
+
+// Planar / luma: esp_jpeg only emits interleaved pixels, so these layouts
+// drive TJpgDec directly and scatter each MCU block on output. RGB888 takes
+// the same route when the two-core decoder is running, and always with the
+// local decoder (TJPGD_USE_LOCAL), so every path in main/ decodes the same.
+typedef struct {
+    jpeg_layout_t  layout;
+    uint8_t       *out;
+    int            width;
+    int            height;
+} jpeg_layout_dst_t;
+
+static bool layout_out_cb(void *user, const uint8_t *in, const JRECT *rect)
+{
+    jpeg_layout_dst_t *d = (jpeg_layout_dst_t *)user;
+
+    const size_t plane = (size_t)d->width * d->height;
+
+    if (d->layout == JPEG_LAYOUT_RGB888) {
+        const size_t row_bytes = (size_t)(rect->right - rect->left + 1) * 3;
+
+        for (int y = rect->top; y <= rect->bottom; y++) {
+            memcpy(d->out + ((size_t)y * d->width + rect->left) * 3, in, row_bytes);
+            in += row_bytes;
+        }
+        return true;
     }
 
-    if (!jpg2rgb565(jpeg, jpeg_len, rgb565, JPG_SCALE_NONE)) {
-        ESP_LOGE(TAG, "jpg2rgb565 failed");
-        free(rgb565);
-        return ESP_FAIL;
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        for (int x = rect->left; x <= rect->right; x++) {
+            const size_t i = (size_t)y * d->width + x;
+
+            if (d->layout == JPEG_LAYOUT_LUMA) {
+                // BT.601 luma, 8-bit fixed point
+                d->out[i] = (uint8_t)((77 * in[0] + 150 * in[1] + 29 * in[2]) >> 8);
+            } else {
+                d->out[i]             = in[0];
+                d->out[plane + i]     = in[1];
+                d->out[2 * plane + i] = in[2];
+            }
+            in += 3;
+        }
+    }
+
+    return true;
+}
+
+static esp_err_t decode_with_ctx(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    jpeg_layout_t layout,
+    uint8_t *out,
+    size_t out_size,
+    int w,
+    int h)
+{
+    jpeg_layout_dst_t d = { layout, out, w, h };
+
+    if (jpeg_dec_parallel_ready()) {
+        // Split across both cores when the frame has restart markers
+        return jpeg_dec_run_parallel(ctx, jpeg, jpeg_len, layout_out_cb, &d, NULL);
+    }
+
+#if !TJPGD_USE_LOCAL
+    if (layout == JPEG_LAYOUT_RGB888) {
+        esp_jpeg_image_cfg_t cfg = {};
+        cfg.indata      = (uint8_t *)jpeg;
+        cfg.indata_size = jpeg_len;
+        cfg.outbuf      = out;
+        cfg.outbuf_size = out_size;
+        cfg.out_format  = JPEG_IMAGE_FORMAT_RGB888;
+        cfg.out_scale   = JPEG_IMAGE_SCALE_0;
+        cfg.advanced.working_buffer      = ctx->work;
+        cfg.advanced.working_buffer_size = ctx->work_size;
+
+        esp_jpeg_image_output_t info = {};
+        esp_err_t err = esp_jpeg_decode(&cfg, &info);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "esp_jpeg_decode failed (%s)", esp_err_to_name(err));
+        }
+        return err;
+    }
+#endif
+
+    esp_err_t err = jpeg_dec_open(ctx, jpeg, jpeg_len);
+    if (err == ESP_OK) {
+        err = jpeg_dec_run(ctx, 0, layout_out_cb, &d);
+    }
+    return err;
+}
+
+esp_err_t jpeg_decode_into(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    jpeg_layout_t layout,
+    uint8_t *out,
+    size_t out_size,
+    int *out_w,
+    int *out_h)
+{
+    if (!out) return ESP_ERR_INVALID_ARG;
+
+    int w = 0, h = 0;
+    esp_err_t err = jpeg_get_size(jpeg, jpeg_len, &w, &h);
+    if (err != ESP_OK) return err;
+
+    const size_t need = jpeg_layout_bytes(layout, w, h);
+    if (out_size < need) {
+        ESP_LOGE(TAG, "JPEG %dx%d needs %u bytes, buffer has %u",
+                 w, h, (unsigned)need, (unsigned)out_size);
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    uint8_t *rgb888 = (uint8_t *)malloc(pixels * 3);
+    if (ctx) {
+        err = decode_with_ctx(ctx, jpeg, jpeg_len, layout, out, out_size, w, h);
+    } else {
+        jpeg_dec_ctx_t *shared = shared_ctx_lock();
+        if (!shared) return ESP_ERR_NO_MEM;
+
+        err = decode_with_ctx(shared, jpeg, jpeg_len, layout, out, out_size, w, h);
+        xSemaphoreGive(s_dec_lock);
+    }
+    if (err != ESP_OK) return err;
+
+    if (out_w) *out_w = w;
+    if (out_h) *out_h = h;
+
+    ESP_LOGI(TAG, "JPEG → %s (%dx%d)",
+             layout == JPEG_LAYOUT_RGB888 ? "RGB888" :
+             layout == JPEG_LAYOUT_RGB_PLANAR ? "RGB planar" : "luma",
+             w, h);
+    return ESP_OK;
+}
+
+esp_err_t jpeg_to_rgb888_into(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t *out_rgb,
+    size_t out_size,
+    int *out_w,
+    int *out_h)
+{
+    return jpeg_decode_into(NULL, jpeg, jpeg_len, JPEG_LAYOUT_RGB888,
+                            out_rgb, out_size, out_w, out_h);
+}
+
+esp_err_t jpeg_to_rgb888(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t **out_rgb,
+    int *out_w,
+    int *out_h)
+{
+    int w = 0, h = 0;
+    esp_err_t err = jpeg_get_size(jpeg, jpeg_len, &w, &h);
+    if (err != ESP_OK) return err;
+
+    const size_t size = jpeg_layout_bytes(JPEG_LAYOUT_RGB888, w, h);
+    uint8_t *rgb888 = (uint8_t *)malloc(size);
     if (!rgb888) {
-        free(rgb565);
         return ESP_ERR_NO_MEM;
     }
 
-    rgb565_to_rgb888(rgb565, rgb888, pixels);
-    free(rgb565);
+    err = jpeg_to_rgb888_into(jpeg, jpeg_len, rgb888, size, out_w, out_h);
+    if (err != ESP_OK) {
+        free(rgb888);
+        return err;
+    }
 
     *out_rgb = rgb888;
-    *out_w   = width;
-    *out_h   = height;
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// 1/8-scale luma thumbnail
+// -----------------------------------------------------------------------------
+typedef struct {
+    uint8_t *out;
+    int      width;
+    int      height;
+} jpeg_thumb_dst_t;
+
+static bool thumb_out_cb(void *user, const uint8_t *p, const JRECT *rect)
+{
+    jpeg_thumb_dst_t *d = (jpeg_thumb_dst_t *)user;
+
+    for (int y = rect->top; y <= rect->bottom; y++) {
+        for (int x = rect->left; x <= rect->right; x++) {
+            if (x < d->width && y < d->height) {
+                // BT.601 luma, 8-bit fixed point
+                d->out[y * d->width + x] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8);
+            }
+            p += 3;
+        }
+    }
 
-    ESP_LOGI(TAG, "JPEG → RGB888 (%dx%d)", width, height);
+    return true;
+}
+
+static esp_err_t thumb_with_ctx(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t *out,
+    size_t out_size,
+    int *out_w,
+    int *out_h)
+{
+    esp_err_t err = jpeg_dec_open(ctx, jpeg, jpeg_len);
+    if (err != ESP_OK) return err;
+
+    jpeg_thumb_dst_t d = { out, JPEG_THUMB_DIM(ctx->width), JPEG_THUMB_DIM(ctx->height) };
+
+    if (out_size < (size_t)d.width * d.height) {
+        ESP_LOGE(TAG, "Thumbnail %dx%d needs %u bytes, buffer has %u",
+                 d.width, d.height, (unsigned)(d.width * d.height), (unsigned)out_size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    err = jpeg_dec_run(ctx, 3, thumb_out_cb, &d);
+    if (err != ESP_OK) return err;
+
+    if (out_w) *out_w = d.width;
+    if (out_h) *out_h = d.height;
     return ESP_OK;
 }
 
+esp_err_t jpeg_thumb_luma(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t *out,
+    size_t out_size,
+    int *out_w,
+    int *out_h)
+{
+    if (!jpeg || jpeg_len == 0 || !out) return ESP_ERR_INVALID_ARG;
+
+    if (ctx) {
+        return thumb_with_ctx(ctx, jpeg, jpeg_len, out, out_size, out_w, out_h);
+    }
+
+    jpeg_dec_ctx_t *shared = shared_ctx_lock();
+    if (!shared) return ESP_ERR_NO_MEM;
+
+    esp_err_t err = thumb_with_ctx(shared, jpeg, jpeg_len, out, out_size, out_w, out_h);
+    xSemaphoreGive(s_dec_lock);
+    return err;
+}
+
+esp_err_t jpeg_thumb_benchmark(const uint8_t *jpeg, size_t jpeg_len, int iterations)
+{
+    if (!jpeg || jpeg_len == 0 || iterations <= 0) return ESP_ERR_INVALID_ARG;
+
+    int w = 0, h = 0;
+    esp_err_t err = jpeg_get_size(jpeg, jpeg_len, &w, &h);
+    if (err != ESP_OK) return err;
+
+    const size_t rgb_size   = jpeg_layout_bytes(JPEG_LAYOUT_RGB888, w, h);
+    const size_t thumb_size = (size_t)JPEG_THUMB_DIM(w) * JPEG_THUMB_DIM(h);
+
+    jpeg_dec_ctx_t ctx;
+    uint8_t *rgb   = (uint8_t *)heap_caps_malloc(rgb_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *thumb = (uint8_t *)heap_caps_malloc(thumb_size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    if (!rgb || !thumb || jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) {
+        heap_caps_free(rgb);
+        heap_caps_free(thumb);
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t t_full  = 0;
+    int64_t t_thumb = 0;
+
+    for (int it = 0; it < iterations && err == ESP_OK; it++) {
+        jpeg_layout_dst_t d = { JPEG_LAYOUT_RGB888, rgb, w, h };
+
+        int64_t t0 = esp_timer_get_time();
+        err = jpeg_dec_open(&ctx, jpeg, jpeg_len);
+        if (err == ESP_OK) err = jpeg_dec_run(&ctx, 0, layout_out_cb, &d);
+        int64_t t1 = esp_timer_get_time();
+        if (err == ESP_OK) err = thumb_with_ctx(&ctx, jpeg, jpeg_len, thumb, thumb_size, NULL, NULL);
+        int64_t t2 = esp_timer_get_time();
+
+        t_full  += t1 - t0;
+        t_thumb += t2 - t1;
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Thumbnail bench %dx%d -> %dx%d, %d runs: full RGB888 %lld us, 1/8 luma %lld us (x%.1f)",
+                 w, h, JPEG_THUMB_DIM(w), JPEG_THUMB_DIM(h), iterations,
+                 (long long)(t_full / iterations), (long long)(t_thumb / iterations),
+                 t_thumb > 0 ? (double)t_full / (double)t_thumb : 0.0);
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+    heap_caps_free(rgb);
+    heap_caps_free(thumb);
+
+    return err;
+}
+
 // -----------------------------------------------------------------------------
 // Center crop RGB888
 // -----------------------------------------------------------------------------
-esp_err_t crop_rgb888_center(
+esp_err_t crop_rgb888_center_into(
     const uint8_t *src,
     int src_w,
     int src_h,
     int crop_w,
     int crop_h,
-    uint8_t **out_rgb)
+    uint8_t *dst)
 {
     if (crop_w > src_w || crop_h > src_h) {
         ESP_LOGE(TAG, "Invalid crop size");
@@ -118,12 +449,6 @@ esp_err_t crop_rgb888_center(
     int x0 = (src_w - crop_w) / 2;
     int y0 = (src_h - crop_h) / 2;
 
-    uint8_t *dst = (uint8_t *)malloc(crop_w * crop_h * 3);
-    if (!dst) {
-        ESP_LOGE(TAG, "Crop alloc failed");
-        return ESP_ERR_NO_MEM;
-    }
-
     for (int y = 0; y < crop_h; y++) {
         memcpy(
             dst + y * crop_w * 3,
@@ -132,112 +457,255 @@ esp_err_t crop_rgb888_center(
         );
     }
 
-    *out_rgb = dst;
     ESP_LOGI(TAG, "Center crop %dx%d", crop_w, crop_h);
     return ESP_OK;
 }
 
-esp_err_t resize_rgb888(
+esp_err_t crop_rgb888_center(
     const uint8_t *src,
     int src_w,
     int src_h,
-    int dst_w,
-    int dst_h,
+    int crop_w,
+    int crop_h,
     uint8_t **out_rgb)
 {
-    uint8_t *dst = (uint8_t *)malloc(dst_w * dst_h * 3);
+    if (crop_w > src_w || crop_h > src_h) {
+        ESP_LOGE(TAG, "Invalid crop size");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t *dst = (uint8_t *)malloc(crop_w * crop_h * 3);
     if (!dst) {
-        ESP_LOGE("PPM", "Resize alloc failed");
+        ESP_LOGE(TAG, "Crop alloc failed");
         return ESP_ERR_NO_MEM;
     }
 
-    for (int y = 0; y < dst_h; y++) {
-        int src_y = y * src_h / dst_h;
-        for (int x = 0; x < dst_w; x++) {
-            int src_x = x * src_w / dst_w;
+    crop_rgb888_center_into(src, src_w, src_h, crop_w, crop_h, dst);
 
-            const uint8_t *p =
-                src + (src_y * src_w + src_x) * 3;
+    *out_rgb = dst;
+    return ESP_OK;
+}
 
-            uint8_t *q =
-                dst + (y * dst_w + x) * 3;
+// -----------------------------------------------------------------------------
+// Resize (RGB888)
+//
+// The helpers below keep one resampler per (filter, fit) and rebuild it only
+// when the geometry changes, so a steady stream of same-size frames pays for
+// the coordinate math once and allocates nothing. Callers with a fixed
+// geometry can own a resampler_t.
+// -----------------------------------------------------------------------------
+static resampler_t       s_rs[RESAMPLE_AREA + 1][RESAMPLE_CROP + 1];
+static SemaphoreHandle_t s_rs_lock = NULL;
 
-            q[0] = p[0];
-            q[1] = p[1];
-            q[2] = p[2];
-        }
+static esp_err_t resample_cached(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    resample_fit_t fit,
+    uint8_t *dst)
+{
+    if (!lazy_mutex(&s_rs_lock)) return ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(s_rs_lock, portMAX_DELAY);
+
+    resampler_t *rs = &s_rs[filter][fit];
+    esp_err_t err = ESP_OK;
+
+    if (!resampler_matches(rs, src_w, src_h, dst_w, dst_h, filter, fit)) {
+        resampler_deinit(rs);
+        err = resampler_init(rs, src_w, src_h, dst_w, dst_h, filter, fit);
     }
+    if (err == ESP_OK) err = resampler_run(rs, src, dst);
+
+    xSemaphoreGive(s_rs_lock);
+    return err;
+}
+
+esp_err_t resize_rgb888_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst)
+{
+    esp_err_t err = resample_cached(src, src_w, src_h, dst_w, dst_h,
+                                    RESAMPLE_NEAREST, RESAMPLE_STRETCH, dst);
+    if (err != ESP_OK) return err;
 
-    *out_rgb = dst;
     ESP_LOGI("PPM", "Resize %dx%d → %dx%d",
              src_w, src_h, dst_w, dst_h);
 
     return ESP_OK;
 }
 
-esp_err_t resize_rgb888_aspect_crop(
+esp_err_t resize_rgb888(
     const uint8_t *src,
     int src_w,
     int src_h,
-    int dst_size,              // e.g. 128
+    int dst_w,
+    int dst_h,
     uint8_t **out_rgb)
 {
-    // Step 1: scale so short side == dst_size
-    float scale;
-    int scaled_w, scaled_h;
+    uint8_t *dst = (uint8_t *)malloc(dst_w * dst_h * 3);
+    if (!dst) {
+        ESP_LOGE("PPM", "Resize alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
 
-    if (src_w < src_h) {
-        scale = (float)dst_size / src_w;
-    } else {
-        scale = (float)dst_size / src_h;
+    esp_err_t err = resize_rgb888_into(src, src_w, src_h, dst_w, dst_h, dst);
+    if (err != ESP_OK) {
+        free(dst);
+        return err;
     }
 
-    scaled_w = (int)(src_w * scale + 0.5f);
-    scaled_h = (int)(src_h * scale + 0.5f);
+    *out_rgb = dst;
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Area-average resize (RGB888, anti-aliased)
+// -----------------------------------------------------------------------------
+esp_err_t resize_rgb888_area_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst)
+{
+    if (!src || !dst || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0)
+        return ESP_ERR_INVALID_ARG;
 
-    // Temporary buffer
-    uint8_t *scaled =
-        (uint8_t *)malloc(scaled_w * scaled_h * 3);
-    if (!scaled) return ESP_ERR_NO_MEM;
+    return resample_cached(src, src_w, src_h, dst_w, dst_h,
+                           RESAMPLE_AREA, RESAMPLE_STRETCH, dst);
+}
 
-    // Nearest-neighbour resize (aspect preserved)
-    for (int y = 0; y < scaled_h; y++) {
-        int sy = (int)(y / scale);
-        for (int x = 0; x < scaled_w; x++) {
-            int sx = (int)(x / scale);
+esp_err_t resize_rgb888_area(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t **out_rgb)
+{
+    if (!src || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0)
+        return ESP_ERR_INVALID_ARG;
 
-            const uint8_t *p =
-                src + (sy * src_w + sx) * 3;
-            uint8_t *q =
-                scaled + (y * scaled_w + x) * 3;
+    uint8_t *dst = (uint8_t *)malloc(dst_w * dst_h * 3);
+    if (!dst) {
+        ESP_LOGE(TAG, "Resize alloc failed");
+        return ESP_ERR_NO_MEM;
+    }
 
-            q[0] = p[0];
-            q[1] = p[1];
-            q[2] = p[2];
-        }
+    esp_err_t err = resize_rgb888_area_into(src, src_w, src_h, dst_w, dst_h, dst);
+    if (err != ESP_OK) {
+        free(dst);
+        return err;
     }
 
-    // Step 2: center crop to dst_size × dst_size
-    int x0 = (scaled_w - dst_size) / 2;
-    int y0 = (scaled_h - dst_size) / 2;
+    *out_rgb = dst;
+    return ESP_OK;
+}
 
-    uint8_t *dst =
-        (uint8_t *)malloc(dst_size * dst_size * 3);
-    if (!dst) {
-        free(scaled);
+// Mean |a - b| over n bytes, x1000
+static uint32_t mean_abs_diff_milli(const uint8_t *a, const uint8_t *b, size_t n)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += (a[i] > b[i]) ? a[i] - b[i] : b[i] - a[i];
+    return n ? (uint32_t)(sum * 1000 / n) : 0;
+}
+
+esp_err_t resize_filter_benchmark(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    int dst_w,
+    int dst_h,
+    int iterations)
+{
+    if (!jpeg || jpeg_len == 0 || dst_w <= 0 || dst_h <= 0 || iterations <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    int w = 0, h = 0;
+    esp_err_t err = jpeg_get_size(jpeg, jpeg_len, &w, &h);
+    if (err != ESP_OK) return err;
+
+    const size_t rgb_size = jpeg_layout_bytes(JPEG_LAYOUT_RGB888, w, h);
+    const size_t out_size = (size_t)dst_w * dst_h * 3;
+
+    // Frame, the same frame moved right by one source pixel, and one output
+    // per (filter, frame)
+    uint8_t *rgb   = (uint8_t *)heap_caps_malloc(2 * rgb_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    uint8_t *out   = (uint8_t *)heap_caps_malloc(4 * out_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    resampler_t rs[2] = {};
+
+    if (!rgb || !out) {
+        heap_caps_free(rgb);
+        heap_caps_free(out);
         return ESP_ERR_NO_MEM;
     }
 
-    for (int y = 0; y < dst_size; y++) {
-        memcpy(
-            dst + y * dst_size * 3,
-            scaled + ((y0 + y) * scaled_w + x0) * 3,
-            dst_size * 3
-        );
+    uint8_t *moved = rgb + rgb_size;
+
+    err = jpeg_to_rgb888_into(jpeg, jpeg_len, rgb, rgb_size, NULL, NULL);
+    if (err == ESP_OK) err = resampler_init(&rs[0], w, h, dst_w, dst_h, RESAMPLE_NEAREST, RESAMPLE_LETTERBOX);
+    if (err == ESP_OK) err = resampler_init(&rs[1], w, h, dst_w, dst_h, RESAMPLE_AREA, RESAMPLE_LETTERBOX);
+
+    if (err == ESP_OK) {
+        for (int y = 0; y < h; y++) {
+            const uint8_t *s = rgb + (size_t)y * w * 3;
+            uint8_t       *d = moved + (size_t)y * w * 3;
+            memcpy(d, s, 3);
+            memcpy(d + 3, s, (size_t)(w - 1) * 3);
+        }
+
+        int64_t  us[2];
+        uint32_t jitter[2];
+
+        for (int f = 0; f < 2; f++) {
+            uint8_t *a = out + (2 * f) * out_size;
+            uint8_t *b = a + out_size;
+
+            int64_t t0 = esp_timer_get_time();
+            for (int it = 0; it < iterations; it++) resampler_run(&rs[f], rgb, a);
+            us[f] = (esp_timer_get_time() - t0) / iterations;
+
+            // Sub-pixel camera shake: how much the output changes when the
+            // scene moves by one source pixel
+            resampler_run(&rs[f], moved, b);
+            jitter[f] = mean_abs_diff_milli(a, b, out_size);
+        }
+
+        ESP_LOGI(TAG, "Resize bench %dx%d -> %dx%d letterbox, %d runs: nearest %lld us, area %lld us (x%.1f)",
+                 w, h, dst_w, dst_h, iterations, (long long)us[0], (long long)us[1],
+                 us[0] > 0 ? (double)us[1] / (double)us[0] : 0.0);
+        ESP_LOGI(TAG, "Resize stability, 1 px shift: mean |diff| nearest %lu.%03lu, area %lu.%03lu",
+                 (unsigned long)(jitter[0] / 1000), (unsigned long)(jitter[0] % 1000),
+                 (unsigned long)(jitter[1] / 1000), (unsigned long)(jitter[1] % 1000));
     }
 
-    free(scaled);
-    *out_rgb = dst;
+    resampler_deinit(&rs[0]);
+    resampler_deinit(&rs[1]);
+    heap_caps_free(rgb);
+    heap_caps_free(out);
+
+    return err;
+}
+
+esp_err_t resize_rgb888_aspect_crop_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_size,              // e.g. 128
+    uint8_t *dst)
+{
+    // Short side scaled to dst_size, centre window sampled straight from src
+    esp_err_t err = resample_cached(src, src_w, src_h, dst_size, dst_size,
+                                    RESAMPLE_NEAREST, RESAMPLE_CROP, dst);
+    if (err != ESP_OK) return err;
 
     ESP_LOGI("PPM",
         "Aspect resize+crop %dx%d → %dx%d",
@@ -246,6 +714,88 @@ esp_err_t resize_rgb888_aspect_crop(
     return ESP_OK;
 }
 
+esp_err_t resize_rgb888_aspect_crop(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_size,
+    uint8_t **out_rgb)
+{
+    uint8_t *dst =
+        (uint8_t *)malloc(dst_size * dst_size * 3);
+    if (!dst) return ESP_ERR_NO_MEM;
+
+    esp_err_t err = resize_rgb888_aspect_crop_into(src, src_w, src_h, dst_size, dst);
+    if (err != ESP_OK) {
+        free(dst);
+        return err;
+    }
+
+    *out_rgb = dst;
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Letterbox resize (RGB888)
+// -----------------------------------------------------------------------------
+esp_err_t resize_rgb888_letterbox_filter_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    uint8_t *dst)
+{
+    // Geometry-preserving, no-crop resize using letterboxing
+    // Output is always dst_w × dst_h (e.g. 192×192)
+    // Aspect ratio preserved, black padding added where needed
+
+    if (!src || !dst || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 ||
+        (unsigned)filter > RESAMPLE_AREA)
+        return ESP_ERR_INVALID_ARG;
+
+    return resample_cached(src, src_w, src_h, dst_w, dst_h,
+                           filter, RESAMPLE_LETTERBOX, dst);
+}
+
+esp_err_t resize_rgb888_letterbox_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst)
+{
+    return resize_rgb888_letterbox_filter_into(src, src_w, src_h, dst_w, dst_h,
+                                               RESAMPLE_NEAREST, dst);
+}
+
+esp_err_t resize_rgb888_letterbox(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t **out_rgb)
+{
+    if (!src || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0)
+        return ESP_ERR_INVALID_ARG;
+
+    uint8_t *dst = (uint8_t *)malloc(dst_w * dst_h * 3);
+    if (!dst)
+        return ESP_ERR_NO_MEM;
+
+    esp_err_t err = resize_rgb888_letterbox_into(src, src_w, src_h, dst_w, dst_h, dst);
+    if (err != ESP_OK) {
+        free(dst);
+        return err;
+    }
+
+    *out_rgb = dst;
+    return ESP_OK;
+}
+
 void improve_rgb888_contrast(
     uint8_t *rgb,
     int width,
@@ -277,6 +827,18 @@ esp_err_t rgb888_to_grayscale(
     uint8_t *gray = (uint8_t *)malloc(width * height);
     if (!gray) return ESP_ERR_NO_MEM;
 
+    rgb888_to_grayscale_into(src, width, height, gray);
+
+    *out_gray = gray;
+    return ESP_OK;
+}
+
+esp_err_t rgb888_to_grayscale_into(
+    const uint8_t *src,
+    int width,
+    int height,
+    uint8_t *gray)
+{
     int pixels = width * height;
     for (int i = 0; i < pixels; i++) {
         uint8_t r = src[i * 3 + 0];
@@ -289,7 +851,6 @@ esp_err_t rgb888_to_grayscale(
         );
     }
 
-    *out_gray = gray;
     return ESP_OK;
 }
 
@@ -5,6 +5,8 @@
 #include <stddef.h>
 
 #include "esp_err.h"
+#include "jpeg_dec.h"
+#include "resample.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,9 +22,52 @@ esp_err_t ppm_write_rgb888(
     int height
 );
 
+// Same file through the asynchronous SD writer (sd_writer.h); returns as
+// soon as the pixels are copied. flags: SD_WRITE_*
+esp_err_t ppm_submit_rgb888(
+    const char *path,
+    const uint8_t *rgb,
+    int width,
+    int height,
+    uint32_t flags
+);
+
 // -----------------------------------------------------------------------------
-// JPEG → RGB888 (via RGB565 internally)
+// JPEG decode
+//
+// Dimensions come from the JPEG header; output goes straight into the layout
+// the next stage wants. Buffers are caller-owned and checked against the
+// header size (ESP_ERR_INVALID_SIZE instead of an overrun).
 // -----------------------------------------------------------------------------
+typedef enum {
+    JPEG_LAYOUT_RGB888 = 0,     // interleaved R,G,B
+    JPEG_LAYOUT_RGB_PLANAR,     // R plane, G plane, B plane
+    JPEG_LAYOUT_LUMA,           // 8-bit BT.601 luma
+} jpeg_layout_t;
+
+esp_err_t jpeg_get_size(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    int *out_w,
+    int *out_h
+);
+
+size_t jpeg_layout_bytes(jpeg_layout_t layout, int width, int height);
+
+// ctx: caller-owned decoder context, or NULL for a shared one (serialized
+// across tasks)
+esp_err_t jpeg_decode_into(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    jpeg_layout_t layout,
+    uint8_t *out,
+    size_t out_size,
+    int *out_w,
+    int *out_h
+);
+
+// JPEG → RGB888, allocated to the header size (caller frees)
 esp_err_t jpeg_to_rgb888(
     const uint8_t *jpeg,
     size_t jpeg_len,
@@ -31,6 +76,40 @@ esp_err_t jpeg_to_rgb888(
     int *out_h
 );
 
+// Same, into a caller-owned buffer of at least w*h*3 bytes (no heap use)
+esp_err_t jpeg_to_rgb888_into(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t *out_rgb,
+    size_t out_size,
+    int *out_w,
+    int *out_h
+);
+
+// -----------------------------------------------------------------------------
+// 1/8-scale luma thumbnail
+//
+// One pixel per 8x8 block, taken from the DC coefficients: the decoder still
+// parses every AC code but skips de-quantizing, the IDCT and full-size colour
+// conversion. 40x30 for QVGA. Meant for per-frame analytics (change,
+// exposure, blur, obstruction) that run before deciding on a full decode.
+// -----------------------------------------------------------------------------
+#define JPEG_THUMB_DIM(px) ((px) >> 3)  // thumbnail width / height for a source size
+
+// ctx: caller-owned decoder context, or NULL for the shared one
+esp_err_t jpeg_thumb_luma(
+    jpeg_dec_ctx_t *ctx,
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    uint8_t *out,
+    size_t out_size,
+    int *out_w,
+    int *out_h
+);
+
+// Full RGB888 decode vs thumbnail timing on one frame
+esp_err_t jpeg_thumb_benchmark(const uint8_t *jpeg, size_t jpeg_len, int iterations);
+
 // -----------------------------------------------------------------------------
 // Center crop RGB888
 // -----------------------------------------------------------------------------
@@ -43,8 +122,26 @@ esp_err_t crop_rgb888_center(
     uint8_t **out_rgb
 );
 
+esp_err_t crop_rgb888_center_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int crop_w,
+    int crop_h,
+    uint8_t *dst
+);
+
 // -----------------------------------------------------------------------------
-// Resize RGB888 (nearest-neighbour)
+// Resize RGB888
+//
+// All resize helpers run a resampler (resample.h) cached per filter and fit;
+// its tables are rebuilt only when the geometry changes.
+//
+// resize_rgb888*(), the aspect crop and resize_rgb888_letterbox*() sample
+// nearest. resize_rgb888_area*() always area-averages, and
+// resize_rgb888_letterbox_filter_into() takes the filter as an argument
+// (RESAMPLE_AREA averages every source pixel a destination pixel covers, which
+// keeps thin structures from flickering in and out between frames).
 // -----------------------------------------------------------------------------
 esp_err_t resize_rgb888(
     const uint8_t *src,
@@ -55,7 +152,50 @@ esp_err_t resize_rgb888(
     uint8_t **out_rgb
 );
 
+esp_err_t resize_rgb888_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst
+);
 
+// -----------------------------------------------------------------------------
+// Resize RGB888, area average (anti-aliased box filter, fixed point)
+// -----------------------------------------------------------------------------
+esp_err_t resize_rgb888_area(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t **out_rgb
+);
+
+esp_err_t resize_rgb888_area_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst
+);
+
+// Decodes one frame, then letterboxes it to dst_w × dst_h with nearest and
+// area: time per resize, and the mean output change when the frame moves by
+// one source pixel (lower = steadier input between frames)
+esp_err_t resize_filter_benchmark(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    int dst_w,
+    int dst_h,
+    int iterations
+);
+
+// -----------------------------------------------------------------------------
+// Resize RGB888, aspect preserved, center crop to dst_size × dst_size
+// -----------------------------------------------------------------------------
 esp_err_t resize_rgb888_aspect_crop(
     const uint8_t *src,
     int src_w,
@@ -64,6 +204,48 @@ esp_err_t resize_rgb888_aspect_crop(
     uint8_t **out_rgb
 );
 
+// Crop is folded into the sampling; no scaled temporary is created.
+esp_err_t resize_rgb888_aspect_crop_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_size,
+    uint8_t *dst
+);
+
+// -----------------------------------------------------------------------------
+// Resize RGB888, aspect preserved, letterboxed (black padding) to dst_w × dst_h
+// -----------------------------------------------------------------------------
+esp_err_t resize_rgb888_letterbox(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t **out_rgb
+);
+
+esp_err_t resize_rgb888_letterbox_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    uint8_t *dst
+);
+
+// Same with the filter chosen by the caller (e.g. the model-input filter,
+// which can change between frames)
+esp_err_t resize_rgb888_letterbox_filter_into(
+    const uint8_t *src,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    uint8_t *dst
+);
+
 esp_err_t rgb888_to_grayscale(
     const uint8_t *src,
     int width,
@@ -71,6 +253,13 @@ esp_err_t rgb888_to_grayscale(
     uint8_t **out_gray
 );
 
+esp_err_t rgb888_to_grayscale_into(
+    const uint8_t *src,
+    int width,
+    int height,
+    uint8_t *gray
+);
+
 esp_err_t pgm_write_gray(
     const char *path,
     const uint8_t *gray,
@@ -0,0 +1,360 @@
+// File: main/preproc.cpp
+
+#include "preproc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+#include "jpeg_dec.h"
+#include "resample.h"
+
+static const char *TAG = "PREPROC";
+
+// TJpgDec emits one MCU band (8 or 16 source rows) left to right; the ring
+// holds one band, so 16 rows cover every chroma subsampling mode.
+#define PREPROC_RING_ROWS 16
+
+// -----------------------------------------------------------------------------
+// State (built once by preproc_init)
+// -----------------------------------------------------------------------------
+static preproc_cfg_t s_cfg;
+static bool s_ready = false;
+
+// Letterbox: nearest uses the maps only (destination pixel → source column /
+// row), filtered modes stream ring rows through the resampler. Maps cover
+// only the scaled area [off, off + n); the rest is pad. The crop is nearest.
+static resampler_t s_lb;              // letterbox → model input
+static resampler_t s_crop;            // center crop (optional)
+static uint8_t    *s_lb_row = nullptr;    // one filtered letterbox row, RGB888
+
+// Filter requested by preproc_set_filter(), applied at the next frame
+static volatile resample_filter_t s_filter_req = RESAMPLE_NEAREST;
+
+static quant_lut_t s_lut;             // internal RAM copy, hit per pixel
+static jpeg_dec_ctx_t s_dec;          // own decoder context (internal RAM)
+static uint8_t *s_ring = nullptr;     // PREPROC_RING_ROWS source rows, RGB888
+static size_t   s_ring_bytes = 0;
+static size_t   s_working_set = 0;
+
+typedef struct {
+    int            ring_rows;       // MCU band height of this JPEG
+
+    int8_t        *dst_i8;
+    uint8_t       *dst_rgb;
+    uint8_t       *dst_crop;
+
+    int            lb_row;          // next letterbox row to emit (scaled area)
+    int            crop_row;        // next crop row to emit
+} preproc_session_t;
+
+static void update_working_set(void)
+{
+    s_working_set = s_ring_bytes + s_dec.work_size + sizeof(s_lut) + s_cfg.dst_w * 3 +
+                    resampler_bytes(&s_lb) + resampler_bytes(&s_crop);
+}
+
+esp_err_t preproc_init(const preproc_cfg_t *cfg)
+{
+    if (!cfg || cfg->src_w <= 0 || cfg->src_h <= 0 ||
+        cfg->dst_w <= 0 || cfg->dst_h <= 0 || cfg->crop_size < 0 || !cfg->lut ||
+        cfg->filter > RESAMPLE_AREA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_ready) {
+        ESP_LOGW(TAG, "Preprocessor already initialized");
+        return ESP_OK;
+    }
+
+    s_cfg = *cfg;
+
+    const size_t ring_bytes = (size_t)cfg->src_w * 3 * PREPROC_RING_ROWS;
+    const int    crop_n     = cfg->crop_size;
+
+    // Same resampler geometry as the ppm.cpp resizers, so the A/B check can
+    // compare byte for byte
+    esp_err_t err = resampler_init(&s_lb, cfg->src_w, cfg->src_h, cfg->dst_w, cfg->dst_h,
+                                   cfg->filter, RESAMPLE_LETTERBOX);
+    if (err == ESP_OK && crop_n) {
+        err = resampler_init(&s_crop, cfg->src_w, cfg->src_h, crop_n, crop_n,
+                             RESAMPLE_NEAREST, RESAMPLE_CROP);
+    }
+
+    s_ring   = (uint8_t *)heap_caps_malloc(ring_bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    s_lb_row = (uint8_t *)heap_caps_malloc(cfg->dst_w * 3, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+
+    if (err != ESP_OK || !s_ring || !s_lb_row || jpeg_dec_ctx_init(&s_dec, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Preprocessor table alloc failed");
+        resampler_deinit(&s_lb);
+        resampler_deinit(&s_crop);
+        free(s_ring);
+        free(s_lb_row);
+        jpeg_dec_ctx_deinit(&s_dec);
+        s_ring = nullptr;
+        s_lb_row = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_lut = *cfg->lut;
+    s_filter_req = cfg->filter;
+    s_ring_bytes = ring_bytes;
+    s_ready = true;
+
+    update_working_set();
+
+    ESP_LOGI(TAG, "Fused preprocess %dx%d → letterbox %dx%d (scaled %dx%d, filter %d), crop %d, rgb565_compat=%d",
+             cfg->src_w, cfg->src_h, cfg->dst_w, cfg->dst_h,
+             s_lb.x.n, s_lb.y.n, (int)cfg->filter, crop_n, (int)cfg->rgb565_compat);
+    ESP_LOGI(TAG, "Working set %u bytes internal RAM (%d-row ring %u bytes)",
+             (unsigned)s_working_set, PREPROC_RING_ROWS, (unsigned)ring_bytes);
+
+    return ESP_OK;
+}
+
+size_t preproc_working_set_bytes(void)
+{
+    return s_working_set;
+}
+
+esp_err_t preproc_set_filter(resample_filter_t filter)
+{
+    if (filter > RESAMPLE_AREA) return ESP_ERR_INVALID_ARG;
+
+    s_filter_req = filter;
+    return ESP_OK;
+}
+
+// Rebuild the letterbox tables for a newly requested filter (between frames;
+// the old ones stay if the new ones do not fit)
+static void apply_filter_request(void)
+{
+    const resample_filter_t filter = s_filter_req;
+    if (filter == s_lb.filter) return;
+
+    resampler_t next;
+    esp_err_t err = resampler_init(&next, s_cfg.src_w, s_cfg.src_h, s_cfg.dst_w, s_cfg.dst_h,
+                                   filter, RESAMPLE_LETTERBOX);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Letterbox filter %d unavailable (%s), keeping %d",
+                 (int)filter, esp_err_to_name(err), (int)s_lb.filter);
+        s_filter_req = s_lb.filter;
+        return;
+    }
+
+    resampler_deinit(&s_lb);
+    s_lb = next;
+    update_working_set();
+
+    ESP_LOGI(TAG, "Letterbox filter %d, working set %u bytes", (int)filter, (unsigned)s_working_set);
+}
+
+// -----------------------------------------------------------------------------
+// Row emitters: one destination row from one ring row (or filtered row)
+// -----------------------------------------------------------------------------
+static inline uint8_t *ring_row(const preproc_session_t *ss, int sy)
+{
+    return s_ring + (size_t)(sy % ss->ring_rows) * s_cfg.src_w * 3;
+}
+
+// xmap: source column of each pixel in src (nearest); nullptr: src already
+// holds the x.n scaled pixels
+static void emit_letterbox_row(preproc_session_t *ss, int y, const uint8_t *src, const int16_t *xmap)
+{
+    const int dy     = s_lb.y.off + y;
+    const int stride = s_cfg.dst_w * 3;
+
+    int8_t  *q = ss->dst_i8 + dy * stride;
+    uint8_t *c = ss->dst_rgb ? ss->dst_rgb + dy * stride : nullptr;
+
+    // Left / right bars
+    const int right = s_lb.x.off + s_lb.x.n;
+    quant_lut_fill_pad(&s_lut, q, s_lb.x.off);
+    quant_lut_fill_pad(&s_lut, q + right * 3, s_cfg.dst_w - right);
+    if (c) {
+        memset(c, 0, s_lb.x.off * 3);
+        memset(c + right * 3, 0, (s_cfg.dst_w - right) * 3);
+    }
+
+    q += s_lb.x.off * 3;
+    if (c) c += s_lb.x.off * 3;
+
+    for (int x = 0; x < s_lb.x.n; x++) {
+        const uint8_t *p = src + (xmap ? xmap[x] : x) * 3;
+        uint8_t r = p[0], g = p[1], b = p[2];
+
+        if (s_cfg.rgb565_compat) {
+            // 8 → 5/6/5 → 8 bit replication, as an RGB565 decode + expand
+            r = (r & 0xF8) | (r >> 5);
+            g = (g & 0xFC) | (g >> 6);
+            b = (b & 0xF8) | (b >> 5);
+        }
+
+        q[0] = s_lut.ch[0][r];
+        q[1] = s_lut.ch[1][g];
+        q[2] = s_lut.ch[2][b];
+        q += 3;
+
+        if (c) {
+            c[0] = r; c[1] = g; c[2] = b;
+            c += 3;
+        }
+    }
+}
+
+static void emit_crop_row(preproc_session_t *ss, int y)
+{
+    uint8_t *c = ss->dst_crop + y * s_crop.x.n * 3;
+    const uint8_t *src = ring_row(ss, s_crop.y.first[y]);
+
+    for (int x = 0; x < s_crop.x.n; x++) {
+        const uint8_t *p = src + s_crop.x.first[x] * 3;
+        c[0] = p[0]; c[1] = p[1]; c[2] = p[2];
+        c += 3;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Decoder output
+// -----------------------------------------------------------------------------
+static bool preproc_out_cb(void *user, const uint8_t *in, const JRECT *rect)
+{
+    preproc_session_t *ss = (preproc_session_t *)user;
+
+    // MCU block → ring
+    const int bw = rect->right - rect->left + 1;
+
+    for (int sy = rect->top; sy <= rect->bottom; sy++) {
+        uint8_t *row = ring_row(ss, sy) + rect->left * 3;
+        memcpy(row, in, bw * 3);
+        in += bw * 3;
+    }
+
+    // Band not complete yet
+    if (rect->right < s_cfg.src_w - 1) return true;
+
+    // Every destination row sampling this band can be produced now
+    const int last = rect->bottom;
+
+    if (s_lb.filter == RESAMPLE_NEAREST) {
+        while (ss->lb_row < s_lb.y.n && s_lb.y.first[ss->lb_row] <= last) {
+            const int y = ss->lb_row++;
+            emit_letterbox_row(ss, y, ring_row(ss, s_lb.y.first[y]), s_lb.x.first);
+        }
+    } else {
+        // Every band row through the horizontal filter; a letterbox row is
+        // done once its last source row is in
+        for (int sy = rect->top; sy <= last; sy++) {
+            resampler_push_row(&s_lb, sy, ring_row(ss, sy));
+
+            while (ss->lb_row < s_lb.y.n && resampler_last_src_row(&s_lb, ss->lb_row) <= sy) {
+                const int y = ss->lb_row++;
+                resampler_emit_row(&s_lb, y, s_lb_row);
+                emit_letterbox_row(ss, y, s_lb_row, nullptr);
+            }
+        }
+    }
+
+    if (ss->dst_crop) {
+        while (ss->crop_row < s_crop.y.n && s_crop.y.first[ss->crop_row] <= last) {
+            emit_crop_row(ss, ss->crop_row++);
+        }
+    }
+
+    return true;    // continue decoding
+}
+
+// -----------------------------------------------------------------------------
+// Public: JPEG → model input
+// -----------------------------------------------------------------------------
+esp_err_t preproc_jpeg_to_input(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    int8_t *dst_i8,
+    uint8_t *dst_rgb,
+    uint8_t *dst_crop)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+    if (!jpeg || jpeg_len == 0 || !dst_i8) return ESP_ERR_INVALID_ARG;
+    if (dst_crop && !s_cfg.crop_size) return ESP_ERR_INVALID_ARG;
+
+    preproc_session_t ss = {};
+    ss.dst_i8   = dst_i8;
+    ss.dst_rgb  = dst_rgb;
+    ss.dst_crop = dst_crop;
+
+    esp_err_t err = jpeg_dec_open(&s_dec, jpeg, jpeg_len);
+    if (err != ESP_OK) return err;
+
+    if (s_dec.width != s_cfg.src_w || s_dec.height != s_cfg.src_h) {
+        ESP_LOGE(TAG, "Unexpected JPEG size %dx%d (expected %dx%d)",
+                 s_dec.width, s_dec.height, s_cfg.src_w, s_cfg.src_h);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    apply_filter_request();
+    if (s_lb.filter != RESAMPLE_NEAREST) resampler_stream_begin(&s_lb);
+
+    ss.ring_rows = s_dec.mcu_h;
+    if (ss.ring_rows > PREPROC_RING_ROWS) {
+        ESP_LOGE(TAG, "MCU height %d exceeds row ring", ss.ring_rows);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // Top / bottom bars; image rows are written whole as bands complete
+    const size_t row_px = s_cfg.dst_w;
+    const size_t top    = (size_t)s_lb.y.off * row_px;
+    const size_t bottom = (size_t)(s_cfg.dst_h - s_lb.y.off - s_lb.y.n) * row_px;
+    const size_t tail   = (size_t)(s_lb.y.off + s_lb.y.n) * row_px;
+
+    quant_lut_fill_pad(&s_lut, dst_i8, top);
+    quant_lut_fill_pad(&s_lut, dst_i8 + tail * 3, bottom);
+    if (dst_rgb) {
+        memset(dst_rgb, 0, top * 3);
+        memset(dst_rgb + tail * 3, 0, bottom * 3);
+    }
+
+    err = jpeg_dec_run(&s_dec, 0, preproc_out_cb, &ss);
+    if (err != ESP_OK) return err;
+
+    if (ss.lb_row != s_lb.y.n || (dst_crop && ss.crop_row != s_crop.y.n)) {
+        ESP_LOGE(TAG, "Incomplete output (%d/%d rows)", ss.lb_row, s_lb.y.n);
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// A/B comparison helper
+// -----------------------------------------------------------------------------
+int preproc_compare_i8(
+    const char *label,
+    const int8_t *a,
+    const int8_t *b,
+    int n)
+{
+    int mismatches = 0;
+    int max_delta  = 0;
+    int first      = -1;
+
+    for (int i = 0; i < n; i++) {
+        int d = abs((int)a[i] - (int)b[i]);
+        if (d) {
+            if (first < 0) first = i;
+            mismatches++;
+            if (d > max_delta) max_delta = d;
+        }
+    }
+
+    if (mismatches == 0) {
+        ESP_LOGI(TAG, "%s: bit-exact (%d values)", label, n);
+    } else {
+        ESP_LOGW(TAG, "%s: %d / %d values differ (max |delta|=%d, first at %d)",
+                 label, mismatches, n, max_delta, first);
+    }
+
+    return mismatches;
+}
@@ -0,0 +1,78 @@
+// File: main/preproc.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "quant_lut.h"
+#include "resample.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Fused JPEG decode → letterbox / center-crop resize → int8 quantize
+//
+// Streams the decode: MCU blocks land in a ring holding one MCU band (8 or 16
+// source rows). When a band is complete, every destination row that samples
+// it is produced in order (same resampler geometry as the ppm.cpp resizers):
+// quantized letterbox rows for the model input, plus optional RGB888
+// letterbox and center-crop rows for auditing. The letterbox filter is
+// selectable (nearest, or area / bilinear: ring rows are filtered
+// horizontally as they complete and a letterbox row is emitted once its last
+// source row is in); the crop is nearest. No full-frame buffer is
+// created; ring, maps, LUT and decoder scratch (~30 KB for QVGA) all live in
+// internal RAM.
+// -----------------------------------------------------------------------------
+typedef struct {
+    int   src_w;            // expected JPEG size
+    int   src_h;
+    int   dst_w;            // model input size
+    int   dst_h;
+
+    int   crop_size;        // center-crop output (square), 0: none
+
+    resample_filter_t filter;   // letterbox (model input) filter
+
+    const quant_lut_t *lut; // input quantizer (copied at init)
+
+    // Truncate to RGB565 precision (8 → 5/6/5 → 8), for comparing against
+    // a decode that went through RGB565 (filtered letterbox: applied to the
+    // filtered pixels)
+    bool  rgb565_compat;
+} preproc_cfg_t;
+
+esp_err_t preproc_init(const preproc_cfg_t *cfg);
+
+// dst_i8:   dst_w × dst_h × 3 int8 (e.g. g_input_tensor->data.int8)
+// dst_rgb:  optional dst_w × dst_h × 3 RGB888 copy of the letterbox (audit)
+// dst_crop: optional crop_size² × 3 RGB888 center crop (audit)
+esp_err_t preproc_jpeg_to_input(
+    const uint8_t *jpeg,
+    size_t jpeg_len,
+    int8_t *dst_i8,
+    uint8_t *dst_rgb,
+    uint8_t *dst_crop
+);
+
+// Letterbox filter for the following frames (tables rebuilt before the next
+// frame; the current filter stays if the new tables cannot be allocated)
+esp_err_t preproc_set_filter(resample_filter_t filter);
+
+// Internal RAM used by the streaming path (ring, maps, LUT, decoder scratch)
+size_t preproc_working_set_bytes(void);
+
+// Compare two int8 inputs; logs mismatch count / max delta, returns mismatches
+int preproc_compare_i8(
+    const char *label,
+    const int8_t *a,
+    const int8_t *b,
+    int n
+);
+
+#ifdef __cplusplus
+}
+#endif
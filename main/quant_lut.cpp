@@ -0,0 +1,265 @@
+// File: main/quant_lut.cpp
+
+#include "quant_lut.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "QLUT";
+
+// -----------------------------------------------------------------------------
+// Build
+// -----------------------------------------------------------------------------
+void quant_lut_default_cfg(quant_lut_cfg_t *cfg, float scale, int zero_point)
+{
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->scale      = scale;
+    cfg->zero_point = zero_point;
+    cfg->gamma      = 1.0f;
+
+    for (int c = 0; c < 3; c++) {
+        cfg->mean[c] = 0.0f;
+        cfg->std[c]  = 1.0f;
+    }
+}
+
+static int8_t quantize_f(float x, float scale, int zero_point)
+{
+    int q = (int)roundf(x / scale) + zero_point;
+    if (q < -128) q = -128;
+    if (q > 127)  q = 127;
+    return (int8_t)q;
+}
+
+esp_err_t quant_lut_build(quant_lut_t *lut, const quant_lut_cfg_t *cfg)
+{
+    if (!lut || !cfg || cfg->scale <= 0.0f) return ESP_ERR_INVALID_ARG;
+
+    const bool use_gamma = cfg->gamma > 0.0f && cfg->gamma != 1.0f;
+
+    if (cfg->normalize) {
+        for (int c = 0; c < 3; c++) {
+            if (cfg->std[c] <= 0.0f) return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    for (int c = 0; c < 3; c++) {
+        for (int v = 0; v < 256; v++) {
+
+            int u = v;
+            if (cfg->contrast) {
+                u = (u - 128) * 11 / 10 + 128;
+                if (u < 0)   u = 0;
+                if (u > 255) u = 255;
+            }
+
+            if (!use_gamma && !cfg->normalize) {
+                // Same expression as the per-pixel path → bit-exact
+                lut->ch[c][v] = quantize_u8_to_int8((uint8_t)u, cfg->scale, cfg->zero_point);
+                continue;
+            }
+
+            float x = (float)u;
+            if (use_gamma) {
+                x = 255.0f * powf(x / 255.0f, 1.0f / cfg->gamma);
+            }
+            if (cfg->normalize) {
+                x = (x / 255.0f - cfg->mean[c]) / cfg->std[c];
+            }
+
+            lut->ch[c][v] = quantize_f(x, cfg->scale, cfg->zero_point);
+        }
+    }
+
+    lut->uniform = memcmp(lut->ch[0], lut->ch[1], 256) == 0 &&
+                   memcmp(lut->ch[0], lut->ch[2], 256) == 0;
+    lut->folded  = cfg->contrast || use_gamma || cfg->normalize;
+
+    ESP_LOGI(TAG, "Input LUT: scale=%.6f zp=%d contrast=%d gamma=%.2f normalize=%d uniform=%d (q[0]=%d q[255]=%d)",
+             (double)cfg->scale, cfg->zero_point,
+             (int)cfg->contrast, (double)(use_gamma ? cfg->gamma : 1.0f),
+             (int)cfg->normalize, (int)lut->uniform,
+             (int)lut->ch[0][0], (int)lut->ch[0][255]);
+
+    return ESP_OK;
+}
+
+// -----------------------------------------------------------------------------
+// Apply
+//
+// No byte-gather instruction exists on the S3, so the hot loop is an unrolled
+// table gather that assembles results in registers and stores whole words:
+// 4 values per store for uniform tables, 4 pixels (3 words) otherwise.
+// Word access needs 4-byte aligned src/dst (frame arena buffers are 16-byte
+// aligned); anything else goes through the byte loop.
+// -----------------------------------------------------------------------------
+static inline uint32_t pack4(int8_t a, int8_t b, int8_t c, int8_t d)
+{
+    return  (uint32_t)(uint8_t)a        |
+           ((uint32_t)(uint8_t)b << 8)  |
+           ((uint32_t)(uint8_t)c << 16) |
+           ((uint32_t)(uint8_t)d << 24);
+}
+
+static void apply_uniform(const int8_t *t, const uint8_t *src, int8_t *dst, size_t n)
+{
+    size_t i = 0;
+
+    if ((((uintptr_t)src | (uintptr_t)dst) & 3) == 0) {
+        const uint32_t *s32 = (const uint32_t *)src;
+        uint32_t       *d32 = (uint32_t *)dst;
+
+        for (; i + 8 <= n; i += 8) {
+            const uint32_t a = s32[0];
+            const uint32_t b = s32[1];
+
+            d32[0] = pack4(t[a & 0xFF], t[(a >> 8) & 0xFF], t[(a >> 16) & 0xFF], t[a >> 24]);
+            d32[1] = pack4(t[b & 0xFF], t[(b >> 8) & 0xFF], t[(b >> 16) & 0xFF], t[b >> 24]);
+
+            s32 += 2;
+            d32 += 2;
+        }
+    }
+
+    for (; i < n; i++) {
+        dst[i] = t[src[i]];
+    }
+}
+
+static void apply_per_channel(const quant_lut_t *lut, const uint8_t *src, int8_t *dst, size_t pixels)
+{
+    const int8_t *tr = lut->ch[0];
+    const int8_t *tg = lut->ch[1];
+    const int8_t *tb = lut->ch[2];
+
+    size_t p = 0;
+
+    if ((((uintptr_t)src | (uintptr_t)dst) & 3) == 0) {
+        const uint32_t *s32 = (const uint32_t *)src;
+        uint32_t       *d32 = (uint32_t *)dst;
+
+        // 4 pixels = 12 bytes = 3 words: RGBR GBRG BRGB
+        for (; p + 4 <= pixels; p += 4) {
+            const uint32_t a = s32[0];
+            const uint32_t b = s32[1];
+            const uint32_t c = s32[2];
+
+            d32[0] = pack4(tr[a & 0xFF], tg[(a >> 8) & 0xFF], tb[(a >> 16) & 0xFF], tr[a >> 24]);
+            d32[1] = pack4(tg[b & 0xFF], tb[(b >> 8) & 0xFF], tr[(b >> 16) & 0xFF], tg[b >> 24]);
+            d32[2] = pack4(tb[c & 0xFF], tr[(c >> 8) & 0xFF], tg[(c >> 16) & 0xFF], tb[c >> 24]);
+
+            s32 += 3;
+            d32 += 3;
+        }
+    }
+
+    for (; p < pixels; p++) {
+        dst[p * 3 + 0] = tr[src[p * 3 + 0]];
+        dst[p * 3 + 1] = tg[src[p * 3 + 1]];
+        dst[p * 3 + 2] = tb[src[p * 3 + 2]];
+    }
+}
+
+void quant_lut_apply_rgb(
+    const quant_lut_t *lut,
+    const uint8_t *src,
+    int8_t *dst,
+    size_t pixels)
+{
+    if (lut->uniform) {
+        apply_uniform(lut->ch[0], src, dst, pixels * 3);
+    } else {
+        apply_per_channel(lut, src, dst, pixels);
+    }
+}
+
+void quant_lut_fill_pad(const quant_lut_t *lut, int8_t *dst, size_t pixels)
+{
+    if (lut->uniform) {
+        memset(dst, quant_lut_pad(lut, 0), pixels * 3);
+        return;
+    }
+
+    const int8_t r = quant_lut_pad(lut, 0);
+    const int8_t g = quant_lut_pad(lut, 1);
+    const int8_t b = quant_lut_pad(lut, 2);
+
+    for (size_t p = 0; p < pixels; p++) {
+        dst[p * 3 + 0] = r;
+        dst[p * 3 + 1] = g;
+        dst[p * 3 + 2] = b;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark
+// -----------------------------------------------------------------------------
+esp_err_t quant_lut_benchmark(const quant_lut_t *lut, const quant_lut_cfg_t *cfg,
+                              size_t pixels, int iterations)
+{
+    if (!lut || !cfg || pixels == 0 || iterations <= 0) return ESP_ERR_INVALID_ARG;
+
+    const size_t n = pixels * 3;
+
+    uint8_t *src   = (uint8_t *)heap_caps_aligned_alloc(16, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int8_t  *d_ref = (int8_t *)heap_caps_aligned_alloc(16, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    int8_t  *d_lut = (int8_t *)heap_caps_aligned_alloc(16, n, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+
+    if (!src || !d_ref || !d_lut) {
+        heap_caps_free(src);
+        heap_caps_free(d_ref);
+        heap_caps_free(d_lut);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Deterministic pseudo-random pixels covering all 256 values
+    uint32_t x = 0x12345678u;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1664525u + 1013904223u;
+        src[i] = (uint8_t)(x >> 24);
+    }
+
+    int64_t t_ref = 0;
+    int64_t t_lut = 0;
+
+    for (int it = 0; it < iterations; it++) {
+
+        int64_t t0 = esp_timer_get_time();
+        for (size_t i = 0; i < n; i++) {
+            d_ref[i] = quantize_u8_to_int8(src[i], cfg->scale, cfg->zero_point);
+        }
+        int64_t t1 = esp_timer_get_time();
+        quant_lut_apply_rgb(lut, src, d_lut, pixels);
+        int64_t t2 = esp_timer_get_time();
+
+        t_ref += t1 - t0;
+        t_lut += t2 - t1;
+    }
+
+    t_ref /= iterations;
+    t_lut /= iterations;
+
+    ESP_LOGI(TAG, "Benchmark %u values x %d: per-value roundf %lld us, LUT %lld us (x%.1f)",
+             (unsigned)n, iterations,
+             (long long)t_ref, (long long)t_lut,
+             t_lut > 0 ? (double)t_ref / (double)t_lut : 0.0);
+
+    if (!lut->folded) {
+        if (memcmp(d_ref, d_lut, n) == 0) {
+            ESP_LOGI(TAG, "Benchmark: LUT output bit-exact");
+        } else {
+            ESP_LOGE(TAG, "Benchmark: LUT output differs from reference");
+        }
+    }
+
+    heap_caps_free(src);
+    heap_caps_free(d_ref);
+    heap_caps_free(d_lut);
+
+    return ESP_OK;
+}
@@ -0,0 +1,91 @@
+// File: main/quant_lut.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Reference quantizer (u8 pixel → int8 tensor value)
+// -----------------------------------------------------------------------------
+static inline int8_t quantize_u8_to_int8(uint8_t v, float scale, int zero_point)
+{
+    int q = (int)roundf(v / scale) + zero_point;
+    if (q < -128) q = -128;
+    if (q > 127)  q = 127;
+    return (int8_t)q;
+}
+
+// -----------------------------------------------------------------------------
+// Table-driven input quantizer
+//
+// The input tensor's scale / zero_point are fixed after AllocateTensors() and
+// a pixel only has 256 values, so the whole u8 → int8 mapping (plus optional
+// contrast, gamma and per-channel normalization) is evaluated once into one
+// 256-entry table per channel. Per frame only table lookups remain.
+//
+// Folding order per value v:
+//   contrast  : v = clamp((v - 128) * 11 / 10 + 128)   (improve_rgb888_contrast)
+//   gamma     : x = 255 * (v / 255)^(1 / gamma)
+//   normalize : x = (x / 255 - mean[c]) / std[c]
+//   quantize  : q = clamp(round(x / scale) + zero_point)
+// With every option off the tables equal quantize_u8_to_int8() bit-exactly.
+// -----------------------------------------------------------------------------
+typedef struct {
+    float scale;            // input tensor quant params
+    int   zero_point;
+
+    bool  contrast;         // fold improve_rgb888_contrast()
+    float gamma;            // <= 0 or 1.0: off
+
+    bool  normalize;        // fold (x/255 - mean) / std per channel
+    float mean[3];
+    float std[3];
+} quant_lut_cfg_t;
+
+typedef struct {
+    int8_t ch[3][256];      // R, G, B
+    bool   uniform;         // all channels share one table (byte-wise apply)
+    bool   folded;          // anything beyond plain quantization folded in
+} quant_lut_t;
+
+// Plain quantization config (no folding) from tensor params
+void quant_lut_default_cfg(quant_lut_cfg_t *cfg, float scale, int zero_point);
+
+esp_err_t quant_lut_build(quant_lut_t *lut, const quant_lut_cfg_t *cfg);
+
+// Quantized value of a black pixel for channel c (letterbox padding)
+static inline int8_t quant_lut_pad(const quant_lut_t *lut, int c)
+{
+    return lut->ch[c][0];
+}
+
+// Interleaved RGB888 → int8, pixels × 3 values. src and dst may alias.
+void quant_lut_apply_rgb(
+    const quant_lut_t *lut,
+    const uint8_t *src,
+    int8_t *dst,
+    size_t pixels
+);
+
+// Fill pixels × 3 values with the quantized black pixel
+void quant_lut_fill_pad(const quant_lut_t *lut, int8_t *dst, size_t pixels);
+
+// -----------------------------------------------------------------------------
+// Benchmark: per-value quantize_u8_to_int8() loop vs LUT apply on a
+// pixels-sized synthetic image (heap buffers, init-time only). Logs timings
+// and, for unfolded tables, verifies both outputs are identical.
+// -----------------------------------------------------------------------------
+esp_err_t quant_lut_benchmark(const quant_lut_t *lut, const quant_lut_cfg_t *cfg,
+                              size_t pixels, int iterations);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,463 @@
+// File: main/recorder.cpp
+
+#include "recorder.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "RECORDER";
+
+// -----------------------------------------------------------------------------
+// Ring
+// -----------------------------------------------------------------------------
+typedef enum {
+    ENT_FREE = 0,
+    ENT_FILLING,            // being copied in by recorder_push
+    ENT_HELD,               // pre-roll, overwritten unless a trigger marks it
+    ENT_PENDING,            // marked for the sink
+    ENT_WRITING,            // in the sink
+} ent_state_t;
+
+typedef struct {
+    ent_state_t state;
+    uint32_t    seq;
+    int64_t     t_capture_us;
+    size_t      jpeg_len;
+    int         rgb;        // RGB buffer index, -1: none
+    uint8_t    *jpeg;       // jpeg_cap
+} rec_entry_t;
+
+#define RGB_FREE    (-1)
+#define RGB_FILLING (-2)
+
+static recorder_cfg_t   s_cfg;
+static bool             s_ready = false;
+
+static uint8_t         *s_mem = nullptr;        // PSRAM, all JPEG + RGB buffers
+static rec_entry_t     *s_ent = nullptr;
+static int             *s_rgb_owner = nullptr;  // entry index / RGB_FREE / RGB_FILLING
+static uint8_t         *s_rgb_mem = nullptr;    // rgb_frames × s_rgb_bytes
+static size_t           s_rgb_bytes = 0;
+
+static portMUX_TYPE     s_mux = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t     s_task = nullptr;
+static uint32_t         s_last_det_seq = UINT32_MAX;
+
+// Trigger window (s_mux)
+static bool             s_marking = false;
+static uint32_t         s_mark_from = 0;
+static uint32_t         s_mark_until = 0;
+static uint32_t         s_last_seq = 0;         // newest pushed frame
+
+// Counters (s_mux)
+static recorder_stats_t s_st;
+
+// Sequence numbers wrap: compare by difference
+static bool seq_in(uint32_t seq, uint32_t lo, uint32_t hi)
+{
+    return (int32_t)(seq - lo) >= 0 && (int32_t)(hi - seq) >= 0;
+}
+
+// HELD, or PENDING if the window covers it; caller holds s_mux
+static bool settle_locked(rec_entry_t *e)
+{
+    if (s_marking && seq_in(e->seq, s_mark_from, s_mark_until)) {
+        e->state = ENT_PENDING;
+        s_st.pending++;
+        return true;
+    }
+    e->state = ENT_HELD;
+    return false;
+}
+
+static void drop_rgb_locked(rec_entry_t *e)
+{
+    if (e->rgb >= 0) s_rgb_owner[e->rgb] = RGB_FREE;
+    e->rgb = -1;
+}
+
+// Mark [seq - preroll, seq + post_frames]; caller holds s_mux
+static void mark_locked(uint32_t seq, uint32_t post_frames)
+{
+    const uint32_t lo = seq - std::min(seq, (uint32_t)s_cfg.preroll_frames);
+    const uint32_t hi = seq + post_frames;
+
+    // Oldest frame in the ring: window frames before it are gone
+    bool     any    = false;
+    uint32_t oldest = 0;
+    for (int i = 0; i < s_cfg.ring_frames; i++) {
+        rec_entry_t *e = &s_ent[i];
+        if (e->state == ENT_FREE || e->state == ENT_FILLING) continue;
+
+        if (!any || (int32_t)(e->seq - oldest) < 0) oldest = e->seq;
+        any = true;
+
+        if (e->state == ENT_HELD && seq_in(e->seq, lo, hi)) {
+            e->state = ENT_PENDING;
+            s_st.pending++;
+        }
+    }
+
+    // Only count what an earlier window did not already cover
+    const uint32_t first = (s_marking && (int32_t)(s_mark_until - lo) >= 0) ? s_mark_until + 1 : lo;
+    if (any && (int32_t)(oldest - first) > 0) {
+        const uint32_t missed = std::min({ oldest, s_last_seq + 1, hi + 1 }) - first;
+        if ((int32_t)missed > 0) s_st.preroll_missed += missed;
+    }
+
+    if (s_marking) {
+        if ((int32_t)(lo - s_mark_from) < 0) s_mark_from = lo;
+        if ((int32_t)(hi - s_mark_until) > 0) s_mark_until = hi;
+    } else {
+        s_marking    = true;
+        s_mark_from  = lo;
+        s_mark_until = hi;
+    }
+}
+
+// Oldest marked entry, or nullptr; caller holds s_mux
+static rec_entry_t *oldest_pending_locked(void)
+{
+    rec_entry_t *best = nullptr;
+
+    for (int i = 0; i < s_cfg.ring_frames; i++) {
+        rec_entry_t *e = &s_ent[i];
+        if (e->state == ENT_PENDING && (!best || (int32_t)(e->seq - best->seq) < 0)) {
+            best = e;
+        }
+    }
+    return best;
+}
+
+// Held or marked entry for seq, or nullptr; caller holds s_mux
+static rec_entry_t *find_locked(uint32_t seq)
+{
+    for (int i = 0; i < s_cfg.ring_frames; i++) {
+        rec_entry_t *e = &s_ent[i];
+        if ((e->state == ENT_HELD || e->state == ENT_PENDING) && e->seq == seq) return e;
+    }
+    return nullptr;
+}
+
+// Entry for an incoming frame: a free one, else the oldest held one, nullptr
+// if every entry is marked or in use; caller holds s_mux
+static rec_entry_t *claim_locked(void)
+{
+    rec_entry_t *oldest = nullptr;
+
+    for (int i = 0; i < s_cfg.ring_frames; i++) {
+        rec_entry_t *e = &s_ent[i];
+        if (e->state == ENT_FREE) return e;
+        if (e->state == ENT_HELD && (!oldest || (int32_t)(e->seq - oldest->seq) < 0)) oldest = e;
+    }
+    return oldest;
+}
+
+// Free RGB buffer, else the one of the oldest held entry; caller holds s_mux
+static int take_rgb_locked(void)
+{
+    for (int b = 0; b < s_cfg.rgb_frames; b++) {
+        if (s_rgb_owner[b] == RGB_FREE) return b;
+    }
+
+    rec_entry_t *victim = nullptr;
+    for (int i = 0; i < s_cfg.ring_frames; i++) {
+        rec_entry_t *e = &s_ent[i];
+        if (e->state == ENT_HELD && e->rgb >= 0 && (!victim || (int32_t)(e->seq - victim->seq) < 0)) {
+            victim = e;
+        }
+    }
+    if (!victim) return -1;
+
+    const int b = victim->rgb;
+    drop_rgb_locked(victim);
+    return b;
+}
+
+// -----------------------------------------------------------------------------
+// Writer task
+// -----------------------------------------------------------------------------
+static void recorder_task(void *pv)
+{
+    ESP_LOGI(TAG, "Recorder started on core %d", xPortGetCoreID());
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (true) {
+            portENTER_CRITICAL(&s_mux);
+            rec_entry_t *e = oldest_pending_locked();
+            if (e) e->state = ENT_WRITING;
+            portEXIT_CRITICAL(&s_mux);
+
+            if (!e) break;
+
+            recorder_frame_t f = {};
+            f.seq          = e->seq;
+            f.t_capture_us = e->t_capture_us;
+            f.jpeg         = e->jpeg;
+            f.jpeg_len     = e->jpeg_len;
+            f.rgb          = e->rgb >= 0 ? s_rgb_mem + e->rgb * s_rgb_bytes : nullptr;
+            f.rgb_w        = s_cfg.rgb_w;
+            f.rgb_h        = s_cfg.rgb_h;
+
+            const esp_err_t err = s_cfg.sink(&f);
+
+            portENTER_CRITICAL(&s_mux);
+            if (err == ESP_OK) {
+                s_st.frames_written++;
+                s_st.bytes_written += e->jpeg_len + (e->rgb >= 0 ? s_rgb_bytes : 0);
+            } else {
+                s_st.sink_errors++;
+            }
+            drop_rgb_locked(e);
+            e->state = ENT_FREE;
+            s_st.pending--;
+            portEXIT_CRITICAL(&s_mux);
+        }
+    }
+}
+
+static void free_buffers(void)
+{
+    heap_caps_free(s_mem);
+    heap_caps_free(s_ent);
+    heap_caps_free(s_rgb_owner);
+    s_mem       = nullptr;
+    s_ent       = nullptr;
+    s_rgb_owner = nullptr;
+    s_rgb_mem   = nullptr;
+    s_task      = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t recorder_init(const recorder_cfg_t *cfg)
+{
+    if (!cfg || !cfg->sink || cfg->preroll_frames < 0 || cfg->postroll_frames < 0 ||
+        cfg->ring_frames <= cfg->preroll_frames || cfg->jpeg_cap == 0 ||
+        cfg->rgb_frames < 0 || (cfg->rgb_frames > 0 && (cfg->rgb_w <= 0 || cfg->rgb_h <= 0)) ||
+        (cfg->num_class_rules > 0 && !cfg->class_rules)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_ready) {
+        ESP_LOGW(TAG, "Recorder already initialized");
+        return ESP_OK;
+    }
+
+    s_cfg       = *cfg;
+    s_rgb_bytes = cfg->rgb_frames ? (size_t)cfg->rgb_w * cfg->rgb_h * 3 : 0;
+
+    const size_t jpeg_stride = (cfg->jpeg_cap + 15) & ~(size_t)15;
+    const size_t psram = jpeg_stride * cfg->ring_frames + s_rgb_bytes * cfg->rgb_frames;
+
+    s_mem       = (uint8_t *)heap_caps_malloc(psram, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_ent       = (rec_entry_t *)heap_caps_calloc(cfg->ring_frames, sizeof(rec_entry_t), MALLOC_CAP_INTERNAL);
+    s_rgb_owner = (int *)heap_caps_calloc(std::max(cfg->rgb_frames, 1), sizeof(int), MALLOC_CAP_INTERNAL);
+
+    if (!s_mem || !s_ent || !s_rgb_owner) {
+        ESP_LOGE(TAG, "Recorder alloc failed (%u KB PSRAM)", (unsigned)(psram / 1024));
+        free_buffers();
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (int i = 0; i < cfg->ring_frames; i++) {
+        s_ent[i].jpeg = s_mem + jpeg_stride * i;
+        s_ent[i].rgb  = -1;
+    }
+    s_rgb_mem = s_mem + jpeg_stride * cfg->ring_frames;
+    for (int b = 0; b < cfg->rgb_frames; b++) s_rgb_owner[b] = RGB_FREE;
+
+    memset(&s_st, 0, sizeof(s_st));
+
+    if (xTaskCreatePinnedToCore(recorder_task, "RECORDER", 4096, nullptr,
+                                cfg->priority, &s_task, cfg->core) != pdPASS) {
+        ESP_LOGE(TAG, "Recorder task create failed");
+        free_buffers();
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_ready = true;
+
+    ESP_LOGI(TAG, "Recorder: %d-frame ring, %d pre-roll + %d post-roll frames, %d RGB buffers, %u KB PSRAM, triggers%s%s%s, %d class rules",
+             cfg->ring_frames, cfg->preroll_frames, cfg->postroll_frames, cfg->rgb_frames,
+             (unsigned)(psram / 1024),
+             (cfg->triggers & REC_TRIGGER_DETECTION) ? " detection" : "",
+             (cfg->triggers & REC_TRIGGER_MOTION) ? " motion" : "",
+             (cfg->triggers & REC_TRIGGER_MANUAL) ? " manual" : "",
+             cfg->num_class_rules);
+
+    return ESP_OK;
+}
+
+bool recorder_ready(void)
+{
+    return s_ready;
+}
+
+void recorder_push(const recorder_frame_t *frame)
+{
+    if (!s_ready || !frame) return;
+
+    // Overwrite the oldest pre-roll frame; marked frames are skipped
+    portENTER_CRITICAL(&s_mux);
+    rec_entry_t *e = claim_locked();
+
+    s_st.frames_seen++;
+    s_st.bytes_seen += frame->jpeg_len;
+
+    // Past the window: nothing more to mark
+    s_last_seq = frame->seq;
+    if (s_marking && (int32_t)(frame->seq - s_mark_until) > 0) s_marking = false;
+
+    if (!e || frame->jpeg_len > s_cfg.jpeg_cap) {
+        s_st.overruns++;
+        portEXIT_CRITICAL(&s_mux);
+        return;
+    }
+
+    if (e->state == ENT_HELD) s_st.frames_discarded++;
+    drop_rgb_locked(e);
+    e->state = ENT_FILLING;
+    portEXIT_CRITICAL(&s_mux);
+
+    memcpy(e->jpeg, frame->jpeg, frame->jpeg_len);
+
+    portENTER_CRITICAL(&s_mux);
+    e->seq          = frame->seq;
+    e->t_capture_us = frame->t_capture_us;
+    e->jpeg_len     = frame->jpeg_len;
+    const bool post = settle_locked(e);
+    portEXIT_CRITICAL(&s_mux);
+
+    if (frame->rgb && frame->rgb_w == s_cfg.rgb_w && frame->rgb_h == s_cfg.rgb_h) {
+        recorder_attach_rgb(frame->seq, frame->rgb);
+    }
+
+    if (post) xTaskNotifyGive(s_task);
+}
+
+void recorder_attach_rgb(uint32_t seq, const uint8_t *rgb)
+{
+    if (!s_ready || !rgb || s_rgb_bytes == 0) return;
+
+    portENTER_CRITICAL(&s_mux);
+    rec_entry_t *e = find_locked(seq);
+    const int b = (e && e->rgb < 0) ? take_rgb_locked() : -1;
+    if (b >= 0) s_rgb_owner[b] = RGB_FILLING;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (b < 0) return;
+
+    uint8_t *dst = s_rgb_mem + b * s_rgb_bytes;
+    memcpy(dst, rgb, s_rgb_bytes);
+
+    // The frame may have been written or overwritten meanwhile
+    portENTER_CRITICAL(&s_mux);
+    e = find_locked(seq);
+    if (e && e->rgb < 0) {
+        e->rgb = b;
+        s_rgb_owner[b] = (int)(e - s_ent);
+        s_st.bytes_seen += s_rgb_bytes;
+    } else {
+        s_rgb_owner[b] = RGB_FREE;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void trigger_at(recorder_trigger_t src, uint32_t seq, bool newest, uint32_t post_frames)
+{
+    if (!s_ready || !(s_cfg.triggers & src)) return;
+
+    if (post_frames == 0) post_frames = (uint32_t)s_cfg.postroll_frames;
+
+    portENTER_CRITICAL(&s_mux);
+    if (newest) seq = s_last_seq;
+    const bool     recording = s_marking;
+    const uint32_t missed    = s_st.preroll_missed;
+    mark_locked(seq, post_frames);
+    const uint32_t lost      = s_st.preroll_missed - missed;
+    if (src == REC_TRIGGER_DETECTION) s_st.events_detection++;
+    if (src == REC_TRIGGER_MOTION)    s_st.events_motion++;
+    if (src == REC_TRIGGER_MANUAL)    s_st.events_manual++;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (!recording) {
+        ESP_LOGI(TAG, "Recording: %s trigger at frame %06lu, %d pre-roll + %lu post-roll frames",
+                 src == REC_TRIGGER_DETECTION ? "detection" :
+                 src == REC_TRIGGER_MOTION ? "motion" : "manual",
+                 (unsigned long)seq, s_cfg.preroll_frames, (unsigned long)post_frames);
+    }
+    if (lost) {
+        ESP_LOGW(TAG, "Frame %06lu: %lu frames of its window already overwritten (ring shorter than the trigger latency)",
+                 (unsigned long)seq, (unsigned long)lost);
+    }
+    xTaskNotifyGive(s_task);
+}
+
+void recorder_trigger(recorder_trigger_t src, uint32_t post_frames)
+{
+    trigger_at(src, 0, true, post_frames);
+}
+
+void recorder_on_detection(uint32_t seq, int cls, float score)
+{
+    if (!s_ready || !(s_cfg.triggers & REC_TRIGGER_DETECTION)) return;
+
+    // One trigger per frame
+    if (seq == s_last_det_seq) return;
+
+    const recorder_class_rule_t *rule = nullptr;
+    for (int i = 0; i < s_cfg.num_class_rules; i++) {
+        const recorder_class_rule_t *r = &s_cfg.class_rules[i];
+        if (r->cls == cls) {
+            rule = r;
+            break;
+        }
+        if (r->cls == REC_CLASS_ANY && !rule) rule = r;
+    }
+
+    if (!rule || score < rule->min_score) return;
+
+    s_last_det_seq = seq;
+    ESP_LOGI(TAG, "Frame %06lu: cls=%d score=%.2f triggers recording",
+             (unsigned long)seq, cls, (double)score);
+    trigger_at(REC_TRIGGER_DETECTION, seq, false, 0);
+}
+
+void recorder_get_stats(recorder_stats_t *out)
+{
+    portENTER_CRITICAL(&s_mux);
+    *out = s_st;
+    out->postroll_left = (s_marking && (int32_t)(s_mark_until - s_last_seq) > 0)
+                         ? s_mark_until - s_last_seq : 0;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void recorder_log_stats(void)
+{
+    if (!s_ready) return;
+
+    recorder_stats_t s;
+    recorder_get_stats(&s);
+
+    const uint32_t permille = s.bytes_seen ? (uint32_t)(s.bytes_written * 1000 / s.bytes_seen) : 0;
+
+    ESP_LOGI(TAG, "seen=%lu written=%lu discarded=%lu overruns=%lu missed=%lu sink_err=%lu pending=%lu post=%lu events det=%lu motion=%lu manual=%lu",
+             (unsigned long)s.frames_seen, (unsigned long)s.frames_written,
+             (unsigned long)s.frames_discarded, (unsigned long)s.overruns,
+             (unsigned long)s.preroll_missed,
+             (unsigned long)s.sink_errors, (unsigned long)s.pending,
+             (unsigned long)s.postroll_left, (unsigned long)s.events_detection,
+             (unsigned long)s.events_motion, (unsigned long)s.events_manual);
+    ESP_LOGI(TAG, "SD bytes: %llu KB of %llu KB seen (%lu‰)",
+             (unsigned long long)(s.bytes_written / 1024),
+             (unsigned long long)(s.bytes_seen / 1024), (unsigned long)permille);
+}
@@ -0,0 +1,124 @@
+// File: main/recorder.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Event-triggered recording
+//
+// Every frame is copied into a PSRAM ring of the last ring_frames frames
+// (JPEG) and normally overwritten unseen. A trigger names the frame it is
+// about (the detected frame, or the newest one for motion / manual) and
+// marks the window [seq - preroll_frames, seq + postroll_frames]: frames of
+// it still in the ring now, later ones as they arrive. A retrigger extends
+// the window. A low-priority task hands marked frames to the sink oldest
+// first, so the frames around an event reach the card and quiet periods
+// write nothing.
+//
+// A detection arrives a whole Invoke() after its frame was pushed, so the
+// ring has to hold preroll_frames plus every frame captured in that time;
+// window frames already overwritten are counted as preroll_missed.
+//
+// The letterboxed model input (rgb_w × rgb_h RGB888) of a frame can be
+// attached later from one of rgb_frames buffers, typically once the frame
+// has been inferred; a buffer goes back with its frame.
+//
+// An incoming frame takes a free entry, else replaces the oldest unmarked
+// one wherever it is in the ring. Marked frames are never overwritten: only
+// when every entry is marked (the sink fell that far behind) is the incoming
+// frame dropped and counted as an overrun.
+// -----------------------------------------------------------------------------
+typedef enum {
+    REC_TRIGGER_DETECTION = 1u << 0,
+    REC_TRIGGER_MOTION    = 1u << 1,
+    REC_TRIGGER_MANUAL    = 1u << 2,
+} recorder_trigger_t;
+
+#define REC_CLASS_ANY (-1)
+
+// Detections of class cls (REC_CLASS_ANY: classes without their own rule)
+// with score >= min_score trigger; min_score > 1 disables a class
+typedef struct {
+    int   cls;
+    float min_score;
+} recorder_class_rule_t;
+
+typedef struct {
+    uint32_t       seq;
+    int64_t        t_capture_us;    // esp_timer time of capture
+    const uint8_t *jpeg;
+    size_t         jpeg_len;
+    const uint8_t *rgb;             // rgb_w × rgb_h RGB888, NULL: none attached
+    int            rgb_w;
+    int            rgb_h;
+} recorder_frame_t;
+
+// Persists one frame; runs on the recorder task and may block
+typedef esp_err_t (*recorder_sink_t)(const recorder_frame_t *frame);
+
+typedef struct {
+    int      ring_frames;           // ring entries, > preroll_frames
+    int      preroll_frames;        // frames written before the trigger frame
+    int      postroll_frames;       // ... and after it (the last trigger's)
+    size_t   jpeg_cap;              // largest JPEG kept
+    int      rgb_frames;            // attachable RGB buffers, 0: JPEG only
+    int      rgb_w;
+    int      rgb_h;
+
+    uint32_t triggers;              // enabled recorder_trigger_t bits
+    const recorder_class_rule_t *class_rules;
+    int      num_class_rules;
+
+    recorder_sink_t sink;
+    int         core;
+    UBaseType_t priority;
+} recorder_cfg_t;
+
+typedef struct {
+    uint32_t frames_seen;
+    uint32_t frames_written;
+    uint32_t frames_discarded;      // overwritten without an event
+    uint32_t overruns;              // incoming frames dropped: every entry marked, or JPEG > jpeg_cap
+    uint32_t preroll_missed;        // window frames overwritten before their trigger
+    uint32_t sink_errors;
+    uint32_t events_detection;
+    uint32_t events_motion;
+    uint32_t events_manual;
+    uint64_t bytes_written;         // JPEG + RGB handed to the sink
+    uint64_t bytes_seen;            // ... had every frame been written
+    uint32_t pending;               // marked, not yet written
+    uint32_t postroll_left;         // window frames still to arrive
+} recorder_stats_t;
+
+esp_err_t recorder_init(const recorder_cfg_t *cfg);
+bool      recorder_ready(void);
+
+// Copy a frame into the ring (in capture order; rgb may be NULL)
+void recorder_push(const recorder_frame_t *frame);
+
+// Attach frame seq's rgb_w × rgb_h RGB888 if it is still in the ring.
+// Takes a free buffer, else the oldest unmarked frame's.
+void recorder_attach_rgb(uint32_t seq, const uint8_t *rgb);
+
+// Fire a trigger at the newest frame if src is enabled; post_frames 0: cfg
+// postroll_frames
+void recorder_trigger(recorder_trigger_t src, uint32_t post_frames);
+
+// Check one detection in frame seq against the class rules
+void recorder_on_detection(uint32_t seq, int cls, float score);
+
+void recorder_get_stats(recorder_stats_t *out);
+void recorder_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,515 @@
+// File: main/resample.cpp
+
+#include "resample.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "RESAMPLE";
+
+// -----------------------------------------------------------------------------
+// Axis tables
+// -----------------------------------------------------------------------------
+static void *alloc_table(size_t bytes)
+{
+    return heap_caps_malloc(bytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+}
+
+static void free_axis(resample_axis_t *ax)
+{
+    heap_caps_free(ax->first);
+    heap_caps_free(ax->taps);
+    heap_caps_free(ax->w_at);
+    heap_caps_free(ax->w);
+    memset(ax, 0, sizeof(*ax));
+}
+
+// Nearest: the exact expressions of the ppm.cpp resizers (float scale, int
+// destination index), so the sampled pixels do not move
+static void build_nearest(resample_axis_t *ax, int src_n, int dst_n, resample_fit_t fit, float scale, int o)
+{
+    for (int d = 0; d < ax->n; d++) {
+        int s;
+        if (fit == RESAMPLE_STRETCH) {
+            s = d * src_n / dst_n;
+        } else {
+            s = (int)((o + d) / scale);
+            if (s >= src_n) s = src_n - 1;
+        }
+        ax->first[d] = (int16_t)s;
+    }
+    ax->max_taps = 1;
+}
+
+// Q12 weights of taps [i0, i0 + n), summing to exactly RESAMPLE_WEIGHT_ONE:
+// each tap gets the rounded running sum minus the previous one, so the
+// rounding error never accumulates and no weight goes negative. Zero taps at
+// either end are dropped.
+static int quantize_taps(const double *wf, int n, int *i0, uint16_t *w)
+{
+    int q[256];
+
+    double total = 0.0;
+    for (int k = 0; k < n; k++) total += wf[k];
+
+    double cum  = 0.0;
+    int    prev = 0;
+    for (int k = 0; k < n; k++) {
+        cum += wf[k];
+        const int next = (k == n - 1) ? RESAMPLE_WEIGHT_ONE
+                                      : (int)lround(cum / total * RESAMPLE_WEIGHT_ONE);
+        q[k] = next - prev;
+        prev = next;
+    }
+
+    int lo = 0, hi = n;
+    while (lo < hi - 1 && q[lo] == 0) lo++;
+    while (hi > lo + 1 && q[hi - 1] == 0) hi--;
+
+    for (int k = lo; k < hi; k++) w[k - lo] = (uint16_t)q[k];
+    *i0 += lo;
+    return hi - lo;
+}
+
+// Bilinear / area: destination sample d covers [o + d, o + d + 1) of the
+// scaled image, i.e. [(o + d) / scale, (o + d + 1) / scale) of the source
+static esp_err_t build_filtered(
+    resample_axis_t *ax,
+    int src_n,
+    resample_filter_t filter,
+    double scale,
+    int o,
+    int bound)
+{
+    double   wf[256];
+    uint32_t at = 0;
+
+    ax->max_taps = 1;
+
+    for (int d = 0; d < ax->n; d++) {
+        int i0, n;
+
+        if (filter == RESAMPLE_BILINEAR) {
+            double c = (o + d + 0.5) / scale - 0.5;
+            c = std::min(std::max(c, 0.0), (double)(src_n - 1));
+            i0 = (int)floor(c);
+            if (i0 >= src_n - 1) {
+                i0 = src_n - 1;
+                n = 1;
+                wf[0] = 1.0;
+            } else {
+                n = 2;
+                wf[1] = c - i0;
+                wf[0] = 1.0 - wf[1];
+            }
+        } else {
+            double a = (o + d) / scale;
+            double b = (o + d + 1) / scale;
+            a = std::min(std::max(a, 0.0), (double)src_n);
+            b = std::min(std::max(b, 0.0), (double)src_n);
+
+            i0 = std::min((int)floor(a), src_n - 1);
+            int i1 = std::max((int)ceil(b) - 1, i0);
+            if (i1 >= src_n) i1 = src_n - 1;
+            n = i1 - i0 + 1;
+
+            if (b <= a) {
+                n = 1;
+                wf[0] = 1.0;
+            } else {
+                for (int k = 0; k < n; k++) {
+                    double lo = std::max(a, (double)(i0 + k));
+                    double hi = std::min(b, (double)(i0 + k + 1));
+                    wf[k] = std::max(hi - lo, 0.0) / (b - a);
+                }
+            }
+        }
+
+        if (n > bound) return ESP_ERR_INVALID_STATE;    // bound is wrong
+
+        n = quantize_taps(wf, n, &i0, ax->w + at);
+
+        ax->first[d] = (int16_t)i0;
+        ax->taps[d]  = (uint8_t)n;
+        ax->w_at[d]  = (uint16_t)at;
+        at += n;
+        if (n > ax->max_taps) ax->max_taps = n;
+    }
+
+    return ESP_OK;
+}
+
+static esp_err_t build_axis(
+    resample_axis_t *ax,
+    int src_n,
+    int dst_n,
+    resample_filter_t filter,
+    resample_fit_t fit,
+    float scale,
+    int o)
+{
+    ax->first = (int16_t *)alloc_table(ax->n * sizeof(int16_t));
+    if (!ax->first) return ESP_ERR_NO_MEM;
+
+    if (filter == RESAMPLE_NEAREST) {
+        build_nearest(ax, src_n, dst_n, fit, scale, o);
+        return ESP_OK;
+    }
+
+    // Stretch has its own scale per axis
+    const double s = (fit == RESAMPLE_STRETCH) ? (double)dst_n / src_n : (double)scale;
+
+    // Worst-case taps per destination sample
+    const int bound = (filter == RESAMPLE_BILINEAR) ? 2 : (int)ceil(1.0 / s) + 2;
+    if (bound > 255 || (size_t)ax->n * bound > 65535) {
+        ESP_LOGE(TAG, "Downscale %d → %d too large for the tap tables", src_n, dst_n);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    ax->taps = (uint8_t *)alloc_table(ax->n);
+    ax->w_at = (uint16_t *)alloc_table(ax->n * sizeof(uint16_t));
+    ax->w    = (uint16_t *)alloc_table((size_t)ax->n * bound * sizeof(uint16_t));
+    if (!ax->taps || !ax->w_at || !ax->w) return ESP_ERR_NO_MEM;
+
+    return build_filtered(ax, src_n, filter, s, o, bound);
+}
+
+// -----------------------------------------------------------------------------
+// Public: build / free
+// -----------------------------------------------------------------------------
+esp_err_t resampler_init(
+    resampler_t *rs,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    resample_fit_t fit)
+{
+    if (!rs || src_w <= 0 || src_h <= 0 || dst_w <= 0 || dst_h <= 0 ||
+        src_w > INT16_MAX || src_h > INT16_MAX ||
+        filter > RESAMPLE_AREA || fit > RESAMPLE_CROP) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(rs, 0, sizeof(*rs));
+    rs->src_w  = src_w;
+    rs->src_h  = src_h;
+    rs->dst_w  = dst_w;
+    rs->dst_h  = dst_h;
+    rs->filter = filter;
+    rs->fit    = fit;
+
+    float scale = 1.0f;
+    int   ox = 0, oy = 0;
+
+    switch (fit) {
+    case RESAMPLE_STRETCH:
+        rs->x.n = dst_w;
+        rs->y.n = dst_h;
+        break;
+
+    case RESAMPLE_LETTERBOX:
+        // Fit inside; the scaled image is centred, bars are padding
+        scale = std::min((float)dst_w / (float)src_w, (float)dst_h / (float)src_h);
+        rs->x.n   = (int)(src_w * scale);
+        rs->y.n   = (int)(src_h * scale);
+        rs->x.off = (dst_w - rs->x.n) / 2;
+        rs->y.off = (dst_h - rs->y.n) / 2;
+        break;
+
+    case RESAMPLE_CROP: {
+        // Cover; the destination is a centred window of the scaled image
+        scale = std::max((float)dst_w / (float)src_w, (float)dst_h / (float)src_h);
+        const int scaled_w = (int)(src_w * scale + 0.5f);
+        const int scaled_h = (int)(src_h * scale + 0.5f);
+        ox = (scaled_w - dst_w) / 2;
+        oy = (scaled_h - dst_h) / 2;
+        rs->x.n = dst_w;
+        rs->y.n = dst_h;
+        break;
+    }
+    }
+
+    if (rs->x.n <= 0 || rs->y.n <= 0) {
+        ESP_LOGE(TAG, "Degenerate geometry %dx%d → %dx%d", src_w, src_h, dst_w, dst_h);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = build_axis(&rs->x, src_w, dst_w, filter, fit, scale, ox);
+    if (err == ESP_OK) err = build_axis(&rs->y, src_h, dst_h, filter, fit, scale, oy);
+
+    if (err == ESP_OK && filter != RESAMPLE_NEAREST) {
+        const size_t row = (size_t)rs->x.n * 3;
+        rs->hrow     = (uint16_t *)alloc_table(row * rs->y.max_taps * sizeof(uint16_t));
+        rs->hrow_src = (int *)alloc_table(rs->y.max_taps * sizeof(int));
+        rs->vacc     = (uint32_t *)alloc_table(row * sizeof(uint32_t));
+        if (!rs->hrow || !rs->hrow_src || !rs->vacc) err = ESP_ERR_NO_MEM;
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Resampler %dx%d → %dx%d init failed: %s",
+                 src_w, src_h, dst_w, dst_h, esp_err_to_name(err));
+        resampler_deinit(rs);
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Resampler %dx%d → %dx%d (fit %d, filter %d, image %dx%d at %d,%d, taps %dx%d, %u bytes)",
+             src_w, src_h, dst_w, dst_h, (int)fit, (int)filter,
+             rs->x.n, rs->y.n, rs->x.off, rs->y.off, rs->x.max_taps, rs->y.max_taps,
+             (unsigned)resampler_bytes(rs));
+
+    return ESP_OK;
+}
+
+void resampler_deinit(resampler_t *rs)
+{
+    if (!rs) return;
+
+    free_axis(&rs->x);
+    free_axis(&rs->y);
+    heap_caps_free(rs->hrow);
+    heap_caps_free(rs->hrow_src);
+    heap_caps_free(rs->vacc);
+    memset(rs, 0, sizeof(*rs));
+}
+
+bool resampler_matches(
+    const resampler_t *rs,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    resample_fit_t fit)
+{
+    return rs && rs->x.first &&
+           rs->src_w == src_w && rs->src_h == src_h &&
+           rs->dst_w == dst_w && rs->dst_h == dst_h &&
+           rs->filter == filter && rs->fit == fit;
+}
+
+size_t resampler_bytes(const resampler_t *rs)
+{
+    if (!rs || !rs->x.first) return 0;
+
+    size_t bytes = 0;
+    const resample_axis_t *axes[2] = { &rs->x, &rs->y };
+
+    for (const resample_axis_t *ax : axes) {
+        bytes += ax->n * sizeof(int16_t);
+        if (ax->taps) {
+            bytes += ax->n * (sizeof(uint8_t) + sizeof(uint16_t));
+            for (int d = 0; d < ax->n; d++) bytes += ax->taps[d] * sizeof(uint16_t);
+        }
+    }
+
+    if (rs->hrow) {
+        const size_t row = (size_t)rs->x.n * 3;
+        bytes += row * rs->y.max_taps * sizeof(uint16_t) +
+                 rs->y.max_taps * sizeof(int) +
+                 row * sizeof(uint32_t);
+    }
+
+    return bytes;
+}
+
+// -----------------------------------------------------------------------------
+// Run
+// -----------------------------------------------------------------------------
+
+// Letterbox bars: rows above / below the image, columns left / right of it
+static void fill_pad(const resampler_t *rs, uint8_t *dst)
+{
+    const size_t stride = (size_t)rs->dst_w * 3;
+    const int    right  = rs->x.off + rs->x.n;
+
+    memset(dst, 0, rs->y.off * stride);
+    memset(dst + (rs->y.off + rs->y.n) * stride, 0, (rs->dst_h - rs->y.off - rs->y.n) * stride);
+
+    if (rs->x.n == rs->dst_w) return;
+
+    for (int y = rs->y.off; y < rs->y.off + rs->y.n; y++) {
+        uint8_t *row = dst + y * stride;
+        memset(row, 0, rs->x.off * 3);
+        memset(row + right * 3, 0, (rs->dst_w - right) * 3);
+    }
+}
+
+static void run_nearest(const resampler_t *rs, const uint8_t *src, uint8_t *dst)
+{
+    const size_t   src_stride = (size_t)rs->src_w * 3;
+    const size_t   dst_stride = (size_t)rs->dst_w * 3;
+    const int16_t *xs = rs->x.first;
+    const int16_t *ys = rs->y.first;
+
+    uint8_t *q_prev = nullptr;
+
+    for (int y = 0; y < rs->y.n; y++) {
+        uint8_t *q = dst + (rs->y.off + y) * dst_stride + rs->x.off * 3;
+
+        // Upscaling repeats source rows: copy the finished row
+        if (q_prev && ys[y] == ys[y - 1]) {
+            memcpy(q, q_prev, rs->x.n * 3);
+            q_prev = q;
+            continue;
+        }
+
+        const uint8_t *row = src + ys[y] * src_stride;
+        q_prev = q;
+
+        for (int x = 0; x < rs->x.n; x++) {
+            const uint8_t *p = row + xs[x] * 3;
+            q[0] = p[0];
+            q[1] = p[1];
+            q[2] = p[2];
+            q += 3;
+        }
+    }
+}
+
+// One source row → x.n horizontally filtered pixels, Q8. Downscales by less
+// than 2x need at most 3 taps; those counts get straight-line code.
+static void filter_row(const resampler_t *rs, const uint8_t *row, uint16_t *out)
+{
+    const resample_axis_t *ax = &rs->x;
+
+    for (int x = 0; x < ax->n; x++) {
+        const uint8_t  *p = row + ax->first[x] * 3;
+        const uint16_t *w = ax->w + ax->w_at[x];
+
+        uint32_t r, g, b;
+        switch (ax->taps[x]) {
+        case 1:
+            r = (uint32_t)p[0] << 12;
+            g = (uint32_t)p[1] << 12;
+            b = (uint32_t)p[2] << 12;
+            break;
+        case 2:
+            r = w[0] * p[0] + w[1] * p[3];
+            g = w[0] * p[1] + w[1] * p[4];
+            b = w[0] * p[2] + w[1] * p[5];
+            break;
+        case 3:
+            r = w[0] * p[0] + w[1] * p[3] + w[2] * p[6];
+            g = w[0] * p[1] + w[1] * p[4] + w[2] * p[7];
+            b = w[0] * p[2] + w[1] * p[5] + w[2] * p[8];
+            break;
+        default:
+            r = g = b = 0;
+            for (int k = 0; k < ax->taps[x]; k++) {
+                r += w[k] * p[0];
+                g += w[k] * p[1];
+                b += w[k] * p[2];
+                p += 3;
+            }
+            break;
+        }
+
+        // Q12 * 8 bit → Q8
+        out[0] = (uint16_t)((r + 8) >> 4);
+        out[1] = (uint16_t)((g + 8) >> 4);
+        out[2] = (uint16_t)((b + 8) >> 4);
+        out += 3;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Row streaming (filtered modes)
+// -----------------------------------------------------------------------------
+void resampler_stream_begin(resampler_t *rs)
+{
+    for (int i = 0; i < rs->y.max_taps; i++) rs->hrow_src[i] = -1;
+}
+
+void resampler_push_row(resampler_t *rs, int sy, const uint8_t *row)
+{
+    // A destination row's taps are consecutive source rows and never more
+    // than y.max_taps, so they never share a slot
+    const int slot = sy % rs->y.max_taps;
+
+    filter_row(rs, row, rs->hrow + slot * rs->x.n * 3);
+    rs->hrow_src[slot] = sy;
+}
+
+void resampler_emit_row(resampler_t *rs, int y, uint8_t *out)
+{
+    const resample_axis_t *ay = &rs->y;
+
+    const int       row_n = rs->x.n * 3;
+    const int       slots = ay->max_taps;
+    const int       sy0   = ay->first[y];
+    const int       n     = ay->taps[y];
+    const uint16_t *w     = ay->w + ay->w_at[y];
+
+    // Vertical pass: Q12 * Q8 → Q20
+    const uint16_t *h0 = rs->hrow + (sy0 % slots) * row_n;
+
+    if (n == 1) {
+        for (int i = 0; i < row_n; i++) out[i] = (uint8_t)((h0[i] + 128) >> 8);
+        return;
+    }
+
+    const uint16_t *h1 = rs->hrow + ((sy0 + 1) % slots) * row_n;
+    const uint32_t  w0 = w[0], w1 = w[1];
+
+    if (n == 2) {
+        for (int i = 0; i < row_n; i++) {
+            out[i] = (uint8_t)((w0 * h0[i] + w1 * h1[i] + (1u << 19)) >> 20);
+        }
+        return;
+    }
+
+    uint32_t *acc = rs->vacc;
+    for (int i = 0; i < row_n; i++) acc[i] = w0 * h0[i] + w1 * h1[i];
+
+    for (int k = 2; k < n; k++) {
+        const uint16_t *h  = rs->hrow + ((sy0 + k) % slots) * row_n;
+        const uint32_t  wk = w[k];
+        for (int i = 0; i < row_n; i++) acc[i] += wk * h[i];
+    }
+
+    for (int i = 0; i < row_n; i++) out[i] = (uint8_t)((acc[i] + (1u << 19)) >> 20);
+}
+
+static void run_filtered(resampler_t *rs, const uint8_t *src, uint8_t *dst)
+{
+    const resample_axis_t *ay = &rs->y;
+
+    const size_t src_stride = (size_t)rs->src_w * 3;
+    const size_t dst_stride = (size_t)rs->dst_w * 3;
+
+    resampler_stream_begin(rs);
+
+    for (int y = 0; y < ay->n; y++) {
+        // Only the source rows some destination row needs are filtered
+        for (int k = 0; k < ay->taps[y]; k++) {
+            const int sy = ay->first[y] + k;
+            if (rs->hrow_src[sy % ay->max_taps] != sy) {
+                resampler_push_row(rs, sy, src + sy * src_stride);
+            }
+        }
+
+        resampler_emit_row(rs, y, dst + (rs->y.off + y) * dst_stride + rs->x.off * 3);
+    }
+}
+
+esp_err_t resampler_run(resampler_t *rs, const uint8_t *src, uint8_t *dst)
+{
+    if (!rs || !rs->x.first || !src || !dst) return ESP_ERR_INVALID_ARG;
+
+    if (rs->fit == RESAMPLE_LETTERBOX) fill_pad(rs, dst);
+
+    if (rs->filter == RESAMPLE_NEAREST) {
+        run_nearest(rs, src, dst);
+    } else {
+        run_filtered(rs, src, dst);
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,129 @@
+// File: main/resample.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Precomputed RGB888 resampler
+//
+// Built once per (source size, destination size, filter, fit) and reused for
+// every frame: the per-pixel coordinate math is done at init and stored as
+// per-axis source index / tap tables, so running it is table lookups plus
+// fixed-point multiply-adds.
+//
+//   fit STRETCH    source → whole destination, per-axis scale
+//   fit LETTERBOX  uniform scale to fit inside, centred, pad = 0
+//   fit CROP       uniform scale to cover, centred crop (no scaled temporary)
+//
+//   NEAREST   one source sample; same geometry as the original ppm.cpp
+//             resizers, so results are bit-identical to them
+//   BILINEAR  2 taps per axis around the sample centre
+//   AREA      box filter: every source sample the destination pixel covers,
+//             weighted by overlap (anti-aliased downscale)
+//
+// Weights are Q12 and sum to 4096 per destination sample. Filtered modes run
+// separably: source rows are filtered horizontally once (Q8, cached per row)
+// and combined vertically.
+// -----------------------------------------------------------------------------
+typedef enum {
+    RESAMPLE_NEAREST = 0,
+    RESAMPLE_BILINEAR,
+    RESAMPLE_AREA,
+} resample_filter_t;
+
+typedef enum {
+    RESAMPLE_STRETCH = 0,
+    RESAMPLE_LETTERBOX,
+    RESAMPLE_CROP,
+} resample_fit_t;
+
+#define RESAMPLE_WEIGHT_ONE 4096    // Q12
+
+// One axis. Destination samples [off, off + n) come from the source; the
+// rest (letterbox bars) is padding.
+typedef struct {
+    int       off;
+    int       n;
+
+    int16_t  *first;        // n: first source index (the sample, for NEAREST)
+    uint8_t  *taps;         // n: tap count (filtered only)
+    uint16_t *w_at;         // n: offset of the first weight in w (filtered only)
+    uint16_t *w;            // Q12 weights, all samples back to back
+    int       max_taps;
+} resample_axis_t;
+
+typedef struct {
+    int               src_w;
+    int               src_h;
+    int               dst_w;
+    int               dst_h;
+    resample_filter_t filter;
+    resample_fit_t    fit;
+
+    resample_axis_t   x;
+    resample_axis_t   y;
+
+    // Filtered modes: y.max_taps horizontally filtered rows (Q8), slot by
+    // source row modulo y.max_taps
+    uint16_t         *hrow;
+    int              *hrow_src;     // source row held by each slot, -1: none
+    uint32_t         *vacc;         // x.n * 3 vertical accumulators
+} resampler_t;
+
+// Tables go to internal RAM
+esp_err_t resampler_init(
+    resampler_t *rs,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    resample_fit_t fit
+);
+
+void resampler_deinit(resampler_t *rs);
+
+// True if rs was built for exactly this geometry
+bool resampler_matches(
+    const resampler_t *rs,
+    int src_w,
+    int src_h,
+    int dst_w,
+    int dst_h,
+    resample_filter_t filter,
+    resample_fit_t fit
+);
+
+// src: src_w × src_h RGB888, dst: dst_w × dst_h RGB888 (pad written as 0)
+esp_err_t resampler_run(resampler_t *rs, const uint8_t *src, uint8_t *dst);
+
+// -----------------------------------------------------------------------------
+// Row streaming (BILINEAR / AREA), for producers that hold only a few source
+// rows at a time: after stream_begin, push every source row in order; image
+// row y ([0, y.n), destination row y.off + y) can be emitted as soon as row
+// resampler_last_src_row(rs, y) has been pushed, and must be emitted before
+// the next push. out: x.n RGB888 pixels.
+// -----------------------------------------------------------------------------
+void resampler_stream_begin(resampler_t *rs);
+void resampler_push_row(resampler_t *rs, int sy, const uint8_t *row);
+void resampler_emit_row(resampler_t *rs, int y, uint8_t *out);
+
+static inline int resampler_last_src_row(const resampler_t *rs, int y)
+{
+    return rs->y.first[y] + (rs->filter == RESAMPLE_NEAREST ? 0 : rs->y.taps[y] - 1);
+}
+
+// Internal RAM held by the tables and row cache
+size_t resampler_bytes(const resampler_t *rs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,559 @@
+// File: main/sd_writer.cpp
+
+#include "sd_writer.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "sdcard.h"
+
+static const char *TAG = "SD_WRITER";
+
+#define SD_WRITER_PATH_MAX 128
+
+// -----------------------------------------------------------------------------
+// State
+// -----------------------------------------------------------------------------
+
+// One pending file. Ring layout at `at`: path (NUL-terminated, padded to 4),
+// then header + payload.
+typedef struct {
+    uint32_t at;
+    uint32_t size;          // contiguous bytes from `at`
+    uint32_t held;          // ring bytes released with the job (size + skipped tail)
+    uint32_t len;           // header + payload bytes
+    uint32_t offset;        // SD_WRITE_AT
+    uint16_t path_len;
+    uint16_t flags;
+    int64_t  t_submit;
+} sd_job_t;
+
+static sd_writer_cfg_t   s_cfg;
+static bool              s_ready = false;
+
+// Ring: [tail, head) in submission order, possibly wrapped. s_used tells a
+// full ring from an empty one and includes tails skipped on wrap.
+static uint8_t          *s_ring = nullptr;
+static size_t            s_ring_size = 0;
+static size_t            s_head = 0;
+static size_t            s_tail = 0;
+static size_t            s_used = 0;
+static portMUX_TYPE      s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static QueueHandle_t     s_jobs = nullptr;
+static SemaphoreHandle_t s_submit_lock = nullptr;  // producers in ring order
+static SemaphoreHandle_t s_space = nullptr;        // given after each finished job
+
+// Writer task side
+static uint8_t          *s_stage = nullptr;        // internal DMA-capable, one chunk
+static size_t            s_chunk = 0;
+static size_t            s_stage_n = 0;
+static int               s_fd = -1;
+static off_t             s_file_pos = 0;           // file offset of s_stage[0]
+static char              s_open_path[SD_WRITER_PATH_MAX];
+
+// Counters (s_mux)
+static sd_writer_stats_t s_st;
+
+static inline uint32_t align4(uint32_t n)
+{
+    return (n + 3u) & ~3u;
+}
+
+// -----------------------------------------------------------------------------
+// Ring
+// -----------------------------------------------------------------------------
+static bool ring_reserve(uint32_t need, uint32_t *at, uint32_t *held)
+{
+    bool ok = false;
+
+    portENTER_CRITICAL(&s_mux);
+
+    if (s_used == 0) {
+        s_head = s_tail = 0;
+    }
+
+    if (s_used == 0 || s_head > s_tail) {
+        // Free: [head, size) and [0, tail)
+        if (s_ring_size - s_head >= need) {
+            *at = s_head;
+            *held = need;
+            ok = true;
+        } else if (s_tail >= need) {
+            // Skip the tail end, wrap to the front
+            *at = 0;
+            *held = need + (uint32_t)(s_ring_size - s_head);
+            ok = true;
+        }
+    } else if (s_tail - s_head >= need) {
+        // Wrapped: free is [head, tail)
+        *at = s_head;
+        *held = need;
+        ok = true;
+    }
+
+    if (ok) {
+        s_head = *at + need;
+        if (s_head == s_ring_size) s_head = 0;
+        s_used += *held;
+        s_st.ring_used_max = std::max(s_st.ring_used_max, s_used);
+    }
+
+    portEXIT_CRITICAL(&s_mux);
+    return ok;
+}
+
+// Jobs finish in submission order, so the oldest held bytes go first
+static void ring_release(const sd_job_t *job)
+{
+    portENTER_CRITICAL(&s_mux);
+    s_tail  = job->at + job->size;
+    s_used -= job->held;
+    if (s_tail >= s_ring_size) s_tail = 0;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+// -----------------------------------------------------------------------------
+// Writer task: staging buffer → card
+// -----------------------------------------------------------------------------
+static void note_busy(int64_t t0, bool transfer)
+{
+    const int64_t dt = esp_timer_get_time() - t0;
+
+    portENTER_CRITICAL(&s_mux);
+    s_st.busy_us += dt;
+    if (transfer && dt > s_st.transfer_us_max) s_st.transfer_us_max = (uint32_t)dt;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static bool flush_stage(void)
+{
+    if (s_stage_n == 0) return true;
+
+    const int64_t t0 = esp_timer_get_time();
+    const ssize_t w  = write(s_fd, s_stage, s_stage_n);
+    note_busy(t0, true);
+
+    if (w != (ssize_t)s_stage_n) {
+        ESP_LOGE(TAG, "write(%s) %d/%u failed errno=%d (%s)",
+                 s_open_path, (int)w, (unsigned)s_stage_n, errno, strerror(errno));
+        s_stage_n = 0;
+        return false;
+    }
+
+    s_file_pos += s_stage_n;
+    s_stage_n = 0;
+    return true;
+}
+
+// Copy into the staging buffer; a transfer always ends on a chunk boundary
+// of the file, so every full transfer covers whole allocation units
+static bool stage(const uint8_t *p, size_t len)
+{
+    while (len > 0) {
+        const size_t cap = s_chunk - (size_t)(s_file_pos % s_chunk);
+        const size_t n   = std::min(len, cap - s_stage_n);
+
+        memcpy(s_stage + s_stage_n, p, n);
+        s_stage_n += n;
+        p   += n;
+        len -= n;
+
+        if (s_stage_n == cap && !flush_stage()) return false;
+    }
+    return true;
+}
+
+static bool open_file(const char *path, const sd_job_t *job)
+{
+    if (!sdcard_is_mounted()) return false;
+
+    const int64_t t0 = esp_timer_get_time();
+
+    int mode = O_WRONLY | O_CREAT;
+    if (job->flags & SD_WRITE_APPEND)     mode |= O_APPEND;
+    else if (!(job->flags & SD_WRITE_AT)) mode |= O_TRUNC;
+
+    s_fd = open(path, mode, 0666);
+    if (s_fd >= 0) {
+        if (job->flags & SD_WRITE_APPEND) {
+            s_file_pos = lseek(s_fd, 0, SEEK_END);
+        } else if (job->flags & SD_WRITE_AT) {
+            s_file_pos = lseek(s_fd, job->offset, SEEK_SET);
+        } else {
+            s_file_pos = 0;
+        }
+        if (s_file_pos < 0) {
+            close(s_fd);
+            s_fd = -1;
+        } else {
+            memcpy(s_open_path, path, strlen(path) + 1);    // length checked at submit
+        }
+    }
+    note_busy(t0, false);
+
+    if (s_fd < 0) {
+        ESP_LOGE(TAG, "open('%s') failed errno=%d (%s)", path, errno, strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static bool close_file(void)
+{
+    if (s_fd < 0) return true;
+
+    bool ok = flush_stage();
+
+    const int64_t t0 = esp_timer_get_time();
+    if (close(s_fd) != 0) ok = false;
+    note_busy(t0, false);
+
+    s_fd = -1;
+    s_stage_n = 0;
+    s_open_path[0] = 0;
+    return ok;
+}
+
+// True if job only adds to the open file where it currently ends
+static bool continues_open_file(const sd_job_t *job, const char *path)
+{
+    if (s_fd < 0 || strcmp(path, s_open_path) != 0) return false;
+
+    if (job->flags & SD_WRITE_APPEND) return true;
+    return (job->flags & SD_WRITE_AT) && job->offset == s_file_pos + s_stage_n;
+}
+
+static bool next_continues(void)
+{
+    sd_job_t next;
+    if (xQueuePeek(s_jobs, &next, 0) != pdTRUE) return false;
+
+    return continues_open_file(&next, (const char *)s_ring + next.at);
+}
+
+static void write_job(const sd_job_t *job)
+{
+    const char    *path = (const char *)s_ring + job->at;
+    const uint8_t *data = s_ring + job->at + align4(job->path_len + 1);
+
+    // An open file is only kept for a job that continues it
+    if (s_fd >= 0 && !continues_open_file(job, path)) {
+        close_file();
+    }
+
+    bool ok = (s_fd >= 0) || open_file(path, job);
+    if (ok) ok = stage(data, job->len);
+
+    // Jobs queued right behind this one continue in the same buffer
+    if (!ok || !next_continues()) {
+        if (!close_file()) ok = false;
+    }
+
+    const int64_t job_us = esp_timer_get_time() - job->t_submit;
+
+    portENTER_CRITICAL(&s_mux);
+    if (ok) {
+        s_st.written++;
+        s_st.bytes_written += job->len;
+    } else {
+        s_st.errors++;
+    }
+    if (job_us > s_st.job_us_max) s_st.job_us_max = (uint32_t)job_us;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static void writer_task(void *pv)
+{
+    ESP_LOGI(TAG, "SD writer started on core %d", xPortGetCoreID());
+
+    sd_job_t job;
+
+    while (true) {
+        if (xQueueReceive(s_jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+
+        write_job(&job);
+        ring_release(&job);
+        xSemaphoreGive(s_space);
+    }
+}
+
+static void free_resources(void)
+{
+    heap_caps_free(s_ring);
+    heap_caps_free(s_stage);
+    if (s_jobs) vQueueDelete(s_jobs);
+    if (s_submit_lock) vSemaphoreDelete(s_submit_lock);
+    if (s_space) vSemaphoreDelete(s_space);
+    s_ring = s_stage = nullptr;
+    s_ring_size = 0;
+    s_jobs = nullptr;
+    s_submit_lock = s_space = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Public
+// -----------------------------------------------------------------------------
+esp_err_t sd_writer_init(const sd_writer_cfg_t *cfg)
+{
+    if (!cfg || cfg->ring_bytes < 1024 || cfg->max_jobs <= 0 ||
+        cfg->optional_fill_pct < 0 || cfg->optional_fill_pct > 100) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (s_ready) {
+        ESP_LOGW(TAG, "SD writer already initialized");
+        return ESP_OK;
+    }
+
+    s_cfg   = *cfg;
+    s_chunk = cfg->chunk_bytes ? cfg->chunk_bytes : SD_WRITER_CHUNK_DEFAULT;
+
+    s_ring_size   = cfg->ring_bytes & ~(size_t)3;
+    s_ring        = (uint8_t *)heap_caps_malloc(s_ring_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    s_stage       = (uint8_t *)heap_caps_aligned_alloc(4, s_chunk, MALLOC_CAP_INTERNAL | MALLOC_CAP_DMA);
+    s_jobs        = xQueueCreate(cfg->max_jobs, sizeof(sd_job_t));
+    s_submit_lock = xSemaphoreCreateMutex();
+    s_space       = xSemaphoreCreateBinary();
+
+    if (!s_ring || !s_stage || !s_jobs || !s_submit_lock || !s_space) {
+        ESP_LOGE(TAG, "SD writer alloc failed");
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(&s_st, 0, sizeof(s_st));
+    s_st.capacity  = cfg->max_jobs;
+    s_st.ring_size = s_ring_size;
+
+    if (xTaskCreatePinnedToCore(writer_task, "SD_WRITER", 4096, nullptr,
+                                cfg->priority, nullptr, cfg->core) != pdPASS) {
+        ESP_LOGE(TAG, "SD writer task create failed");
+        free_resources();
+        return ESP_ERR_NO_MEM;
+    }
+
+    s_ready = true;
+
+    ESP_LOGI(TAG, "SD writer: ring %u KB PSRAM, %d jobs, %u KB transfers, policy %s (%lu ms), optional shed at %d%%",
+             (unsigned)(s_ring_size / 1024), cfg->max_jobs, (unsigned)(s_chunk / 1024),
+             cfg->policy == SD_WRITER_BLOCK ? "block" : "drop",
+             (unsigned long)cfg->block_ms, cfg->optional_fill_pct);
+
+    return ESP_OK;
+}
+
+bool sd_writer_ready(void)
+{
+    return s_ready;
+}
+
+static void count_drop(size_t len, bool shed)
+{
+    portENTER_CRITICAL(&s_mux);
+    s_st.dropped++;
+    if (shed) s_st.shed++;
+    s_st.bytes_dropped += len;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static esp_err_t submit(
+    const char *path,
+    uint32_t offset,
+    const void *hdr,
+    size_t hdr_len,
+    const void *data,
+    size_t len,
+    uint32_t flags)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+    if (!path || (hdr_len && !hdr) || (len && !data)) return ESP_ERR_INVALID_ARG;
+
+    const size_t path_len = strlen(path);
+    if (path_len >= SD_WRITER_PATH_MAX) return ESP_ERR_INVALID_ARG;
+
+    const size_t total = hdr_len + len;
+    const size_t need  = align4(path_len + 1) + align4(total);
+    if (need > s_ring_size) {
+        count_drop(total, false);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    xSemaphoreTake(s_submit_lock, portMAX_DELAY);
+
+    // Audit output goes first when the card falls behind
+    if ((flags & SD_WRITE_OPTIONAL) && s_cfg.optional_fill_pct > 0) {
+        portENTER_CRITICAL(&s_mux);
+        const bool over = (s_used + need) * 100 > s_ring_size * (size_t)s_cfg.optional_fill_pct;
+        portEXIT_CRITICAL(&s_mux);
+
+        if (over) {
+            xSemaphoreGive(s_submit_lock);
+            count_drop(total, true);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    const TickType_t wait  = (s_cfg.policy == SD_WRITER_BLOCK) ? pdMS_TO_TICKS(s_cfg.block_ms) : 0;
+    const TickType_t start = xTaskGetTickCount();
+
+    uint32_t at = 0, held = 0;
+
+    while (true) {
+        if (uxQueueSpacesAvailable(s_jobs) > 0 && ring_reserve(need, &at, &held)) break;
+
+        const TickType_t waited = xTaskGetTickCount() - start;
+        if (waited >= wait) {
+            xSemaphoreGive(s_submit_lock);
+            count_drop(total, false);
+            ESP_LOGW(TAG, "Dropped %s (%u bytes): writer backlog", path, (unsigned)total);
+            return ESP_ERR_NO_MEM;
+        }
+        xSemaphoreTake(s_space, wait - waited);
+    }
+
+    uint8_t *p = s_ring + at;
+    memcpy(p, path, path_len + 1);
+    p += align4(path_len + 1);
+    if (hdr_len) memcpy(p, hdr, hdr_len);
+    if (len) memcpy(p + hdr_len, data, len);
+
+    sd_job_t job = {};
+    job.at       = at;
+    job.size     = need;
+    job.held     = held;
+    job.len      = total;
+    job.path_len = (uint16_t)path_len;
+    job.flags    = (uint16_t)flags;
+    job.offset   = offset;
+    job.t_submit = esp_timer_get_time();
+
+    // Only producers add and they hold the lock, so the space checked above
+    // is still there
+    xQueueSend(s_jobs, &job, 0);
+
+    const uint32_t depth = (uint32_t)uxQueueMessagesWaiting(s_jobs);
+
+    portENTER_CRITICAL(&s_mux);
+    s_st.submitted++;
+    if (depth > s_st.depth_max) s_st.depth_max = depth;
+    portEXIT_CRITICAL(&s_mux);
+
+    xSemaphoreGive(s_submit_lock);
+    return ESP_OK;
+}
+
+esp_err_t sd_writer_submit(
+    const char *path,
+    const void *hdr,
+    size_t hdr_len,
+    const void *data,
+    size_t len,
+    uint32_t flags)
+{
+    return submit(path, 0, hdr, hdr_len, data, len, flags & ~SD_WRITE_AT);
+}
+
+esp_err_t sd_writer_submit_at(
+    const char *path,
+    uint32_t offset,
+    const void *hdr,
+    size_t hdr_len,
+    const void *data,
+    size_t len,
+    uint32_t flags)
+{
+    return submit(path, offset, hdr, hdr_len, data, len, (flags | SD_WRITE_AT) & ~SD_WRITE_APPEND);
+}
+
+esp_err_t sd_writer_wait_room(size_t bytes, TickType_t wait)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+
+    const size_t pct   = s_cfg.optional_fill_pct > 0 ? (size_t)s_cfg.optional_fill_pct : 100;
+    const TickType_t start = xTaskGetTickCount();
+
+    while (true) {
+        portENTER_CRITICAL(&s_mux);
+        const bool room = s_used == 0 || (s_used + bytes) * 100 <= s_ring_size * pct;
+        portEXIT_CRITICAL(&s_mux);
+
+        if (room) return ESP_OK;
+        if (xTaskGetTickCount() - start >= wait) return ESP_ERR_TIMEOUT;
+
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+esp_err_t sd_writer_flush(TickType_t wait)
+{
+    if (!s_ready) return ESP_ERR_INVALID_STATE;
+
+    portENTER_CRITICAL(&s_mux);
+    const uint32_t target = s_st.submitted;
+    portEXIT_CRITICAL(&s_mux);
+
+    const TickType_t start = xTaskGetTickCount();
+
+    while (true) {
+        portENTER_CRITICAL(&s_mux);
+        const uint32_t done = s_st.written + s_st.errors;
+        portEXIT_CRITICAL(&s_mux);
+
+        if ((int32_t)(done - target) >= 0) return ESP_OK;
+        if (xTaskGetTickCount() - start >= wait) return ESP_ERR_TIMEOUT;
+
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void sd_writer_get_stats(sd_writer_stats_t *out)
+{
+    portENTER_CRITICAL(&s_mux);
+    *out = s_st;
+    out->ring_used = s_used;
+    portEXIT_CRITICAL(&s_mux);
+
+    out->depth = s_jobs ? (uint32_t)uxQueueMessagesWaiting(s_jobs) : 0;
+}
+
+void sd_writer_log_stats(void)
+{
+    static uint64_t s_prev_bytes = 0;
+    static int64_t  s_prev_t     = 0;
+
+    if (!s_ready) return;
+
+    sd_writer_stats_t s;
+    sd_writer_get_stats(&s);
+
+    const int64_t now  = esp_timer_get_time();
+    const int64_t span = s_prev_t ? now - s_prev_t : 0;
+    const uint32_t rate = span > 0 ? (uint32_t)((s.bytes_written - s_prev_bytes) * 1000000ULL / span) : 0;
+    const uint32_t card = s.busy_us > 0 ? (uint32_t)(s.bytes_written * 1000000ULL / s.busy_us) : 0;
+
+    s_prev_bytes = s.bytes_written;
+    s_prev_t     = now;
+
+    ESP_LOGI(TAG, "depth=%lu/%lu max=%lu ring=%u/%u KB max=%u KB jobs ok=%lu err=%lu dropped=%lu (shed %lu, %llu KB)",
+             (unsigned long)s.depth, (unsigned long)s.capacity, (unsigned long)s.depth_max,
+             (unsigned)(s.ring_used / 1024), (unsigned)(s.ring_size / 1024),
+             (unsigned)(s.ring_used_max / 1024),
+             (unsigned long)s.written, (unsigned long)s.errors, (unsigned long)s.dropped,
+             (unsigned long)s.shed, (unsigned long long)(s.bytes_dropped / 1024));
+    ESP_LOGI(TAG, "rate=%lu B/s (card %lu B/s while busy) worst transfer=%lu us worst job=%lu us",
+             (unsigned long)rate, (unsigned long)card,
+             (unsigned long)s.transfer_us_max, (unsigned long)s.job_us_max);
+}
@@ -0,0 +1,120 @@
+// File: main/sd_writer.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Asynchronous SD writer
+//
+// Producers copy a file's bytes (optional header + payload) into a bounded
+// PSRAM ring and return; a low-priority task writes the jobs in order. The
+// payload goes to the card through an internal-RAM DMA staging buffer in
+// transfers of one FAT allocation unit (16 KB), aligned to allocation-unit
+// file offsets, so the SDMMC driver does multi-block writes instead of
+// bouncing PSRAM data one sector at a time. Consecutive APPEND jobs to the
+// same file share one open file and one staging buffer, so small appends
+// coalesce into full transfers; so do AT jobs that continue exactly where
+// the previous job to that file ended.
+//
+// When the card stalls the ring fills up:
+//   - OPTIONAL jobs are refused once the ring is optional_fill_pct full, so
+//     audit output is shed before primary data
+//   - a job that does not fit is dropped (policy DROP) or waits up to
+//     block_ms for space, then is dropped (policy BLOCK)
+// Every drop is counted; producers never wait longer than block_ms.
+// -----------------------------------------------------------------------------
+typedef enum {
+    SD_WRITER_DROP = 0,     // no room: refuse at once
+    SD_WRITER_BLOCK,        // no room: wait up to block_ms, then refuse
+} sd_writer_policy_t;
+
+// Job flags
+#define SD_WRITE_APPEND     (1u << 0)   // append instead of truncate
+#define SD_WRITE_OPTIONAL   (1u << 1)   // shed first under back-pressure
+#define SD_WRITE_AT         (1u << 2)   // write at an offset, keep the rest (sd_writer_submit_at)
+
+#define SD_WRITER_CHUNK_DEFAULT (16 * 1024)     // = FAT allocation unit (sdcard.cpp)
+
+typedef struct {
+    size_t             ring_bytes;          // PSRAM ring of pending data
+    int                max_jobs;            // pending files
+    size_t             chunk_bytes;         // transfer size, 0: SD_WRITER_CHUNK_DEFAULT
+    sd_writer_policy_t policy;
+    uint32_t           block_ms;            // BLOCK: longest producer wait
+    int                optional_fill_pct;   // ring fill that refuses OPTIONAL jobs (0: never)
+    int                core;
+    UBaseType_t        priority;
+} sd_writer_cfg_t;
+
+typedef struct {
+    uint32_t submitted;         // jobs accepted
+    uint32_t written;           // jobs on the card
+    uint32_t dropped;           // jobs refused (back-pressure)
+    uint32_t shed;              // ... of which OPTIONAL jobs refused early
+    uint32_t errors;            // jobs that failed on the card
+    uint64_t bytes_written;
+    uint64_t bytes_dropped;
+
+    uint32_t depth;             // jobs waiting
+    uint32_t depth_max;
+    uint32_t capacity;
+    size_t   ring_used;         // ring bytes held by waiting jobs
+    size_t   ring_used_max;
+    size_t   ring_size;
+
+    uint32_t transfer_us_max;   // worst single transfer (one write() call)
+    uint32_t job_us_max;        // worst submit → closed on the card
+    uint64_t busy_us;           // time spent in open / write / close
+} sd_writer_stats_t;
+
+esp_err_t sd_writer_init(const sd_writer_cfg_t *cfg);
+bool      sd_writer_ready(void);
+
+// Queue hdr (may be NULL) followed by data for path; both are copied.
+// ESP_ERR_NO_MEM: dropped by back-pressure, ESP_ERR_INVALID_STATE: not
+// initialized, ESP_ERR_INVALID_SIZE: larger than the ring.
+esp_err_t sd_writer_submit(
+    const char *path,
+    const void *hdr,
+    size_t hdr_len,
+    const void *data,
+    size_t len,
+    uint32_t flags
+);
+
+// Same, written at offset into an existing (e.g. pre-allocated) file
+esp_err_t sd_writer_submit_at(
+    const char *path,
+    uint32_t offset,
+    const void *hdr,
+    size_t hdr_len,
+    const void *data,
+    size_t len,
+    uint32_t flags
+);
+
+// Wait until `bytes` more fit without crossing the OPTIONAL shedding
+// threshold (the whole ring if none), for background producers that would
+// rather wait than drop. ESP_ERR_TIMEOUT if still full after wait.
+esp_err_t sd_writer_wait_room(size_t bytes, TickType_t wait);
+
+// Wait until every job submitted so far is on the card (or failed)
+esp_err_t sd_writer_flush(TickType_t wait);
+
+void sd_writer_get_stats(sd_writer_stats_t *out);
+
+// One line of counters plus the write rate since the previous call
+void sd_writer_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
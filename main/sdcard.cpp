@@ -4,6 +4,7 @@
 #include "sdcard.h"
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_vfs_fat.h"
 #include "driver/sdmmc_host.h"
 #include "sdmmc_cmd.h"
@@ -14,6 +15,9 @@
 #include <errno.h>
 #include <dirent.h> // Required for opendir, readdir, closedir
 #include <string.h> // Required for strcmp
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 static const char *TAG = "SDCARD";
 static const char *MOUNT_POINT = "/sdcard";
@@ -201,4 +205,292 @@ esp_err_t sdcard_write_file(const char *path, const uint8_t *data, size_t size)
 
 	ESP_LOGI(TAG, "Wrote %u bytes to %s", (unsigned)size, path);
 	return ESP_OK;
-}
\ No newline at end of file
+}
+
+// =========================================================================
+// Capture namespace: <root>/YYYYMMDD/HH[_NN]/
+// =========================================================================
+#define NS_PATH_MAX 	96
+#define NS_MAX_PARTS 	100
+#define NS_CLOCK_VALID 	1704067200 	// 2024-01-01: anything earlier is an unsynced clock
+
+static char s_ns_root[48];
+static uint32_t s_ns_max_entries = 0;
+
+// Current shard, cached between calls
+static int64_t s_ns_hour = -1; 			// local hour key YYYYMMDDHH, -2: clock not set, -1: none yet
+static int s_ns_part = 0;
+static uint32_t s_ns_count = 0; 		// entries in the current shard
+static char s_ns_dir[NS_PATH_MAX];
+static int s_ns_dir_len = 0;
+static int64_t s_ns_prepared = -1; 		// hour key pre-created by sdcard_capture_prepare
+
+// Counters
+static uint32_t s_ns_shards = 0;
+static uint32_t s_ns_overflows = 0;
+static uint32_t s_ns_mkdirs = 0;
+static uint32_t s_ns_mkdir_us_max = 0;
+
+// Local hour as YYYYMMDDHH: the key and the directory name come from the
+// same struct tm, so a shard never spans two local hours (offsets that are
+// not whole hours, DST changes)
+static int64_t ns_hour_key(time_t t)
+{
+	if (t < NS_CLOCK_VALID) return -2;
+
+	struct tm tm;
+	localtime_r(&t, &tm);
+	return (int64_t)(tm.tm_year + 1900) * 1000000 + (tm.tm_mon + 1) * 10000 +
+		   tm.tm_mday * 100 + tm.tm_hour;
+}
+
+static int ns_shard_path(char *out, size_t cap, int64_t hour, int part, bool day_only)
+{
+	if (hour == -2) {
+		return (part == 0)
+			? snprintf(out, cap, "%s/nosync", s_ns_root)
+			: snprintf(out, cap, "%s/nosync_%02d", s_ns_root, part);
+	}
+
+	const int day = (int)(hour / 100); 	// YYYYMMDD
+	const int hh  = (int)(hour % 100);
+
+	if (day_only) {
+		return snprintf(out, cap, "%s/%08d", s_ns_root, day);
+	}
+	return (part == 0)
+		? snprintf(out, cap, "%s/%08d/%02d", s_ns_root, day, hh)
+		: snprintf(out, cap, "%s/%08d/%02d_%02d", s_ns_root, day, hh, part);
+}
+
+// mkdir, timed; true if the directory was newly created
+static bool ns_mkdir(const char *path, bool *ok)
+{
+	int64_t t0 = esp_timer_get_time();
+	int r = ::mkdir(path, 0777);
+	uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+	s_ns_mkdirs++;
+	if (dt > s_ns_mkdir_us_max) s_ns_mkdir_us_max = dt;
+
+	*ok = (r == 0 || errno == EEXIST);
+	if (!*ok) {
+		ESP_LOGE(TAG, "mkdir('%s') failed errno=%d (%s)", path, errno, strerror(errno));
+	}
+	return r == 0;
+}
+
+static uint32_t ns_count_entries(const char *path)
+{
+	uint32_t n = 0;
+	DIR *dir = opendir(path);
+	if (!dir) return 0;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) n++;
+	}
+	closedir(dir);
+	return n;
+}
+
+// Create the day + hour directories of a shard
+static bool ns_create(int64_t hour, int part, char *path, size_t cap, bool *fresh)
+{
+	bool ok = true;
+
+	if (hour != -2) {
+		ns_shard_path(path, cap, hour, 0, true);
+		ns_mkdir(path, &ok);
+		if (!ok) return false;
+	}
+
+	ns_shard_path(path, cap, hour, part, false);
+	*fresh = ns_mkdir(path, &ok);
+	return ok;
+}
+
+// Make (hour, part) the current shard. A directory that already existed
+// (reboot within the hour, pre-created) is counted once.
+static bool ns_open_shard(int64_t hour, int part)
+{
+	char path[NS_PATH_MAX];
+	bool fresh = false;
+
+	if (!ns_create(hour, part, path, sizeof(path), &fresh)) return false;
+
+	s_ns_hour = hour;
+	s_ns_part = part;
+	s_ns_count = fresh ? 0 : ns_count_entries(path);
+	s_ns_dir_len = (int)strlen(path);
+	memcpy(s_ns_dir, path, s_ns_dir_len + 1);
+	s_ns_shards++;
+
+	ESP_LOGI(TAG, "Capture shard %s (%lu entries)", s_ns_dir, (unsigned long)s_ns_count);
+	return true;
+}
+
+esp_err_t sdcard_capture_ns_init(const char *root, uint32_t max_entries)
+{
+	if (!root || max_entries == 0 || strlen(root) >= sizeof(s_ns_root) - 1) {
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	strcpy(s_ns_root, root);
+	s_ns_max_entries = max_entries;
+	s_ns_hour = -1;
+	s_ns_prepared = -1;
+
+	return sdcard_mkdir(root);
+}
+
+int sdcard_capture_dir(char *out, size_t cap, uint32_t files)
+{
+	if (s_ns_max_entries == 0 || !out) return -1;
+
+	int64_t hour = ns_hour_key(time(NULL));
+
+	if (hour != s_ns_hour && !ns_open_shard(hour, 0)) return -1;
+
+	while (s_ns_count + files > s_ns_max_entries && s_ns_count > 0) {
+		if (s_ns_part + 1 >= NS_MAX_PARTS) break; 	// keep filling the last one
+		if (!ns_open_shard(hour, s_ns_part + 1)) return -1;
+		s_ns_overflows++;
+	}
+
+	if ((size_t)s_ns_dir_len + 1 > cap) return -1;
+
+	memcpy(out, s_ns_dir, s_ns_dir_len + 1);
+	s_ns_count += files;
+	return s_ns_dir_len;
+}
+
+void sdcard_capture_prepare(uint32_t ahead_s)
+{
+	// Nothing to prepare until capture files are written at all
+	if (s_ns_max_entries == 0 || s_ns_hour == -1) return;
+
+	int64_t hour = ns_hour_key(time(NULL) + ahead_s);
+	if (hour == -2 || hour == s_ns_hour || hour == s_ns_prepared) return;
+
+	char path[NS_PATH_MAX];
+	bool fresh = false;
+	if (ns_create(hour, 0, path, sizeof(path), &fresh)) {
+		s_ns_prepared = hour;
+		ESP_LOGI(TAG, "Pre-created capture shard %s", path);
+	}
+}
+
+void sdcard_capture_log_stats(void)
+{
+	if (s_ns_max_entries == 0) return;
+
+	ESP_LOGI(TAG, "capture shard=%s entries=%lu/%lu shards=%lu overflows=%lu mkdirs=%lu mkdir max=%lu us",
+			 s_ns_dir_len ? s_ns_dir : "-",
+			 (unsigned long)s_ns_count, (unsigned long)s_ns_max_entries,
+			 (unsigned long)s_ns_shards, (unsigned long)s_ns_overflows,
+			 (unsigned long)s_ns_mkdirs, (unsigned long)s_ns_mkdir_us_max);
+}
+
+// =========================================================================
+// Create-latency benchmark: flat directory vs capped shards
+// =========================================================================
+static void bench_path(char *out, size_t cap, const char *dir, bool sharded, int per_dir, int i)
+{
+	if (sharded) {
+		snprintf(out, cap, "%s/shard/%03d/frame_%06d.jpg", dir, i / per_dir, i);
+	} else {
+		snprintf(out, cap, "%s/flat/frame_%06d.jpg", dir, i);
+	}
+}
+
+static void bench_run(const char *dir, bool sharded, int per_dir, int files, int step,
+					  uint32_t *avg, uint32_t *worst)
+{
+	static uint8_t payload[512];
+	char path[NS_PATH_MAX];
+
+	for (int i = 0; i < files; i++) {
+		if (sharded && (i % per_dir) == 0) {
+			snprintf(path, sizeof(path), "%s/shard/%03d", dir, i / per_dir);
+			sdcard_mkdir(path);
+		}
+		bench_path(path, sizeof(path), dir, sharded, per_dir, i);
+
+		int64_t t0 = esp_timer_get_time();
+		FILE *f = ::fopen(path, "wb");
+		if (f) {
+			fwrite(payload, 1, sizeof(payload), f);
+			fclose(f);
+		}
+		uint32_t dt = (uint32_t)(esp_timer_get_time() - t0);
+
+		avg[i / step] += dt;
+		if (dt > worst[i / step]) worst[i / step] = dt;
+	}
+
+	for (int b = 0; b < (files + step - 1) / step; b++) {
+		int n = (b + 1) * step <= files ? step : files - b * step;
+		avg[b] /= n;
+	}
+}
+
+static void bench_cleanup(const char *dir, bool sharded, int per_dir, int files)
+{
+	char path[NS_PATH_MAX];
+
+	for (int i = 0; i < files; i++) {
+		bench_path(path, sizeof(path), dir, sharded, per_dir, i);
+		::unlink(path);
+		if (sharded && (i % per_dir) == per_dir - 1) {
+			snprintf(path, sizeof(path), "%s/shard/%03d", dir, i / per_dir);
+			::rmdir(path);
+		}
+	}
+	if (sharded && (files % per_dir) != 0) {
+		snprintf(path, sizeof(path), "%s/shard/%03d", dir, files / per_dir);
+		::rmdir(path);
+	}
+
+	snprintf(path, sizeof(path), "%s/%s", dir, sharded ? "shard" : "flat");
+	::rmdir(path);
+}
+
+void sdcard_create_benchmark(const char *dir, int files, int step)
+{
+	if (!sdcard_is_mounted() || files <= 0 || step <= 0) return;
+
+	const int per_dir = s_ns_max_entries ? (int)s_ns_max_entries : 256;
+	const int buckets = (files + step - 1) / step;
+
+	uint32_t *res = (uint32_t *)calloc(4 * buckets, sizeof(uint32_t));
+	if (!res) return;
+
+	uint32_t *flat_avg = res, *flat_max = res + buckets;
+	uint32_t *shard_avg = res + 2 * buckets, *shard_max = res + 3 * buckets;
+	char path[NS_PATH_MAX];
+
+	sdcard_mkdir(dir);
+	snprintf(path, sizeof(path), "%s/flat", dir);
+	sdcard_mkdir(path);
+	snprintf(path, sizeof(path), "%s/shard", dir);
+	sdcard_mkdir(path);
+
+	ESP_LOGI(TAG, "Create benchmark: %d files, flat vs %d per directory", files, per_dir);
+
+	bench_run(dir, false, per_dir, files, step, flat_avg, flat_max);
+	bench_run(dir, true, per_dir, files, step, shard_avg, shard_max);
+
+	for (int b = 0; b < buckets; b++) {
+		ESP_LOGI(TAG, "files %5d-%5d: flat avg %6lu us max %6lu us | sharded avg %6lu us max %6lu us",
+				 b * step, (b + 1) * step < files ? (b + 1) * step - 1 : files - 1,
+				 (unsigned long)flat_avg[b], (unsigned long)flat_max[b],
+				 (unsigned long)shard_avg[b], (unsigned long)shard_max[b]);
+	}
+
+	bench_cleanup(dir, false, per_dir, files);
+	bench_cleanup(dir, true, per_dir, files);
+	::rmdir(dir);
+
+	free(res);
+}
@@ -44,4 +44,45 @@ esp_err_t sdcard_write_file(const char *path, const uint8_t *data, size_t size);
  * @param path The directory path to list (e.g., "/sdcard").
  * @return ESP_OK on success.
  */
-esp_err_t sdcard_print_directory_tree(const char *path);
\ No newline at end of file
+esp_err_t sdcard_print_directory_tree(const char *path);
+/**
+ * @brief Sets up the capture namespace: new capture files go to
+ *        <root>/YYYYMMDD/HH/ (local time from the modem-synced clock,
+ *        <root>/nosync/ while the clock is unset). A shard directory holds
+ *        at most max_entries files; further files overflow to HH_01, HH_02...
+ *        Not thread-safe: one task (the persist stage, or the recorder's
+ *        sink) creates capture files and prepares shards.
+ * @param root Capture root (e.g. "/sdcard/capture"), created if missing.
+ * @param max_entries Files per shard directory.
+ * @return ESP_OK on success.
+ */
+esp_err_t sdcard_capture_ns_init(const char *root, uint32_t max_entries);
+
+/**
+ * @brief Copies the current shard directory (no trailing '/') into out and
+ *        reserves `files` entries in it. Constant time: the directory is
+ *        cached and only created when the hour changes or the shard is full.
+ * @return Length of the path written, or -1 (not initialized / too small).
+ */
+int sdcard_capture_dir(char *out, size_t cap, uint32_t files);
+
+/**
+ * @brief Pre-creates the shard that will be current `ahead_s` seconds from
+ *        now, so the hour rollover does not mkdir on the write path. Cheap
+ *        when there is nothing to do (or no capture file was written yet);
+ *        call after each frame.
+ */
+void sdcard_capture_prepare(uint32_t ahead_s);
+
+/**
+ * @brief Logs shard / mkdir counters of the capture namespace.
+ */
+void sdcard_capture_log_stats(void);
+
+/**
+ * @brief Benchmark: creates `files` small files in one flat directory and
+ *        the same number in capped shard directories under `dir`, logging
+ *        the create latency (average / worst) per `step` files, then
+ *        deletes everything again.
+ */
+void sdcard_create_benchmark(const char *dir, int files, int step);
@@ -0,0 +1,563 @@
+// File: main/tjpgd_kern.cpp
+
+#include "tjpgd_kern.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "TJPGD_KERN";
+
+// AAN multipliers, 12-bit fixed point (as in tjpgd.c)
+#define M13 ((int32_t)(1.41421 * 4096))
+#define M2  ((int32_t)(1.08239 * 4096))
+#define M4  ((int32_t)(2.61313 * 4096))
+#define M5  ((int32_t)(1.84776 * 4096))
+
+// YCbCr -> RGB coefficients, CVACC = 1024 on 32-bit targets (as in tjpgd.c)
+#define CVACC 1024
+#define K_RV  ((int)(1.402 * CVACC))
+#define K_GU  ((int)(0.344 * CVACC))
+#define K_GV  ((int)(0.714 * CVACC))
+#define K_BU  ((int)(1.772 * CVACC))
+
+static inline uint8_t clip8(int v)
+{
+    if ((unsigned)v <= 255) return (uint8_t)v;
+    return v < 0 ? 0 : 255;
+}
+
+// -----------------------------------------------------------------------------
+// IDCT: upstream reference
+// -----------------------------------------------------------------------------
+void tjpgd_idct_ref(int32_t *src, int16_t *dst, int ncoef)
+{
+    int32_t v0, v1, v2, v3, v4, v5, v6, v7;
+    int32_t t10, t11, t12, t13;
+    int i;
+
+    /* Process columns */
+    for (i = 0; i < 8; i++) {
+        v0 = src[8 * 0];    /* Get even elements */
+        v1 = src[8 * 2];
+        v2 = src[8 * 4];
+        v3 = src[8 * 6];
+
+        t10 = v0 + v2;      /* Process the even elements */
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = src[8 * 7];    /* Get odd elements */
+        v5 = src[8 * 1];
+        v6 = src[8 * 5];
+        v7 = src[8 * 3];
+
+        t10 = v5 - v4;      /* Process the odd elements */
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        src[8 * 0] = v0 + v7;   /* Write-back transformed values */
+        src[8 * 7] = v0 - v7;
+        src[8 * 1] = v1 + v6;
+        src[8 * 6] = v1 - v6;
+        src[8 * 2] = v2 + v5;
+        src[8 * 5] = v2 - v5;
+        src[8 * 3] = v3 + v4;
+        src[8 * 4] = v3 - v4;
+
+        src++;  /* Next column */
+    }
+
+    /* Process rows */
+    src -= 8;
+    for (i = 0; i < 8; i++) {
+        v0 = src[0] + (128L << 8);  /* Get even elements (remove DC offset (-128) here) */
+        v1 = src[2];
+        v2 = src[4];
+        v3 = src[6];
+
+        t10 = v0 + v2;              /* Process the even elements */
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = src[7];                /* Get odd elements */
+        v5 = src[1];
+        v6 = src[5];
+        v7 = src[3];
+
+        t10 = v5 - v4;              /* Process the odd elements */
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        /* Descale the transformed values 8 bits and output a row */
+        dst[0] = (int16_t)((v0 + v7) >> 8);
+        dst[7] = (int16_t)((v0 - v7) >> 8);
+        dst[1] = (int16_t)((v1 + v6) >> 8);
+        dst[6] = (int16_t)((v1 - v6) >> 8);
+        dst[2] = (int16_t)((v2 + v5) >> 8);
+        dst[5] = (int16_t)((v2 - v5) >> 8);
+        dst[3] = (int16_t)((v3 + v4) >> 8);
+        dst[4] = (int16_t)((v3 - v4) >> 8);
+
+        dst += 8; src += 8; /* Next row */
+    }
+}
+
+// -----------------------------------------------------------------------------
+// IDCT: fast
+//
+// mcu_load() knows where the block's EOB was: every non-zero coefficient lies
+// within the first ncoef zigzag positions, i.e. in the top-left K x K corner
+// (K = 2 up to 3 coefficients, 4 up to 10, 6 up to 21). Columns right of K
+// are zero and stay zero through the column pass, so only K columns are
+// transformed, and both passes drop the butterfly inputs known to be zero.
+// Zero operands give zero products, so the result is the reference's exactly.
+// -----------------------------------------------------------------------------
+// Same code as the reference, with the inputs at index >= K replaced by 0
+template <int K>
+static void idct_k(int32_t *src, int16_t *dst)
+{
+    int32_t v0, v1, v2, v3, v4, v5, v6, v7;
+    int32_t t10, t11, t12, t13;
+
+    // Columns 0..K-1
+    for (int i = 0; i < K; i++) {
+        v0 = src[8 * 0];
+        v1 = K > 2 ? src[8 * 2] : 0;
+        v2 = K > 4 ? src[8 * 4] : 0;
+        v3 = K > 6 ? src[8 * 6] : 0;
+
+        t10 = v0 + v2;
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = K > 7 ? src[8 * 7] : 0;
+        v5 = src[8 * 1];
+        v6 = K > 5 ? src[8 * 5] : 0;
+        v7 = K > 3 ? src[8 * 3] : 0;
+
+        t10 = v5 - v4;
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        src[8 * 0] = v0 + v7;
+        src[8 * 7] = v0 - v7;
+        src[8 * 1] = v1 + v6;
+        src[8 * 6] = v1 - v6;
+        src[8 * 2] = v2 + v5;
+        src[8 * 5] = v2 - v5;
+        src[8 * 3] = v3 + v4;
+        src[8 * 4] = v3 - v4;
+
+        src++;
+    }
+
+    // Rows, DC offset removed on the way
+    src -= K;
+    for (int i = 0; i < 8; i++) {
+        v0 = src[0] + (128L << 8);
+        v1 = K > 2 ? src[2] : 0;
+        v2 = K > 4 ? src[4] : 0;
+        v3 = K > 6 ? src[6] : 0;
+
+        t10 = v0 + v2;
+        t12 = v0 - v2;
+        t11 = (v1 - v3) * M13 >> 12;
+        v3 += v1;
+        t11 -= v3;
+        v0 = t10 + v3;
+        v3 = t10 - v3;
+        v1 = t11 + t12;
+        v2 = t12 - t11;
+
+        v4 = K > 7 ? src[7] : 0;
+        v5 = src[1];
+        v6 = K > 5 ? src[5] : 0;
+        v7 = K > 3 ? src[3] : 0;
+
+        t10 = v5 - v4;
+        t11 = v5 + v4;
+        t12 = v6 - v7;
+        v7 += v6;
+        v5 = (t11 - v7) * M13 >> 12;
+        v7 += t11;
+        t13 = (t10 + t12) * M5 >> 12;
+        v4 = t13 - (t10 * M2 >> 12);
+        v6 = t13 - (t12 * M4 >> 12) - v7;
+        v5 -= v6;
+        v4 -= v5;
+
+        dst[0] = (int16_t)((v0 + v7) >> 8);
+        dst[7] = (int16_t)((v0 - v7) >> 8);
+        dst[1] = (int16_t)((v1 + v6) >> 8);
+        dst[6] = (int16_t)((v1 - v6) >> 8);
+        dst[2] = (int16_t)((v2 + v5) >> 8);
+        dst[5] = (int16_t)((v2 - v5) >> 8);
+        dst[3] = (int16_t)((v3 + v4) >> 8);
+        dst[4] = (int16_t)((v3 - v4) >> 8);
+
+        dst += 8; src += 8;
+    }
+}
+
+void tjpgd_idct_fast(int32_t *src, int16_t *dst, int ncoef)
+{
+    if (ncoef <= 3) {
+        idct_k<2>(src, dst);
+    } else if (ncoef <= 10) {
+        idct_k<4>(src, dst);
+    } else if (ncoef <= 21) {
+        idct_k<6>(src, dst);
+    } else {
+        idct_k<8>(src, dst);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// YCbCr -> RGB888: upstream reference (mcu_output, RGB part)
+// -----------------------------------------------------------------------------
+void tjpgd_ycc_rgb_ref(const int16_t *mcu, int msx, int msy, uint8_t *pix)
+{
+    const unsigned int mx = msx * 8, my = msy * 8;
+    unsigned int ix, iy;
+    int yy, cb, cr;
+    const int16_t *py, *pc;
+
+    for (iy = 0; iy < my; iy++) {
+        pc = py = mcu;
+        if (my == 16) {     /* Double block height? */
+            pc += 64 * 4 + (iy >> 1) * 8;
+            if (iy >= 8) {
+                py += 64;
+            }
+        } else {            /* Single block height */
+            pc += mx * 8 + iy * 8;
+        }
+        py += iy * 8;
+        for (ix = 0; ix < mx; ix++) {
+            cb = pc[0] - 128;   /* Get Cb/Cr component and remove offset */
+            cr = pc[64] - 128;
+            if (mx == 16) {                 /* Double block width? */
+                if (ix == 8) {
+                    py += 64 - 8;    /* Jump to next block if double block heigt */
+                }
+                /* Step forward chroma pointer every two pixels */
+                if (ix % 2) {
+                    pc++;
+                }
+            } else {                        /* Single block width */
+                pc++;                       /* Step forward chroma pointer every pixel */
+            }
+            yy = *py++;         /* Get Y component */
+            *pix++ = /*R*/ clip8(yy + (K_RV * cr) / CVACC);
+            *pix++ = /*G*/ clip8(yy - (K_GU * cb + K_GV * cr) / CVACC);
+            *pix++ = /*B*/ clip8(yy + (K_BU * cb) / CVACC);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// YCbCr -> RGB888: fast
+//
+// One chroma sample -> three additive terms, applied to the 1 / 2 / 4 luma
+// samples it covers. Same integer expressions as the reference, so the terms
+// (and the result) are identical.
+// -----------------------------------------------------------------------------
+typedef struct {
+    int r;
+    int g;
+    int b;
+} chroma_terms_t;
+
+static inline chroma_terms_t chroma_terms(int cb, int cr)
+{
+    cb -= 128;
+    cr -= 128;
+
+    chroma_terms_t t;
+    t.r = (K_RV * cr) / CVACC;
+    t.g = (K_GU * cb + K_GV * cr) / CVACC;
+    t.b = (K_BU * cb) / CVACC;
+    return t;
+}
+
+static inline void put_rgb(uint8_t *p, int yy, const chroma_terms_t &t)
+{
+    p[0] = clip8(yy + t.r);
+    p[1] = clip8(yy - t.g);
+    p[2] = clip8(yy + t.b);
+}
+
+void tjpgd_ycc_rgb_fast(const int16_t *mcu, int msx, int msy, uint8_t *rgb)
+{
+    if (msx == 1 && msy == 1) {
+        // 4:4:4: Y, Cb, Cr
+        const int16_t *cb = mcu + 64;
+        const int16_t *cr = mcu + 128;
+
+        for (int i = 0; i < 64; i++) {
+            put_rgb(rgb + i * 3, mcu[i], chroma_terms(cb[i], cr[i]));
+        }
+        return;
+    }
+
+    if (msx == 2 && msy == 1) {
+        // 4:2:2: Y0 Y1 (left, right), Cb, Cr; 16x8 pixels
+        const int16_t *cb = mcu + 128;
+        const int16_t *cr = mcu + 192;
+
+        for (int iy = 0; iy < 8; iy++) {
+            uint8_t *row = rgb + iy * 16 * 3;
+
+            for (int cx = 0; cx < 8; cx++) {
+                const chroma_terms_t t = chroma_terms(cb[iy * 8 + cx], cr[iy * 8 + cx]);
+                const int16_t *py = mcu + (cx >> 2) * 64 + iy * 8 + ((cx * 2) & 7);
+
+                put_rgb(row + cx * 6,     py[0], t);
+                put_rgb(row + cx * 6 + 3, py[1], t);
+            }
+        }
+        return;
+    }
+
+    if (msx == 2 && msy == 2) {
+        // 4:2:0: Y0..Y3 (TL, TR, BL, BR), Cb, Cr; 16x16 pixels
+        const int16_t *cb = mcu + 256;
+        const int16_t *cr = mcu + 320;
+
+        for (int cy = 0; cy < 8; cy++) {
+            uint8_t *row0 = rgb + (cy * 2) * 16 * 3;
+            uint8_t *row1 = row0 + 16 * 3;
+
+            for (int cx = 0; cx < 8; cx++) {
+                const chroma_terms_t t = chroma_terms(cb[cy * 8 + cx], cr[cy * 8 + cx]);
+                const int16_t *py = mcu + ((cy >> 2) * 2 + (cx >> 2)) * 64
+                                  + ((cy * 2) & 7) * 8 + ((cx * 2) & 7);
+
+                put_rgb(row0 + cx * 6,     py[0], t);
+                put_rgb(row0 + cx * 6 + 3, py[1], t);
+                put_rgb(row1 + cx * 6,     py[8], t);
+                put_rgb(row1 + cx * 6 + 3, py[9], t);
+            }
+        }
+        return;
+    }
+
+    // 4:4:0 and anything else: rare, keep the upstream loop
+    tjpgd_ycc_rgb_ref(mcu, msx, msy, rgb);
+}
+
+// -----------------------------------------------------------------------------
+// Benchmark / bit-exactness check
+// -----------------------------------------------------------------------------
+#define BENCH_BLOCKS 64
+#define BENCH_MCUS   8
+
+static uint32_t s_rng = 0x12345678u;
+
+static inline uint32_t rnd(void)
+{
+    s_rng = s_rng * 1664525u + 1013904223u;
+    return s_rng >> 8;
+}
+
+static const uint8_t s_zig[64] = {     // zigzag -> raster (tjpgd.c Zig[])
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// De-quantized blocks as mcu_load() hands them to the IDCT, with an EOB mix
+// close to QVGA camera frames: half of them end within 21 coefficients
+static void bench_fill_blocks(int32_t *blk, uint8_t *ncoef, int n)
+{
+    for (int b = 0; b < n; b++, blk += 64) {
+        int nc;
+        switch (b & 7) {
+        case 0:  nc = 2 + (int)(rnd() % 2);   break;
+        case 1:
+        case 2:  nc = 4 + (int)(rnd() % 7);   break;
+        case 3:  nc = 11 + (int)(rnd() % 11); break;
+        default: nc = 22 + (int)(rnd() % 43); break;
+        }
+
+        memset(blk, 0, 64 * sizeof(int32_t));
+        blk[0] = (int32_t)(rnd() % 65536) - 32768;
+        for (int z = 1; z < nc; z++) {
+            if (z == nc - 1 || rnd() % 3 == 0) {
+                blk[s_zig[z]] = (int32_t)(rnd() % 16384) - 8192;
+            }
+        }
+        ncoef[b] = (uint8_t)nc;
+    }
+}
+
+static void bench_idct(int32_t *work, const int32_t *blocks, const uint8_t *ncoef,
+                       int16_t *out, bool fast)
+{
+    memcpy(work, blocks, BENCH_BLOCKS * 64 * sizeof(int32_t));
+
+    for (int b = 0; b < BENCH_BLOCKS; b++) {
+        if (fast) {
+            tjpgd_idct_fast(work + b * 64, out + b * 64, ncoef[b]);
+        } else {
+            tjpgd_idct_ref(work + b * 64, out + b * 64, ncoef[b]);
+        }
+    }
+}
+
+esp_err_t tjpgd_kern_benchmark(int iterations)
+{
+    if (iterations <= 0) return ESP_ERR_INVALID_ARG;
+
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    const size_t blk_bytes = BENCH_BLOCKS * 64 * sizeof(int32_t);
+    const size_t smp_bytes = BENCH_BLOCKS * 64 * sizeof(int16_t);
+    const size_t mcu_len   = 6 * 64;                // 4:2:0, the largest MCU
+    const size_t rgb_bytes = BENCH_MCUS * 16 * 16 * 3;
+
+    uint8_t  ncoef[BENCH_BLOCKS];
+    int32_t *blocks  = (int32_t *)heap_caps_malloc(blk_bytes, caps);
+    int32_t *work    = (int32_t *)heap_caps_malloc(blk_bytes, caps);
+    int16_t *s_ref   = (int16_t *)heap_caps_malloc(smp_bytes, caps);
+    int16_t *s_fast  = (int16_t *)heap_caps_malloc(smp_bytes, caps);
+    int16_t *mcus    = (int16_t *)heap_caps_malloc(BENCH_MCUS * mcu_len * sizeof(int16_t), caps);
+    uint8_t *rgb_ref = (uint8_t *)heap_caps_malloc(rgb_bytes, caps);
+    uint8_t *rgb_fst = (uint8_t *)heap_caps_malloc(rgb_bytes, caps);
+
+    esp_err_t ret = ESP_OK;
+
+    if (!blocks || !work || !s_ref || !s_fast || !mcus || !rgb_ref || !rgb_fst) {
+        ret = ESP_ERR_NO_MEM;
+        goto done;
+    }
+
+    s_rng = 0x12345678u;
+    bench_fill_blocks(blocks, ncoef, BENCH_BLOCKS);
+
+    // Samples around [0, 255] with some over/undershoot to exercise clipping
+    for (size_t i = 0; i < BENCH_MCUS * mcu_len; i++) {
+        mcus[i] = (int16_t)((int)(rnd() % 384) - 64);
+    }
+
+    {
+        int64_t t_ref = 0;
+        int64_t t_fast = 0;
+        bool exact = true;
+
+        for (int it = 0; it < iterations; it++) {
+            int64_t t0 = esp_timer_get_time();
+            bench_idct(work, blocks, ncoef, s_ref, false);
+            int64_t t1 = esp_timer_get_time();
+            bench_idct(work, blocks, ncoef, s_fast, true);
+            int64_t t2 = esp_timer_get_time();
+
+            t_ref  += t1 - t0;
+            t_fast += t2 - t1;
+            exact = exact && memcmp(s_ref, s_fast, smp_bytes) == 0;
+        }
+
+        ESP_LOGI(TAG, "IDCT %d blocks x %d: ref %lld us, fast %lld us (x%.2f)%s",
+                 BENCH_BLOCKS, iterations, (long long)t_ref, (long long)t_fast,
+                 t_fast > 0 ? (double)t_ref / (double)t_fast : 0.0,
+                 exact ? ", bit-exact" : "");
+        if (!exact) {
+            ESP_LOGE(TAG, "IDCT: fast output differs from reference");
+            ret = ESP_FAIL;
+        }
+    }
+
+    {
+        static const struct { int msx, msy; const char *name; } modes[] = {
+            { 1, 1, "4:4:4" }, { 2, 1, "4:2:2" }, { 2, 2, "4:2:0" }, { 1, 2, "4:4:0" },
+        };
+
+        for (const auto &m : modes) {
+            const size_t out_bytes = (size_t)m.msx * m.msy * 64 * 3;
+            int64_t t_ref = 0;
+            int64_t t_fast = 0;
+            bool exact = true;
+
+            for (int it = 0; it < iterations; it++) {
+                int64_t t0 = esp_timer_get_time();
+                for (int k = 0; k < BENCH_MCUS; k++) {
+                    tjpgd_ycc_rgb_ref(mcus + k * mcu_len, m.msx, m.msy, rgb_ref + k * out_bytes);
+                }
+                int64_t t1 = esp_timer_get_time();
+                for (int k = 0; k < BENCH_MCUS; k++) {
+                    tjpgd_ycc_rgb_fast(mcus + k * mcu_len, m.msx, m.msy, rgb_fst + k * out_bytes);
+                }
+                int64_t t2 = esp_timer_get_time();
+
+                t_ref  += t1 - t0;
+                t_fast += t2 - t1;
+                exact = exact && memcmp(rgb_ref, rgb_fst, BENCH_MCUS * out_bytes) == 0;
+            }
+
+            ESP_LOGI(TAG, "YCbCr %s %d MCUs x %d: ref %lld us, fast %lld us (x%.2f)%s",
+                     m.name, BENCH_MCUS, iterations, (long long)t_ref, (long long)t_fast,
+                     t_fast > 0 ? (double)t_ref / (double)t_fast : 0.0,
+                     exact ? ", bit-exact" : "");
+            if (!exact) {
+                ESP_LOGE(TAG, "YCbCr %s: fast output differs from reference", m.name);
+                ret = ESP_FAIL;
+            }
+        }
+    }
+
+done:
+    heap_caps_free(blocks);
+    heap_caps_free(work);
+    heap_caps_free(s_ref);
+    heap_caps_free(s_fast);
+    heap_caps_free(mcus);
+    heap_caps_free(rgb_ref);
+    heap_caps_free(rgb_fst);
+
+    return ret;
+}
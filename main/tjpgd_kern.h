@@ -0,0 +1,58 @@
+// File: main/tjpgd_kern.h
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// TJpgDec pixel kernels (local decoder, tjpgd_local.c)
+//
+// The two per-pixel stages of the decoder, split out so they can be swapped:
+//
+//   idct : 8x8 AAN inverse DCT of one de-quantized block (int32, modified in
+//          place) into int16 samples, level-shifted, not yet clipped.
+//          ncoef: coefficients up to the EOB in zigzag order (2..64), the
+//          rest of the block is zero
+//   ycc  : one full-size MCU (Y blocks, then Cb, Cr) into RGB888
+//
+// *_ref is the upstream TJpgDec R0.03 code. *_fast gives bit-identical
+// output: the IDCT transforms only the top-left corner that can hold non-zero
+// coefficients, the colour conversion computes the chroma terms once per
+// chroma sample instead of once per pixel (2x for 4:2:2, 4x for 4:2:0) and
+// walks the Y blocks without per-pixel branches. Both keep the decoder's
+// block / MCU layout, so a SIMD version can replace either one alone.
+//
+// TJPGD_KERN_FAST selects the pair the decoder is built with.
+// -----------------------------------------------------------------------------
+#ifndef TJPGD_KERN_FAST
+#define TJPGD_KERN_FAST 1
+#endif
+
+void tjpgd_idct_ref(int32_t *src, int16_t *dst, int ncoef);
+void tjpgd_idct_fast(int32_t *src, int16_t *dst, int ncoef);
+
+// msx / msy: MCU size in blocks (1 or 2); rgb: (8 * msx) x (8 * msy) pixels
+void tjpgd_ycc_rgb_ref(const int16_t *mcu, int msx, int msy, uint8_t *rgb);
+void tjpgd_ycc_rgb_fast(const int16_t *mcu, int msx, int msy, uint8_t *rgb);
+
+#if TJPGD_KERN_FAST
+#define tjpgd_idct      tjpgd_idct_fast
+#define tjpgd_ycc_rgb   tjpgd_ycc_rgb_fast
+#else
+#define tjpgd_idct      tjpgd_idct_ref
+#define tjpgd_ycc_rgb   tjpgd_ycc_rgb_ref
+#endif
+
+// Reference vs fast kernels on pseudo-random blocks / MCUs: timing per call
+// and bit-exactness check (ESP_FAIL on any difference)
+esp_err_t tjpgd_kern_benchmark(int iterations);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+// File: main/tjpgd_port.h
+// TJpgDec binding shared by the streaming decoders in main/
+// (local R0.03 copy with swappable pixel kernels by default, otherwise the
+// ROM decoder on ESP32-S3 or the esp_jpeg component copy)
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+// 1: tjpgd_local.c (IDCT / colour kernels from tjpgd_kern, TJPGD_KERN_FAST)
+// 0: whatever esp_jpeg is configured with (CONFIG_JD_USE_ROM)
+#ifndef TJPGD_USE_LOCAL
+#define TJPGD_USE_LOCAL 1
+#endif
+
+#if TJPGD_USE_LOCAL
+#include "tjpgd_local.h"
+
+typedef size_t tjpgd_len_t;
+typedef int    tjpgd_out_t;
+
+#define tjpgd_prepare tjd_prepare
+#define tjpgd_decomp  tjd_decomp
+
+// Worst-case pool use of tjd_prepare() (4:2:0, 4 quantizer tables, full
+// huffman tables): 512 input buffer + 1024 dequantizer tables + ~1.1 KB
+// huffman tables + 6 KB fast-decode LUTs + 768 IDCT / RGB working buffer
+// + 768 MCU samples = ~10.3 KB
+#define TJPGD_WORK_BUF_SIZE 12288
+
+#elif CONFIG_JD_USE_ROM
+#include "rom/tjpgd.h"
+
+// ROM TJpgDec is the older R0.01 API
+typedef unsigned int tjpgd_len_t;
+typedef unsigned int tjpgd_out_t;
+
+#define tjpgd_prepare jd_prepare
+#define tjpgd_decomp  jd_decomp
+
+#define TJPGD_WORK_BUF_SIZE 3100
+
+#else
+#include "tjpgd.h"
+
+#if JD_FORMAT != 0
+#error "main/ decoders expect TJpgDec RGB888 output (CONFIG_JD_FORMAT_RGB888)"
+#endif
+
+typedef size_t tjpgd_len_t;
+typedef int    tjpgd_out_t;
+
+#define tjpgd_prepare jd_prepare
+#define tjpgd_decomp  jd_decomp
+
+#if JD_FASTDECODE == 2
+#define TJPGD_WORK_BUF_SIZE 65472
+#else
+#define TJPGD_WORK_BUF_SIZE 3100
+#endif
+
+#endif
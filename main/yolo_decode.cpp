@@ -0,0 +1,486 @@
+// File: main/yolo_decode.cpp
+
+#include "yolo_decode.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+#include "yolo_nms.h"
+
+static const char *TAG = "YOLO";
+
+#define YOLO_MAX_REG     32
+#define YOLO_MAX_TOPK    16
+#define YOLO_MAX_CLASSES 256
+
+// -----------------------------------------------------------------------------
+// State (built once by yolo_decode_init)
+// -----------------------------------------------------------------------------
+static yolo_decode_cfg_t s_cfg;
+static bool  s_ready = false;
+
+static int   s_anchors  = 0;
+static int   s_channels = 0;
+static int   s_box_ch   = 0;     // 4 or 4 * reg_max
+static int   s_cls_ch   = 0;
+static int   s_q_thresh = 128;
+
+// Element (anchor a, channel c) lives at data[a * s_sa + c * s_sc]
+static int   s_sa = 0;
+static int   s_sc = 0;
+
+// Anchor table: center and stride per anchor, model input pixels
+static float *s_anchor_cx     = nullptr;
+static float *s_anchor_cy     = nullptr;
+static float *s_anchor_stride = nullptr;
+
+// Channel-major scan scratch: running per-anchor best class
+static int8_t  *s_best_q   = nullptr;
+static uint8_t *s_best_cls = nullptr;
+
+// Candidate selection / decode scratch (fixed capacity)
+static yolo_topk_t s_topk;
+static yolo_box_t  s_cand[YOLO_NMS_MAX_TOPK];
+
+// Indexed by (uint8_t)q
+static float s_deq[256];
+static float s_score[256];
+static float s_exp[256];         // exp(dequant(q) - dequant(127)): softmax-safe
+
+static inline int lut_idx(int8_t q)
+{
+    return (uint8_t)q;
+}
+
+static inline int8_t at(const int8_t *data, int a, int c)
+{
+    return data[a * s_sa + c * s_sc];
+}
+
+// -----------------------------------------------------------------------------
+// Anchor table
+// -----------------------------------------------------------------------------
+static int build_anchor_table(const yolo_model_desc_t *d, int in_w, int in_h, bool count_only)
+{
+    int n = 0;
+
+    for (int si = 0; si < d->num_strides; si++) {
+        const int s  = d->strides[si];
+        const int gw = in_w / s;
+        const int gh = in_h / s;
+
+        for (int gy = 0; gy < gh; gy++) {
+            for (int gx = 0; gx < gw; gx++) {
+                if (!count_only) {
+                    s_anchor_cx[n]     = (gx + 0.5f) * s;
+                    s_anchor_cy[n]     = (gy + 0.5f) * s;
+                    s_anchor_stride[n] = (float)s;
+                }
+                n++;
+            }
+        }
+    }
+
+    return n;
+}
+
+esp_err_t yolo_decode_init(const yolo_decode_cfg_t *cfg)
+{
+    if (s_ready) {
+        ESP_LOGW(TAG, "Decoder already initialized");
+        return ESP_OK;
+    }
+
+    if (!cfg || cfg->dim1 <= 0 || cfg->dim2 <= 0 ||
+        cfg->input_w <= 0 || cfg->input_h <= 0 || cfg->out_scale <= 0.0f ||
+        cfg->desc.num_strides < 0 || cfg->desc.num_strides > YOLO_MAX_STRIDES ||
+        cfg->nms_topk <= 0 || cfg->nms_topk > YOLO_NMS_MAX_TOPK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    s_cfg = *cfg;
+    yolo_model_desc_t *d = &s_cfg.desc;
+
+    // -------------------------------------------------
+    // Layout from dims + descriptor
+    // -------------------------------------------------
+    if (d->layout == YOLO_LAYOUT_CHANNEL_MAJOR) {
+        s_channels = cfg->dim1;
+        s_anchors  = cfg->dim2;
+        s_sa = 1;
+        s_sc = s_anchors;
+    } else {
+        s_anchors  = cfg->dim1;
+        s_channels = cfg->dim2;
+        s_sa = s_channels;
+        s_sc = 1;
+    }
+
+    if (d->box_format == YOLO_BOX_DFL) {
+        if (d->reg_max <= 0 || d->reg_max > YOLO_MAX_REG) return ESP_ERR_INVALID_ARG;
+        s_box_ch = 4 * d->reg_max;
+    } else {
+        s_box_ch = 4;
+    }
+
+    s_cls_ch = s_channels - s_box_ch;
+
+    if (s_cls_ch <= 0 || s_cls_ch > YOLO_MAX_CLASSES ||
+        (d->num_classes > 0 && d->num_classes != s_cls_ch)) {
+        ESP_LOGE(TAG, "Layout mismatch: dims [%d x %d], %s, box=%d ch, nc=%d",
+                 cfg->dim1, cfg->dim2,
+                 d->layout == YOLO_LAYOUT_CHANNEL_MAJOR ? "channel-major" : "anchor-major",
+                 s_box_ch, d->num_classes);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    d->num_classes = s_cls_ch;
+
+    // -------------------------------------------------
+    // Anchors: stride pyramid, else one square grid
+    // -------------------------------------------------
+    if (d->num_strides > 0 &&
+        build_anchor_table(d, cfg->input_w, cfg->input_h, true) != s_anchors) {
+        ESP_LOGW(TAG, "%d anchors do not match the stride table, trying a single grid", s_anchors);
+        d->num_strides = 0;
+    }
+
+    if (d->num_strides == 0) {
+        const int grid = (int)roundf(sqrtf((float)s_anchors));
+        if (grid * grid != s_anchors || cfg->input_w % grid != 0) {
+            ESP_LOGE(TAG, "No anchor layout fits %d anchors", s_anchors);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        d->strides[0]  = cfg->input_w / grid;
+        d->num_strides = 1;
+    }
+
+    const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+    s_anchor_cx     = (float *)heap_caps_malloc(s_anchors * sizeof(float), caps);
+    s_anchor_cy     = (float *)heap_caps_malloc(s_anchors * sizeof(float), caps);
+    s_anchor_stride = (float *)heap_caps_malloc(s_anchors * sizeof(float), caps);
+    s_best_q        = (int8_t *)heap_caps_malloc(s_anchors, caps);
+    s_best_cls      = (uint8_t *)heap_caps_malloc(s_anchors, caps);
+
+    if (!s_anchor_cx || !s_anchor_cy || !s_anchor_stride || !s_best_q || !s_best_cls) {
+        ESP_LOGE(TAG, "Anchor table alloc failed");
+        free(s_anchor_cx); free(s_anchor_cy); free(s_anchor_stride);
+        free(s_best_q); free(s_best_cls);
+        s_anchor_cx = s_anchor_cy = s_anchor_stride = nullptr;
+        s_best_q = nullptr;
+        s_best_cls = nullptr;
+        return ESP_ERR_NO_MEM;
+    }
+
+    build_anchor_table(d, cfg->input_w, cfg->input_h, false);
+
+    // -------------------------------------------------
+    // Value tables + int8 threshold
+    // -------------------------------------------------
+    const float deq_max = (127 - cfg->out_zero_point) * cfg->out_scale;
+
+    for (int q = -128; q <= 127; q++) {
+        const float x = (q - cfg->out_zero_point) * cfg->out_scale;
+        s_deq[lut_idx((int8_t)q)]   = x;
+        s_score[lut_idx((int8_t)q)] = d->cls_activated ? x : 1.0f / (1.0f + expf(-x));
+        s_exp[lut_idx((int8_t)q)]   = expf(x - deq_max);
+    }
+
+    // Smallest raw value whose score reaches the threshold; evaluated with
+    // the same float math, so the int8 test matches the float one.
+    s_q_thresh = 128;
+    for (int q = -128; q <= 127; q++) {
+        if (s_score[lut_idx((int8_t)q)] >= cfg->conf_thresh) {
+            s_q_thresh = q;
+            break;
+        }
+    }
+
+    s_ready = true;
+
+    ESP_LOGI(TAG, "Decoder: dims [%d x %d] %s, %s box (%d ch), nc=%d, anchors=%d, strides=%d/%d/%d (%d levels), CONF_THRESH=%.2f → q>=%d",
+             cfg->dim1, cfg->dim2,
+             d->layout == YOLO_LAYOUT_CHANNEL_MAJOR ? "channel-major" : "anchor-major",
+             d->box_format == YOLO_BOX_DFL ? "DFL" : "xywh", s_box_ch,
+             s_cls_ch, s_anchors,
+             d->strides[0],
+             d->num_strides > 1 ? d->strides[1] : 0,
+             d->num_strides > 2 ? d->strides[2] : 0,
+             d->num_strides,
+             (double)cfg->conf_thresh, s_q_thresh);
+    ESP_LOGI(TAG, "NMS: top-%d candidates, IoU > %.2f, %s",
+             cfg->nms_topk, (double)cfg->nms_iou_thresh,
+             cfg->nms_class_aware ? "class-aware" : "class-agnostic");
+
+    return ESP_OK;
+}
+
+int yolo_decode_q_thresh(void)
+{
+    return s_q_thresh;
+}
+
+float yolo_decode_dequant(int8_t q)
+{
+    return s_deq[lut_idx(q)];
+}
+
+float yolo_decode_score(int8_t q)
+{
+    return s_score[lut_idx(q)];
+}
+
+// -----------------------------------------------------------------------------
+// Survivor decode
+// -----------------------------------------------------------------------------
+static void decode_box(const int8_t *data, int a, int8_t best_q, int best_cls, yolo_box_t *box)
+{
+    const yolo_model_desc_t *d = &s_cfg.desc;
+
+    if (d->box_format == YOLO_BOX_XYWH) {
+        float cx = s_deq[lut_idx(at(data, a, 0))];
+        float cy = s_deq[lut_idx(at(data, a, 1))];
+        float w  = s_deq[lut_idx(at(data, a, 2))];
+        float h  = s_deq[lut_idx(at(data, a, 3))];
+
+        if (d->xywh_normalized) {
+            cx *= s_cfg.input_w;  w *= s_cfg.input_w;
+            cy *= s_cfg.input_h;  h *= s_cfg.input_h;
+        }
+
+        box->x = cx - 0.5f * w;
+        box->y = cy - 0.5f * h;
+        box->w = w;
+        box->h = h;
+    } else {
+        // DFL: softmax expectation per side (l, t, r, b), table exp
+        const int reg_max = d->reg_max;
+        float dist[4];
+
+        for (int s = 0; s < 4; s++) {
+            float sum = 0.0f;
+            float acc = 0.0f;
+
+            for (int k = 0; k < reg_max; k++) {
+                const float e = s_exp[lut_idx(at(data, a, s * reg_max + k))];
+                sum += e;
+                acc += k * e;
+            }
+            dist[s] = acc / sum;
+        }
+
+        const float st = s_anchor_stride[a];
+        const float cx = s_anchor_cx[a];
+        const float cy = s_anchor_cy[a];
+
+        box->x = cx - dist[0] * st;
+        box->y = cy - dist[1] * st;
+        box->w = (dist[0] + dist[2]) * st;
+        box->h = (dist[1] + dist[3]) * st;
+    }
+
+    box->score = s_score[lut_idx(best_q)];
+    box->cls   = best_cls;
+}
+
+// -----------------------------------------------------------------------------
+// Scan: per-anchor argmax (first max wins) + whole-tensor stats
+// -----------------------------------------------------------------------------
+static inline void acc_stats(const int8_t *p, int n, int8_t *mn, int8_t *mx, int64_t *sum)
+{
+    int8_t  lo = *mn, hi = *mx;
+    int32_t s  = 0;
+
+    for (int i = 0; i < n; i++) {
+        const int8_t v = p[i];
+        if (v < lo) lo = v;
+        if (v > hi) hi = v;
+        s += v;
+    }
+
+    *mn = lo;
+    *mx = hi;
+    *sum += s;
+}
+
+// Channel-major: every channel is a contiguous row of s_anchors values, so
+// the argmax runs row by row against the per-anchor running best.
+static void scan_channel_major(const int8_t *data, yolo_scan_stats_t *stats)
+{
+    const int A = s_anchors;
+
+    if (stats) {
+        acc_stats(data, s_box_ch * A, &stats->q_min, &stats->q_max, &stats->q_sum);
+    }
+
+    const int8_t *row = data + s_box_ch * A;
+    memcpy(s_best_q, row, A);
+    memset(s_best_cls, 0, A);
+    if (stats) acc_stats(row, A, &stats->q_min, &stats->q_max, &stats->q_sum);
+
+    for (int c = 1; c < s_cls_ch; c++) {
+        row = data + (s_box_ch + c) * A;
+
+        for (int a = 0; a < A; a++) {
+            const int8_t v = row[a];
+            if (v > s_best_q[a]) {
+                s_best_q[a]   = v;
+                s_best_cls[a] = (uint8_t)c;
+            }
+        }
+
+        if (stats) acc_stats(row, A, &stats->q_min, &stats->q_max, &stats->q_sum);
+    }
+}
+
+// Anchor-major: each anchor's channels are contiguous
+static void scan_anchor_major(const int8_t *data, yolo_scan_stats_t *stats)
+{
+    for (int a = 0; a < s_anchors; a++) {
+        const int8_t *cell = data + a * s_channels;
+        const int8_t *cls  = cell + s_box_ch;
+
+        int8_t best_q   = cls[0];
+        int    best_cls = 0;
+
+        for (int c = 1; c < s_cls_ch; c++) {
+            if (cls[c] > best_q) {
+                best_q   = cls[c];
+                best_cls = c;
+            }
+        }
+
+        s_best_q[a]   = best_q;
+        s_best_cls[a] = (uint8_t)best_cls;
+
+        if (stats) acc_stats(cell, s_channels, &stats->q_min, &stats->q_max, &stats->q_sum);
+    }
+}
+
+int yolo_decode(
+    const int8_t *data,
+    yolo_box_t *boxes,
+    int max_boxes,
+    yolo_scan_stats_t *stats)
+{
+    if (!s_ready || !data) return 0;
+
+    int64_t t0 = esp_timer_get_time();
+
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->q_min     = 127;
+        stats->q_max     = -128;
+        stats->best_q    = -128;
+        stats->best_cell = -1;
+        stats->best_cls  = -1;
+    }
+
+    if (s_cfg.desc.layout == YOLO_LAYOUT_CHANNEL_MAJOR) {
+        scan_channel_major(data, stats);
+    } else {
+        scan_anchor_major(data, stats);
+    }
+
+    // -------------------------------------------------
+    // Threshold on raw int8 → top-K heap
+    // -------------------------------------------------
+    int8_t g_best_q    = -128;
+    int    g_best_cell = -1;
+
+    yolo_topk_reset(&s_topk, s_cfg.nms_topk);
+
+    for (int a = 0; a < s_anchors; a++) {
+        const int8_t q = s_best_q[a];
+
+        if (q > g_best_q || g_best_cell < 0) {
+            g_best_q    = q;
+            g_best_cell = a;
+        }
+
+        if (q >= s_q_thresh) {
+            yolo_topk_push(&s_topk, a, q);
+        }
+    }
+
+    const int candidates = s_topk.pushed;
+    const int n_in = yolo_topk_sort(&s_topk);
+
+    int64_t t1 = esp_timer_get_time();
+
+    // -------------------------------------------------
+    // Decode the K best only, then NMS
+    // -------------------------------------------------
+    for (int i = 0; i < n_in; i++) {
+        const int a = yolo_topk_anchor(&s_topk, i);
+        decode_box(data, a, yolo_topk_q(&s_topk, i), s_best_cls[a], &s_cand[i]);
+    }
+
+    int suppressed = 0;
+    const int found = yolo_nms(s_cand, n_in,
+                               s_cfg.nms_iou_thresh, s_cfg.nms_class_aware,
+                               max_boxes, &suppressed);
+
+    memcpy(boxes, s_cand, found * sizeof(yolo_box_t));
+
+    int64_t t2 = esp_timer_get_time();
+
+    if (stats) {
+        stats->count      = s_anchors * s_channels;
+        stats->best_q     = g_best_q;
+        stats->best_cell  = g_best_cell;
+        stats->best_cls   = g_best_cell >= 0 ? s_best_cls[g_best_cell] : -1;
+        stats->best_score = g_best_cell >= 0 ? s_score[lut_idx(g_best_q)] : 0.0f;
+        stats->candidates = candidates;
+        stats->nms_in     = n_in;
+        stats->suppressed = suppressed;
+        stats->scan_us    = (int32_t)(t1 - t0);
+        stats->nms_us     = (int32_t)(t2 - t1);
+    }
+
+    return found;
+}
+
+// -----------------------------------------------------------------------------
+// Top-k on raw int8 (small k: insertion into a sorted array)
+// -----------------------------------------------------------------------------
+int yolo_decode_topk_at_cell(
+    const int8_t *data,
+    int cell,
+    int k,
+    int *cls,
+    float *score)
+{
+    if (!s_ready || !data || cell < 0 || cell >= s_anchors || k <= 0) return 0;
+    if (k > YOLO_MAX_TOPK) k = YOLO_MAX_TOPK;
+    if (k > s_cls_ch)      k = s_cls_ch;
+
+    int8_t top_q[YOLO_MAX_TOPK];
+    int    top_c[YOLO_MAX_TOPK];
+    int    n = 0;
+
+    for (int c = 0; c < s_cls_ch; c++) {
+        const int8_t v = at(data, cell, s_box_ch + c);
+        if (n == k && v <= top_q[n - 1]) continue;
+
+        int j = (n < k) ? n++ : n - 1;
+        while (j > 0 && top_q[j - 1] < v) {
+            top_q[j] = top_q[j - 1];
+            top_c[j] = top_c[j - 1];
+            j--;
+        }
+        top_q[j] = v;
+        top_c[j] = c;
+    }
+
+    for (int i = 0; i < n; i++) {
+        cls[i]   = top_c[i];
+        score[i] = s_score[lut_idx(top_q[i])];
+    }
+
+    return n;
+}
@@ -0,0 +1,134 @@
+// File: main/yolo_decode.h
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// YOLO output decoder working in the int8 domain
+//
+// Sigmoid is monotonic, so "sigmoid(dequant(q)) >= conf_thresh" is the same
+// test as "q >= q_thresh" with q_thresh derived once from the output tensor's
+// scale / zero_point. One pass over the raw int8 tensor does the per-anchor
+// argmax, the threshold test and all per-frame statistics; only surviving
+// anchors are dequantized and decoded. Scores and DFL exp come from 256-entry
+// tables indexed by the raw value, so no expf() runs per frame.
+//
+// The tensor layout is described by yolo_model_desc_t plus the tensor dims:
+//   channel-major [1 x (box + nc) x anchors]  (Ultralytics TFLite export)
+//   anchor-major  [1 x anchors x (box + nc)]
+// box = 4 pre-decoded xywh values, or 4 * reg_max DFL bins.
+// Anchor centers / strides come from a table built at init for the given
+// strides (e.g. 8/16/32 at 192 px: 24² + 12² + 6² = 756 anchors).
+//
+// Anchors above threshold feed a fixed top-K heap; only those K are decoded
+// and passed through class-aware NMS (yolo_nms.h) before boxes are returned.
+// -----------------------------------------------------------------------------
+typedef struct {
+    float x, y, w, h;       // top-left + size, model input pixels
+    float score;
+    int   cls;
+} yolo_box_t;
+
+typedef enum {
+    YOLO_LAYOUT_CHANNEL_MAJOR = 0,  // [1 x C x anchors]
+    YOLO_LAYOUT_ANCHOR_MAJOR,       // [1 x anchors x C]
+} yolo_layout_t;
+
+typedef enum {
+    YOLO_BOX_XYWH = 0,      // 4 channels: cx, cy, w, h
+    YOLO_BOX_DFL,           // 4 * reg_max channels: l, t, r, b distributions
+} yolo_box_format_t;
+
+#define YOLO_MAX_STRIDES 4
+
+typedef struct {
+    yolo_layout_t     layout;
+    yolo_box_format_t box_format;
+    int   num_classes;          // 0: derive from tensor dims
+    int   reg_max;              // DFL bins (YOLO_BOX_DFL only)
+    bool  xywh_normalized;      // XYWH in 0..1 of the input size
+    bool  cls_activated;        // class channels already hold probabilities
+
+    int   strides[YOLO_MAX_STRIDES];
+    int   num_strides;          // 0: single square grid from the anchor count
+} yolo_model_desc_t;
+
+typedef struct {
+    yolo_model_desc_t desc;
+
+    int   dim1;                 // output tensor dims[1], dims[2]
+    int   dim2;
+    int   input_w;              // model input size
+    int   input_h;
+
+    float conf_thresh;
+
+    int   nms_topk;             // candidates decoded per frame (<= YOLO_NMS_MAX_TOPK)
+    float nms_iou_thresh;
+    bool  nms_class_aware;
+
+    float out_scale;            // output tensor quant params
+    int   out_zero_point;
+} yolo_decode_cfg_t;
+
+// Everything the diagnostics used to gather in separate passes
+typedef struct {
+    // Whole tensor (all channels), raw int8
+    int      count;
+    int8_t   q_min;
+    int8_t   q_max;
+    int64_t  q_sum;
+
+    // Global best class value
+    int8_t   best_q;
+    int      best_cell;     // anchor index, -1 if none
+    int      best_cls;
+    float    best_score;
+
+    int      candidates;    // anchors at or above the int8 threshold
+    int      nms_in;        // candidates kept by the top-K heap and decoded
+    int      suppressed;    // removed by NMS overlap
+
+    int32_t  scan_us;       // scan + threshold + top-K
+    int32_t  nms_us;        // survivor decode + NMS
+} yolo_scan_stats_t;
+
+esp_err_t yolo_decode_init(const yolo_decode_cfg_t *cfg);
+
+// Quantized threshold: class values >= this pass conf_thresh.
+// 128 means nothing can pass.
+int yolo_decode_q_thresh(void);
+
+// Scan + select + decode + NMS. Returns boxes written (<= max_boxes),
+// best score first. stats may be NULL.
+int yolo_decode(
+    const int8_t *data,
+    yolo_box_t *boxes,
+    int max_boxes,
+    yolo_scan_stats_t *stats
+);
+
+// Top-k classes at one anchor, selected on raw int8 and converted at the end.
+// Returns entries written to cls / score (<= k).
+int yolo_decode_topk_at_cell(
+    const int8_t *data,
+    int cell,
+    int k,
+    int *cls,
+    float *score
+);
+
+// Dequantize / score one raw output value via the tables
+float yolo_decode_dequant(int8_t q);
+float yolo_decode_score(int8_t q);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,172 @@
+// File: main/yolo_nms.cpp
+
+#include "yolo_nms.h"
+
+#include <math.h>
+
+// -----------------------------------------------------------------------------
+// Top-K min-heap (root = worst kept candidate)
+// -----------------------------------------------------------------------------
+void yolo_topk_reset(yolo_topk_t *h, int capacity)
+{
+    if (capacity > YOLO_NMS_MAX_TOPK) capacity = YOLO_NMS_MAX_TOPK;
+    if (capacity < 1) capacity = 1;
+
+    h->count    = 0;
+    h->capacity = capacity;
+    h->pushed   = 0;
+}
+
+static void sift_down(int32_t *k, int n, int i)
+{
+    const int32_t v = k[i];
+
+    while (true) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && k[c + 1] < k[c]) c++;
+        if (k[c] >= v) break;
+        k[i] = k[c];
+        i = c;
+    }
+
+    k[i] = v;
+}
+
+void yolo_topk_push(yolo_topk_t *h, int anchor, int8_t q)
+{
+    const int32_t key = (((int32_t)q + 128) << 16) | (0xFFFF - (anchor & 0xFFFF));
+
+    h->pushed++;
+
+    if (h->count < h->capacity) {
+        // Sift up
+        int i = h->count++;
+        while (i > 0) {
+            const int p = (i - 1) / 2;
+            if (h->key[p] <= key) break;
+            h->key[i] = h->key[p];
+            i = p;
+        }
+        h->key[i] = key;
+        return;
+    }
+
+    if (key <= h->key[0]) return;   // not better than the current K-th best
+
+    h->key[0] = key;
+    sift_down(h->key, h->count, 0);
+}
+
+int yolo_topk_sort(yolo_topk_t *h)
+{
+    // Heap sort on a min-heap: repeatedly move the minimum to the end,
+    // leaving the array in descending key order
+    int32_t *k = h->key;
+    const int n = h->count;
+
+    for (int end = n - 1; end > 0; end--) {
+        const int32_t t = k[0];
+        k[0]   = k[end];
+        k[end] = t;
+        sift_down(k, end, 0);
+    }
+
+    h->count = 0;
+    return n;
+}
+
+// -----------------------------------------------------------------------------
+// NMS in 1/16 px fixed point
+// -----------------------------------------------------------------------------
+#define NMS_FRAC_BITS 4
+#define NMS_IOU_BITS  8
+#define NMS_COORD_MAX 32767
+
+typedef struct {
+    int32_t x1, y1, x2, y2;
+    int32_t area;
+} nms_rect_t;
+
+static int32_t to_fixed(float v)
+{
+    float f = v * (1 << NMS_FRAC_BITS);
+    if (f < -NMS_COORD_MAX) f = -NMS_COORD_MAX;
+    if (f >  NMS_COORD_MAX) f =  NMS_COORD_MAX;
+    return (int32_t)lrintf(f);
+}
+
+static void to_rect(const yolo_box_t *b, nms_rect_t *r)
+{
+    r->x1 = to_fixed(b->x);
+    r->y1 = to_fixed(b->y);
+    r->x2 = to_fixed(b->x + b->w);
+    r->y2 = to_fixed(b->y + b->h);
+
+    const int32_t w = r->x2 > r->x1 ? r->x2 - r->x1 : 0;
+    const int32_t h = r->y2 > r->y1 ? r->y2 - r->y1 : 0;
+    r->area = (int32_t)(((int64_t)w * h) >> NMS_FRAC_BITS);   // keep in int32
+}
+
+// IoU(a, b) > t  ⇔  inter * 2^IOU_BITS > t_q * union
+static bool iou_above(const nms_rect_t *a, const nms_rect_t *b, int32_t t_q)
+{
+    const int32_t ix1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    const int32_t iy1 = a->y1 > b->y1 ? a->y1 : b->y1;
+    const int32_t ix2 = a->x2 < b->x2 ? a->x2 : b->x2;
+    const int32_t iy2 = a->y2 < b->y2 ? a->y2 : b->y2;
+
+    if (ix2 <= ix1 || iy2 <= iy1) return false;
+
+    const int64_t inter = ((int64_t)(ix2 - ix1) * (iy2 - iy1)) >> NMS_FRAC_BITS;
+    const int64_t uni   = (int64_t)a->area + b->area - inter;
+    if (uni <= 0) return false;
+
+    return (inter << NMS_IOU_BITS) > (int64_t)t_q * uni;
+}
+
+int yolo_nms(
+    yolo_box_t *boxes,
+    int n,
+    float iou_thresh,
+    bool class_aware,
+    int max_out,
+    int *suppressed)
+{
+    if (n > YOLO_NMS_MAX_TOPK) n = YOLO_NMS_MAX_TOPK;
+
+    nms_rect_t rect[YOLO_NMS_MAX_TOPK];
+    bool       dead[YOLO_NMS_MAX_TOPK];
+
+    for (int i = 0; i < n; i++) {
+        to_rect(&boxes[i], &rect[i]);
+        dead[i] = false;
+    }
+
+    const int32_t t_q = (int32_t)lrintf(iou_thresh * (1 << NMS_IOU_BITS));
+
+    int kept = 0;
+    int supp = 0;
+
+    for (int i = 0; i < n && kept < max_out; i++) {
+        if (dead[i]) continue;
+
+        boxes[kept++] = boxes[i];
+
+        // Early termination: nothing further can be kept
+        if (kept == max_out) break;
+
+        for (int j = i + 1; j < n; j++) {
+            if (dead[j]) continue;
+            if (class_aware && boxes[j].cls != boxes[i].cls) continue;
+
+            if (iou_above(&rect[i], &rect[j], t_q)) {
+                dead[j] = true;
+                supp++;
+            }
+        }
+    }
+
+    if (suppressed) *suppressed = supp;
+    return kept;
+}
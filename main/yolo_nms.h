@@ -0,0 +1,64 @@
+// File: main/yolo_nms.h
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "yolo_decode.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+// Fixed-capacity candidate selection + class-aware NMS
+//
+// Candidates above threshold go through a top-K min-heap keyed on the raw
+// int8 score, so only the K best are ever decoded, however many anchors fire.
+// Suppression compares boxes in 1/16 px integer coordinates with an integer
+// IoU test and stops as soon as max_out boxes are kept. Worst-case cost is
+// O(N log K) selection + O(K²) IoU; no heap allocation anywhere.
+// -----------------------------------------------------------------------------
+#define YOLO_NMS_MAX_TOPK 128
+
+typedef struct {
+    int32_t key[YOLO_NMS_MAX_TOPK];     // (q + 128) << 16 | (0xFFFF - anchor)
+    int     count;
+    int     capacity;
+    int     pushed;                     // candidates offered this frame
+} yolo_topk_t;
+
+void yolo_topk_reset(yolo_topk_t *h, int capacity);
+
+// O(log K); rejected immediately when worse than the current K-th best
+void yolo_topk_push(yolo_topk_t *h, int anchor, int8_t q);
+
+// Sorts the heap in place, best first (ties: lower anchor first), and
+// returns the entry count. The heap is consumed.
+int yolo_topk_sort(yolo_topk_t *h);
+
+static inline int yolo_topk_anchor(const yolo_topk_t *h, int i)
+{
+    return 0xFFFF - (h->key[i] & 0xFFFF);
+}
+
+static inline int8_t yolo_topk_q(const yolo_topk_t *h, int i)
+{
+    return (int8_t)((h->key[i] >> 16) - 128);
+}
+
+// boxes: n entries sorted best first. Kept boxes are compacted to the front
+// (order preserved); returns how many, <= max_out. *suppressed counts boxes
+// removed by overlap (optional).
+int yolo_nms(
+    yolo_box_t *boxes,
+    int n,
+    float iou_thresh,
+    bool class_aware,
+    int max_out,
+    int *suppressed
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+# File: tools/capture_extract.py
+#
+# Lists and extracts the segmented capture store written by
+# main/capture_store.cpp (seg_NNNNNN.cap + seg_NNNNNN.idx).
+#
+#   capture_extract.py list    /path/to/capture
+#   capture_extract.py extract /path/to/capture -o frames/ [--type jpeg] [--seq 100-200]
+#
+# Records are located through the segment's .idx when it is present and
+# valid, then by scanning on from the last indexed record (records queued
+# after the last index rewrite); without an index the whole segment is
+# scanned. Scanning stops at the first record whose header does not validate
+# (end of data or the pre-allocated, never written tail). Every payload is
+# checked against its CRC. Output names match the old per-file layout.
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+SEG_MAGIC = 0x53504143  # "CAPS"
+REC_MAGIC = 0x52504143  # "CAPR"
+IDX_MAGIC = 0x49504143  # "CAPI"
+
+SEG_HDR = struct.Struct("<IHHIIqII")        # 32 B
+REC_HDR = struct.Struct("<IHHIIqHHII")      # 36 B
+IDX_HDR = struct.Struct("<IHHIIII")         # 24 B
+IDX_ENTRY = struct.Struct("<IIIHHq")        # 24 B
+
+REC_JPEG, REC_RGB888_CROP, REC_RGB888_LETTERBOX = 1, 2, 3
+TYPE_NAMES = {REC_JPEG: "jpeg", REC_RGB888_CROP: "crop", REC_RGB888_LETTERBOX: "letterbox"}
+
+
+def crc32(data, seed):
+    return zlib.crc32(data, seed) & 0xFFFFFFFF
+
+
+class Record:
+    def __init__(self, offset, rtype, seq, length, time_us, width, height, ok):
+        self.offset, self.type, self.seq, self.len = offset, rtype, seq, length
+        self.time_us, self.width, self.height, self.ok = time_us, width, height, ok
+
+    def file_name(self):
+        if self.type == REC_JPEG:
+            return "frame_%06u.jpg" % self.seq
+        if self.type == REC_RGB888_CROP:
+            return "frame_%06u_cropped.ppm" % self.seq
+        if self.type == REC_RGB888_LETTERBOX:
+            return "frame_%06u_rgb%u.ppm" % (self.seq, self.width)
+        return "frame_%06u_type%u.bin" % (self.seq, self.type)
+
+
+class Segment:
+    def __init__(self, path):
+        self.path = path
+        with open(path, "rb") as f:
+            self.data = f.read()
+
+        if len(self.data) < SEG_HDR.size:
+            raise ValueError("too short")
+        (magic, version, hdr_bytes, self.number, self.nonce,
+         self.created_us, self.size, hdr_crc) = SEG_HDR.unpack_from(self.data, 0)
+        if magic != SEG_MAGIC or crc32(self.data[:SEG_HDR.size - 4], 0) != hdr_crc:
+            raise ValueError("bad segment header")
+        if version != 1:
+            raise ValueError("unsupported version %d" % version)
+        self.first = hdr_bytes
+
+    def _record_at(self, off):
+        """Record at off, or None if no valid header is there."""
+        if off + REC_HDR.size > len(self.data):
+            return None
+        (magic, rtype, hdr_bytes, seq, length, time_us, width, height,
+         payload_crc, hdr_crc) = REC_HDR.unpack_from(self.data, off)
+        if magic != REC_MAGIC:
+            return None
+        if crc32(self.data[off:off + REC_HDR.size - 4], self.nonce) != hdr_crc:
+            return None
+        start = off + hdr_bytes
+        if start + length > len(self.data):
+            return None
+        ok = crc32(self.data[start:start + length], self.nonce) == payload_crc
+        rec = Record(off, rtype, seq, length, time_us, width, height, ok)
+        rec.payload_at = start
+        rec.end = start + length
+        return rec
+
+    def _index_offsets(self):
+        idx_path = os.path.splitext(self.path)[0] + ".idx"
+        if not os.path.exists(idx_path):
+            return None
+        with open(idx_path, "rb") as f:
+            idx = f.read()
+        if len(idx) < IDX_HDR.size:
+            return None
+        magic, _version, entry_bytes, number, nonce, count, crc = IDX_HDR.unpack_from(idx, 0)
+        entries = idx[IDX_HDR.size:IDX_HDR.size + count * entry_bytes]
+        if (magic != IDX_MAGIC or number != self.number or nonce != self.nonce or
+                len(entries) != count * entry_bytes or crc32(entries, nonce) != crc):
+            print("%s: index does not match, scanning" % idx_path, file=sys.stderr)
+            return None
+        return [IDX_ENTRY.unpack_from(entries, i * entry_bytes)[0] for i in range(count)]
+
+    def records(self):
+        recs = []
+        off = self.first
+
+        for at in self._index_offsets() or []:
+            rec = self._record_at(at)
+            if rec is None:
+                print("%s: indexed record @%u missing (write error?)" % (self.path, at),
+                      file=sys.stderr)
+                continue
+            recs.append(rec)
+            off = rec.end
+
+        while True:
+            rec = self._record_at(off)
+            if rec is None:
+                break
+            recs.append(rec)
+            off = rec.end
+
+        self.used = off
+        return recs
+
+    def payload(self, rec):
+        return self.data[rec.payload_at:rec.end]
+
+
+def segment_paths(inputs):
+    paths = []
+    for p in inputs:
+        if os.path.isdir(p):
+            paths += [os.path.join(p, n) for n in os.listdir(p)
+                      if n.lower().startswith("seg_") and n.lower().endswith(".cap")]
+        else:
+            paths.append(p)
+    return sorted(paths)
+
+
+def parse_seq(text):
+    if not text:
+        return None
+    lo, _, hi = text.partition("-")
+    return int(lo), int(hi) if hi else int(lo)
+
+
+def selected(rec, args):
+    if args.type and TYPE_NAMES.get(rec.type) != args.type:
+        return False
+    seq = parse_seq(args.seq)
+    return not seq or seq[0] <= rec.seq <= seq[1]
+
+
+def cmd_list(args):
+    for path in segment_paths(args.inputs):
+        try:
+            seg = Segment(path)
+        except (OSError, ValueError) as e:
+            print("%s: %s" % (path, e))
+            continue
+        recs = seg.records()
+        bad = sum(not r.ok for r in recs)
+        print("%s: segment %u, %u records, %u/%u KB used%s" % (
+            path, seg.number, len(recs), seg.used // 1024, seg.size // 1024,
+            ", %u CRC errors" % bad if bad else ""))
+        if args.verbose:
+            for r in recs:
+                if selected(r, args):
+                    print("  @%-10u seq=%-6u %-9s %6u B %ux%u t=%d%s" % (
+                        r.offset, r.seq, TYPE_NAMES.get(r.type, str(r.type)), r.len,
+                        r.width, r.height, r.time_us, "" if r.ok else "  CRC ERROR"))
+
+
+def cmd_extract(args):
+    os.makedirs(args.out, exist_ok=True)
+    written = skipped = 0
+
+    for path in segment_paths(args.inputs):
+        try:
+            seg = Segment(path)
+        except (OSError, ValueError) as e:
+            print("%s: %s" % (path, e), file=sys.stderr)
+            continue
+
+        for rec in seg.records():
+            if not selected(rec, args):
+                continue
+            if not rec.ok and not args.keep_corrupt:
+                print("%s: seq %u %s: CRC error, skipped" % (
+                    path, rec.seq, TYPE_NAMES.get(rec.type, rec.type)), file=sys.stderr)
+                skipped += 1
+                continue
+
+            with open(os.path.join(args.out, rec.file_name()), "wb") as f:
+                if rec.type in (REC_RGB888_CROP, REC_RGB888_LETTERBOX):
+                    f.write(b"P6\n%d %d\n255\n" % (rec.width, rec.height))
+                f.write(seg.payload(rec))
+            written += 1
+
+    print("%u files written to %s, %u skipped" % (written, args.out, skipped))
+
+
+def main():
+    ap = argparse.ArgumentParser(description="List / extract capture store segments")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    for name in ("list", "extract"):
+        p = sub.add_parser(name)
+        p.add_argument("inputs", nargs="+", help="capture directory or seg_*.cap files")
+        p.add_argument("--type", choices=sorted(TYPE_NAMES.values()))
+        p.add_argument("--seq", help="frame sequence number or range A-B")
+        if name == "list":
+            p.add_argument("-v", "--verbose", action="store_true", help="one line per record")
+        else:
+            p.add_argument("-o", "--out", required=True, help="output directory")
+            p.add_argument("--keep-corrupt", action="store_true",
+                           help="write records whose payload CRC does not match")
+
+    args = ap.parse_args()
+    (cmd_list if args.cmd == "list" else cmd_extract)(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,356 @@
+// File: tools/jpeg_dec_check.cpp
+//
+// Host driver for the main/jpeg_dec.cpp checks of tools/tjpgd_check.py,
+// built against main/jpeg_dec.cpp, main/ppm.cpp (thumbnail only; the rest is
+// dropped by --gc-sections), main/tjpgd_local.c, main/tjpgd_kern.cpp and a
+// thread-backed FreeRTOS shim (tasks are host threads).
+//
+//   jpeg_dec_check bands [-r repeats] <file.jpg>...
+//   jpeg_dec_check contexts [-r repeats] [-t threads] <file.jpg>...
+//   jpeg_dec_check thumb [-r repeats] <file.jpg>...
+//
+// bands: every frame is decoded whole (jpeg_dec_open) as the reference. If
+// it has a complete restart index, it is then decoded as two bands split at
+// every restart boundary (jpeg_dec_open_band), and with
+// jpeg_dec_run_parallel(), which gives the bottom band to the worker task.
+// Every output must equal the reference. Single and two-core decode times
+// are the best of the repeats.
+//
+// contexts: every file is hashed at scales 1/1 .. 1/8 on one thread, then
+// -t threads with a context each decode all files and scales -r times at
+// once, each starting at a different file, and compare every hash. Then
+// jpeg_dec_stress() (the firmware's DBG_DECODE_STRESS test, two tasks) runs
+// on each file.
+//
+// thumb: jpeg_thumb_luma() of every file, hashed for the script to compare
+// with the BT.601 luma of the component decoder's 1/8 output (tjpgd_check
+// -y), and timed against a full-size RGB888 decode (best of the repeats).
+//
+// Output, one line per file (bands, thumb), per thread and per file
+// (contexts):
+//   <file> <w>x<h> nrst <n> splits <k> bad <b> split <row> single <us> par <us>
+//   thread <i> decodes <n> bad <b>
+//   <file> stress ok|fail
+//   <file> thumb <tw>x<th> <fnv1a32> full <us> thumb <us>
+//   <file> error <esp_err_t>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "jpeg_dec.h"
+#include "ppm.h"
+#include "esp_timer.h"
+
+typedef struct {
+    uint8_t *rgb;
+    int      width;
+} frame_t;
+
+static bool frame_out_cb(void *user, const uint8_t *rgb, const JRECT *rect)
+{
+    frame_t *f = (frame_t *)user;
+    const size_t bw = (size_t)(rect->right - rect->left + 1) * 3;
+
+    for (int y = rect->top; y <= rect->bottom; y++, rgb += bw) {
+        memcpy(f->rgb + ((size_t)y * f->width + rect->left) * 3, rgb, bw);
+    }
+    return true;
+}
+
+static bool load_file(const char *path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(n > 0 ? (size_t)n : 0);
+    bool ok = n > 0 && fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+// Whole-frame decode into rgb (sized here)
+static esp_err_t decode_whole(jpeg_dec_ctx_t *ctx, const std::vector<uint8_t> &jpeg,
+                              std::vector<uint8_t> &rgb, int *w, int *h)
+{
+    esp_err_t err = jpeg_dec_open(ctx, jpeg.data(), jpeg.size());
+    if (err != ESP_OK) return err;
+
+    *w = ctx->width;
+    *h = ctx->height;
+    rgb.assign((size_t)*w * *h * 3, 0);
+
+    frame_t f = { rgb.data(), *w };
+    return jpeg_dec_run(ctx, 0, frame_out_cb, &f);
+}
+
+static int run_bands(int repeats, int argc, char **argv)
+{
+    if (jpeg_dec_parallel_init(1) != ESP_OK) {
+        fprintf(stderr, "parallel worker not started\n");
+        return 1;
+    }
+
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) return 1;
+
+    static jpeg_rst_index_t idx;
+    std::vector<uint8_t> jpeg, ref, out;
+    int ret = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!load_file(argv[i], jpeg)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+
+        int w = 0, h = 0;
+        esp_err_t err = decode_whole(&ctx, jpeg, ref, &w, &h);
+        if (err == ESP_OK) err = jpeg_dec_index(jpeg.data(), jpeg.size(), &idx);
+        if (err != ESP_OK) {
+            printf("%s error %d\n", argv[i], (int)err);
+            ret = 1;
+            continue;
+        }
+
+        int splits = 0, bad = 0;
+        frame_t f = { nullptr, w };
+
+        // Top + bottom band at every restart boundary
+        for (int r = 1; idx.nrst && idx.complete && r < idx.mcu_rows; r++) {
+            if ((r * idx.mcus_per_row) % idx.nrst) continue;
+
+            out.assign(ref.size(), 0x55);
+            f.rgb = out.data();
+            err = jpeg_dec_open_band(&ctx, jpeg.data(), jpeg.size(), &idx, 0, r);
+            if (err == ESP_OK) err = jpeg_dec_run(&ctx, 0, frame_out_cb, &f);
+            if (err == ESP_OK) err = jpeg_dec_open_band(&ctx, jpeg.data(), jpeg.size(), &idx, r, idx.mcu_rows);
+            if (err == ESP_OK) err = jpeg_dec_run(&ctx, 0, frame_out_cb, &f);
+
+            splits++;
+            if (err != ESP_OK || out != ref) bad++;
+        }
+
+        // Single vs two-core, best of repeats; every two-core output checked
+        int64_t t_single = -1, t_par = -1;
+        int split = 0;
+        std::vector<uint8_t> tmp;
+
+        for (int r = 0; r < repeats; r++) {
+            int64_t t0 = esp_timer_get_time();
+            int tw, th;
+            err = decode_whole(&ctx, jpeg, tmp, &tw, &th);
+            int64_t dt = esp_timer_get_time() - t0;
+            if (t_single < 0 || dt < t_single) t_single = dt;
+            if (err != ESP_OK) break;
+
+            out.assign(ref.size(), 0x55);
+            f.rgb = out.data();
+            t0 = esp_timer_get_time();
+            err = jpeg_dec_run_parallel(&ctx, jpeg.data(), jpeg.size(), frame_out_cb, &f, &split);
+            dt = esp_timer_get_time() - t0;
+            if (t_par < 0 || dt < t_par) t_par = dt;
+            if (err != ESP_OK || out != ref) {
+                bad++;
+                break;
+            }
+        }
+
+        if (bad) ret = 1;
+        printf("%s %dx%d nrst %u splits %d bad %d split %d single %lld par %lld\n",
+               argv[i], w, h, (unsigned)(idx.complete ? idx.nrst : 0), splits, bad, split,
+               (long long)t_single, (long long)t_par);
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+    return ret;
+}
+
+// FNV-1a over the blocks in decode order
+static bool hash_out_cb(void *user, const uint8_t *rgb, const JRECT *rect)
+{
+    uint32_t *h = (uint32_t *)user;
+    const size_t n = (size_t)(rect->right - rect->left + 1) * (rect->bottom - rect->top + 1) * 3;
+
+    uint32_t x = *h;
+    for (size_t i = 0; i < n; i++) x = (x ^ rgb[i]) * 16777619u;
+    *h = x;
+    return true;
+}
+
+static esp_err_t decode_hash(jpeg_dec_ctx_t *ctx, const std::vector<uint8_t> &jpeg, int scale, uint32_t *hash)
+{
+    *hash = 2166136261u;
+
+    esp_err_t err = jpeg_dec_open(ctx, jpeg.data(), jpeg.size());
+    if (err == ESP_OK) err = jpeg_dec_run(ctx, scale, hash_out_cb, hash);
+    return err;
+}
+
+typedef struct {
+    const std::vector<std::vector<uint8_t>> *files;
+    const std::vector<uint32_t>             *expect;    // [file * 4 + scale]
+    int  first;
+    int  repeats;
+    int  decodes;
+    int  bad;
+} contexts_job_t;
+
+static void contexts_thread(contexts_job_t *job)
+{
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) {
+        job->bad = -1;
+        return;
+    }
+
+    const int n = (int)job->files->size();
+    for (int r = 0; r < job->repeats; r++) {
+        for (int k = 0; k < n; k++) {
+            const int f = (job->first + k) % n;
+            for (int scale = 0; scale <= 3; scale++) {
+                uint32_t h = 0;
+                if (decode_hash(&ctx, (*job->files)[f], scale, &h) != ESP_OK ||
+                    h != (*job->expect)[f * 4 + scale]) {
+                    job->bad++;
+                }
+                job->decodes++;
+            }
+        }
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+}
+
+static int run_contexts(int repeats, int threads, int argc, char **argv)
+{
+    std::vector<std::vector<uint8_t>> files(argc);
+    std::vector<uint32_t> expect((size_t)argc * 4);
+
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) return 1;
+
+    for (int i = 0; i < argc; i++) {
+        if (!load_file(argv[i], files[i])) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        for (int scale = 0; scale <= 3; scale++) {
+            esp_err_t err = decode_hash(&ctx, files[i], scale, &expect[i * 4 + scale]);
+            if (err != ESP_OK) {
+                printf("%s error %d\n", argv[i], (int)err);
+                return 1;
+            }
+        }
+    }
+    jpeg_dec_ctx_deinit(&ctx);
+
+    std::vector<contexts_job_t> jobs(threads);
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        jobs[t] = { &files, &expect, t * argc / threads, repeats, 0, 0 };
+        pool.emplace_back(contexts_thread, &jobs[t]);
+    }
+
+    int ret = 0;
+    for (int t = 0; t < threads; t++) {
+        pool[t].join();
+        printf("thread %d decodes %d bad %d\n", t, jobs[t].decodes, jobs[t].bad);
+        if (jobs[t].bad) ret = 1;
+    }
+
+    for (int i = 0; i < argc; i++) {
+        const bool ok = jpeg_dec_stress(files[i].data(), files[i].size(), repeats) == ESP_OK;
+        printf("%s stress %s\n", argv[i], ok ? "ok" : "fail");
+        if (!ok) ret = 1;
+    }
+
+    return ret;
+}
+
+static int run_thumb(int repeats, int argc, char **argv)
+{
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) return 1;
+
+    std::vector<uint8_t> jpeg, rgb, thumb;
+    int ret = 0;
+
+    for (int i = 0; i < argc; i++) {
+        if (!load_file(argv[i], jpeg)) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+
+        int64_t t_full = -1, t_thumb = -1;
+        int w = 0, h = 0, tw = 0, th = 0;
+        esp_err_t err = ESP_OK;
+
+        for (int r = 0; r < repeats && err == ESP_OK; r++) {
+            int64_t t0 = esp_timer_get_time();
+            err = decode_whole(&ctx, jpeg, rgb, &w, &h);
+            int64_t t1 = esp_timer_get_time();
+            if (err != ESP_OK) break;
+
+            thumb.assign((size_t)JPEG_THUMB_DIM(w) * JPEG_THUMB_DIM(h), 0);
+            err = jpeg_thumb_luma(&ctx, jpeg.data(), jpeg.size(), thumb.data(), thumb.size(), &tw, &th);
+            int64_t t2 = esp_timer_get_time();
+
+            if (t_full < 0 || t1 - t0 < t_full) t_full = t1 - t0;
+            if (t_thumb < 0 || t2 - t1 < t_thumb) t_thumb = t2 - t1;
+        }
+
+        if (err != ESP_OK) {
+            printf("%s error %d\n", argv[i], (int)err);
+            ret = 1;
+            continue;
+        }
+
+        uint32_t hash = 2166136261u;
+        for (uint8_t b : thumb) hash = (hash ^ b) * 16777619u;
+        printf("%s thumb %dx%d %08x full %lld thumb %lld\n", argv[i], tw, th, (unsigned)hash,
+               (long long)t_full, (long long)t_thumb);
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s bands|contexts|thumb [-r repeats] [-t threads] <file.jpg>...\n", argv[0]);
+        return 2;
+    }
+
+    const char *mode = argv[1];
+    int repeats = 1;
+    int threads = 4;
+    int argi = 2;
+
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (!strcmp(argv[argi], "-r") && argi + 1 < argc) {
+            repeats = atoi(argv[++argi]);
+        } else if (!strcmp(argv[argi], "-t") && argi + 1 < argc) {
+            threads = atoi(argv[++argi]);
+        } else {
+            fprintf(stderr, "unknown option %s\n", argv[argi]);
+            return 2;
+        }
+    }
+    if (repeats < 1) repeats = 1;
+    if (threads < 1) threads = 1;
+
+    if (!strcmp(mode, "bands"))    return run_bands(repeats, argc - argi, argv + argi);
+    if (!strcmp(mode, "contexts")) return run_contexts(repeats, threads, argc - argi, argv + argi);
+    if (!strcmp(mode, "thumb"))    return run_thumb(repeats, argc - argi, argv + argi);
+
+    fprintf(stderr, "unknown mode %s\n", mode);
+    return 2;
+}
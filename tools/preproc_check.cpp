@@ -0,0 +1,175 @@
+// File: tools/preproc_check.cpp
+//
+// Host driver for tools/preproc_check.py: runs the fused preprocessor
+// (main/preproc.cpp) and the reference ppm.cpp path on the same JPEGs and
+// compares their outputs byte for byte, for every letterbox filter.
+//
+//   preproc_check [-f] <src_w> <src_h> <dst> <file.jpg>...
+//
+// Reference, as preprocess_reference() in main.cpp: whole-frame RGB888
+// decode (jpeg_dec, what jpeg_to_rgb888_into() runs with the local
+// decoder), resize_rgb888_letterbox_filter_into(), quant_lut_apply_rgb() and
+// resize_rgb888_aspect_crop_into(). Fused: preproc_jpeg_to_input() with the
+// RGB888 letterbox and crop audit outputs, the filter switched with
+// preproc_set_filter() between passes. -f builds the LUT with contrast,
+// gamma and normalization folded in instead of plain quantization.
+//
+// Output, one line per file and filter:
+//   <file> <filter> band <mcu rows> i8 <diffs> rgb <diffs> crop <diffs>
+//   <file> <filter> error <esp_err_t>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "jpeg_dec.h"
+#include "ppm.h"
+#include "preproc.h"
+#include "quant_lut.h"
+
+static bool load_file(const char *path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(n > 0 ? (size_t)n : 0);
+    bool ok = n > 0 && fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+typedef struct {
+    uint8_t *rgb;
+    int      width;
+} frame_t;
+
+static bool frame_out_cb(void *user, const uint8_t *rgb, const JRECT *rect)
+{
+    frame_t *f = (frame_t *)user;
+    const size_t bw = (size_t)(rect->right - rect->left + 1) * 3;
+
+    for (int y = rect->top; y <= rect->bottom; y++, rgb += bw) {
+        memcpy(f->rgb + ((size_t)y * f->width + rect->left) * 3, rgb, bw);
+    }
+    return true;
+}
+
+template <typename T>
+static int count_diffs(const std::vector<T> &a, const std::vector<T> &b)
+{
+    int n = 0;
+    for (size_t i = 0; i < a.size(); i++) n += a[i] != b[i];
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int argi = 1;
+    bool folded = false;
+
+    if (argi < argc && !strcmp(argv[argi], "-f")) {
+        folded = true;
+        argi++;
+    }
+    if (argc - argi < 4) {
+        fprintf(stderr, "usage: %s [-f] <src_w> <src_h> <dst> <file.jpg>...\n", argv[0]);
+        return 2;
+    }
+
+    const int src_w = atoi(argv[argi++]);
+    const int src_h = atoi(argv[argi++]);
+    const int dst   = atoi(argv[argi++]);
+
+    // int8 input of a typical 0..255 model, optionally with everything folded
+    quant_lut_cfg_t lut_cfg;
+    quant_lut_default_cfg(&lut_cfg, 1.0f, -128);
+    if (folded) {
+        lut_cfg.scale      = 0.0187f;
+        lut_cfg.zero_point = -14;
+        lut_cfg.contrast   = true;
+        lut_cfg.gamma      = 1.2f;
+        lut_cfg.normalize  = true;
+        const float mean[3] = { 0.485f, 0.456f, 0.406f }, std[3] = { 0.229f, 0.224f, 0.225f };
+        memcpy(lut_cfg.mean, mean, sizeof(mean));
+        memcpy(lut_cfg.std, std, sizeof(std));
+    }
+
+    static quant_lut_t lut;
+    if (quant_lut_build(&lut, &lut_cfg) != ESP_OK) return 1;
+
+    preproc_cfg_t pp = {};
+    pp.src_w     = src_w;
+    pp.src_h     = src_h;
+    pp.dst_w     = dst;
+    pp.dst_h     = dst;
+    pp.crop_size = dst;
+    pp.filter    = RESAMPLE_NEAREST;
+    pp.lut       = &lut;
+    if (preproc_init(&pp) != ESP_OK) return 1;
+
+    jpeg_dec_ctx_t ctx;
+    if (jpeg_dec_ctx_init(&ctx, 0) != ESP_OK) return 1;
+
+    static const resample_filter_t FILTERS[] = { RESAMPLE_NEAREST, RESAMPLE_BILINEAR, RESAMPLE_AREA };
+    static const char *const NAMES[]         = { "nearest", "bilinear", "area" };
+
+    const size_t out_px = (size_t)dst * dst;
+    std::vector<uint8_t> jpeg, rgb((size_t)src_w * src_h * 3);
+    std::vector<uint8_t> ref_rgb(out_px * 3), ref_crop(out_px * 3), rgb_out(out_px * 3), crop_out(out_px * 3);
+    std::vector<int8_t>  ref_i8(out_px * 3), i8_out(out_px * 3);
+    int ret = 0;
+
+    for (int f = 0; f < 3; f++) {
+        preproc_set_filter(FILTERS[f]);
+
+        for (int i = argi; i < argc; i++) {
+            if (!load_file(argv[i], jpeg)) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 1;
+            }
+
+            // Reference path
+            frame_t fr = { rgb.data(), src_w };
+            esp_err_t err = jpeg_dec_open(&ctx, jpeg.data(), jpeg.size());
+            const int mcu_h = ctx.mcu_h;
+            if (err == ESP_OK && (ctx.width != src_w || ctx.height != src_h)) err = ESP_ERR_INVALID_SIZE;
+            if (err == ESP_OK) err = jpeg_dec_run(&ctx, 0, frame_out_cb, &fr);
+            if (err == ESP_OK) {
+                err = resize_rgb888_letterbox_filter_into(rgb.data(), src_w, src_h, dst, dst,
+                                                          FILTERS[f], ref_rgb.data());
+            }
+            if (err == ESP_OK) err = resize_rgb888_aspect_crop_into(rgb.data(), src_w, src_h, dst, ref_crop.data());
+            if (err == ESP_OK) quant_lut_apply_rgb(&lut, ref_rgb.data(), ref_i8.data(), out_px);
+
+            // Fused path, outputs pre-filled so unwritten bytes show up
+            std::fill(i8_out.begin(), i8_out.end(), (int8_t)0x55);
+            std::fill(rgb_out.begin(), rgb_out.end(), 0x55);
+            std::fill(crop_out.begin(), crop_out.end(), 0x55);
+            if (err == ESP_OK) {
+                err = preproc_jpeg_to_input(jpeg.data(), jpeg.size(), i8_out.data(), rgb_out.data(), crop_out.data());
+            }
+
+            if (err != ESP_OK) {
+                printf("%s %s error %d\n", argv[i], NAMES[f], (int)err);
+                ret = 1;
+                continue;
+            }
+
+            const int d_i8   = count_diffs(i8_out, ref_i8);
+            const int d_rgb  = count_diffs(rgb_out, ref_rgb);
+            const int d_crop = count_diffs(crop_out, ref_crop);
+            if (d_i8 || d_rgb || d_crop) ret = 1;
+
+            printf("%s %s band %d i8 %d rgb %d crop %d\n", argv[i], NAMES[f], mcu_h, d_i8, d_rgb, d_crop);
+        }
+    }
+
+    jpeg_dec_ctx_deinit(&ctx);
+    return ret;
+}
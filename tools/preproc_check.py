@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+# File: tools/preproc_check.py
+#
+# Host bit-exactness check of the fused preprocessor (main/preproc.cpp)
+# against the reference ppm.cpp path, for every letterbox filter.
+#
+#   preproc_check.py [--images images] [--dst 192]
+#
+# Every image under --images is re-encoded (Pillow) as a QVGA frame at
+# 4:4:4 and 4:2:2 (8-row MCU bands in the ring) and 4:2:0 (16-row bands),
+# and as a 300x226 frame whose edge MCUs are partial. tools/preproc_check.cpp
+# is built with g++ against the real main/preproc.cpp, ppm.cpp, resample.cpp,
+# quant_lut.cpp, jpeg_dec.cpp and the local TJpgDec (ESP-IDF stubs and the
+# FreeRTOS thread shim of tools/tjpgd_check.py). For nearest, bilinear and
+# area it compares the int8 model input, the RGB888 letterbox and the
+# centre crop of preproc_jpeg_to_input() with those of the reference path,
+# once with a plain quantization LUT and once with contrast, gamma and
+# normalization folded in. Any difference fails the script.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from PIL import Image
+
+from tjpgd_check import CFLAGS, STUBS, list_images
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(TOOLS)
+MAIN = os.path.join(REPO, "main")
+
+# ppm.cpp is there for the reference resizers only: --gc-sections drops the
+# rest and with it every reference to sd_writer / esp_jpeg
+SOURCES = [os.path.join(TOOLS, "preproc_check.cpp")] + [
+    os.path.join(MAIN, name) for name in
+    ("preproc.cpp", "ppm.cpp", "resample.cpp", "quant_lut.cpp", "jpeg_dec.cpp", "tjpgd_local.c", "tjpgd_kern.cpp")
+]
+
+# (size, subsampling) of the re-encodes; 4:2:0 MCUs are 16 rows, the rest 8
+FRAMES = [
+    ((320, 240), "4:4:4"),
+    ((320, 240), "4:2:2"),
+    ((320, 240), "4:2:0"),
+    ((300, 226), "4:2:0"),
+]
+
+
+def encode(path, root, out_dir, size, sub):
+    img = Image.open(path).convert("RGB")
+    w, h = img.size
+    fw, fh = size
+    cw, ch = min(w, h * fw / fh), min(h, w * fh / fw)
+    box = ((w - cw) / 2, (h - ch) / 2, (w + cw) / 2, (h + ch) / 2)
+
+    base = os.path.splitext(os.path.relpath(path, root))[0].replace(os.sep, "_")
+    dst = os.path.join(out_dir, "%s_%dx%d_%s.jpg" % (base, fw, fh, sub.replace(":", "")))
+    img.resize(size, Image.LANCZOS, box=box).save(dst, quality=80, subsampling=sub)
+    return dst
+
+
+def build(work):
+    inc = os.path.join(work, "include")
+    os.makedirs(os.path.join(inc, "freertos"), exist_ok=True)
+    for name, text in STUBS.items():
+        with open(os.path.join(inc, name), "w") as f:
+            f.write(text)
+
+    exe = os.path.join(work, "preproc_check")
+    objs = []
+    for src in SOURCES + [os.path.join(inc, "freertos_host.cpp")]:
+        obj = os.path.join(work, os.path.basename(src) + ".o")
+        cc = ["gcc", "-std=gnu11"] if src.endswith(".c") else ["g++", "-std=gnu++17"]
+        subprocess.run(cc + CFLAGS + ["-ffunction-sections", "-fdata-sections", "-DTJPGD_KERN_FAST=1",
+                                      "-I", inc, "-I", MAIN, "-I",
+                                      os.path.join(REPO, "managed_components", "espressif__esp_jpeg", "include"),
+                                      "-c", src, "-o", obj], check=True)
+        objs.append(obj)
+    subprocess.run(["g++"] + objs + ["-Wl,--gc-sections", "-pthread", "-o", exe], check=True)
+    return exe
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Fused preprocessor vs reference ppm.cpp path: bit-exactness")
+    ap.add_argument("--images", default=os.path.join(REPO, "images"), help="image tree (default: images/)")
+    ap.add_argument("--dst", type=int, default=192, help="model input size (square)")
+    ap.add_argument("--keep", metavar="DIR", help="build and write re-encodes into DIR and keep them")
+    args = ap.parse_args()
+
+    images = list_images(args.images)
+    if not images:
+        sys.exit("no JPEG files under %s" % args.images)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        work = args.keep or tmp
+        frames = os.path.join(work, "frames")
+        os.makedirs(frames, exist_ok=True)
+
+        exe = build(work)
+        failed = False
+
+        print("%d images, %dx%d input; mismatching values per output (int8 / RGB letterbox / crop)"
+              % (len(images), args.dst, args.dst))
+        print("  %-18s %-6s %-8s %4s %6s %8s %8s %8s" % ("frame", "band", "filter", "lut", "files", "i8", "rgb", "crop"))
+
+        for size, sub in FRAMES:
+            files = [encode(p, args.images, frames, size, sub) for p in images]
+            for lut in ("plain", "folded"):
+                cmd = [exe] + (["-f"] if lut == "folded" else []) + [str(size[0]), str(size[1]), str(args.dst)]
+                proc = subprocess.run(cmd + files, stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                      universal_newlines=True)
+                failed = failed or proc.returncode != 0
+
+                # filter: [files, band rows, i8, rgb, crop]
+                stats = {}
+                for line in proc.stdout.splitlines():
+                    f = line.split()
+                    if f[2] == "error":
+                        print("  %s %s: error %s" % (f[0], f[1], f[3]))
+                        continue
+                    s = stats.setdefault(f[1], [0, f[3], 0, 0, 0])
+                    s[0] += 1
+                    s[2] += int(f[5])
+                    s[3] += int(f[7])
+                    s[4] += int(f[9])
+
+                for name in ("nearest", "bilinear", "area"):
+                    s = stats.get(name, [0, "?", 0, 0, 0])
+                    failed = failed or s[0] != len(files)
+                    print("  %-18s %-6s %-8s %4s %6d %8d %8d %8d"
+                          % ("%dx%d %s" % (size[0], size[1], sub), s[1], name, lut[0], s[0], s[2], s[3], s[4]))
+                if proc.returncode != 0 and not stats:
+                    sys.stderr.write(proc.stderr)
+
+        print("FAIL" if failed else "all outputs identical")
+        sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,186 @@
+// File: tools/resize_stability.cpp
+//
+// Host driver for tools/resize_stability.py: runs main/resample.cpp over
+// sub-pixel shifted QVGA renders of the same scene and reports how much the
+// 192×192 letterboxed model input moves per shift step, for each filter.
+// Also checks that the row-streaming path (used by the fused preprocessor)
+// matches resampler_run() byte for byte.
+//
+//   resize_stability <frames dir> [dst_w dst_h]
+//
+// The frames dir holds <name>_<k>.ppm (P6), k = 0..steps, all of the same
+// size; frame k is frame 0 shifted by k steps.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "resample.h"
+
+typedef struct {
+    int w;
+    int h;
+    std::vector<uint8_t> rgb;
+} image_t;
+
+static bool load_ppm(const std::string &path, image_t *img)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+
+    int maxval = 0;
+    bool ok = fscanf(f, "P6 %d %d %d", &img->w, &img->h, &maxval) == 3 && maxval == 255 &&
+              fgetc(f) != EOF;
+    if (ok) {
+        img->rgb.resize((size_t)img->w * img->h * 3);
+        ok = fread(img->rgb.data(), 1, img->rgb.size(), f) == img->rgb.size();
+    }
+    fclose(f);
+    return ok;
+}
+
+static double mean_abs_diff(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < a.size(); i++) sum += (uint64_t)abs((int)a[i] - (int)b[i]);
+    return (double)sum / (double)a.size();
+}
+
+// Same emit pattern as the fused preprocessor: each image row as soon as its
+// last source row is in
+static void run_streamed(resampler_t *rs, const image_t &src, std::vector<uint8_t> &dst)
+{
+    std::fill(dst.begin(), dst.end(), 0);
+    std::vector<uint8_t> row((size_t)rs->x.n * 3);
+
+    resampler_stream_begin(rs);
+    int y = 0;
+    for (int sy = 0; sy < src.h; sy++) {
+        resampler_push_row(rs, sy, src.rgb.data() + (size_t)sy * src.w * 3);
+        while (y < rs->y.n && resampler_last_src_row(rs, y) <= sy) {
+            resampler_emit_row(rs, y, row.data());
+            memcpy(dst.data() + ((size_t)(rs->y.off + y) * rs->dst_w + rs->x.off) * 3, row.data(), row.size());
+            y++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <frames dir> [dst_w dst_h]\n", argv[0]);
+        return 2;
+    }
+    const std::string dir = argv[1];
+    const int dst_w = argc > 3 ? atoi(argv[2]) : 192;
+    const int dst_h = argc > 3 ? atoi(argv[3]) : 192;
+
+    // Scenes: every <name>_0.ppm
+    std::vector<std::string> scenes;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        fprintf(stderr, "cannot open %s\n", dir.c_str());
+        return 1;
+    }
+    while (struct dirent *e = readdir(d)) {
+        const std::string n = e->d_name;
+        if (n.size() > 6 && n.compare(n.size() - 6, 6, "_0.ppm") == 0) scenes.push_back(n.substr(0, n.size() - 6));
+    }
+    closedir(d);
+    std::sort(scenes.begin(), scenes.end());
+    if (scenes.empty()) {
+        fprintf(stderr, "no <name>_0.ppm frames in %s\n", dir.c_str());
+        return 1;
+    }
+
+    static const resample_filter_t FILTERS[] = { RESAMPLE_NEAREST, RESAMPLE_BILINEAR, RESAMPLE_AREA };
+    static const char *const NAMES[]         = { "nearest", "bilinear", "area" };
+    const int nf = 3;
+
+    resampler_t rs[nf] = {};
+    int src_w = 0, src_h = 0;
+    int steps = -1;
+
+    std::vector<std::vector<double>> vs_first(nf);   // [filter][k]: |frame k - frame 0|
+    std::vector<double> per_step(nf, 0.0);           // adjacent frames
+    int stream_checked = 0, stream_mismatch = 0;
+
+    for (const std::string &scene : scenes) {
+        std::vector<image_t> frames;
+        for (int k = 0;; k++) {
+            image_t img;
+            if (!load_ppm(dir + "/" + scene + "_" + std::to_string(k) + ".ppm", &img)) break;
+            frames.push_back(std::move(img));
+        }
+        if (frames.size() < 2) continue;
+
+        if (steps < 0) {
+            steps = (int)frames.size() - 1;
+            src_w = frames[0].w;
+            src_h = frames[0].h;
+            for (int f = 0; f < nf; f++) {
+                if (resampler_init(&rs[f], src_w, src_h, dst_w, dst_h, FILTERS[f], RESAMPLE_LETTERBOX) != ESP_OK) {
+                    fprintf(stderr, "resampler_init failed (%s)\n", NAMES[f]);
+                    return 1;
+                }
+                vs_first[f].assign(steps + 1, 0.0);
+            }
+        }
+        if ((int)frames.size() - 1 != steps) {
+            fprintf(stderr, "%s: %d frames, expected %d\n", scene.c_str(), (int)frames.size(), steps + 1);
+            return 1;
+        }
+
+        const size_t out_bytes = (size_t)dst_w * dst_h * 3;
+        std::vector<uint8_t> streamed(out_bytes);
+
+        for (int f = 0; f < nf; f++) {
+            std::vector<std::vector<uint8_t>> out(frames.size(), std::vector<uint8_t>(out_bytes));
+
+            for (size_t k = 0; k < frames.size(); k++) {
+                if (frames[k].w != src_w || frames[k].h != src_h) {
+                    fprintf(stderr, "%s_%d: %dx%d, expected %dx%d\n", scene.c_str(), (int)k,
+                            frames[k].w, frames[k].h, src_w, src_h);
+                    return 1;
+                }
+                resampler_run(&rs[f], frames[k].rgb.data(), out[k].data());
+
+                if (FILTERS[f] != RESAMPLE_NEAREST) {
+                    run_streamed(&rs[f], frames[k], streamed);
+                    stream_checked++;
+                    if (streamed != out[k]) stream_mismatch++;
+                }
+            }
+
+            for (int k = 1; k <= steps; k++) {
+                vs_first[f][k] += mean_abs_diff(out[0], out[k]);
+                per_step[f]    += mean_abs_diff(out[k - 1], out[k]);
+            }
+        }
+    }
+
+    if (steps < 1) {
+        fprintf(stderr, "no scene with shifted frames\n");
+        return 1;
+    }
+
+    const double n = (double)scenes.size();
+    printf("%d scenes, %dx%d -> %dx%d letterbox, %d shift steps\n", (int)scenes.size(), src_w, src_h, dst_w, dst_h, steps);
+    printf("mean |delta| of the model input (0..255 per channel)\n");
+    printf("%-9s %9s", "filter", "per step");
+    for (int k = 1; k <= steps; k++) printf("   k=%d vs 0", k);
+    printf("\n");
+    for (int f = 0; f < nf; f++) {
+        printf("%-9s %9.2f", NAMES[f], per_step[f] / (n * steps));
+        for (int k = 1; k <= steps; k++) printf(" %10.2f", vs_first[f][k] / n);
+        printf("\n");
+        resampler_deinit(&rs[f]);
+    }
+    printf("streamed == resampler_run: %d of %d frames\n", stream_checked - stream_mismatch, stream_checked);
+
+    return stream_mismatch ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# File: tools/resize_stability.py
+#
+# Host measurement of how stable the model input is under small scene shifts
+# for each resize filter of main/resample.cpp (RESAMPLE_NEAREST / _BILINEAR /
+# _AREA, the INPUT_RESIZE_FILTER choice).
+#
+#   resize_stability.py [--images images] [--shift 0.32] [--steps 3]
+#
+# Every image under --images is rendered (Pillow, antialiased) as a 320x240
+# camera frame and again shifted right by k * --shift frame pixels,
+# k = 1..--steps. tools/resize_stability.cpp is then built with g++ against
+# the real main/resample.cpp and runs the 192x192 letterbox over all frames;
+# it prints the mean |delta| of the model input per shift step and checks
+# that the streamed (fused preprocessor) path matches resampler_run().
+# A lower delta means detections jitter less while the scene barely moves.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from PIL import Image
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(TOOLS)
+
+# Just enough of ESP-IDF for resample.cpp on the host
+STUBS = {
+    "esp_err.h": """#pragma once
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_SUPPORTED 0x106
+static inline const char *esp_err_to_name(esp_err_t err) { return err == ESP_OK ? "ESP_OK" : "error"; }
+""",
+    "esp_log.h": """#pragma once
+#include <stdio.h>
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+""",
+    "esp_heap_caps.h": """#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+static inline void *heap_caps_malloc(size_t n, uint32_t caps) { (void)caps; return malloc(n); }
+static inline void *heap_caps_calloc(size_t n, size_t s, uint32_t caps) { (void)caps; return calloc(n, s); }
+static inline void heap_caps_free(void *p) { free(p); }
+""",
+}
+
+FRAME_W, FRAME_H = 320, 240
+
+
+def list_images(root):
+    out = []
+    for dirpath, _, files in os.walk(root):
+        for name in sorted(files):
+            if name.lower().endswith((".jpg", ".jpeg", ".png")):
+                out.append(os.path.join(dirpath, name))
+    return sorted(out)
+
+
+def render_frames(path, root, out_dir, shift, steps):
+    """Centre 4:3 crop of the image as a QVGA frame, then shifted copies."""
+    img = Image.open(path).convert("RGB")
+    w, h = img.size
+
+    # 4:3 crop with room for the largest shift on the right
+    scale = min(w / FRAME_W, h / FRAME_H) / (1.0 + shift * steps / FRAME_W)
+    cw, ch = FRAME_W * scale, FRAME_H * scale
+    x0 = max(0.0, (w - cw * (1.0 + shift * steps / FRAME_W)) / 2)
+    y0 = max(0.0, (h - ch) / 2)
+
+    rel = os.path.relpath(path, root)
+    base = os.path.splitext(rel)[0].replace(os.sep, "_").replace(".", "_")
+
+    for k in range(steps + 1):
+        dx = k * shift * scale
+        frame = img.resize((FRAME_W, FRAME_H), Image.LANCZOS, box=(x0 + dx, y0, x0 + dx + cw, y0 + ch))
+        frame.save(os.path.join(out_dir, "%s_%d.ppm" % (base, k)))
+
+
+def build(work):
+    inc = os.path.join(work, "include")
+    os.makedirs(inc, exist_ok=True)
+    for name, text in STUBS.items():
+        with open(os.path.join(inc, name), "w") as f:
+            f.write(text)
+
+    exe = os.path.join(work, "resize_stability")
+    cmd = ["g++", "-std=gnu++17", "-O2", "-I", inc, "-I", os.path.join(REPO, "main"),
+           os.path.join(TOOLS, "resize_stability.cpp"), os.path.join(REPO, "main", "resample.cpp"),
+           "-o", exe]
+    subprocess.run(cmd, check=True)
+    return exe
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Model input stability per resize filter under sub-pixel shifts")
+    ap.add_argument("--images", default=os.path.join(REPO, "images"), help="image tree (default: images/)")
+    ap.add_argument("--shift", type=float, default=0.32, help="shift per step, frame pixels")
+    ap.add_argument("--steps", type=int, default=3, help="shifted copies per image")
+    ap.add_argument("--keep", metavar="DIR", help="render frames and build into DIR and keep them")
+    args = ap.parse_args()
+
+    images = list_images(args.images)
+    if not images:
+        sys.exit("no images under %s" % args.images)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        work = args.keep or tmp
+        frames = os.path.join(work, "frames")
+        os.makedirs(frames, exist_ok=True)
+
+        for path in images:
+            render_frames(path, args.images, frames, args.shift, args.steps)
+        print("%d images, %d frames each, %.2f px per step" % (len(images), args.steps + 1, args.shift))
+
+        exe = build(work)
+        sys.exit(subprocess.run([exe, frames]).returncode)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,199 @@
+// File: tools/tjpgd_check.cpp
+//
+// Host driver for tools/tjpgd_check.py: decodes JPEG files with one TJpgDec
+// build at every output scale (1/1 .. 1/8) and prints a hash of the RGB888
+// output and the best-of-N decode time of each.
+//
+//   tjpgd_check [-r repeats] [-k kern_iterations] <file.jpg>...
+//   tjpgd_check -y <file.jpg>...
+//
+// Built once against the component's tjpgd.c and once per kernel set
+// against main/tjpgd_local.c (TJPGD_CHECK_LOCAL=1); the script compares the
+// hashes across builds. -k also runs tjpgd_kern_benchmark() (local builds).
+//
+// -y instead decodes at 1/8 only and hashes the BT.601 luma of the first
+// (w >> 3) x (h >> 3) pixels: what jpeg_thumb_luma() (ppm.cpp) returns.
+//
+// Output, one line per file and scale (-y: per file):
+//   <file> <scale> <w>x<h> <fnv1a32> <us>|error <JRESULT>
+//   <file> thumb <tw>x<th> <fnv1a32>|error <JRESULT>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#if TJPGD_CHECK_LOCAL
+#include "tjpgd_local.h"
+#include "tjpgd_kern.h"
+#define check_prepare   tjd_prepare
+#define check_decomp    tjd_decomp
+#else
+#include "tjpgd.h"
+#define check_prepare   jd_prepare
+#define check_decomp    jd_decomp
+#endif
+
+#define WORK_BYTES  (64 * 1024)     // generous: the firmware sizes it per stream
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+    uint8_t *rgb;
+    int w;
+} io_t;
+
+static size_t in_cb(JDEC *jd, uint8_t *buf, size_t n)
+{
+    io_t *io = (io_t *)jd->device;
+    if (n > io->len - io->pos) n = io->len - io->pos;
+    if (buf) memcpy(buf, io->data + io->pos, n);
+    io->pos += n;
+    return n;
+}
+
+static int out_cb(JDEC *jd, void *bitmap, JRECT *rect)
+{
+    io_t *io = (io_t *)jd->device;
+    const size_t bw = (size_t)(rect->right - rect->left + 1) * 3;
+    const uint8_t *src = (const uint8_t *)bitmap;
+
+    for (int y = rect->top; y <= rect->bottom; y++, src += bw) {
+        memcpy(io->rgb + ((size_t)y * io->w + rect->left) * 3, src, bw);
+    }
+    return 1;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool load_file(const char *path, std::vector<uint8_t> &out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return false;
+
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    out.resize(n > 0 ? (size_t)n : 0);
+    bool ok = n > 0 && fread(out.data(), 1, out.size(), f) == out.size();
+    fclose(f);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = 1;
+    int kern_iters = 0;
+    bool luma_thumb = false;
+    int argi = 1;
+
+    for (; argi < argc && argv[argi][0] == '-'; argi++) {
+        if (!strcmp(argv[argi], "-r") && argi + 1 < argc) {
+            repeats = atoi(argv[++argi]);
+        } else if (!strcmp(argv[argi], "-k") && argi + 1 < argc) {
+            kern_iters = atoi(argv[++argi]);
+        } else if (!strcmp(argv[argi], "-y")) {
+            luma_thumb = true;
+        } else {
+            fprintf(stderr, "usage: %s [-r repeats] [-k kern_iterations] | -y <file.jpg>...\n", argv[0]);
+            return 2;
+        }
+    }
+    if (repeats < 1) repeats = 1;
+
+    int ret = 0;
+
+    if (kern_iters > 0) {
+#if TJPGD_CHECK_LOCAL
+        if (tjpgd_kern_benchmark(kern_iters) != ESP_OK) ret = 1;
+#else
+        fprintf(stderr, "-k: no kernels in the component build\n");
+#endif
+    }
+
+    static uint8_t work[WORK_BYTES];
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> rgb;
+
+    for (; argi < argc; argi++) {
+        const char *path = argv[argi];
+        if (!load_file(path, data)) {
+            fprintf(stderr, "cannot read %s\n", path);
+            return 1;
+        }
+
+        if (luma_thumb) {
+            io_t io = { data.data(), data.size(), 0, NULL, 0 };
+            JDEC jd;
+
+            JRESULT res = check_prepare(&jd, in_cb, work, sizeof(work), &io);
+            if (res == JDR_OK) {
+                rgb.assign((size_t)((jd.width + 7) >> 3) * ((jd.height + 7) >> 3) * 3, 0);
+                io.rgb = rgb.data();
+                io.w = (jd.width + 7) >> 3;
+                res = check_decomp(&jd, out_cb, 3);
+            }
+            if (res != JDR_OK) {
+                printf("%s thumb error %d\n", path, (int)res);
+                continue;
+            }
+
+            const int w = io.w;
+            const int tw = jd.width >> 3, th = jd.height >> 3;
+
+            uint32_t hash = 2166136261u;
+            for (int y = 0; y < th; y++) {
+                for (int x = 0; x < tw; x++) {
+                    const uint8_t *p = &rgb[((size_t)y * w + x) * 3];
+                    hash = (hash ^ (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8)) * 16777619u;
+                }
+            }
+            printf("%s thumb %dx%d %08x\n", path, tw, th, (unsigned)hash);
+            continue;
+        }
+
+        for (int scale = 0; scale <= 3; scale++) {
+            int64_t best = -1;
+            int w = 0, h = 0;
+            JRESULT res = JDR_OK;
+
+            for (int r = 0; r < repeats && res == JDR_OK; r++) {
+                io_t io = { data.data(), data.size(), 0, NULL, 0 };
+                JDEC jd;
+
+                int64_t t0 = now_us();
+                res = check_prepare(&jd, in_cb, work, sizeof(work), &io);
+                if (res != JDR_OK) break;
+
+                w = (jd.width + (1 << scale) - 1) >> scale;
+                h = (jd.height + (1 << scale) - 1) >> scale;
+                rgb.assign((size_t)w * h * 3, 0);
+                io.rgb = rgb.data();
+                io.w = w;
+
+                res = check_decomp(&jd, out_cb, (uint8_t)scale);
+                int64_t dt = now_us() - t0;
+                if (best < 0 || dt < best) best = dt;
+            }
+
+            if (res != JDR_OK) {
+                printf("%s %d error %d\n", path, scale, (int)res);
+                continue;
+            }
+
+            uint32_t hash = 2166136261u;
+            for (uint8_t b : rgb) hash = (hash ^ b) * 16777619u;
+            printf("%s %d %dx%d %08x %lld\n", path, scale, w, h, (unsigned)hash, (long long)best);
+        }
+    }
+
+    return ret;
+}
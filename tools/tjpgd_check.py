@@ -0,0 +1,535 @@
+#!/usr/bin/env python3
+# File: tools/tjpgd_check.py
+#
+# Host bit-exactness check and benchmark of the local TJpgDec
+# (main/tjpgd_local.c + main/tjpgd_kern.cpp) against the esp_jpeg
+# component's tjpgd.c.
+#
+#   tjpgd_check.py [--images images] [--repeats 20] [--kern N] [--no-qvga]
+#                  [--threads 4] [--rounds 2]
+#
+# tools/tjpgd_check.cpp is built three times with g++:
+#   component : managed_components/espressif__esp_jpeg/tjpgd/tjpgd.c
+#   local ref : main/tjpgd_local.c, TJPGD_KERN_FAST 0 (upstream kernels)
+#   local fast: main/tjpgd_local.c, TJPGD_KERN_FAST 1
+# all with the configuration of tjpgd_local.h (RGB888, scaling, arithmetic
+# clipping, JD_FASTDECODE 2). Every JPEG under --images, plus QVGA 4:2:2 and
+# 4:2:0 re-encodes of them (Pillow, closer to the camera frames), is decoded
+# at scales 1/1 .. 1/8; the script fails if any output differs between the
+# builds and prints the decode time of each (best of --repeats runs).
+#
+# Host auto-vectorization is off: the ESP32-S3 build gets none, and it would
+# speed the reference loops up more than the fast ones.
+#
+# tools/jpeg_dec_check.cpp is then built against main/jpeg_dec.cpp (local
+# fast TJpgDec, FreeRTOS tasks as host threads) and checks the decoder built
+# on top of it:
+#   bands: QVGA re-encodes with restart intervals (1 MCU row at 4:2:2 and
+#          4:2:0, 7 MCUs, none) decoded whole, as two bands split at every
+#          restart boundary, and with jpeg_dec_run_parallel(); all outputs
+#          must be identical. Times are host times: with one host CPU the
+#          two-core figure is the slicing overhead, not a speed-up
+#          (DBG_DECODE_PARALLEL_BENCH measures that on the target).
+#   contexts: --threads threads, one jpeg_dec context each, decode every
+#          file above at every scale --rounds times at once and compare
+#          each output hash with a single-thread decode; then
+#          jpeg_dec_stress() (DBG_DECODE_STRESS) runs on every file. Host
+#          threads preempt each other mid-decode, so state shared between
+#          contexts would show up as mismatches even on one CPU.
+#   thumb: jpeg_thumb_luma() (main/ppm.cpp) of every images/ and QVGA file
+#          must equal the BT.601 luma of the component decoder's 1/8 output;
+#          its time is compared with a full-size RGB888 decode.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+from PIL import Image
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(TOOLS)
+TJPGD_COMPONENT = os.path.join(REPO, "managed_components", "espressif__esp_jpeg", "tjpgd")
+
+# Just enough of ESP-IDF for tjpgd.c / tjpgd_local.c / tjpgd_kern.cpp on the host
+STUBS = {
+    "sdkconfig.h": """#pragma once
+/* The component built like tjpgd_local.h */
+#define CONFIG_JD_SZBUF 512
+#define CONFIG_JD_FORMAT 0
+#define CONFIG_JD_USE_SCALE 1
+#define CONFIG_JD_TBLCLIP 0
+#define CONFIG_JD_FASTDECODE 2
+#define CONFIG_JD_DEFAULT_HUFFMAN 0
+""",
+    "esp_err.h": """#pragma once
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_INVALID_SIZE 0x104
+static inline const char *esp_err_to_name(esp_err_t err) { (void)err; return "error"; }
+""",
+    "esp_log.h": """#pragma once
+#include <stdio.h>
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) do { (void)(tag); } while (0)
+""",
+    "esp_heap_caps.h": """#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+static inline void *heap_caps_malloc(size_t n, uint32_t caps) { (void)caps; return malloc(n); }
+static inline void *heap_caps_calloc(size_t n, size_t s, uint32_t caps) { (void)caps; return calloc(n, s); }
+static inline void *heap_caps_aligned_alloc(size_t a, size_t n, uint32_t caps) { (void)caps; return aligned_alloc(a, (n + a - 1) / a * a); }
+static inline void heap_caps_free(void *p) { free(p); }
+""",
+    "esp_timer.h": """#pragma once
+#include <stdint.h>
+#include <time.h>
+static inline int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+""",
+    "freertos/FreeRTOS.h": """#pragma once
+#include <stdint.h>
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xffffffffu
+/* One process-wide lock: only guards one-time lazy init here */
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#ifdef __cplusplus
+extern "C" {
+#endif
+void host_critical(int enter);
+#ifdef __cplusplus
+}
+#endif
+#define portENTER_CRITICAL(mux) ((void)(mux), host_critical(1))
+#define portEXIT_CRITICAL(mux) ((void)(mux), host_critical(0))
+""",
+    "freertos/task.h": """#pragma once
+#include "freertos/FreeRTOS.h"
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#ifdef __cplusplus
+extern "C" {
+#endif
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+#ifdef __cplusplus
+}
+#endif
+""",
+    "freertos/semphr.h": """#pragma once
+#include "freertos/FreeRTOS.h"
+typedef void *SemaphoreHandle_t;
+#ifdef __cplusplus
+extern "C" {
+#endif
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+#ifdef __cplusplus
+}
+#endif
+""",
+    # Tasks are detached threads; semaphores and task notifications are
+    # counters (waits are unbounded, which is all jpeg_dec.cpp uses)
+    "freertos_host.cpp": """#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+struct host_sem_t {
+    std::mutex              m;
+    std::condition_variable cv;
+    unsigned                count;
+};
+
+static thread_local host_sem_t *t_notify = nullptr;
+
+static host_sem_t *sem_new(unsigned count)
+{
+    host_sem_t *s = new host_sem_t;
+    s->count = count;
+    return s;
+}
+
+extern "C" {
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return sem_new(1); }
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return sem_new(0); }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) { (void)max; return sem_new(initial); }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete (host_sem_t *)sem; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    host_sem_t *s = (host_sem_t *)sem;
+    std::unique_lock<std::mutex> lock(s->m);
+    (void)wait;
+    s->cv.wait(lock, [s] { return s->count > 0; });
+    s->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    host_sem_t *s = (host_sem_t *)sem;
+    {
+        std::lock_guard<std::mutex> lock(s->m);
+        s->count++;
+    }
+    s->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)name; (void)stack; (void)prio; (void)core;
+    host_sem_t *notify = sem_new(0);
+    if (out) *out = notify;
+    std::thread([=] { t_notify = notify; fn(arg); }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) { (void)task; }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait)
+{
+    (void)clear;
+    xSemaphoreTake(t_notify, wait);
+    return 1;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) { return xSemaphoreGive(task); }
+
+static std::recursive_mutex s_critical;
+void host_critical(int enter) { if (enter) s_critical.lock(); else s_critical.unlock(); }
+
+}
+""",
+}
+
+CFLAGS = ["-O2", "-fno-tree-vectorize", "-fno-tree-slp-vectorize"]
+
+BUILDS = [
+    ("component", [os.path.join(TJPGD_COMPONENT, "tjpgd.c")], ["-I", TJPGD_COMPONENT]),
+    ("local ref", [os.path.join(REPO, "main", "tjpgd_local.c"), os.path.join(REPO, "main", "tjpgd_kern.cpp")],
+     ["-DTJPGD_CHECK_LOCAL=1", "-DTJPGD_KERN_FAST=0"]),
+    ("local fast", [os.path.join(REPO, "main", "tjpgd_local.c"), os.path.join(REPO, "main", "tjpgd_kern.cpp")],
+     ["-DTJPGD_CHECK_LOCAL=1", "-DTJPGD_KERN_FAST=1"]),
+]
+
+# ppm.cpp is only there for jpeg_thumb_luma(): --gc-sections drops the rest
+# and with it every reference to sd_writer / resample / esp_jpeg
+JPEG_DEC_SOURCES = [os.path.join(TOOLS, "jpeg_dec_check.cpp"), os.path.join(REPO, "main", "jpeg_dec.cpp"),
+                    os.path.join(REPO, "main", "ppm.cpp"),
+                    os.path.join(REPO, "main", "tjpgd_local.c"), os.path.join(REPO, "main", "tjpgd_kern.cpp")]
+JPEG_DEC_FLAGS = ["-DTJPGD_KERN_FAST=1", "-ffunction-sections", "-fdata-sections",
+                  "-I", os.path.join(REPO, "managed_components", "espressif__esp_jpeg", "include")]
+
+FRAME_W, FRAME_H = 320, 240
+
+# Restart intervals of the band re-encodes: (name, subsampling, Pillow option)
+RST_ENCODES = [
+    ("rst1row_422", "4:2:2", {"restart_marker_rows": 1}),
+    ("rst1row_420", "4:2:0", {"restart_marker_rows": 1}),
+    ("rst7mcu_422", "4:2:2", {"restart_marker_blocks": 7}),
+    ("norst_422",   "4:2:2", {}),
+]
+
+
+def list_images(root):
+    out = []
+    for dirpath, _, files in os.walk(root):
+        for name in sorted(files):
+            if name.lower().endswith((".jpg", ".jpeg")):
+                out.append(os.path.join(dirpath, name))
+    return sorted(out)
+
+
+def qvga_frame(path):
+    """Centre 4:3 crop of the image at QVGA."""
+    img = Image.open(path).convert("RGB")
+    w, h = img.size
+    cw, ch = min(w, h * FRAME_W // FRAME_H), min(h, w * FRAME_H // FRAME_W)
+    box = ((w - cw) // 2, (h - ch) // 2, (w + cw) // 2, (h + ch) // 2)
+    return img.resize((FRAME_W, FRAME_H), Image.LANCZOS, box=box)
+
+
+def base_name(path, root):
+    return os.path.splitext(os.path.relpath(path, root))[0].replace(os.sep, "_")
+
+
+def encode_qvga(path, root, out_dir):
+    """QVGA JPEGs of the image, 4:2:2 (camera) and 4:2:0."""
+    frame = qvga_frame(path)
+    out = []
+    for sub in ("4:2:2", "4:2:0"):
+        dst = os.path.join(out_dir, "%s_%s.jpg" % (base_name(path, root), sub.replace(":", "")))
+        frame.save(dst, quality=80, subsampling=sub)
+        out.append(dst)
+    return out
+
+
+def encode_rst(path, root, out_dir):
+    """QVGA JPEGs of the image with each restart interval of RST_ENCODES."""
+    frame = qvga_frame(path)
+    out = []
+    for name, sub, opts in RST_ENCODES:
+        dst = os.path.join(out_dir, "%s_%s.jpg" % (base_name(path, root), name))
+        frame.save(dst, quality=80, subsampling=sub, **opts)
+        out.append(dst)
+    return out
+
+
+def link(work, inc, exe, sources, defs, ldflags=()):
+    objs = []
+    for src in sources:
+        obj = os.path.join(work, "%s_%s.o" % (os.path.basename(exe), os.path.basename(src)))
+        cc = ["gcc", "-std=gnu11"] if src.endswith(".c") else ["g++", "-std=gnu++17"]
+        subprocess.run(cc + CFLAGS + defs + ["-I", inc, "-I", os.path.join(REPO, "main"), "-c", src, "-o", obj],
+                       check=True)
+        objs.append(obj)
+    subprocess.run(["g++"] + objs + list(ldflags) + ["-pthread", "-o", exe], check=True)
+
+
+def build(work):
+    """The three TJpgDec builds, then the jpeg_dec.cpp driver."""
+    inc = os.path.join(work, "include")
+    os.makedirs(os.path.join(inc, "freertos"), exist_ok=True)
+    for name, text in STUBS.items():
+        with open(os.path.join(inc, name), "w") as f:
+            f.write(text)
+
+    exes = []
+    for name, sources, defs in BUILDS:
+        exe = os.path.join(work, "tjpgd_check_" + name.replace(" ", "_"))
+        link(work, inc, exe, [os.path.join(TOOLS, "tjpgd_check.cpp")] + sources, defs)
+        exes.append((name, exe))
+
+    dec_exe = os.path.join(work, "jpeg_dec_check")
+    link(work, inc, dec_exe, JPEG_DEC_SOURCES + [os.path.join(inc, "freertos_host.cpp")], JPEG_DEC_FLAGS,
+         ["-Wl,--gc-sections"])
+    return exes, dec_exe
+
+
+def run(exe, files, repeats, kern):
+    """{(file, scale): (size, hash)}, total decode time per scale, exit code."""
+    cmd = [exe, "-r", str(repeats)]
+    if kern:
+        cmd += ["-k", str(kern)]
+    proc = subprocess.run(cmd + files, stdout=subprocess.PIPE, universal_newlines=True)
+
+    results = {}
+    us = [0, 0, 0, 0]
+    for line in proc.stdout.splitlines():
+        path, scale, rest = line.split(" ", 2)
+        scale = int(scale)
+        if rest.startswith("error"):
+            results[(path, scale)] = (rest, None)
+            continue
+        size, digest, t = rest.split()
+        results[(path, scale)] = (size, digest)
+        us[scale] += int(t)
+    return results, us, proc.returncode
+
+
+def check_bands(exe, files, repeats):
+    """jpeg_dec_check bands: False on any mismatch or error."""
+    proc = subprocess.run([exe, "bands", "-r", str(repeats)] + files, stdout=subprocess.PIPE,
+                          universal_newlines=True)
+    ok = proc.returncode == 0
+
+    # per restart layout: files, split checks, bad, single us, two-core us
+    stats = {}
+    for line in proc.stdout.splitlines():
+        f = line.split()
+        if f[1] == "error":
+            print("  %s: error %s" % (f[0], f[2]))
+            ok = False
+            continue
+        kv = dict(zip(f[2::2], f[3::2]))
+        layout = os.path.splitext(f[0])[0].rsplit("_", 2)[-2:]
+        s = stats.setdefault("_".join(layout), [0, 0, 0, 0, 0, 0])
+        s[0] += 1
+        s[1] += int(kv["splits"])
+        s[2] += int(kv["bad"])
+        s[3] += int(kv["split"]) > 0
+        s[4] += int(kv["single"])
+        s[5] += int(kv["par"])
+        if int(kv["bad"]):
+            print("  %s: %s mismatched band decodes" % (f[0], kv["bad"]))
+
+    print("  %-12s %5s %7s %4s %9s %12s %12s" % ("", "files", "splits", "bad", "two-core", "single ms", "parallel ms"))
+    for layout, s in sorted(stats.items()):
+        print("  %-12s %5d %7d %4d %9d %12.1f %12.1f" % (layout, s[0], s[1], s[2], s[3], s[4] / 1000.0, s[5] / 1000.0))
+        ok = ok and s[2] == 0
+    return ok
+
+
+def check_contexts(exe, files, rounds, threads):
+    """jpeg_dec_check contexts: False on any mismatch or error."""
+    proc = subprocess.run([exe, "contexts", "-r", str(rounds), "-t", str(threads)] + files,
+                          stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+    ok = proc.returncode == 0
+
+    decodes = bad = stress = stress_bad = 0
+    for line in proc.stdout.splitlines():
+        f = line.split()
+        if f[0] == "thread":
+            decodes += int(f[3])
+            bad += int(f[5])
+            if int(f[5]):
+                print("  thread %s: %s of %s decodes mismatched" % (f[1], f[5], f[3]))
+        elif f[1] == "stress":
+            stress += 1
+            if f[2] != "ok":
+                stress_bad += 1
+                print("  %s: jpeg_dec_stress failed" % f[0])
+        else:
+            print("  %s: error %s" % (f[0], f[2]))
+            ok = False
+
+    print("  %d threads: %d concurrent decodes, %s" % (threads, decodes, "all identical" if not bad else "MISMATCHES"))
+    print("  jpeg_dec_stress: %d of %d files pass" % (stress - stress_bad, stress))
+    if not ok:
+        sys.stderr.write(proc.stderr)
+    return ok and not bad and not stress_bad and stress == len(files)
+
+
+def check_thumb(component_exe, dec_exe, sets, repeats):
+    """jpeg_thumb_luma() vs the component's 1/8 luma: False on any mismatch."""
+    ok = True
+    for set_name, files in sets:
+        ref = subprocess.run([component_exe, "-y"] + files, stdout=subprocess.PIPE, universal_newlines=True)
+        got = subprocess.run([dec_exe, "thumb", "-r", str(repeats)] + files, stdout=subprocess.PIPE,
+                             universal_newlines=True)
+        ok = ok and ref.returncode == 0 and got.returncode == 0
+
+        expect = {}
+        for line in ref.stdout.splitlines():
+            f = line.split()
+            expect[f[0]] = f[2:4]
+
+        same = 0
+        t_full = t_thumb = 0
+        for line in got.stdout.splitlines():
+            f = line.split()
+            if f[1] == "error" or expect.get(f[0]) != f[2:4]:
+                print("  %s: thumbnail differs from the component 1/8 decode" % f[0])
+                ok = False
+                continue
+            same += 1
+            t_full += int(f[5])
+            t_thumb += int(f[7])
+
+        ok = ok and same == len(files)
+        print("  %-6s %d of %d thumbnails identical; full RGB888 %.1f ms, thumbnail %.1f ms (x%.1f)"
+              % (set_name, same, len(files), t_full / 1000.0, t_thumb / 1000.0,
+                 float(t_full) / t_thumb if t_thumb else 0.0))
+    return ok
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Local TJpgDec vs esp_jpeg tjpgd.c: bit-exactness and decode time")
+    ap.add_argument("--images", default=os.path.join(REPO, "images"), help="image tree (default: images/)")
+    ap.add_argument("--repeats", type=int, default=20, help="decodes per file and scale, best one is timed")
+    ap.add_argument("--kern", type=int, default=0, metavar="N", help="also run tjpgd_kern_benchmark(N)")
+    ap.add_argument("--no-qvga", action="store_true", help="skip the QVGA re-encodes and the jpeg_dec checks")
+    ap.add_argument("--threads", type=int, default=4, help="concurrent decoder contexts")
+    ap.add_argument("--rounds", type=int, default=2, help="passes over all files per context thread")
+    ap.add_argument("--keep", metavar="DIR", help="build and write re-encodes into DIR and keep them")
+    args = ap.parse_args()
+
+    images = list_images(args.images)
+    if not images:
+        sys.exit("no JPEG files under %s" % args.images)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        work = args.keep or tmp
+        sets = [("images", images)]
+        if not args.no_qvga:
+            qvga_dir = os.path.join(work, "qvga")
+            os.makedirs(qvga_dir, exist_ok=True)
+            sets.append(("QVGA", [q for p in images for q in encode_qvga(p, args.images, qvga_dir)]))
+
+        exes, dec_exe = build(work)
+        failed = False
+
+        for set_name, files in sets:
+            print("%s: %d files, scales 1/1..1/8, best of %d" % (set_name, len(files), args.repeats))
+            ref = None
+            times = []
+            for name, exe in exes:
+                # the kernel benchmark times both kernel sets itself: run it once
+                kern = args.kern if set_name == "images" and name == "local fast" else 0
+                results, us, rc = run(exe, files, args.repeats, kern)
+                times.append((name, us))
+                failed = failed or rc != 0
+
+                errors = [k for k, v in results.items() if v[1] is None]
+                for path, scale in errors:
+                    print("  %s: %s 1/%d: %s" % (name, path, 1 << scale, results[(path, scale)][0]))
+                failed = failed or bool(errors)
+
+                if ref is None:
+                    ref = results
+                    continue
+                diff = sorted(k for k in ref if results.get(k) != ref[k])
+                for path, scale in diff:
+                    print("  %s differs from %s: %s 1/%d" % (name, exes[0][0], path, 1 << scale))
+                print("  %-10s vs %s: %d of %d outputs identical" % (name, exes[0][0], len(ref) - len(diff), len(ref)))
+                failed = failed or bool(diff)
+
+            print("  %-10s %10s %10s %10s %10s  (total ms)" % ("", "1/1", "1/2", "1/4", "1/8"))
+            for name, us in times:
+                print("  %-10s %s" % (name, " ".join("%10.1f" % (t / 1000.0) for t in us)))
+
+        if not args.no_qvga:
+            rst_dir = os.path.join(work, "rst")
+            os.makedirs(rst_dir, exist_ok=True)
+            rst_files = [q for p in images for q in encode_rst(p, args.images, rst_dir)]
+
+            print("jpeg_dec bands: %d QVGA files, split at every restart boundary and two-core, best of %d"
+                  % (len(rst_files), args.repeats))
+            failed = not check_bands(dec_exe, rst_files, args.repeats) or failed
+
+            all_files = images + sets[1][1] + rst_files
+            print("jpeg_dec contexts: %d files, scales 1/1..1/8, %d rounds" % (len(all_files), args.rounds))
+            failed = not check_contexts(dec_exe, all_files, args.rounds, args.threads) or failed
+
+            print("jpeg_dec thumb: jpeg_thumb_luma() vs component 1/8 decode, best of %d" % args.repeats)
+            failed = not check_thumb(exes[0][1], dec_exe, sets, args.repeats) or failed
+
+        sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()